@@ -0,0 +1,269 @@
+//
+// Google Benchmark suite for the tensor kernels, the Dense layer and the environments.
+//
+// ./bench_tensor --benchmark_out=bench.json --benchmark_out_format=json records a run;
+// the JSON context carries the active ISA and thread count so runs can be compared.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "utec/agent/EnvGym.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/reduction.h"
+#include "utec/algebra/tensor.h"
+#include "utec/nn/dense.h"
+
+using utec::algebra::Tensor;
+
+namespace {
+
+template<typename T, size_t N>
+void fill_pattern(Tensor<T, N>& t) {
+  for (size_t i = 0; i < t.size(); ++i) t.data()[i] = T(std::sin(double(i)) * 0.5);
+}
+
+void set_flops(benchmark::State& state, double per_iteration) {
+  state.counters["FLOPS"] = benchmark::Counter(per_iteration, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// ------------------------------------------------ matrix_product
+
+void BM_MatrixProduct(benchmark::State& state) {
+  const size_t m = size_t(state.range(0)), k = size_t(state.range(1)), n = size_t(state.range(2));
+  Tensor<float, 2> a(m, k), b(k, n), c(m, n);
+  fill_pattern(a);
+  fill_pattern(b);
+  for (auto _ : state) {
+    utec::algebra::matrix_product(a, b, c);
+    benchmark::DoNotOptimize(c.data());
+    benchmark::ClobberMemory();
+  }
+  set_flops(state, 2.0 * double(m) * double(k) * double(n));
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t((m * k + k * n + m * n) * sizeof(float)));
+}
+// Square shapes, then (batch, in) x (in, out) products of a 784-128 layer.
+BENCHMARK(BM_MatrixProduct)
+    ->ArgNames({"m", "k", "n"})
+    ->Args({64, 64, 64})
+    ->Args({128, 128, 128})
+    ->Args({256, 256, 256})
+    ->Args({512, 512, 512})
+    ->Args({1024, 1024, 1024})
+    ->Args({1, 784, 128})
+    ->Args({32, 784, 128})
+    ->Args({256, 784, 128})
+    ->Args({1024, 784, 128})
+    ->Unit(benchmark::kMicrosecond);
+
+void BM_BatchedMatrixProduct(benchmark::State& state) {
+  const size_t batch = size_t(state.range(0)), n = size_t(state.range(1));
+  Tensor<float, 3> a(batch, n, n), b(batch, n, n), c(batch, n, n);
+  fill_pattern(a);
+  fill_pattern(b);
+  for (auto _ : state) {
+    utec::algebra::matrix_product(a, b, c);
+    benchmark::DoNotOptimize(c.data());
+    benchmark::ClobberMemory();
+  }
+  set_flops(state, 2.0 * double(batch) * double(n) * double(n) * double(n));
+}
+BENCHMARK(BM_BatchedMatrixProduct)
+    ->ArgNames({"batch", "n"})
+    ->Args({8, 32})
+    ->Args({64, 32})
+    ->Args({16, 128})
+    ->Unit(benchmark::kMicrosecond);
+
+// ------------------------------------------------ elementwise, transpose, reshape, copy
+
+void BM_Add(benchmark::State& state) {
+  const size_t rows = size_t(state.range(0)), cols = size_t(state.range(1));
+  Tensor<float, 2> a(rows, cols), b(rows, cols), c(rows, cols);
+  fill_pattern(a);
+  fill_pattern(b);
+  for (auto _ : state) {
+    c = a + b;
+    benchmark::DoNotOptimize(c.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(3 * rows * cols * sizeof(float)));
+}
+BENCHMARK(BM_Add)->ArgNames({"rows", "cols"})->Args({256, 256})->Args({1024, 1024})->Args({4096, 1024});
+
+// (rows, cols) + (1, cols): the bias-add pattern.
+void BM_AddBroadcast(benchmark::State& state) {
+  const size_t rows = size_t(state.range(0)), cols = size_t(state.range(1));
+  Tensor<float, 2> a(rows, cols), b(1, cols), c(rows, cols);
+  fill_pattern(a);
+  fill_pattern(b);
+  for (auto _ : state) {
+    c = a + b;
+    benchmark::DoNotOptimize(c.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(2 * rows * cols * sizeof(float)));
+}
+BENCHMARK(BM_AddBroadcast)->ArgNames({"rows", "cols"})->Args({256, 256})->Args({1024, 1024})->Args({4096, 1024});
+
+// a * 2 + b: one fused pass over two inputs.
+void BM_ScaleAdd(benchmark::State& state) {
+  const size_t n = size_t(state.range(0));
+  Tensor<float, 1> a(n), b(n), c(n);
+  fill_pattern(a);
+  fill_pattern(b);
+  for (auto _ : state) {
+    c = a * 2.0f + b;
+    benchmark::DoNotOptimize(c.data());
+    benchmark::ClobberMemory();
+  }
+  set_flops(state, 2.0 * double(n));
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(3 * n * sizeof(float)));
+}
+BENCHMARK(BM_ScaleAdd)->ArgName("n")->Arg(1 << 12)->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 24);
+
+void BM_Transpose2D(benchmark::State& state) {
+  const size_t rows = size_t(state.range(0)), cols = size_t(state.range(1));
+  Tensor<float, 2> a(rows, cols);
+  fill_pattern(a);
+  for (auto _ : state) {
+    auto t = utec::algebra::transpose_2d(a);
+    benchmark::DoNotOptimize(t.data());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(2 * rows * cols * sizeof(float)));
+}
+BENCHMARK(BM_Transpose2D)->ArgNames({"rows", "cols"})->Args({256, 256})->Args({1024, 1024})->Args({4096, 512})->Args({37, 10007});
+
+// Same element count, new shape: only the metadata should change.
+void BM_Reshape(benchmark::State& state) {
+  const size_t n = size_t(state.range(0));
+  Tensor<float, 2> a(n, n);
+  for (auto _ : state) {
+    a.reshape(n * n / 4, 4);
+    a.reshape(n, n);
+    benchmark::DoNotOptimize(a.data());
+  }
+}
+BENCHMARK(BM_Reshape)->ArgName("n")->Arg(64)->Arg(1024);
+
+void BM_Copy(benchmark::State& state) {
+  const size_t n = size_t(state.range(0));
+  Tensor<float, 1> a(n), b(n);
+  fill_pattern(a);
+  for (auto _ : state) {
+    b = a;
+    benchmark::DoNotOptimize(b.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(2 * n * sizeof(float)));
+}
+BENCHMARK(BM_Copy)->ArgName("n")->Arg(1 << 12)->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 24);
+
+void BM_SumAxis(benchmark::State& state) {
+  const size_t rows = size_t(state.range(0)), cols = size_t(state.range(1));
+  const size_t axis = size_t(state.range(2));
+  Tensor<float, 2> a(rows, cols), out;
+  fill_pattern(a);
+  for (auto _ : state) {
+    utec::algebra::sum(a, axis, out);
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(rows * cols * sizeof(float)));
+}
+BENCHMARK(BM_SumAxis)->ArgNames({"rows", "cols", "axis"})->Args({4096, 1024, 0})->Args({4096, 1024, 1});
+
+// ------------------------------------------------ Dense layer
+
+using DenseReLU = utec::neural_network::Dense<float, utec::neural_network::ReLU>;
+
+void BM_DenseForward(benchmark::State& state) {
+  const size_t batch = size_t(state.range(0)), in = size_t(state.range(1)), out = size_t(state.range(2));
+  DenseReLU layer(in, out);
+  Tensor<float, 2> x(batch, in);
+  fill_pattern(x);
+  for (auto _ : state) {
+    const auto& y = layer.forward(x);
+    benchmark::DoNotOptimize(y.data());
+  }
+  set_flops(state, 2.0 * double(batch) * double(in) * double(out));
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(batch));
+}
+BENCHMARK(BM_DenseForward)
+    ->ArgNames({"batch", "in", "out"})
+    ->Args({1, 784, 128})
+    ->Args({32, 784, 128})
+    ->Args({256, 784, 128})
+    ->Args({256, 128, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+// dW, db and dx: about twice the forward FLOPs.
+void BM_DenseBackward(benchmark::State& state) {
+  const size_t batch = size_t(state.range(0)), in = size_t(state.range(1)), out = size_t(state.range(2));
+  DenseReLU layer(in, out);
+  Tensor<float, 2> x(batch, in), grad(batch, out);
+  fill_pattern(x);
+  fill_pattern(grad);
+  layer.forward(x);
+  for (auto _ : state) {
+    const auto& dx = layer.backward(grad);
+    benchmark::DoNotOptimize(dx.data());
+  }
+  set_flops(state, 4.0 * double(batch) * double(in) * double(out));
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(batch));
+}
+BENCHMARK(BM_DenseBackward)
+    ->ArgNames({"batch", "in", "out"})
+    ->Args({1, 784, 128})
+    ->Args({32, 784, 128})
+    ->Args({256, 784, 128})
+    ->Args({256, 128, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+// ------------------------------------------------ environments (items = env steps)
+
+void BM_EnvGymStep(benchmark::State& state) {
+  utec::agent::EnvGym env;
+  env.reset();
+  float reward = 0;
+  bool done = false;
+  int action = -1;
+  for (auto _ : state) {
+    const auto s = env.step(action, reward, done);
+    benchmark::DoNotOptimize(s);
+    if (done) env.reset();
+    action = action == 1 ? -1 : action + 1;
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_EnvGymStep);
+
+void BM_VectorEnvStep(benchmark::State& state) {
+  const size_t envs = size_t(state.range(0));
+  utec::agent::VectorEnv env(envs);
+  env.reset();
+  std::vector<int> actions(envs);
+  for (size_t i = 0; i < envs; ++i) actions[i] = int(i % 3) - 1;
+  for (auto _ : state) {
+    const auto& observations = env.step(actions);
+    benchmark::DoNotOptimize(observations.data());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(envs));
+}
+BENCHMARK(BM_VectorEnvStep)->ArgName("envs")->Arg(1)->Arg(64)->Arg(1024);
+
+}
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::AddCustomContext("utec_isa", utec::algebra::dispatch::name(utec::algebra::dispatch::active()));
+  benchmark::AddCustomContext("utec_threads", std::to_string(utec::algebra::parallel::num_threads()));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -5,4 +5,88 @@
 #ifndef ENVGYM_H
 #define ENVGYM_H
 
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <span>
+
+#include "utec/algebra/tensor.h"
+
+namespace utec::agent {
+
+using algebra::Tensor;
+
+// Single-player Pong on the unit square. The ball bounces off the top, bottom and left
+// walls; the agent's paddle sits on the right edge and moves by action * paddle_speed
+// (action in {-1, 0, 1}). Returning the ball gives reward 1, missing it gives -1 and
+// ends the episode.
+struct State {
+  float ball_x;
+  float ball_y;
+  float ball_vx;
+  float ball_vy;
+  float paddle_y;
+};
+
+inline constexpr size_t state_dim = 5;
+inline constexpr float paddle_half_height = 0.1f;
+inline constexpr float paddle_speed = 0.04f;
+inline constexpr float ball_speed = 0.03f;
+
+// Writes a state as one state_dim row of an observation matrix.
+inline void write_state(const State& s, float* row) {
+  row[0] = s.ball_x;
+  row[1] = s.ball_y;
+  row[2] = s.ball_vx;
+  row[3] = s.ball_vy;
+  row[4] = s.paddle_y;
+}
+
+class EnvGym {
+ private:
+  State state_{};
+  std::mt19937 engine_;
+
+ public:
+  explicit EnvGym(unsigned seed = 42);
+
+  State reset();
+  State step(int action, float& reward, bool& done);
+  const State& state() const { return state_; }
+};
+
+// B environments advanced in lockstep. The state is stored structure-of-arrays, one
+// contiguous row of B values per state component, so step() is a single vectorized
+// pass over all environments. observations() is the (B, state_dim) matrix the network's
+// batched forward expects. Environments whose episode ended in a step are reset before
+// the step returns; dones() flags them.
+class VectorEnv {
+ private:
+  Tensor<float, 2> state_;
+  Tensor<float, 2> observation_;
+  Tensor<float, 1> rewards_;
+  Tensor<float, 1> dones_;
+  std::mt19937 engine_;
+
+  void reset_env(size_t i);
+  void observe();
+
+ public:
+  explicit VectorEnv(size_t envs, unsigned seed = 42);
+
+  size_t size() const { return rewards_.size(); }
+
+  const Tensor<float, 2>& reset();
+  // actions[i] in {-1, 0, 1} for environment i.
+  const Tensor<float, 2>& step(std::span<const int> actions);
+
+  const Tensor<float, 2>& observations() const { return observation_; }
+  // Reward of the last step and 1 where that step ended the episode, 0 otherwise.
+  const Tensor<float, 1>& rewards() const { return rewards_; }
+  const Tensor<float, 1>& dones() const { return dones_; }
+};
+
+}
+
 #endif //ENVGYM_H
@@ -5,4 +5,129 @@
 #ifndef PONGAGENT_H
 #define PONGAGENT_H
 
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "utec/agent/EnvGym.h"
+#include "utec/agent/replay_buffer.h"
+#include "utec/nn/inference.h"
+#include "utec/nn/neural_network.h"
+#include "utec/nn/quantized_network.h"
+
+namespace utec::agent {
+
+using neural_network::FrozenNetwork;
+using neural_network::IOptimizer;
+using neural_network::NeuralNetwork;
+using neural_network::QuantizedNetwork;
+
+inline constexpr size_t num_actions = 3;
+
+// Read-only copy of a network's parameter values, in NeuralNetwork::parameters() order.
+struct WeightsSnapshot {
+  size_t version = 0;
+  std::vector<Tensor<float, 2>> values;
+};
+
+// Copies the snapshot's values into network, whose parameters must match them.
+void copy_weights(const WeightsSnapshot& snapshot, NeuralNetwork<float>& network);
+
+// Plays Pong with a network mapping a State to one score per action (-1, 0, 1); act
+// picks the highest. The agent owns its network and activation buffers, so each
+// thread needs its own agent; weights are shared through snapshots.
+//
+// After freeze(), act runs a FrozenNetwork copy instead: packed GEMV kernels over
+// preallocated buffers, with no allocation and no checks per call. load() keeps the
+// frozen copy in sync; after changing network() directly, call freeze() again.
+//
+// After quantize(), act runs an int8 QuantizedNetwork instead (and ahead of a frozen
+// copy), calibrated on the given states. load() quantizes the new weights with the
+// same calibration states.
+class PongAgent {
+ private:
+  NeuralNetwork<float> network_;
+  Tensor<float, 2> observation_;
+  std::unique_ptr<FrozenNetwork<float>> frozen_;
+  std::unique_ptr<QuantizedNetwork<float>> quantized_;
+  Tensor<float, 2> calibration_;
+  size_t version_ = 0;
+
+ public:
+  explicit PongAgent(NeuralNetwork<float> network);
+
+  int act(const State& state);
+
+  void freeze();
+  bool frozen() const { return frozen_ != nullptr; }
+
+  // calibration should cover the states the agent will see, e.g. a recorded episode.
+  void quantize(const std::vector<State>& calibration);
+  bool quantized() const { return quantized_ != nullptr; }
+  const QuantizedNetwork<float>* quantized_network() const { return quantized_.get(); }
+
+  NeuralNetwork<float>& network() { return network_; }
+
+  // Copies the snapshot's values into the network unless it already holds that version.
+  void load(const WeightsSnapshot& snapshot);
+  std::shared_ptr<const WeightsSnapshot> snapshot(size_t version) const;
+  size_t version() const { return version_; }
+};
+
+struct ActorLearnerConfig {
+  size_t actors = 2;
+  size_t steps_per_actor = 20000;
+  size_t queue_capacity = 4096;
+  size_t replay_capacity = 8192;  // most recent transitions the learner samples from
+  bool prioritized = false;       // prioritized replay on |TD error|
+  size_t batch_size = 64;
+  size_t train_every = 4;         // transitions consumed per training step
+  size_t publish_every = 20;      // training steps between weight snapshots
+  float learning_rate = 0.05f;
+  // Builds the learner's optimizer from learning_rate, e.g. SGD with momentum or Adam
+  // with chosen betas; plain SGD when empty. It is built once and keeps its state.
+  std::function<std::unique_ptr<IOptimizer<float>>(float learning_rate)> make_optimizer;
+  float gamma = 0.9f;
+  float epsilon = 0.1f;
+  unsigned seed = 42;
+};
+
+struct ActorLearnerStats {
+  size_t transitions = 0;
+  size_t train_steps = 0;
+  size_t published = 0;
+  size_t episodes = 0;
+  float total_reward = 0;
+};
+
+// Actor threads each run an EnvGym with an epsilon-greedy PongAgent and push the
+// transitions into a lock-free bounded queue. The learner, on the calling thread,
+// drains the queue into a ReplayBuffer, fits the network to one-step Q-learning targets
+// r + gamma * max_a Q(s', a) on minibatches sampled from it, and
+// every publish_every steps swaps in a new WeightsSnapshot through an atomic
+// shared_ptr. Actors pick it up at the start of their next frame, so acting never waits
+// for learning and vice versa.
+class ActorLearner {
+ private:
+  std::function<NeuralNetwork<float>()> make_network_;
+  ActorLearnerConfig config_;
+  PongAgent learner_;
+  std::atomic<std::shared_ptr<const WeightsSnapshot>> published_;
+
+ public:
+  // make_network builds an untrained network; it is called once per actor and once
+  // for the learner, and all of them start from the learner's weights.
+  ActorLearner(std::function<NeuralNetwork<float>()> make_network, ActorLearnerConfig config = {});
+
+  ActorLearnerStats run();
+
+  PongAgent& agent() { return learner_; }
+};
+
+}
+
 #endif //PONGAGENT_H
@@ -0,0 +1,91 @@
+//
+// Lock-free bounded multi-producer multi-consumer queue.
+//
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace utec::agent {
+
+// Fixed ring of cells, each tagged with a sequence number (Vyukov's bounded queue). A
+// producer claims a slot with one CAS on the tail and publishes it by bumping the
+// cell's sequence; a consumer does the same on the head. Neither blocks: try_push fails
+// when the ring is full and try_pop when it is empty.
+template<typename T>
+class bounded_queue {
+ private:
+  static constexpr size_t line = 64;
+
+  struct cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<cell[]> cells_;
+  size_t mask_;
+  alignas(line) std::atomic<size_t> tail_{0};
+  alignas(line) std::atomic<size_t> head_{0};
+
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit bounded_queue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    cells_ = std::make_unique<cell[]>(size);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bounded_queue(const bounded_queue&) = delete;
+  bounded_queue& operator=(const bounded_queue&) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  bool try_push(const T& value) {
+    size_t position = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells_[position & mask_];
+      const size_t sequence = c.sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          c.value = value;
+          c.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (sequence < position) {
+        return false;
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T& value) {
+    size_t position = head_.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells_[position & mask_];
+      const size_t sequence = c.sequence.load(std::memory_order_acquire);
+      if (sequence == position + 1) {
+        if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          value = c.value;
+          c.sequence.store(position + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (sequence < position + 1) {
+        return false;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+}
+
+#endif //BOUNDED_QUEUE_H
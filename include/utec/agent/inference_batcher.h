@@ -0,0 +1,226 @@
+//
+// Coalesces inference requests from many coroutines into batched forward passes.
+//
+
+#ifndef INFERENCE_BATCHER_H
+#define INFERENCE_BATCHER_H
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "utec/agent/EnvGym.h"
+#include "utec/agent/PongAgent.h"
+#include "utec/agent/scheduler.h"
+#include "utec/agent/task.h"
+#include "utec/algebra/reduction.h"
+#include "utec/nn/neural_network.h"
+
+namespace utec::agent {
+
+struct InferenceBatcherConfig {
+  size_t max_batch = 64;                        // a batch runs as soon as it holds this many requests
+  std::chrono::microseconds max_latency{200};   // or this long after its oldest request arrived
+};
+
+struct InferenceBatcherStats {
+  size_t requests = 0;
+  size_t batches = 0;
+  size_t largest_batch = 0;
+};
+
+// Serves co_await infer(input, output) from any number of coroutines on a scheduler
+// with one network: requests wait in a pending batch, which runs as a single
+// NeuralNetwork::forward (one matrix_product per Dense for all of its rows) when it
+// is full or when its oldest request has waited max_latency, whichever comes first.
+// A full batch runs on the thread whose request filled it and an overdue one on a
+// worker woken by a timer; either way the requesters are then posted back to the pool
+// with their output rows written.
+//
+// load() and update() change the network between batches, so a learner can publish
+// weights while actors keep requesting. The batcher must outlive the requests made to
+// it; its destructor waits for pending latency timers.
+class InferenceBatcher {
+ private:
+  using clock = scheduler::clock;
+
+  struct request {
+    const float* input;
+    float* output;
+    std::coroutine_handle<> waiter;
+    std::exception_ptr* error;
+    clock::time_point arrived;
+  };
+
+  scheduler& scheduler_;
+  NeuralNetwork<float> network_;
+  InferenceBatcherConfig config_;
+  size_t inputs_;
+  size_t outputs_ = 0;
+  size_t version_ = 0;
+
+  std::mutex model_mutex_;  // guards network_, batch_, running_, version_ and stats_
+  Tensor<float, 2> batch_;
+  std::vector<request> running_;
+  InferenceBatcherStats stats_;
+
+  std::mutex mutex_;  // guards pending_, generation_ and timers_
+  std::condition_variable timers_idle_;
+  std::vector<request> pending_;
+  size_t generation_ = 0;  // bumped whenever requests leave pending_
+  size_t timers_ = 0;
+
+  // Arms a timer that runs the pending batch of this generation once its oldest
+  // request is due, unless the batch has left by then. Needs mutex_.
+  void arm(size_t generation, clock::time_point due) {
+    ++timers_;
+    scheduler_.spawn(flush_at(generation, due));
+  }
+
+  task<void> flush_at(size_t generation, clock::time_point due) {
+    co_await scheduler_.sleep_until(due);
+    run(generation);
+    std::lock_guard lock(mutex_);
+    if (--timers_ == 0) timers_idle_.notify_all();
+  }
+
+  // Runs the pending batch if it is full (no generation) or still the given
+  // generation, then any further full batch; a partial remainder gets a new timer.
+  void run(std::optional<size_t> generation) {
+    std::lock_guard model(model_mutex_);
+    while (true) {
+      {
+        std::lock_guard lock(mutex_);
+        if (pending_.empty()) return;
+        if (generation ? *generation != generation_ : pending_.size() < config_.max_batch) return;
+        const size_t n = std::min(pending_.size(), config_.max_batch);
+        running_.assign(pending_.begin(), pending_.begin() + n);
+        pending_.erase(pending_.begin(), pending_.begin() + n);
+        ++generation_;
+        if (!pending_.empty() && pending_.size() < config_.max_batch)
+          arm(generation_, pending_.front().arrived + config_.max_latency);
+        generation.reset();
+      }
+      forward();
+    }
+  }
+
+  // The batched forward over running_, then resumes its requesters. Needs model_mutex_.
+  void forward() {
+    const size_t n = running_.size();
+    try {
+      if (batch_.shape()[0] != n) batch_ = Tensor<float, 2>(n, inputs_);
+      for (size_t r = 0; r < n; ++r) std::copy_n(running_[r].input, inputs_, batch_.data() + r * inputs_);
+      const Tensor<float, 2>& y = network_.forward(batch_);
+      for (size_t r = 0; r < n; ++r) std::copy_n(y.data() + r * outputs_, outputs_, running_[r].output);
+    } catch (...) {
+      for (auto& r : running_) *r.error = std::current_exception();
+    }
+    stats_.requests += n;
+    ++stats_.batches;
+    stats_.largest_batch = std::max(stats_.largest_batch, n);
+    for (auto& r : running_) scheduler_.post(r.waiter);
+    running_.clear();
+  }
+
+  struct awaiter {
+    InferenceBatcher* owner;
+    const float* input;
+    float* output;
+    std::exception_ptr error;
+
+    bool await_ready() const noexcept { return false; }
+
+    // Once the request is in pending_ another thread may run it and resume the
+    // coroutine, which frees this awaiter, so nothing of it is touched afterwards.
+    void await_suspend(std::coroutine_handle<> h) {
+      InferenceBatcher* batcher = owner;
+      const size_t max_batch = batcher->config_.max_batch;
+      bool full;
+      {
+        std::lock_guard lock(batcher->mutex_);
+        const auto now = clock::now();
+        batcher->pending_.push_back({input, output, h, &error, now});
+        full = batcher->pending_.size() >= max_batch;
+        if (!full && batcher->pending_.size() == 1) batcher->arm(batcher->generation_, now + batcher->config_.max_latency);
+      }
+      if (full) batcher->run(std::nullopt);
+    }
+
+    void await_resume() const {
+      if (error) std::rethrow_exception(error);
+    }
+  };
+
+ public:
+  // inputs is the width of one request; a one-row forward at construction checks it
+  // and finds the output width.
+  InferenceBatcher(scheduler& scheduler, NeuralNetwork<float> network, size_t inputs,
+                   InferenceBatcherConfig config = {})
+      : scheduler_(scheduler), network_(std::move(network)), config_(config), inputs_(inputs), batch_(1, inputs) {
+    if (config_.max_batch == 0 || inputs_ == 0 || config_.max_latency.count() < 0)
+      throw std::runtime_error("Invalid inference batcher configuration");
+    outputs_ = network_.forward(batch_).shape()[1];
+  }
+
+  ~InferenceBatcher() {
+    std::unique_lock lock(mutex_);
+    timers_idle_.wait(lock, [&] { return timers_ == 0; });
+  }
+
+  InferenceBatcher(const InferenceBatcher&) = delete;
+  InferenceBatcher& operator=(const InferenceBatcher&) = delete;
+
+  size_t inputs() const { return inputs_; }
+  size_t outputs() const { return outputs_; }
+  const InferenceBatcherConfig& config() const { return config_; }
+
+  // co_await infer(input, output) reads inputs() values and writes outputs() values;
+  // both must stay valid until it completes. Rethrows an error of the forward pass.
+  awaiter infer(const float* input, float* output) { return {this, input, output, nullptr}; }
+
+  // The highest-scoring action (-1, 0, 1) for state, as PongAgent::act.
+  task<int> act(State state) {
+    if (outputs_ != num_actions) throw std::runtime_error("PongAgent network must output one score per action");
+    float observation[state_dim];
+    float scores[num_actions];
+    write_state(state, observation);
+    co_await infer(observation, scores);
+    co_return int(algebra::argmax(algebra::TensorView<const float, 1>(scores, {num_actions}))) - 1;
+  }
+
+  // Copies the snapshot's values into the network between batches, unless it already
+  // holds that version.
+  void load(const WeightsSnapshot& snapshot) {
+    std::lock_guard model(model_mutex_);
+    if (snapshot.version == version_) return;
+    copy_weights(snapshot, network_);
+    version_ = snapshot.version;
+  }
+
+  // fn(network) between batches.
+  template<typename Fn>
+  void update(Fn&& fn) {
+    std::lock_guard model(model_mutex_);
+    fn(network_);
+  }
+
+  InferenceBatcherStats stats() {
+    std::lock_guard model(model_mutex_);
+    return stats_;
+  }
+};
+
+}
+
+#endif //INFERENCE_BATCHER_H
@@ -0,0 +1,193 @@
+//
+// Experience replay stored as structure-of-arrays ring buffers.
+//
+
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "utec/agent/EnvGym.h"
+#include "utec/algebra/simd.h"
+
+namespace utec::agent {
+
+struct Transition {
+  State state;
+  int action;
+  float reward;
+  State next;
+  bool done;
+};
+
+// A minibatch drawn from a ReplayBuffer. The buffers are reused across sample calls.
+// weights holds the importance-sampling corrections of prioritized replay (1 in
+// uniform mode) and indices the sampled slots, for update_priorities.
+struct ReplayBatch {
+  Tensor<float, 2> states;
+  Tensor<float, 2> next_states;
+  Tensor<int, 1> actions;
+  Tensor<float, 1> rewards;
+  Tensor<float, 1> dones;
+  Tensor<float, 1> weights;
+  std::vector<size_t> indices;
+};
+
+// Fixed-capacity replay memory. Each field lives in one preallocated tensor (states and
+// next states as (capacity, state_dim) matrices), and pushing past capacity overwrites
+// the oldest slot. sample() draws all indices first and then gathers the rows with the
+// rows a few iterations ahead prefetched, so the random reads overlap. Capacity must be
+// below 2^32.
+//
+// In prioritized mode slot i is drawn with probability p_i^alpha / sum_j p_j^alpha,
+// using a sum-tree over the priorities (O(log capacity) per draw), and new transitions
+// get the highest priority seen so far.
+class ReplayBuffer {
+ private:
+  static constexpr size_t prefetch_distance = 8;
+
+  Tensor<float, 2> states_;
+  Tensor<float, 2> next_states_;
+  Tensor<int, 1> actions_;
+  Tensor<float, 1> rewards_;
+  Tensor<float, 1> dones_;
+  size_t size_ = 0;
+  size_t next_ = 0;
+
+  bool prioritized_;
+  float alpha_;
+  float max_priority_ = 1.0f;
+  size_t leaves_ = 1;
+  std::vector<float> tree_;  // tree_[1] is the root, leaf i is tree_[leaves_ + i]
+
+  void set_priority(size_t slot, float priority) {
+    size_t node = leaves_ + slot;
+    tree_[node] = std::pow(priority, alpha_);
+    for (node /= 2; node >= 1; node /= 2) tree_[node] = tree_[2 * node] + tree_[2 * node + 1];
+  }
+
+ public:
+  explicit ReplayBuffer(size_t capacity, bool prioritized = false, float alpha = 0.6f)
+      : states_(capacity, state_dim), next_states_(capacity, state_dim), actions_(capacity), rewards_(capacity),
+        dones_(capacity), prioritized_(prioritized), alpha_(alpha) {
+    if (capacity == 0 || capacity > 0xffffffffu) throw std::runtime_error("ReplayBuffer capacity must be in [1, 2^32)");
+    if (prioritized_) {
+      while (leaves_ < capacity) leaves_ *= 2;
+      tree_.assign(2 * leaves_, 0.0f);
+    }
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return rewards_.size(); }
+  bool prioritized() const { return prioritized_; }
+
+  // Sum of p_i^alpha over the stored transitions (prioritized mode).
+  float total_priority() const { return prioritized_ ? tree_[1] : float(size_); }
+
+  void push(const Transition& t) {
+    write_state(t.state, states_.data() + next_ * state_dim);
+    write_state(t.next, next_states_.data() + next_ * state_dim);
+    actions_(next_) = t.action;
+    rewards_(next_) = t.reward;
+    dones_(next_) = t.done ? 1.0f : 0.0f;
+    if (prioritized_) set_priority(next_, max_priority_);
+    next_ = (next_ + 1) % capacity();
+    size_ = std::min(size_ + 1, capacity());
+  }
+
+  // Fills out with batch transitions. In prioritized mode the draws are stratified over
+  // batch equal slices of the total priority, and weights = (size * P(i))^-beta
+  // normalized by the batch maximum.
+  void sample(size_t batch, std::mt19937& engine, ReplayBatch& out, float beta = 0.4f) const {
+    if (size_ == 0) throw std::runtime_error("Cannot sample from an empty ReplayBuffer");
+    if (out.states.shape() != std::array<size_t, 2>{batch, state_dim}) {
+      out.states.reshape(batch, state_dim);
+      out.next_states.reshape(batch, state_dim);
+      out.actions.reshape(batch);
+      out.rewards.reshape(batch);
+      out.dones.reshape(batch);
+      out.weights.reshape(batch);
+    }
+    out.indices.resize(batch);
+
+    if (prioritized_) {
+      // Draw i descends the sum-tree towards cumulative priority (i + u) * segment. All
+      // draws go down one level at a time, so the reads of a level are independent and
+      // their cache misses overlap instead of forming one chain per draw. weights holds
+      // the remaining mass on the way down.
+      const float segment = tree_[1] / float(batch);
+      std::uniform_real_distribution<float> offset(0.0f, 1.0f);
+      for (size_t i = 0; i < batch; ++i) {
+        out.indices[i] = 1;
+        out.weights(i) = (float(i) + offset(engine)) * segment;
+      }
+      for (size_t level = 1; level < leaves_; level *= 2) {
+        for (size_t i = 0; i < batch; ++i) {
+          size_t node = 2 * out.indices[i];
+          const float left = tree_[node];
+          if (out.weights(i) >= left && tree_[node + 1] > 0.0f) {
+            out.weights(i) -= left;
+            ++node;
+          }
+          out.indices[i] = node;
+        }
+      }
+      float max_weight = 0.0f;
+      for (size_t i = 0; i < batch; ++i) {
+        const size_t slot = std::min(out.indices[i] - leaves_, size_ - 1);
+        out.indices[i] = slot;
+        out.weights(i) = std::pow(float(size_) * tree_[leaves_ + slot] / tree_[1], -beta);
+        max_weight = std::max(max_weight, out.weights(i));
+      }
+      for (size_t i = 0; i < batch; ++i) out.weights(i) /= max_weight;
+    } else {
+      // Lemire's multiply-shift maps a 32-bit draw onto [0, size) without a division.
+      static_assert(std::mt19937::max() == 0xffffffffu);
+      for (size_t i = 0; i < batch; ++i) out.indices[i] = size_t((uint64_t(engine()) * size_) >> 32);
+      out.weights.fill(1.0f);
+    }
+
+    const float* states = states_.data();
+    const float* next_states = next_states_.data();
+    float* batch_states = out.states.data();
+    float* batch_next_states = out.next_states.data();
+    for (size_t i = 0; i < batch; ++i) {
+      if (i + prefetch_distance < batch) {
+        const size_t ahead = out.indices[i + prefetch_distance];
+        UTEC_PREFETCH(states + ahead * state_dim);
+        UTEC_PREFETCH(next_states + ahead * state_dim);
+        UTEC_PREFETCH(rewards_.data() + ahead);
+      }
+      const size_t slot = out.indices[i];
+      std::copy_n(states + slot * state_dim, state_dim, batch_states + i * state_dim);
+      std::copy_n(next_states + slot * state_dim, state_dim, batch_next_states + i * state_dim);
+      out.actions.data()[i] = actions_.data()[slot];
+      out.rewards.data()[i] = rewards_.data()[slot];
+      out.dones.data()[i] = dones_.data()[slot];
+    }
+  }
+
+  // New priorities (typically |TD error| + a small epsilon) for the slots of the last
+  // sample; ignored in uniform mode.
+  void update_priorities(const std::vector<size_t>& indices, std::span<const float> priorities) {
+    if (!prioritized_) return;
+    if (indices.size() != priorities.size()) throw std::runtime_error("Number of priorities does not match the batch");
+    for (size_t i = 0; i < indices.size(); ++i) {
+      max_priority_ = std::max(max_priority_, priorities[i]);
+      set_priority(indices[i], priorities[i]);
+    }
+  }
+};
+
+}
+
+#endif //REPLAY_BUFFER_H
@@ -0,0 +1,390 @@
+//
+// Work-stealing coroutine scheduler with timers.
+//
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <semaphore>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utec/agent/task.h"
+
+namespace utec::agent {
+
+namespace detail {
+
+// Fire-and-forget coroutine: started by posting its handle, it frees its own frame
+// when it finishes. Only used to drive tasks from the scheduler; the bodies catch
+// everything, so nothing escapes.
+struct detached {
+  struct promise_type {
+    detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+  std::coroutine_handle<promise_type> handle;
+};
+
+}
+
+// A fixed pool of worker threads resuming coroutines. Each worker has its own deque of
+// ready coroutines: it pushes and pops at the back, so the coroutine it readied last
+// (whose data is still in cache) runs next, and when its deque is empty it steals the
+// oldest entry from the front of another worker's. Coroutines readied from outside the
+// pool go to a shared queue. Idle workers sleep until work arrives or the earliest
+// timer is due. The ready count, the sleeper count and the earliest deadline are
+// atomics, so a busy worker neither posts nor polls timers under a shared lock.
+//
+// Coroutines move onto the pool with co_await schedule(), wait with sleep_for /
+// sleep_until, and are started with spawn (detached), when_all (awaited together) or
+// run (blocking the calling thread). The destructor waits for spawned tasks.
+class scheduler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+ private:
+  struct worker {
+    std::mutex mutex;
+    std::deque<std::coroutine_handle<>> ready;
+  };
+
+  struct timer {
+    clock::time_point due;
+    std::coroutine_handle<> handle;
+    bool operator>(const timer& other) const { return due > other.due; }
+  };
+
+  static constexpr clock::rep no_timer = std::numeric_limits<clock::rep>::max();
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;  // guards timers_ and error_
+  std::condition_variable idle_;
+  std::mutex injected_mutex_;
+  std::deque<std::coroutine_handle<>> injected_;
+  std::priority_queue<timer, std::vector<timer>, std::greater<>> timers_;
+  std::mutex sleep_mutex_;  // held by a worker from its last check for work until it waits; guards stop_
+  std::condition_variable wake_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> sleeping_{0};
+  std::atomic<clock::rep> next_timer_{no_timer};  // due time of timers_.top() since the clock's epoch
+  std::atomic<size_t> spawned_{0};
+  std::atomic<size_t> steals_{0};
+  std::exception_ptr error_;
+  bool stop_ = false;
+
+  static inline thread_local scheduler* current_ = nullptr;
+  static inline thread_local size_t index_ = 0;
+
+  std::optional<std::coroutine_handle<>> pop_front(worker& w) {
+    std::lock_guard lock(w.mutex);
+    if (w.ready.empty()) return std::nullopt;
+    const auto h = w.ready.front();
+    w.ready.pop_front();
+    return h;
+  }
+
+  std::optional<std::coroutine_handle<>> take(size_t self) {
+    {
+      worker& own = *workers_[self];
+      std::lock_guard lock(own.mutex);
+      if (!own.ready.empty()) {
+        const auto h = own.ready.back();
+        own.ready.pop_back();
+        return h;
+      }
+    }
+    {
+      std::lock_guard lock(injected_mutex_);
+      if (!injected_.empty()) {
+        const auto h = injected_.front();
+        injected_.pop_front();
+        return h;
+      }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      if (const auto h = pop_front(*workers_[(self + i) % workers_.size()])) {
+        steals_.fetch_add(1, std::memory_order_relaxed);
+        return h;
+      }
+    }
+    return std::nullopt;
+  }
+
+  static bool is_due(clock::rep deadline) {
+    return deadline != no_timer && deadline <= clock::now().time_since_epoch().count();
+  }
+
+  // Needs mutex_.
+  void publish_next_timer() {
+    next_timer_.store(timers_.empty() ? no_timer : timers_.top().due.time_since_epoch().count());
+  }
+
+  // Posts the coroutines of every timer that is due; only locks when one is.
+  void fire_timers() {
+    if (!is_due(next_timer_.load(std::memory_order_acquire))) return;
+    std::vector<std::coroutine_handle<>> ready;
+    {
+      std::lock_guard lock(mutex_);
+      const auto now = clock::now();
+      while (!timers_.empty() && timers_.top().due <= now) {
+        ready.push_back(timers_.top().handle);
+        timers_.pop();
+      }
+      publish_next_timer();
+    }
+    for (const auto h : ready) post(h);
+  }
+
+  // Called after publishing work or an earlier timer. The publisher's store comes
+  // before its load of sleeping_, and a sleeper increments sleeping_ before it checks
+  // for work, so either the sleeper sees the new work or this sees the sleeper;
+  // sleep_mutex_ then holds the notification back until that sleeper is waiting.
+  void wake_one() {
+    if (sleeping_.load() == 0) return;
+    std::lock_guard lock(sleep_mutex_);
+    wake_.notify_one();
+  }
+
+  void work(size_t index) {
+    current_ = this;
+    index_ = index;
+    while (true) {
+      fire_timers();
+      if (const auto h = take(index)) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        h->resume();
+        continue;
+      }
+      // A single wait per pass, so a new earlier timer is picked up on the next one.
+      std::unique_lock lock(sleep_mutex_);
+      sleeping_.fetch_add(1);
+      const clock::rep next = next_timer_.load();
+      const bool idle = queued_.load() == 0 && !is_due(next);
+      if (idle && !stop_) {
+        if (next == no_timer) wake_.wait(lock);
+        else wake_.wait_until(lock, clock::time_point(clock::duration(next)));
+      }
+      sleeping_.fetch_sub(1);
+      if (idle && stop_) return;
+    }
+  }
+
+  void record(std::exception_ptr error) {
+    std::lock_guard lock(mutex_);
+    if (!error_) error_ = std::move(error);
+  }
+
+  void rethrow_spawned() {
+    std::exception_ptr error;
+    {
+      std::lock_guard lock(mutex_);
+      error = std::exchange(error_, nullptr);
+    }
+    if (error) std::rethrow_exception(error);
+  }
+
+  detail::detached drive(task<void> t) {
+    try {
+      co_await t;
+    } catch (...) {
+      record(std::current_exception());
+    }
+    if (spawned_.fetch_sub(1) == 1) {
+      std::lock_guard lock(mutex_);
+      idle_.notify_all();
+    }
+  }
+
+  template<typename T>
+  detail::detached drive_blocking(task<T> t, std::optional<std::conditional_t<std::is_void_v<T>, bool, T>>& result,
+                                  std::exception_ptr& error, std::binary_semaphore& finished) {
+    try {
+      if constexpr (std::is_void_v<T>) {
+        co_await t;
+        result.emplace(true);
+      } else {
+        result.emplace(co_await t);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    finished.release();
+  }
+
+  struct join_state {
+    std::atomic<size_t> remaining;
+    std::coroutine_handle<> parent;
+    std::mutex mutex;
+    std::exception_ptr error;
+  };
+
+  detail::detached join(task<void> t, join_state& state) {
+    try {
+      co_await t;
+    } catch (...) {
+      std::lock_guard lock(state.mutex);
+      if (!state.error) state.error = std::current_exception();
+    }
+    if (state.remaining.fetch_sub(1) == 1) post(state.parent);
+  }
+
+ public:
+  explicit scheduler(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency())) {
+    threads = std::max<size_t>(1, threads);
+    for (size_t i = 0; i < threads; ++i) workers_.push_back(std::make_unique<worker>());
+    for (size_t i = 0; i < threads; ++i) threads_.emplace_back([this, i] { work(i); });
+  }
+
+  ~scheduler() {
+    {
+      std::unique_lock lock(mutex_);
+      idle_.wait(lock, [&] { return spawned_.load() == 0; });
+    }
+    {
+      std::lock_guard lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+
+  scheduler(const scheduler&) = delete;
+  scheduler& operator=(const scheduler&) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  // Work taken from another worker's deque so far.
+  size_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+  // Whether the calling thread is one of this scheduler's workers.
+  bool on_worker() const { return current_ == this; }
+
+  // Makes h ready: on the calling worker's own deque, or the shared queue from other
+  // threads.
+  void post(std::coroutine_handle<> h) {
+    if (current_ == this) {
+      worker& own = *workers_[index_];
+      std::lock_guard lock(own.mutex);
+      own.ready.push_back(h);
+    } else {
+      std::lock_guard lock(injected_mutex_);
+      injected_.push_back(h);
+    }
+    queued_.fetch_add(1);
+    wake_one();
+  }
+
+  // co_await schedule() continues the coroutine on a worker (a yield when already on
+  // one).
+  auto schedule() {
+    struct awaiter {
+      scheduler* owner;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) { owner->post(h); }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{this};
+  }
+
+  // co_await sleep_until(t) continues the coroutine on a worker once t has passed.
+  auto sleep_until(clock::time_point due) {
+    struct awaiter {
+      scheduler* owner;
+      clock::time_point due;
+      bool await_ready() const noexcept { return false; }
+      // Once the timer is queued, another worker may fire it and free this awaiter.
+      void await_suspend(std::coroutine_handle<> h) {
+        scheduler* pool = owner;
+        {
+          std::lock_guard lock(pool->mutex_);
+          pool->timers_.push({due, h});
+          pool->publish_next_timer();
+        }
+        pool->wake_one();
+      }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{this, due};
+  }
+
+  template<typename Rep, typename Period>
+  auto sleep_for(std::chrono::duration<Rep, Period> delay) {
+    return sleep_until(clock::now() + std::chrono::duration_cast<clock::duration>(delay));
+  }
+
+  // Starts t on the pool without waiting for it. The first exception a spawned task
+  // throws is rethrown by the next run().
+  void spawn(task<void> t) {
+    spawned_.fetch_add(1);
+    post(drive(std::move(t)).handle);
+  }
+
+  // Awaitable running all the tasks concurrently on the pool; completes when every one
+  // has finished and then rethrows the first exception among them.
+  task<void> when_all(std::vector<task<void>> tasks) {
+    if (tasks.empty()) co_return;
+    join_state state;
+    state.remaining = tasks.size();
+    struct awaiter {
+      scheduler* owner;
+      std::vector<task<void>>& tasks;
+      join_state& state;
+      bool await_ready() const noexcept { return false; }
+      // The joins are all created before any is posted: once the last one finishes,
+      // the parent may resume and free `tasks`.
+      void await_suspend(std::coroutine_handle<> parent) {
+        state.parent = parent;
+        std::vector<std::coroutine_handle<>> joins;
+        joins.reserve(tasks.size());
+        scheduler* pool = owner;
+        for (auto& t : tasks) joins.push_back(pool->join(std::move(t), state).handle);
+        for (const auto h : joins) pool->post(h);
+      }
+      void await_resume() const noexcept {}
+    };
+    co_await awaiter{this, tasks, state};
+    if (state.error) std::rethrow_exception(state.error);
+  }
+
+  // Runs t on the pool and blocks the calling thread, which must not be a worker,
+  // until it finishes; returns its result or rethrows its exception.
+  template<typename T>
+  T run(task<T> t) {
+    if (current_ == this) throw std::runtime_error("scheduler::run called from one of its own workers");
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> result;
+    std::exception_ptr error;
+    std::binary_semaphore finished(0);
+    post(drive_blocking(std::move(t), result, error, finished).handle);
+    finished.acquire();
+    if (error) std::rethrow_exception(error);
+    rethrow_spawned();
+    if constexpr (!std::is_void_v<T>) return std::move(*result);
+  }
+};
+
+}
+
+#endif //SCHEDULER_H
@@ -0,0 +1,134 @@
+//
+// Lazily started coroutine tasks.
+//
+
+#ifndef TASK_H
+#define TASK_H
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace utec::agent {
+
+template<typename T = void>
+class task;
+
+namespace detail {
+
+struct task_promise_base {
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+  std::exception_ptr error;
+
+  // Resumes whoever awaited the task, by symmetric transfer so that long chains of
+  // tasks finishing one another do not grow the stack.
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+      return h.promise().continuation;
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { error = std::current_exception(); }
+};
+
+template<typename T>
+struct task_promise : task_promise_base {
+  std::optional<T> value;
+
+  task<T> get_return_object();
+  template<typename U>
+  void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+  T result() {
+    if (error) std::rethrow_exception(error);
+    return std::move(*value);
+  }
+};
+
+template<>
+struct task_promise<void> : task_promise_base {
+  task<void> get_return_object();
+  void return_void() {}
+  void result() {
+    if (error) std::rethrow_exception(error);
+  }
+};
+
+}
+
+// A coroutine returning T that starts only when awaited, on the awaiting thread, and
+// resumes the awaiter when done; exceptions propagate to the awaiter. The task owns
+// its coroutine frame, so it is move-only and must outlive the co_await. To run work
+// elsewhere, await scheduler::schedule() inside it or hand it to a scheduler (see
+// scheduler.h).
+template<typename T>
+class task {
+ public:
+  using promise_type = detail::task_promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+ private:
+  handle_type handle_;
+
+  struct awaiter {
+    handle_type handle;
+
+    bool await_ready() const noexcept { return handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle.promise().continuation = awaiting;
+      return handle;
+    }
+    T await_resume() { return handle.promise().result(); }
+  };
+
+ public:
+  task() = default;
+  explicit task(handle_type handle) : handle_(handle) {}
+  task(task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  task& operator=(task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  task(const task&) = delete;
+  task& operator=(const task&) = delete;
+  ~task() {
+    if (handle_) handle_.destroy();
+  }
+
+  bool valid() const { return bool(handle_); }
+  bool done() const { return handle_ && handle_.done(); }
+
+  // An empty (default-constructed or moved-from) task has nothing to run or return.
+  awaiter operator co_await() const {
+    if (!handle_) throw std::runtime_error("Cannot await an empty task");
+    return {handle_};
+  }
+};
+
+namespace detail {
+
+template<typename T>
+task<T> task_promise<T>::get_return_object() {
+  return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() {
+  return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+}
+
+}
+
+#endif //TASK_H
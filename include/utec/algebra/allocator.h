@@ -0,0 +1,195 @@
+//
+// Storage allocators for Tensor: 64-byte aligned heap storage and a thread-local arena.
+//
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "utec/algebra/profiler.h"
+
+namespace utec::algebra {
+
+inline constexpr size_t tensor_alignment = 64;
+
+// Heap allocator whose blocks start on an Alignment-byte boundary (a cache line, and
+// the width of an AVX-512 register), so packet loads never split a line.
+template<typename T, size_t Alignment = tensor_alignment>
+class aligned_allocator {
+ public:
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+                "Alignment must be a power of two no smaller than alignof(T)");
+
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template<typename U>
+  struct rebind {
+    using other = aligned_allocator<U, Alignment>;
+  };
+
+  aligned_allocator() noexcept = default;
+  template<typename U>
+  aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+  T* allocate(size_t n) {
+    if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_array_new_length();
+    profiler::record_allocation(n * sizeof(T));
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* p, size_t) noexcept { ::operator delete(p, std::align_val_t(Alignment)); }
+
+  template<typename U>
+  bool operator==(const aligned_allocator<U, Alignment>&) const noexcept { return true; }
+};
+
+// Bump allocator for short-lived tensors. Allocation is a pointer increment inside a
+// preallocated block; individual deallocations are no-ops and the whole arena is
+// released at once with reset() (or rewound to a mark), typically once per training
+// step. After the first step the blocks are reused, so steady state never touches
+// the system allocator. An arena is not thread-safe; use one per thread (local()).
+class arena {
+ private:
+  struct block {
+    std::byte* data;
+    size_t size;
+  };
+
+  std::vector<block> blocks_;
+  size_t current_ = 0;
+  size_t offset_ = 0;
+  size_t block_size_;
+
+  static std::byte* allocate_block(size_t size) {
+    return static_cast<std::byte*>(::operator new(size, std::align_val_t(tensor_alignment)));
+  }
+
+  static void release_block(const block& b) { ::operator delete(b.data, std::align_val_t(tensor_alignment)); }
+
+ public:
+  struct mark {
+    size_t block;
+    size_t offset;
+  };
+
+  explicit arena(size_t block_size = size_t{1} << 20) : block_size_(block_size) {}
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+  ~arena() {
+    for (const auto& b : blocks_) release_block(b);
+  }
+
+  static arena& local() {
+    thread_local arena instance;
+    return instance;
+  }
+
+  void* allocate(size_t bytes, size_t alignment = tensor_alignment) {
+    profiler::record_allocation(bytes);
+    alignment = std::max(alignment, tensor_alignment);
+    while (current_ < blocks_.size()) {
+      const size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+      if (start + bytes <= blocks_[current_].size) {
+        offset_ = start + bytes;
+        return blocks_[current_].data + start;
+      }
+      ++current_;
+      offset_ = 0;
+    }
+    const size_t size = std::max(block_size_, bytes);
+    blocks_.push_back({allocate_block(size), size});
+    current_ = blocks_.size() - 1;
+    offset_ = bytes;
+    return blocks_.back().data;
+  }
+
+  mark position() const { return {current_, offset_}; }
+
+  void rewind(const mark& m) {
+    current_ = m.block;
+    offset_ = m.offset;
+  }
+
+  // Releases everything allocated so far. If the last cycle spilled over several
+  // blocks they are merged into one, so the next cycle fits in a single block.
+  void reset() {
+    if (blocks_.size() > 1) {
+      size_t total = 0;
+      for (const auto& b : blocks_) {
+        total += b.size;
+        release_block(b);
+      }
+      blocks_.clear();
+      blocks_.push_back({allocate_block(total), total});
+    }
+    current_ = 0;
+    offset_ = 0;
+  }
+
+  size_t capacity() const {
+    size_t total = 0;
+    for (const auto& b : blocks_) total += b.size;
+    return total;
+  }
+
+  size_t used() const {
+    size_t total = offset_;
+    for (size_t i = 0; i < current_ && i < blocks_.size(); ++i) total += blocks_[i].size;
+    return total;
+  }
+};
+
+// Rewinds the arena to where it was when the scope was entered.
+class arena_scope {
+ private:
+  arena& arena_;
+  arena::mark mark_;
+
+ public:
+  explicit arena_scope(arena& a = arena::local()) : arena_(a), mark_(a.position()) {}
+  arena_scope(const arena_scope&) = delete;
+  arena_scope& operator=(const arena_scope&) = delete;
+  ~arena_scope() { arena_.rewind(mark_); }
+};
+
+template<typename T>
+class arena_allocator {
+ private:
+  arena* arena_;
+
+  template<typename U>
+  friend class arena_allocator;
+
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  arena_allocator() noexcept : arena_(&arena::local()) {}
+  explicit arena_allocator(arena& a) noexcept : arena_(&a) {}
+  template<typename U>
+  arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena_) {}
+
+  T* allocate(size_t n) {
+    if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_array_new_length();
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) noexcept {}
+
+  template<typename U>
+  bool operator==(const arena_allocator<U>& other) const noexcept { return arena_ == other.arena_; }
+};
+
+}
+
+#endif //ALLOCATOR_H
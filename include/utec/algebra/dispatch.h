@@ -0,0 +1,129 @@
+//
+// Runtime selection of ISA-specific kernel variants.
+//
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "utec/algebra/simd.h"
+
+// On x86 with GCC/Clang the hot kernels are compiled a second and third time with
+// AVX2+FMA and AVX-512 enabled through target attributes, and the widest variant the
+// CPU supports is chosen once at startup. Other targets (ARM/NEON, MSVC) use the
+// variant the translation unit was compiled for. Define UTEC_NO_RUNTIME_DISPATCH to
+// always use the compile-time target, e.g. when building with -march=native.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(UTEC_NO_RUNTIME_DISPATCH)
+#define UTEC_RUNTIME_DISPATCH 1
+#define UTEC_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define UTEC_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")))
+#define UTEC_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx512vnni,avx2,fma")))
+#else
+#define UTEC_RUNTIME_DISPATCH 0
+#endif
+
+// The AVX2 and AVX-512 arguments of dispatch::select. They name the target-attributed
+// variants, which only exist when UTEC_RUNTIME_DISPATCH is set, so they are dropped
+// otherwise: select(&k_native<T> UTEC_DISPATCH_VARIANTS(, &k_avx2<T>, &k_avx512<T>)).
+#if UTEC_RUNTIME_DISPATCH
+#define UTEC_DISPATCH_VARIANTS(...) __VA_ARGS__
+#else
+#define UTEC_DISPATCH_VARIANTS(...)
+#endif
+
+namespace utec::algebra::dispatch {
+
+// Ordered from narrowest to widest, so a variant is usable when isa >= its level.
+enum class isa { baseline, avx2, avx512 };
+
+inline const char* name(isa level) {
+  switch (level) {
+    case isa::avx2: return "avx2";
+    case isa::avx512: return "avx512";
+    default: return "baseline";
+  }
+}
+
+// Widest kernel variant this CPU can run.
+inline isa detect() {
+#if UTEC_RUNTIME_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+    return isa::avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return isa::avx2;
+#endif
+  return isa::baseline;
+}
+
+// The level a UTEC_ISA value selects on a CPU supporting `detected`: the named one,
+// but never above `detected`. An empty value keeps `detected`; any other name throws,
+// so that a typo does not silently run the default variant.
+inline isa limit(std::string_view requested, isa detected) {
+  isa wanted = detected;
+  if (requested == "baseline") wanted = isa::baseline;
+  else if (requested == "avx2") wanted = isa::avx2;
+  else if (requested == "avx512") wanted = isa::avx512;
+  else if (!requested.empty()) throw std::runtime_error("Unknown UTEC_ISA '" + std::string(requested) + "'; expected baseline, avx2 or avx512");
+  return wanted < detected ? wanted : detected;
+}
+
+// The variant used by every dispatched kernel, fixed on first use. The UTEC_ISA
+// environment variable (baseline, avx2 or avx512) can lower it, e.g. to compare
+// variants on one machine; it is never raised above what detect() reports.
+inline isa active() {
+  static const isa level = [] {
+    const char* env = std::getenv("UTEC_ISA");
+    return env ? limit(env, detect()) : detect();
+  }();
+  return level;
+}
+
+// Whether the int8 kernels may use the AVX-512 VNNI dot-product instruction
+// (vpdpbusd). Only when the AVX-512 variants are active, so UTEC_ISA also turns it off.
+inline bool vnni() {
+#if UTEC_RUNTIME_DISPATCH
+  static const bool supported = active() == isa::avx512 && __builtin_cpu_supports("avx512vnni");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// Packet width in bytes of the kernels selected by active(). Never narrower than the
+// compile-time target.
+inline size_t vector_bytes() {
+#if UTEC_RUNTIME_DISPATCH
+  if (simd::native_bytes < 64 && active() == isa::avx512) return 64;
+  if (simd::native_bytes < 32 && active() >= isa::avx2) return 32;
+#endif
+  return simd::native_bytes;
+}
+
+// The variant of a kernel for vector_bytes(): avx512 or avx2 when that width is active
+// and wider than the compile-time target, native otherwise. Every kernel selector goes
+// through here; pass the wide variants with UTEC_DISPATCH_VARIANTS.
+template<typename Kernel>
+Kernel select(Kernel native) {
+  return native;
+}
+
+template<typename Kernel>
+Kernel select(Kernel native, Kernel avx2, Kernel avx512) {
+  const size_t bytes = vector_bytes();
+  if (simd::native_bytes < 64 && bytes == 64) return avx512;
+  if (simd::native_bytes < 32 && bytes == 32) return avx2;
+  return native;
+}
+
+}
+
+#endif //DISPATCH_H
@@ -0,0 +1,143 @@
+//
+// Vectorized elementwise kernels and the stride-based broadcast iterator.
+//
+
+#ifndef ELEMENTWISE_H
+#define ELEMENTWISE_H
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "utec/algebra/simd.h"
+
+namespace utec::algebra {
+
+inline bool can_broadcast(const std::array<size_t, 2>& a, const std::array<size_t, 2>& b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i] && a[i] != 1 && b[i] != 1) return false;
+  }
+  return true;
+}
+
+template<size_t N>
+inline bool can_broadcast(const std::array<size_t, N>& a, const std::array<size_t, N>& b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i] && a[i] != 1 && b[i] != 1) return false;
+  }
+  return true;
+}
+
+inline size_t broadcast_index(size_t i, size_t dim_size) {
+  return (dim_size == 1) ? 0 : i;
+}
+
+template<size_t N>
+inline std::array<size_t, N> broadcast_shape(const std::array<size_t, N>& a, const std::array<size_t, N>& b) {
+  std::array<size_t, N> result{};
+  for (size_t i = 0; i < N; ++i) result[i] = (a[i] == 1) ? b[i] : a[i];
+  return result;
+}
+
+}
+
+namespace utec::algebra::elementwise {
+
+struct plus {
+  template<typename V> UTEC_ALWAYS_INLINE constexpr V operator()(const V& a, const V& b) const { return a + b; }
+};
+
+struct minus {
+  template<typename V> UTEC_ALWAYS_INLINE constexpr V operator()(const V& a, const V& b) const { return a - b; }
+};
+
+struct multiplies {
+  template<typename V> UTEC_ALWAYS_INLINE constexpr V operator()(const V& a, const V& b) const { return a * b; }
+};
+
+struct divides {
+  template<typename V> UTEC_ALWAYS_INLINE constexpr V operator()(const V& a, const V& b) const { return a / b; }
+};
+
+// Walks a row-major output of the given shape as a sequence of contiguous rows. Each of
+// the M operands is addressed through its own strides (0 on broadcast axes). Adjacent axes
+// that every operand can address linearly are merged first, so a same-shape operation
+// becomes a single row and a (3,4,5) x (1,1,5) product becomes 12 rows of 5 without any
+// per-element index arithmetic.
+template<size_t N, size_t M>
+class broadcast_iterator {
+ private:
+  std::array<size_t, N> extent_{};
+  std::array<std::array<size_t, N>, M> strides_{};
+  size_t rank_ = 0;
+
+ public:
+  broadcast_iterator(const std::array<size_t, N>& shape,
+                     const std::array<std::array<size_t, N>, M>& strides) {
+    for (size_t d = 0; d < N; ++d) {
+      if (shape[d] == 1) continue;
+      if (rank_ > 0) {
+        bool mergeable = true;
+        for (size_t m = 0; m < M; ++m) {
+          if (strides_[m][rank_ - 1] != strides[m][d] * shape[d]) mergeable = false;
+        }
+        if (mergeable) {
+          extent_[rank_ - 1] *= shape[d];
+          for (size_t m = 0; m < M; ++m) strides_[m][rank_ - 1] = strides[m][d];
+          continue;
+        }
+      }
+      extent_[rank_] = shape[d];
+      for (size_t m = 0; m < M; ++m) strides_[m][rank_] = strides[m][d];
+      ++rank_;
+    }
+    if (rank_ == 0) {
+      extent_[0] = 1;
+      rank_ = 1;
+    }
+  }
+
+  size_t inner_size() const { return extent_[rank_ - 1]; }
+  size_t inner_stride(size_t operand) const { return strides_[operand][rank_ - 1]; }
+
+  size_t rows() const {
+    size_t rows = 1;
+    for (size_t d = 0; d + 1 < rank_; ++d) rows *= extent_[d];
+    return rows;
+  }
+
+  // fn(offsets, row) is invoked once per contiguous output row of inner_size() elements
+  // in [first, last), with offsets[m] the starting element offset of operand m in that
+  // row. Starting mid-way lets a parallel loop hand each task its own range of rows.
+  template<typename Fn>
+  void for_each_row(size_t first, size_t last, Fn&& fn) const {
+    std::array<size_t, N> counter{};
+    std::array<size_t, M> offsets{};
+    for (size_t d = rank_ - 1, rest = first; d-- > 0;) {
+      counter[d] = rest % extent_[d];
+      rest /= extent_[d];
+      for (size_t m = 0; m < M; ++m) offsets[m] += counter[d] * strides_[m][d];
+    }
+
+    for (size_t r = first; r < last; ++r) {
+      fn(offsets, r);
+      for (size_t d = rank_ - 1; d-- > 0;) {
+        for (size_t m = 0; m < M; ++m) offsets[m] += strides_[m][d];
+        if (++counter[d] < extent_[d]) break;
+        for (size_t m = 0; m < M; ++m) offsets[m] -= strides_[m][d] * extent_[d];
+        counter[d] = 0;
+      }
+    }
+  }
+
+  template<typename Fn>
+  void for_each_row(Fn&& fn) const {
+    for_each_row(0, rows(), std::forward<Fn>(fn));
+  }
+};
+
+}
+
+#endif //ELEMENTWISE_H
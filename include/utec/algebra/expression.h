@@ -0,0 +1,552 @@
+//
+// Lazy expression templates for the Tensor arithmetic operators.
+//
+
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/elementwise.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/simd.h"
+
+namespace utec::algebra {
+
+// The storage allocator defaults to 64-byte aligned blocks; see allocator.h.
+template<typename T, size_t N, typename Allocator = aligned_allocator<T>>
+class Tensor;
+
+template<typename T, size_t N>
+class TensorView;
+
+template<typename Derived>
+class tensor_expression;
+
+template<typename X>
+struct is_tensor : std::false_type {};
+
+template<typename T, size_t N, typename Allocator>
+struct is_tensor<Tensor<T, N, Allocator>> : std::true_type {};
+
+template<typename X>
+inline constexpr bool is_tensor_v = is_tensor<std::remove_cvref_t<X>>::value;
+
+template<typename X>
+struct is_tensor_view : std::false_type {};
+
+template<typename T, size_t N>
+struct is_tensor_view<TensorView<T, N>> : std::true_type {};
+
+template<typename X>
+inline constexpr bool is_tensor_view_v = is_tensor_view<std::remove_cvref_t<X>>::value;
+
+template<typename X>
+inline constexpr bool is_expression_v =
+    std::is_base_of_v<tensor_expression<std::remove_cvref_t<X>>, std::remove_cvref_t<X>>;
+
+template<typename X>
+concept tensor_operand = is_tensor_v<X> || is_tensor_view_v<X> || is_expression_v<X>;
+
+namespace detail {
+
+template<typename X, typename = void>
+struct operand_traits {};
+
+template<typename T, size_t N, typename Allocator>
+struct operand_traits<Tensor<T, N, Allocator>> {
+  using value_type = T;
+  static constexpr size_t rank = N;
+};
+
+template<typename T, size_t N>
+struct operand_traits<TensorView<T, N>> {
+  using value_type = std::remove_const_t<T>;
+  static constexpr size_t rank = N;
+};
+
+template<typename X>
+struct operand_traits<X, std::enable_if_t<is_expression_v<X>>> {
+  using value_type = typename X::value_type;
+  static constexpr size_t rank = X::rank;
+};
+
+template<typename X>
+using operand_value_t = typename operand_traits<std::remove_cvref_t<X>>::value_type;
+
+template<size_t N>
+std::array<size_t, N> contiguous_strides(const std::array<size_t, N>& shape) {
+  std::array<size_t, N> strides{};
+  size_t stride = 1;
+  for (size_t d = N; d-- > 0;) {
+    strides[d] = stride;
+    stride *= shape[d];
+  }
+  return strides;
+}
+
+template<size_t N>
+size_t shape_size(const std::array<size_t, N>& shape) {
+  size_t total = 1;
+  for (auto d : shape) total *= d;
+  return total;
+}
+
+// True when the strided region (data, shape, strides) shares memory with the other
+// region without being element-for-element the same layout, i.e. when writing one
+// while reading the other elementwise could observe already-overwritten values.
+template<typename T, size_t N>
+bool regions_alias(const T* a, const std::array<size_t, N>& a_shape, const std::array<size_t, N>& a_strides,
+                   const T* b, const std::array<size_t, N>& b_shape, const std::array<size_t, N>& b_strides) {
+  if (shape_size(a_shape) == 0 || shape_size(b_shape) == 0) return false;
+  if (a == b && a_shape == b_shape && a_strides == b_strides) return false;
+  size_t a_extent = 1;
+  size_t b_extent = 1;
+  for (size_t d = 0; d < N; ++d) {
+    a_extent += (a_shape[d] - 1) * a_strides[d];
+    b_extent += (b_shape[d] - 1) * b_strides[d];
+  }
+  return a < b + b_extent && b < a + a_extent;
+}
+
+// Per-row addressing of the M tensor leaves of an expression: the first element of
+// the row and the step between consecutive elements (0 on broadcast axes).
+template<typename T, size_t M>
+struct expression_cursor {
+  std::array<const T*, M> ptr{};
+  std::array<size_t, M> stride{};
+};
+
+template<typename T, size_t I, bool Contiguous, typename P, size_t M>
+UTEC_ALWAYS_INLINE P load_leaf(const expression_cursor<T, M>& c, size_t i) {
+  if constexpr (Contiguous) {
+    return P::load(c.ptr[I] + i);
+  } else {
+    const size_t s = c.stride[I];
+    if (s == 1) return P::load(c.ptr[I] + i);
+    if (s == 0) return P::broadcast(*c.ptr[I]);
+    return P::gather(c.ptr[I] + i * s, s);
+  }
+}
+
+template<typename T, size_t I, bool Contiguous, size_t M>
+UTEC_ALWAYS_INLINE T read_leaf(const expression_cursor<T, M>& c, size_t i) {
+  if constexpr (Contiguous) {
+    return c.ptr[I][i];
+  } else {
+    return c.ptr[I][i * c.stride[I]];
+  }
+}
+
+}
+
+template<typename E>
+class expression_iterator {
+ private:
+  const E* expression_ = nullptr;
+  std::array<size_t, E::rank> index_{};
+  size_t position_ = 0;
+
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename E::value_type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = value_type;
+
+  expression_iterator() = default;
+  expression_iterator(const E* expression, size_t position) : expression_(expression), position_(position) {}
+
+  value_type operator*() const { return expression_->at(index_); }
+
+  expression_iterator& operator++() {
+    const auto& shape = expression_->shape();
+    ++position_;
+    for (size_t d = E::rank; d-- > 0;) {
+      if (++index_[d] < shape[d]) break;
+      index_[d] = 0;
+    }
+    return *this;
+  }
+
+  expression_iterator operator++(int) {
+    expression_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  bool operator==(const expression_iterator& other) const { return position_ == other.position_; }
+};
+
+// CRTP base of every lazy node. Nodes are cheap to copy: tensors are referenced (or
+// moved in when they are temporaries), so a whole expression is evaluated in one pass
+// into its destination without intermediate storage.
+template<typename Derived>
+class tensor_expression {
+ public:
+  const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+  size_t size() const { return detail::shape_size(derived().shape()); }
+
+  template<typename... Indices>
+  auto operator()(Indices... indices) const {
+    static_assert(sizeof...(Indices) == Derived::rank, "Access must use N indices");
+    return derived().at({static_cast<size_t>(indices)...});
+  }
+
+  auto eval() const { return Tensor<typename Derived::value_type, Derived::rank>(derived()); }
+
+  auto begin() const { return expression_iterator<Derived>(&derived(), 0); }
+  auto end() const { return expression_iterator<Derived>(&derived(), size()); }
+  auto cbegin() const { return begin(); }
+  auto cend() const { return end(); }
+
+  friend std::ostream& operator<<(std::ostream& os, const tensor_expression& expression) {
+    return os << expression.eval();
+  }
+};
+
+template<typename T, size_t N>
+class leaf_expression : public tensor_expression<leaf_expression<T, N>> {
+ private:
+  const T* data_;
+  std::array<size_t, N> shape_;
+  std::array<size_t, N> strides_;
+
+ public:
+  using value_type = T;
+  static constexpr size_t rank = N;
+  static constexpr size_t leaves = 1;
+  static constexpr size_t operations = 0;
+
+  leaf_expression(const T* data, const std::array<size_t, N>& shape, const std::array<size_t, N>& strides)
+      : data_(data), shape_(shape), strides_(strides) {}
+
+  template<typename Allocator>
+  explicit leaf_expression(const Tensor<T, N, Allocator>& tensor)
+      : leaf_expression(tensor.data(), tensor.shape(), detail::contiguous_strides(tensor.shape())) {}
+
+  const std::array<size_t, N>& shape() const { return shape_; }
+
+  bool may_alias(const T* data, const std::array<size_t, N>& shape, const std::array<size_t, N>& strides) const {
+    return detail::regions_alias(data_, shape_, strides_, data, shape, strides);
+  }
+
+  T at(const std::array<size_t, N>& idx) const {
+    size_t offset = 0;
+    for (size_t d = 0; d < N; ++d) offset += broadcast_index(idx[d], shape_[d]) * strides_[d];
+    return data_[offset];
+  }
+
+  template<size_t I, size_t M>
+  void bind(std::array<const T*, M>& base, std::array<std::array<size_t, N>, M>& strides) const {
+    base[I] = data_;
+    for (size_t d = 0; d < N; ++d) strides[I][d] = shape_[d] == 1 ? 0 : strides_[d];
+  }
+
+  template<size_t I, bool Contiguous, typename P, size_t M>
+  UTEC_ALWAYS_INLINE P packet(const detail::expression_cursor<T, M>& c, size_t i) const {
+    return detail::load_leaf<T, I, Contiguous, P>(c, i);
+  }
+
+  template<size_t I, bool Contiguous, size_t M>
+  UTEC_ALWAYS_INLINE T scalar(const detail::expression_cursor<T, M>& c, size_t i) const {
+    return detail::read_leaf<T, I, Contiguous>(c, i);
+  }
+};
+
+// Leaf that took ownership of a temporary Tensor, so `auto e = make() + t;` stays valid.
+template<typename T, size_t N, typename Allocator>
+class owning_leaf_expression : public tensor_expression<owning_leaf_expression<T, N, Allocator>> {
+ private:
+  Tensor<T, N, Allocator> tensor_;
+
+ public:
+  using value_type = T;
+  static constexpr size_t rank = N;
+  static constexpr size_t leaves = 1;
+  static constexpr size_t operations = 0;
+
+  explicit owning_leaf_expression(Tensor<T, N, Allocator>&& tensor) : tensor_(std::move(tensor)) {}
+
+  const std::array<size_t, N>& shape() const { return tensor_.shape(); }
+
+  bool may_alias(const T*, const std::array<size_t, N>&, const std::array<size_t, N>&) const { return false; }
+
+  T at(const std::array<size_t, N>& idx) const { return leaf_expression<T, N>(tensor_).at(idx); }
+
+  template<size_t I, size_t M>
+  void bind(std::array<const T*, M>& base, std::array<std::array<size_t, N>, M>& strides) const {
+    leaf_expression<T, N>(tensor_).template bind<I>(base, strides);
+  }
+
+  template<size_t I, bool Contiguous, typename P, size_t M>
+  UTEC_ALWAYS_INLINE P packet(const detail::expression_cursor<T, M>& c, size_t i) const {
+    return detail::load_leaf<T, I, Contiguous, P>(c, i);
+  }
+
+  template<size_t I, bool Contiguous, size_t M>
+  UTEC_ALWAYS_INLINE T scalar(const detail::expression_cursor<T, M>& c, size_t i) const {
+    return detail::read_leaf<T, I, Contiguous>(c, i);
+  }
+};
+
+template<typename T, size_t N>
+class scalar_expression : public tensor_expression<scalar_expression<T, N>> {
+ private:
+  T value_;
+  std::array<size_t, N> shape_;
+
+ public:
+  using value_type = T;
+  static constexpr size_t rank = N;
+  static constexpr size_t leaves = 0;
+  static constexpr size_t operations = 0;
+
+  explicit scalar_expression(const T& value) : value_(value) { shape_.fill(1); }
+
+  const std::array<size_t, N>& shape() const { return shape_; }
+
+  bool may_alias(const T*, const std::array<size_t, N>&, const std::array<size_t, N>&) const { return false; }
+
+  T at(const std::array<size_t, N>&) const { return value_; }
+
+  template<size_t I, size_t M>
+  void bind(std::array<const T*, M>&, std::array<std::array<size_t, N>, M>&) const {}
+
+  template<size_t I, bool Contiguous, typename P, size_t M>
+  UTEC_ALWAYS_INLINE P packet(const detail::expression_cursor<T, M>&, size_t) const {
+    return P::broadcast(value_);
+  }
+
+  template<size_t I, bool Contiguous, size_t M>
+  UTEC_ALWAYS_INLINE T scalar(const detail::expression_cursor<T, M>&, size_t) const {
+    return value_;
+  }
+};
+
+template<typename Op, typename L, typename R>
+class binary_expression : public tensor_expression<binary_expression<Op, L, R>> {
+ public:
+  using value_type = typename L::value_type;
+  static constexpr size_t rank = L::rank;
+  static constexpr size_t leaves = L::leaves + R::leaves;
+  // Arithmetic operations per output element.
+  static constexpr size_t operations = L::operations + R::operations + 1;
+
+ private:
+  L lhs_;
+  R rhs_;
+  std::array<size_t, rank> shape_;
+
+ public:
+  binary_expression(L lhs, R rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {
+    if (!can_broadcast(lhs_.shape(), rhs_.shape()))
+      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
+    shape_ = broadcast_shape(lhs_.shape(), rhs_.shape());
+  }
+
+  const std::array<size_t, rank>& shape() const { return shape_; }
+
+  bool may_alias(const value_type* data, const std::array<size_t, rank>& shape,
+                 const std::array<size_t, rank>& strides) const {
+    return lhs_.may_alias(data, shape, strides) || rhs_.may_alias(data, shape, strides);
+  }
+
+  value_type at(const std::array<size_t, rank>& idx) const { return Op{}(lhs_.at(idx), rhs_.at(idx)); }
+
+  template<size_t I, size_t M>
+  void bind(std::array<const value_type*, M>& base, std::array<std::array<size_t, rank>, M>& strides) const {
+    lhs_.template bind<I>(base, strides);
+    rhs_.template bind<I + L::leaves>(base, strides);
+  }
+
+  template<size_t I, bool Contiguous, typename P, size_t M>
+  UTEC_ALWAYS_INLINE P packet(const detail::expression_cursor<value_type, M>& c, size_t i) const {
+    return Op{}(lhs_.template packet<I, Contiguous, P>(c, i),
+                rhs_.template packet<I + L::leaves, Contiguous, P>(c, i));
+  }
+
+  template<size_t I, bool Contiguous, size_t M>
+  UTEC_ALWAYS_INLINE value_type scalar(const detail::expression_cursor<value_type, M>& c, size_t i) const {
+    return Op{}(lhs_.template scalar<I, Contiguous>(c, i),
+                rhs_.template scalar<I + L::leaves, Contiguous>(c, i));
+  }
+};
+
+namespace detail {
+
+template<typename X>
+auto as_expression(X&& x) {
+  using D = std::remove_cvref_t<X>;
+  if constexpr (is_expression_v<D>) {
+    return D(std::forward<X>(x));
+  } else if constexpr (is_tensor_view_v<D>) {
+    return leaf_expression<typename operand_traits<D>::value_type, operand_traits<D>::rank>(x.data(), x.shape(), x.strides());
+  } else if constexpr (std::is_lvalue_reference_v<X> || std::is_const_v<std::remove_reference_t<X>>) {
+    return leaf_expression<typename operand_traits<D>::value_type, operand_traits<D>::rank>(x);
+  } else {
+    return owning_leaf_expression<typename operand_traits<D>::value_type, operand_traits<D>::rank,
+                                  typename D::allocator_type>(std::move(x));
+  }
+}
+
+template<typename X>
+using expression_t = decltype(as_expression(std::declval<X>()));
+
+template<bool Contiguous, size_t Bytes, typename E, typename T, size_t M>
+UTEC_ALWAYS_INLINE void evaluate_row(const E& e, const expression_cursor<T, M>& c, T* UTEC_RESTRICT out,
+                                     size_t out_stride, size_t n) {
+  size_t i = 0;
+  if (out_stride == 1) {
+    if constexpr (simd::is_vectorizable_v<T>) {
+      using P = simd::packet<T, Bytes>;
+      for (; i + P::lanes <= n; i += P::lanes) e.template packet<0, Contiguous, P>(c, i).store(out + i);
+    }
+    for (; i < n; ++i) out[i] = e.template scalar<0, Contiguous>(c, i);
+  } else {
+    for (; i < n; ++i) out[i * out_stride] = e.template scalar<0, Contiguous>(c, i);
+  }
+}
+
+template<bool Contiguous, typename E, typename T, size_t M>
+void evaluate_row_native(const E& e, const expression_cursor<T, M>& c, T* out, size_t out_stride, size_t n) {
+  evaluate_row<Contiguous, simd::native_bytes>(e, c, out, out_stride, n);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<bool Contiguous, typename E, typename T, size_t M>
+UTEC_TARGET_AVX2 void evaluate_row_avx2(const E& e, const expression_cursor<T, M>& c, T* out, size_t out_stride,
+                                        size_t n) {
+  evaluate_row<Contiguous, 32>(e, c, out, out_stride, n);
+}
+
+template<bool Contiguous, typename E, typename T, size_t M>
+UTEC_TARGET_AVX512 void evaluate_row_avx512(const E& e, const expression_cursor<T, M>& c, T* out, size_t out_stride,
+                                            size_t n) {
+  evaluate_row<Contiguous, 64>(e, c, out, out_stride, n);
+}
+#endif
+
+template<typename E, typename T, size_t M>
+using row_kernel = void (*)(const E&, const expression_cursor<T, M>&, T*, size_t, size_t);
+
+// Row kernel for the vector width chosen by dispatch::vector_bytes().
+template<bool Contiguous, typename E, typename T, size_t M>
+row_kernel<E, T, M> select_row_kernel() {
+  return dispatch::select(&evaluate_row_native<Contiguous, E, T, M>
+                          UTEC_DISPATCH_VARIANTS(, &evaluate_row_avx2<Contiguous, E, T, M>,
+                                                 &evaluate_row_avx512<Contiguous, E, T, M>));
+}
+
+
+}
+
+// Writes every element of the expression, broadcast to out_shape, into the strided
+// destination. The broadcast iterator reduces the loop nest to rows that are
+// contiguous wherever the layouts allow, and each row is computed packet by packet
+// straight from the leaves' storage. The destination must not alias a leaf (see
+// may_alias) unless it has exactly the same layout as that leaf. Rows run through the
+// kernel variant compiled for the widest ISA the CPU supports.
+template<typename E>
+void evaluate(const tensor_expression<E>& expression, typename E::value_type* out,
+              const std::array<size_t, E::rank>& out_shape, const std::array<size_t, E::rank>& out_strides) {
+  using T = typename E::value_type;
+  constexpr size_t N = E::rank;
+  constexpr size_t M = E::leaves;
+
+  const E& e = expression.derived();
+  UTEC_PROFILE_SCOPE("elementwise", detail::shape_size(out_shape) * E::operations);
+  if (detail::shape_size(out_shape) == 0) return;
+
+  std::array<const T*, M + 1> base{};
+  std::array<std::array<size_t, N>, M + 1> strides{};
+  e.template bind<0>(base, strides);
+  for (size_t d = 0; d < N; ++d) strides[M][d] = out_shape[d] == 1 ? 0 : out_strides[d];
+
+  const elementwise::broadcast_iterator<N, M + 1> it(out_shape, strides);
+  const size_t inner = it.inner_size();
+  const size_t out_stride = it.inner_stride(M);
+  detail::expression_cursor<T, M> cursor;
+  bool contiguous = true;
+  for (size_t m = 0; m < M; ++m) {
+    cursor.stride[m] = it.inner_stride(m);
+    contiguous = contiguous && cursor.stride[m] == 1;
+  }
+
+  const auto row = contiguous ? detail::select_row_kernel<true, E, T, M>()
+                              : detail::select_row_kernel<false, E, T, M>();
+  const auto run_row = [&](const auto& offsets, size_t lo, size_t hi) {
+    detail::expression_cursor<T, M> c = cursor;
+    for (size_t m = 0; m < M; ++m) c.ptr[m] = base[m] + offsets[m] + lo * c.stride[m];
+    row(e, c, out + offsets[M] + lo * out_stride, out_stride, hi - lo);
+  };
+
+  // Tasks get flat element ranges, so a single long row is split as well as many short
+  // ones. Outputs below the grain size run inline.
+  const size_t rows = it.rows();
+  parallel::parallel_for(0, rows * inner, parallel::grain_size(), [&](size_t first, size_t last) {
+    const size_t r0 = first / inner;
+    const size_t r1 = (last + inner - 1) / inner;
+    it.for_each_row(r0, r1, [&](const auto& offsets, size_t r) {
+      const size_t lo = r == r0 ? first - r0 * inner : 0;
+      const size_t hi = r + 1 == r1 ? last - r * inner : inner;
+      run_row(offsets, lo, hi);
+    });
+  });
+}
+
+// Writes the expression to a contiguous row-major buffer of its own shape.
+template<typename E>
+void evaluate(const tensor_expression<E>& expression, typename E::value_type* out) {
+  const auto shape = expression.derived().shape();
+  evaluate(expression, out, shape, detail::contiguous_strides(shape));
+}
+
+#define UTEC_TENSOR_EXPRESSION_OPERATOR(op, functor)                                               \
+  template<tensor_operand L, tensor_operand R>                                                     \
+  auto operator op(L&& lhs, R&& rhs) {                                                             \
+    using A = detail::expression_t<L&&>;                                                           \
+    using B = detail::expression_t<R&&>;                                                           \
+    static_assert(std::is_same_v<typename A::value_type, typename B::value_type>,                  \
+                  "Tensor operands must have the same value type");                                \
+    static_assert(A::rank == B::rank, "Tensor operands must have the same rank");                  \
+    return binary_expression<elementwise::functor, A, B>(detail::as_expression(std::forward<L>(lhs)), \
+                                                         detail::as_expression(std::forward<R>(rhs))); \
+  }                                                                                                \
+                                                                                                   \
+  template<tensor_operand L>                                                                       \
+  auto operator op(L&& lhs, const detail::operand_value_t<L>& scalar) {                            \
+    using A = detail::expression_t<L&&>;                                                           \
+    using S = scalar_expression<typename A::value_type, A::rank>;                                  \
+    return binary_expression<elementwise::functor, A, S>(detail::as_expression(std::forward<L>(lhs)), S(scalar)); \
+  }                                                                                                \
+                                                                                                   \
+  template<tensor_operand R>                                                                       \
+  auto operator op(const detail::operand_value_t<R>& scalar, R&& rhs) {                            \
+    using B = detail::expression_t<R&&>;                                                           \
+    using S = scalar_expression<typename B::value_type, B::rank>;                                  \
+    return binary_expression<elementwise::functor, S, B>(S(scalar), detail::as_expression(std::forward<R>(rhs))); \
+  }
+
+UTEC_TENSOR_EXPRESSION_OPERATOR(+, plus)
+UTEC_TENSOR_EXPRESSION_OPERATOR(-, minus)
+UTEC_TENSOR_EXPRESSION_OPERATOR(*, multiplies)
+UTEC_TENSOR_EXPRESSION_OPERATOR(/, divides)
+
+#undef UTEC_TENSOR_EXPRESSION_OPERATOR
+
+}
+
+#endif //EXPRESSION_H
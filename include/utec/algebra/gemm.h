@@ -0,0 +1,305 @@
+//
+// Packed, cache-blocked GEMM used by matrix_product for float and double.
+//
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/simd.h"
+
+namespace utec::algebra::gemm {
+
+// Register tile (mr x nr) and cache tiles (mc x kc of A in L2, kc x nr of B in L1,
+// kc x nc of B in L3) for a given vector width.
+template<typename T, size_t Bytes = simd::native_bytes>
+struct blocking {
+  static constexpr size_t lanes = simd::packet<T, Bytes>::lanes;
+  static constexpr size_t nr_packets = 2;
+  static constexpr size_t nr = nr_packets * lanes;
+  static constexpr size_t mr = Bytes >= 64 ? 12 : 6;
+  static constexpr size_t kc = 256;
+  static constexpr size_t mc = mr * (Bytes >= 64 ? 8 : 16);
+  static constexpr size_t nc = nr * (4096 / nr);
+};
+
+// Copies an mb x kb block of A (row stride rsa, column stride csa) into mr-row panels,
+// laid out k-major so the micro-kernel reads it sequentially. Short panels are zero padded.
+// A stored as S (e.g. bfloat16) is converted to the compute type T while packing.
+template<typename T, size_t Bytes, typename S>
+void pack_a(size_t mb, size_t kb, const S* a, size_t rsa, size_t csa, T* UTEC_RESTRICT out) {
+  constexpr size_t mr = blocking<T, Bytes>::mr;
+  for (size_t i0 = 0; i0 < mb; i0 += mr) {
+    const size_t rows = std::min(mr, mb - i0);
+    for (size_t p = 0; p < kb; ++p) {
+      const S* src = a + i0 * rsa + p * csa;
+      size_t i = 0;
+      for (; i < rows; ++i) out[i] = T(src[i * rsa]);
+      for (; i < mr; ++i) out[i] = T{};
+      out += mr;
+    }
+  }
+}
+
+// Copies a kb x nb block of B into nr-column panels, k-major, zero padded and converted
+// to T like pack_a.
+template<typename T, size_t Bytes, typename S>
+void pack_b(size_t kb, size_t nb, const S* b, size_t rsb, size_t csb, T* UTEC_RESTRICT out) {
+  constexpr size_t nr = blocking<T, Bytes>::nr;
+  for (size_t j0 = 0; j0 < nb; j0 += nr) {
+    const size_t cols = std::min(nr, nb - j0);
+    for (size_t p = 0; p < kb; ++p) {
+      const S* src = b + p * rsb + j0 * csb;
+      size_t j = 0;
+      if (csb == 1) {
+        for (; j < cols; ++j) out[j] = T(src[j]);
+      } else {
+        for (; j < cols; ++j) out[j] = T(src[j * csb]);
+      }
+      for (; j < nr; ++j) out[j] = T{};
+      out += nr;
+    }
+  }
+}
+
+// Applied to C as it is written: the default leaves the product untouched.
+struct identity_epilogue {
+  template<typename V>
+  UTEC_ALWAYS_INLINE V operator()(const V& value, size_t) const { return value; }
+};
+
+// C[0:rows, 0:cols] (+)= Apanel * Bpanel, keeping the whole mr x nr tile in registers.
+// When finish is set (on the last k-block) each value is passed through
+// (*finish)(value, column) before the store, where value is a packet of consecutive
+// columns or a single element and column is the index of its first column in C.
+template<typename T, size_t Bytes, typename Epilogue>
+UTEC_ALWAYS_INLINE void micro_kernel(size_t kb, const T* UTEC_RESTRICT ap, const T* UTEC_RESTRICT bp,
+                                     T* c, size_t ldc, size_t rows, size_t cols, bool accumulate,
+                                     const Epilogue* finish, size_t column) {
+  using P = simd::packet<T, Bytes>;
+  using B = blocking<T, Bytes>;
+  constexpr size_t mr = B::mr;
+  constexpr size_t np = B::nr_packets;
+  constexpr size_t lanes = B::lanes;
+
+  P acc[mr][np];
+  for (size_t i = 0; i < mr; ++i)
+    for (size_t j = 0; j < np; ++j) acc[i][j] = P::zero();
+
+  for (size_t p = 0; p < kb; ++p) {
+    P b[np];
+    for (size_t j = 0; j < np; ++j) b[j] = P::load(bp + j * lanes);
+    for (size_t i = 0; i < mr; ++i) {
+      const P a = P::broadcast(ap[i]);
+      for (size_t j = 0; j < np; ++j) acc[i][j] = simd::fmadd(a, b[j], acc[i][j]);
+    }
+    ap += mr;
+    bp += B::nr;
+  }
+
+  if (rows == mr && cols == B::nr) {
+    for (size_t i = 0; i < mr; ++i) {
+      T* row = c + i * ldc;
+      for (size_t j = 0; j < np; ++j) {
+        P r = acc[i][j];
+        if (accumulate) r = r + P::load(row + j * lanes);
+        if (finish) r = (*finish)(r, column + j * lanes);
+        r.store(row + j * lanes);
+      }
+    }
+    return;
+  }
+
+  T tile[mr * B::nr];
+  for (size_t i = 0; i < mr; ++i)
+    for (size_t j = 0; j < np; ++j) acc[i][j].store(tile + i * B::nr + j * lanes);
+  for (size_t i = 0; i < rows; ++i) {
+    T* row = c + i * ldc;
+    const T* t = tile + i * B::nr;
+    for (size_t j = 0; j < cols; ++j) {
+      T value = accumulate ? row[j] + t[j] : t[j];
+      if (finish) value = (*finish)(value, column + j);
+      row[j] = value;
+    }
+  }
+}
+
+template<typename T>
+using scratch_buffer = std::vector<T, aligned_allocator<T>>;
+
+template<typename T>
+scratch_buffer<T>& scratch_a() {
+  thread_local scratch_buffer<T> buffer;
+  return buffer;
+}
+
+template<typename T>
+scratch_buffer<T>& scratch_b() {
+  thread_local scratch_buffer<T> buffer;
+  return buffer;
+}
+
+// Accumulator-typed C for products whose output is stored in a narrower type.
+template<typename T>
+scratch_buffer<T>& scratch_c() {
+  thread_local scratch_buffer<T> buffer;
+  return buffer;
+}
+
+// C[0:mb, 0:nb] (+)= packed A block * packed B panels [jr0, jr1) (in units of nr columns).
+// column is the index in the full C of this block's first column.
+template<typename T, size_t Bytes, typename Epilogue>
+UTEC_ALWAYS_INLINE void macro_kernel(size_t mb, size_t nb, size_t kb, size_t jr0, size_t jr1,
+                                     const T* ap, const T* bp, T* c, size_t ldc, bool accumulate,
+                                     const Epilogue* finish, size_t column) {
+  using B = blocking<T, Bytes>;
+  for (size_t jr = jr0 * B::nr; jr < nb && jr < jr1 * B::nr; jr += B::nr) {
+    const size_t cols = std::min(B::nr, nb - jr);
+    for (size_t ir = 0; ir < mb; ir += B::mr) {
+      const size_t rows = std::min(B::mr, mb - ir);
+      micro_kernel<T, Bytes>(kb, ap + ir * kb, bp + jr * kb, c + ir * ldc + jr, ldc, rows, cols, accumulate,
+                             finish, column + jr);
+    }
+  }
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX2 void macro_kernel_avx2(size_t mb, size_t nb, size_t kb, size_t jr0, size_t jr1,
+                                        const T* ap, const T* bp, T* c, size_t ldc, bool accumulate,
+                                        const Epilogue* finish, size_t column) {
+  macro_kernel<T, 32>(mb, nb, kb, jr0, jr1, ap, bp, c, ldc, accumulate, finish, column);
+}
+
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX512 void macro_kernel_avx512(size_t mb, size_t nb, size_t kb, size_t jr0, size_t jr1,
+                                            const T* ap, const T* bp, T* c, size_t ldc, bool accumulate,
+                                            const Epilogue* finish, size_t column) {
+  macro_kernel<T, 64>(mb, nb, kb, jr0, jr1, ap, bp, c, ldc, accumulate, finish, column);
+}
+#endif
+
+// The macro-kernel compiled for Bytes-wide registers: inline when the translation unit
+// already targets that width, otherwise the matching target-attributed variant.
+template<typename T, size_t Bytes, typename Epilogue>
+void macro_kernel_for(size_t mb, size_t nb, size_t kb, size_t jr0, size_t jr1,
+                      const T* ap, const T* bp, T* c, size_t ldc, bool accumulate,
+                      const Epilogue* finish, size_t column) {
+  if constexpr (Bytes <= simd::native_bytes) {
+    macro_kernel<T, Bytes>(mb, nb, kb, jr0, jr1, ap, bp, c, ldc, accumulate, finish, column);
+  }
+#if UTEC_RUNTIME_DISPATCH
+  else if constexpr (Bytes == 32) {
+    macro_kernel_avx2<T>(mb, nb, kb, jr0, jr1, ap, bp, c, ldc, accumulate, finish, column);
+  } else {
+    static_assert(Bytes == 64, "No kernel variant for this vector width");
+    macro_kernel_avx512<T>(mb, nb, kb, jr0, jr1, ap, bp, c, ldc, accumulate, finish, column);
+  }
+#else
+  else {
+    static_assert(Bytes <= simd::native_bytes, "No kernel variant for this vector width");
+  }
+#endif
+}
+
+// C (m x n, row stride ldc, unit column stride) = A (m x k) * B (k x n) with
+// Bytes-wide micro-kernels, where A and B are addressed through arbitrary row/column
+// strides. When accumulate is true the product is added to the existing contents of C.
+// The epilogue is fused into the final store of every tile (see micro_kernel), e.g. to
+// add a bias and apply an activation without another pass over C.
+//
+// Each packed kc x nc panel of B is shared by all threads. Tall products split the
+// mc-row blocks of C across tasks (each packing its own A block into thread-local
+// scratch); short, wide ones pack A once and split the nr-column panels instead.
+//
+// A and B may be stored as another type S, which the packing converts to T: C and every
+// accumulation are in T (e.g. bfloat16 operands with float accumulation).
+template<typename T, size_t Bytes = simd::native_bytes, typename Epilogue = identity_epilogue, typename S = T>
+void blocked_gemm(size_t m, size_t n, size_t k,
+                  const S* a, size_t rsa, size_t csa,
+                  const S* b, size_t rsb, size_t csb,
+                  T* c, size_t ldc, bool accumulate = false, const Epilogue& epilogue = {}) {
+  using B = blocking<T, Bytes>;
+  if (m == 0 || n == 0) return;
+  if (k == 0) {
+    for (size_t i = 0; i < m; ++i) {
+      T* row = c + i * ldc;
+      for (size_t j = 0; j < n; ++j) row[j] = epilogue(accumulate ? row[j] : T{}, j);
+    }
+    return;
+  }
+
+  const size_t kc_max = std::min(B::kc, k);
+  const size_t mc_max = std::min(B::mc, (m + B::mr - 1) / B::mr * B::mr);
+  const size_t nc_max = std::min(B::nc, (n + B::nr - 1) / B::nr * B::nr);
+  const auto reserve_a = [&] {
+    auto& apack = scratch_a<T>();
+    if (apack.size() < mc_max * kc_max) apack.resize(mc_max * kc_max);
+    return apack.data();
+  };
+  auto& bpack = scratch_b<T>();
+  if (bpack.size() < kc_max * nc_max) bpack.resize(kc_max * nc_max);
+
+  const size_t blocks = (m + B::mc - 1) / B::mc;
+  const size_t gemm_grain = parallel::config().gemm_grain;
+
+  for (size_t jc = 0; jc < n; jc += B::nc) {
+    const size_t nb = std::min(B::nc, n - jc);
+    const size_t panels = (nb + B::nr - 1) / B::nr;
+    for (size_t pc = 0; pc < k; pc += B::kc) {
+      const size_t kb = std::min(B::kc, k - pc);
+      const bool acc = accumulate || pc > 0;
+      const Epilogue* finish = pc + kb == k ? &epilogue : nullptr;
+      const T* bp = bpack.data();
+      pack_b<T, Bytes>(kb, nb, b + pc * rsb + jc * csb, rsb, csb, bpack.data());
+
+      if (blocks >= parallel::num_threads()) {
+        const size_t grain = std::max<size_t>(1, gemm_grain / (B::mc * nb * kb));
+        parallel::parallel_for(0, blocks, grain, [&](size_t first, size_t last) {
+          T* ap = reserve_a();
+          for (size_t block = first; block < last; ++block) {
+            const size_t ic = block * B::mc;
+            const size_t mb = std::min(B::mc, m - ic);
+            pack_a<T, Bytes>(mb, kb, a + ic * rsa + pc * csa, rsa, csa, ap);
+            macro_kernel_for<T, Bytes>(mb, nb, kb, 0, panels, ap, bp, c + ic * ldc + jc, ldc, acc, finish, jc);
+          }
+        });
+      } else {
+        T* ap = reserve_a();
+        for (size_t ic = 0; ic < m; ic += B::mc) {
+          const size_t mb = std::min(B::mc, m - ic);
+          pack_a<T, Bytes>(mb, kb, a + ic * rsa + pc * csa, rsa, csa, ap);
+          const size_t grain = std::max<size_t>(1, gemm_grain / (mb * B::nr * kb));
+          parallel::parallel_for(0, panels, grain, [&](size_t first, size_t last) {
+            macro_kernel_for<T, Bytes>(mb, nb, kb, first, last, ap, bp, c + ic * ldc + jc, ldc, acc, finish,
+                                       jc);
+          });
+        }
+      }
+    }
+  }
+}
+
+// blocked_gemm with the widest micro-kernel the CPU supports (see dispatch.h).
+template<typename T, typename Epilogue = identity_epilogue, typename S = T>
+void gemm(size_t m, size_t n, size_t k,
+          const S* a, size_t rsa, size_t csa,
+          const S* b, size_t rsb, size_t csb,
+          T* c, size_t ldc, bool accumulate = false, const Epilogue& epilogue = {}) {
+  const auto kernel = dispatch::select(&blocked_gemm<T, simd::native_bytes, Epilogue, S>
+                                       UTEC_DISPATCH_VARIANTS(, &blocked_gemm<T, 32, Epilogue, S>,
+                                                              &blocked_gemm<T, 64, Epilogue, S>));
+  kernel(m, n, k, a, rsa, csa, b, rsb, csb, c, ldc, accumulate, epilogue);
+}
+
+}
+
+#endif //GEMM_H
@@ -0,0 +1,180 @@
+//
+// 16-bit floating-point storage types and their conversion kernels.
+//
+
+#ifndef HALF_H
+#define HALF_H
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/simd.h"
+
+namespace utec::algebra {
+
+namespace half {
+
+// Both conversions are branch-free integer code (the selects compare bit patterns, not
+// floats), so the loops in convert() vectorize.
+
+inline float bfloat16_to_float(uint16_t h) { return std::bit_cast<float>(uint32_t(h) << 16); }
+
+// Round to nearest even; NaNs stay (quiet) NaNs.
+inline uint16_t float_to_bfloat16(float f) {
+  const uint32_t x = std::bit_cast<uint32_t>(f);
+  const uint32_t rounded = (x + 0x7fffu + ((x >> 16) & 1u)) >> 16;
+  return uint16_t((x & 0x7fffffffu) > 0x7f800000u ? (x >> 16) | 0x40u : rounded);
+}
+
+// IEEE binary16, subnormals included (F. Giesen's bit-manipulation conversions).
+inline float float16_to_float(uint16_t h) {
+  constexpr uint32_t shifted_exponent = 0x7c00u << 13;
+  const uint32_t magnitude = (uint32_t(h) & 0x7fffu) << 13;
+  const uint32_t exponent = magnitude & shifted_exponent;
+  const uint32_t normal = magnitude + ((127u - 15u) << 23);
+  const uint32_t special = normal + ((128u - 16u) << 23);
+  const float subnormal = std::bit_cast<float>(normal + (1u << 23)) - std::bit_cast<float>(113u << 23);
+  const uint32_t bits = exponent == shifted_exponent ? special
+                        : exponent == 0              ? std::bit_cast<uint32_t>(subnormal)
+                                                     : normal;
+  return std::bit_cast<float>(bits | ((uint32_t(h) & 0x8000u) << 16));
+}
+
+// Round to nearest even; overflow goes to infinity and NaNs stay NaNs.
+inline uint16_t float_to_float16(float f) {
+  constexpr uint32_t infinity = 255u << 23;
+  constexpr uint32_t overflow = (127u + 16u) << 23;
+  constexpr uint32_t denormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+  const uint32_t x = std::bit_cast<uint32_t>(f);
+  const uint32_t sign = x & 0x80000000u;
+  const uint32_t magnitude = x ^ sign;
+  const uint32_t large = magnitude > infinity ? 0x7e00u : 0x7c00u;
+  const uint32_t small =
+      std::bit_cast<uint32_t>(std::bit_cast<float>(magnitude) + std::bit_cast<float>(denormal_magic)) - denormal_magic;
+  const uint32_t normal = (magnitude + ((15u - 127u) << 23) + 0xfffu + ((magnitude >> 13) & 1u)) >> 13;
+  const uint32_t bits = magnitude >= overflow ? large : magnitude < (113u << 23) ? small : normal;
+  return uint16_t(bits | (sign >> 16));
+}
+
+}
+
+// bfloat16: the upper half of a float (8 exponent bits, 7 mantissa bits). A storage
+// type: values convert implicitly to float, so any arithmetic on them happens in float,
+// and assigning a float rounds back.
+struct bfloat16 {
+  uint16_t bits = 0;
+
+  constexpr bfloat16() = default;
+  bfloat16(float value) : bits(half::float_to_bfloat16(value)) {}
+  operator float() const { return half::bfloat16_to_float(bits); }
+
+  static constexpr bfloat16 from_bits(uint16_t b) {
+    bfloat16 r;
+    r.bits = b;
+    return r;
+  }
+
+  bfloat16& operator+=(float x) { return *this = float(*this) + x; }
+  bfloat16& operator-=(float x) { return *this = float(*this) - x; }
+  bfloat16& operator*=(float x) { return *this = float(*this) * x; }
+  bfloat16& operator/=(float x) { return *this = float(*this) / x; }
+};
+
+// float16: IEEE binary16 (5 exponent bits, 10 mantissa bits), same storage semantics.
+struct float16 {
+  uint16_t bits = 0;
+
+  constexpr float16() = default;
+  float16(float value) : bits(half::float_to_float16(value)) {}
+  operator float() const { return half::float16_to_float(bits); }
+
+  static constexpr float16 from_bits(uint16_t b) {
+    float16 r;
+    r.bits = b;
+    return r;
+  }
+
+  float16& operator+=(float x) { return *this = float(*this) + x; }
+  float16& operator-=(float x) { return *this = float(*this) - x; }
+  float16& operator*=(float x) { return *this = float(*this) * x; }
+  float16& operator/=(float x) { return *this = float(*this) / x; }
+};
+
+static_assert(sizeof(bfloat16) == 2 && sizeof(float16) == 2);
+
+template<typename T>
+inline constexpr bool is_half_v = std::is_same_v<T, bfloat16> || std::is_same_v<T, float16>;
+
+// Type sums and products of T are accumulated in: float for the 16-bit types, T itself
+// otherwise.
+template<typename T>
+struct accumulator {
+  using type = T;
+};
+
+template<>
+struct accumulator<bfloat16> {
+  using type = float;
+};
+
+template<>
+struct accumulator<float16> {
+  using type = float;
+};
+
+template<typename T>
+using accumulator_t = typename accumulator<T>::type;
+
+namespace half {
+
+template<typename From, typename To>
+UTEC_ALWAYS_INLINE void convert_body(size_t n, const From* UTEC_RESTRICT in, To* UTEC_RESTRICT out) {
+  for (size_t i = 0; i < n; ++i) {
+    if constexpr (std::is_same_v<To, bfloat16> && std::is_same_v<From, float>)
+      out[i] = bfloat16::from_bits(float_to_bfloat16(in[i]));
+    else if constexpr (std::is_same_v<To, float16> && std::is_same_v<From, float>)
+      out[i] = float16::from_bits(float_to_float16(in[i]));
+    else if constexpr (std::is_same_v<From, bfloat16> && std::is_same_v<To, float>)
+      out[i] = bfloat16_to_float(in[i].bits);
+    else if constexpr (std::is_same_v<From, float16> && std::is_same_v<To, float>)
+      out[i] = float16_to_float(in[i].bits);
+    else
+      out[i] = To(in[i]);
+  }
+}
+
+template<typename From, typename To>
+void convert_native(size_t n, const From* in, To* out) {
+  convert_body(n, in, out);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename From, typename To>
+UTEC_TARGET_AVX2 void convert_avx2(size_t n, const From* in, To* out) {
+  convert_body(n, in, out);
+}
+
+template<typename From, typename To>
+UTEC_TARGET_AVX512 void convert_avx512(size_t n, const From* in, To* out) {
+  convert_body(n, in, out);
+}
+#endif
+
+// out[i] = To(in[i]) for n values. Between float and the 16-bit types this runs the
+// widest vectorized variant the CPU supports.
+template<typename From, typename To>
+void convert(size_t n, const From* in, To* out) {
+  dispatch::select(&convert_native<From, To>
+                   UTEC_DISPATCH_VARIANTS(, &convert_avx2<From, To>, &convert_avx512<From, To>))(n, in, out);
+}
+
+}
+
+}
+
+#endif //HALF_H
@@ -0,0 +1,201 @@
+//
+// Parallel loops for the tensor kernels: TBB when available, a std::thread pool otherwise.
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(UTEC_HAS_TBB)
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
+
+namespace utec::algebra::parallel {
+
+// num_threads: upper bound on worker threads (1 disables threading).
+// grain_size: minimum number of elements per task for elementwise kernels; smaller
+//             tensors run inline on the calling thread.
+// gemm_grain: minimum multiply-adds per task for matrix_product.
+struct settings {
+  size_t num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  size_t grain_size = size_t{1} << 15;
+  size_t gemm_grain = size_t{1} << 18;
+};
+
+inline settings& config() {
+  static settings instance;
+  return instance;
+}
+
+namespace detail {
+
+inline thread_local bool inside_parallel_region = false;
+
+#if defined(UTEC_HAS_TBB)
+
+inline std::unique_ptr<tbb::global_control>& tbb_control() {
+  static std::unique_ptr<tbb::global_control> control;
+  return control;
+}
+
+#else
+
+// Fixed set of workers that cooperatively drain one parallel_for at a time; the calling
+// thread participates, so a pool of n - 1 workers gives n-way parallelism.
+class thread_pool {
+ private:
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  void (*job_)(const void*, size_t) = nullptr;
+  const void* context_ = nullptr;
+  std::atomic<size_t> next_{0};
+  std::atomic<size_t> chunks_{0};
+  size_t active_ = 0;
+  size_t generation_ = 0;
+  bool stop_ = false;
+
+  void drain() {
+    for (size_t c; (c = next_.fetch_add(1)) < chunks_;) job_(context_, c);
+  }
+
+  void work() {
+    inside_parallel_region = true;
+    size_t seen = 0;
+    std::unique_lock lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+      ++active_;
+      lock.unlock();
+      drain();
+      lock.lock();
+      if (--active_ == 0) done_.notify_all();
+    }
+  }
+
+ public:
+  explicit thread_pool(size_t workers) {
+    for (size_t i = 0; i < workers; ++i) workers_.emplace_back([this] { work(); });
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& w : workers_) w.join();
+  }
+
+  size_t size() const { return workers_.size() + 1; }
+
+  // Runs job(c) for c in [0, chunks) and returns once every chunk has finished.
+  template<typename Job>
+  void run(size_t chunks, const Job& job) {
+    std::unique_lock lock(mutex_);
+    job_ = [](const void* context, size_t c) { (*static_cast<const Job*>(context))(c); };
+    context_ = &job;
+    chunks_ = chunks;
+    next_ = 0;
+    ++generation_;
+    lock.unlock();
+    wake_.notify_all();
+
+    inside_parallel_region = true;
+    drain();
+    inside_parallel_region = false;
+
+    lock.lock();
+    done_.wait(lock, [&] { return active_ == 0 && next_ >= chunks_; });
+    job_ = nullptr;
+    context_ = nullptr;
+  }
+};
+
+inline std::mutex& pool_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+inline std::unique_ptr<thread_pool>& pool_instance() {
+  static std::unique_ptr<thread_pool> pool;
+  return pool;
+}
+
+#endif
+
+}
+
+inline void set_num_threads(size_t n) {
+  config().num_threads = std::max<size_t>(1, n);
+#if defined(UTEC_HAS_TBB)
+  detail::tbb_control() =
+      std::make_unique<tbb::global_control>(tbb::global_control::max_allowed_parallelism, config().num_threads);
+#endif
+}
+
+inline size_t num_threads() { return config().num_threads; }
+
+inline void set_grain_size(size_t elements) { config().grain_size = std::max<size_t>(1, elements); }
+
+inline size_t grain_size() { return config().grain_size; }
+
+inline void set_gemm_grain(size_t multiply_adds) { config().gemm_grain = std::max<size_t>(1, multiply_adds); }
+
+// Calls fn(chunk_begin, chunk_end) over [begin, end) split into chunks of at least
+// `grain` indices. Runs inline when the range fits in one chunk, when threading is
+// disabled, or when already inside a parallel region of the fallback pool (TBB nests).
+template<typename Fn>
+void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn) {
+  if (end <= begin) return;
+  grain = std::max<size_t>(1, grain);
+  const size_t threads = config().num_threads;
+  const size_t count = end - begin;
+  if (threads <= 1 || count <= grain || detail::inside_parallel_region) {
+    fn(begin, end);
+    return;
+  }
+
+#if defined(UTEC_HAS_TBB)
+  // Isolation keeps a waiting thread from picking up unrelated outer tasks, which could
+  // otherwise reuse the thread-local scratch buffers the caller is still working with.
+  tbb::this_task_arena::isolate([&] {
+    tbb::parallel_for(tbb::blocked_range<size_t>(begin, end, grain),
+                      [&](const tbb::blocked_range<size_t>& r) { fn(r.begin(), r.end()); });
+  });
+#else
+  const size_t chunks = std::min(threads * 4, (count + grain - 1) / grain);
+  const size_t step = (count + chunks - 1) / chunks;
+  std::lock_guard lock(detail::pool_mutex());
+  auto& pool = detail::pool_instance();
+  if (!pool || pool->size() != threads) {
+    pool.reset();
+    pool = std::make_unique<detail::thread_pool>(threads - 1);
+  }
+  pool->run(chunks, [&](size_t c) {
+    const size_t b = begin + c * step;
+    const size_t e = std::min(end, b + step);
+    if (b < e) fn(b, e);
+  });
+#endif
+}
+
+}
+
+#endif //PARALLEL_H
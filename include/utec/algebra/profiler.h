@@ -0,0 +1,286 @@
+//
+// Opt-in per-op counters and Chrome trace_event export for the tensor ops and layers.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef UTEC_PROFILE
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#endif
+
+// Compiled in only with -DUTEC_PROFILE (the UTEC_PROFILE CMake option). Without it
+// UTEC_PROFILE_SCOPE expands to nothing, its arguments are never evaluated, and the
+// functions below are empty inlines, so callers need no #ifdefs.
+//
+// UTEC_PROFILE_SCOPE(name, flops) times the rest of the enclosing block as one call
+// of the op `name` (a string literal) doing `flops` floating-point operations. Counters
+// are per thread and are summed by name in report(); times are inclusive, so a layer's
+// time and allocations contain those of the matrix_product it runs. Allocations are
+// counted through aligned_allocator and arena, on the thread that makes them.
+//
+// While a trace is active (start_trace) every scope also records a complete event;
+// write_trace emits them as Chrome trace_event JSON (chrome://tracing, Perfetto).
+namespace utec::algebra::profiler {
+
+struct op_stats {
+  std::string name;
+  uint64_t calls = 0;
+  uint64_t flops = 0;
+  uint64_t bytes_allocated = 0;
+  double seconds = 0;
+};
+
+#ifdef UTEC_PROFILE
+
+inline constexpr bool enabled = true;
+
+namespace detail {
+
+struct counters {
+  uint64_t calls = 0;
+  uint64_t flops = 0;
+  uint64_t bytes = 0;
+  uint64_t nanoseconds = 0;
+};
+
+struct event {
+  uint32_t site;
+  uint64_t start;
+  uint64_t duration;
+  uint64_t flops;
+  uint64_t bytes;
+};
+
+// One thread's counters, indexed by site. The mutex is only contended while another
+// thread takes a report or a trace.
+struct thread_data {
+  size_t id = 0;
+  std::mutex mutex;
+  std::vector<counters> sites;
+  std::vector<event> events;
+};
+
+struct registry {
+  std::mutex mutex;
+  std::vector<const char*> names;
+  std::vector<std::shared_ptr<thread_data>> threads;
+  std::atomic<bool> tracing{false};
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline registry& global() {
+  static registry instance;
+  return instance;
+}
+
+// Kept alive by the registry, so counters of finished threads still show in reports.
+inline thread_data& local() {
+  thread_local const std::shared_ptr<thread_data> data = [] {
+    auto d = std::make_shared<thread_data>();
+    registry& r = global();
+    std::lock_guard lock(r.mutex);
+    d->id = r.threads.size();
+    r.threads.push_back(d);
+    return d;
+  }();
+  return *data;
+}
+
+inline uint64_t now() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                       global().epoch).count());
+}
+
+inline uint32_t register_site(const char* name) {
+  registry& r = global();
+  std::lock_guard lock(r.mutex);
+  r.names.push_back(name);
+  return uint32_t(r.names.size() - 1);
+}
+
+class scope;
+inline thread_local scope* current = nullptr;
+
+class scope {
+ private:
+  uint32_t site_;
+  uint64_t flops_;
+  uint64_t bytes_ = 0;
+  uint64_t start_;
+  scope* parent_;
+
+ public:
+  scope(uint32_t site, uint64_t flops) : site_(site), flops_(flops), start_(now()), parent_(current) {
+    current = this;
+  }
+
+  scope(const scope&) = delete;
+  scope& operator=(const scope&) = delete;
+
+  ~scope() {
+    const uint64_t duration = now() - start_;
+    current = parent_;
+    if (parent_ != nullptr) parent_->bytes_ += bytes_;
+    thread_data& data = local();
+    std::lock_guard lock(data.mutex);
+    if (data.sites.size() <= site_) data.sites.resize(site_ + 1);
+    counters& c = data.sites[site_];
+    ++c.calls;
+    c.flops += flops_;
+    c.bytes += bytes_;
+    c.nanoseconds += duration;
+    if (global().tracing.load(std::memory_order_relaxed))
+      data.events.push_back({site_, start_, duration, flops_, bytes_});
+  }
+
+  void allocated(size_t bytes) { bytes_ += bytes; }
+};
+
+inline void write_escaped(std::ostream& out, const char* s) {
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') out << '\\';
+    out << *s;
+  }
+}
+
+}
+
+inline void record_allocation(size_t bytes) {
+  if (detail::current != nullptr) detail::current->allocated(bytes);
+}
+
+// Clears all counters and recorded events.
+inline void reset() {
+  detail::registry& r = detail::global();
+  std::lock_guard lock(r.mutex);
+  for (auto& t : r.threads) {
+    std::lock_guard thread_lock(t->mutex);
+    t->sites.clear();
+    t->events.clear();
+  }
+}
+
+// Counters of every op summed over threads, most time first.
+inline std::vector<op_stats> report() {
+  detail::registry& r = detail::global();
+  std::lock_guard lock(r.mutex);
+  std::vector<op_stats> stats;
+  for (auto& t : r.threads) {
+    std::lock_guard thread_lock(t->mutex);
+    for (size_t site = 0; site < t->sites.size(); ++site) {
+      const detail::counters& c = t->sites[site];
+      if (c.calls == 0) continue;
+      auto it = std::find_if(stats.begin(), stats.end(), [&](const op_stats& s) { return s.name == r.names[site]; });
+      if (it == stats.end()) it = stats.insert(stats.end(), op_stats{r.names[site]});
+      it->calls += c.calls;
+      it->flops += c.flops;
+      it->bytes_allocated += c.bytes;
+      it->seconds += double(c.nanoseconds) * 1e-9;
+    }
+  }
+  std::sort(stats.begin(), stats.end(), [](const op_stats& a, const op_stats& b) { return a.seconds > b.seconds; });
+  return stats;
+}
+
+inline void print(std::ostream& out) {
+  out << std::left << std::setw(28) << "op" << std::right << std::setw(10) << "calls" << std::setw(12) << "ms"
+      << std::setw(12) << "GFLOP/s" << std::setw(14) << "MB alloc" << '\n';
+  for (const auto& s : report()) {
+    out << std::left << std::setw(28) << s.name << std::right << std::setw(10) << s.calls << std::setw(12)
+        << std::fixed << std::setprecision(3) << s.seconds * 1e3 << std::setw(12)
+        << (s.seconds > 0 ? double(s.flops) / s.seconds * 1e-9 : 0.0) << std::setw(14)
+        << double(s.bytes_allocated) / 1e6 << '\n';
+  }
+  out.unsetf(std::ios::floatfield);
+}
+
+// Starts recording one event per scope (dropping earlier events); stop_trace keeps
+// them for write_trace.
+inline void start_trace() {
+  detail::registry& r = detail::global();
+  {
+    std::lock_guard lock(r.mutex);
+    for (auto& t : r.threads) {
+      std::lock_guard thread_lock(t->mutex);
+      t->events.clear();
+    }
+  }
+  r.tracing.store(true);
+}
+
+inline void stop_trace() { detail::global().tracing.store(false); }
+
+// Chrome trace_event JSON: one complete ("X") event per scope, timestamps in
+// microseconds, one track per thread.
+inline void write_trace(std::ostream& out) {
+  detail::registry& r = detail::global();
+  std::lock_guard lock(r.mutex);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (auto& t : r.threads) {
+    std::lock_guard thread_lock(t->mutex);
+    out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t->id
+        << ",\"args\":{\"name\":\"thread " << t->id << "\"}}";
+    first = false;
+    for (const auto& e : t->events) {
+      out << ",\n{\"name\":\"";
+      detail::write_escaped(out, r.names[e.site]);
+      out << "\",\"cat\":\"utec\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t->id << ",\"ts\":" << e.start / 1000 << '.'
+          << std::setfill('0') << std::setw(3) << e.start % 1000 << ",\"dur\":" << e.duration / 1000 << '.'
+          << std::setw(3) << e.duration % 1000 << std::setfill(' ') << ",\"args\":{\"flops\":" << e.flops
+          << ",\"bytes_allocated\":" << e.bytes << "}}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+inline void write_trace(const std::string& path) {
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) throw std::runtime_error("Cannot open " + path + " for writing");
+  write_trace(out);
+}
+
+#define UTEC_PROFILE_CONCAT_(a, b) a##b
+#define UTEC_PROFILE_CONCAT(a, b) UTEC_PROFILE_CONCAT_(a, b)
+#define UTEC_PROFILE_SCOPE(name, flops)                                                                      \
+  static const uint32_t UTEC_PROFILE_CONCAT(utec_profile_site_, __LINE__) =                                 \
+      ::utec::algebra::profiler::detail::register_site(name);                                                 \
+  ::utec::algebra::profiler::detail::scope UTEC_PROFILE_CONCAT(utec_profile_scope_, __LINE__)(         \
+      UTEC_PROFILE_CONCAT(utec_profile_site_, __LINE__), uint64_t(flops))
+
+#else
+
+inline constexpr bool enabled = false;
+
+inline void record_allocation(size_t) {}
+inline void reset() {}
+inline std::vector<op_stats> report() { return {}; }
+inline void print(std::ostream&) {}
+inline void start_trace() {}
+inline void stop_trace() {}
+inline void write_trace(std::ostream& out) { out << "{\"traceEvents\":[]}\n"; }
+inline void write_trace(const std::string&) {}
+
+#define UTEC_PROFILE_SCOPE(name, flops) static_assert(true)
+
+#endif
+
+}
+
+#endif //PROFILER_H
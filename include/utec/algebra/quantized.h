@@ -0,0 +1,380 @@
+//
+// Int8 matrices with per-column scales and the int8 x int8 -> int32 matrix_product.
+//
+
+#ifndef QUANTIZED_H
+#define QUANTIZED_H
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/simd.h"
+#include "utec/algebra/tensor.h"
+
+#if UTEC_RUNTIME_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace utec::algebra {
+
+namespace quantization {
+
+// Symmetric int8: v ~= scale * q with q in [-127, 127]; -128 is never produced.
+inline constexpr int limit = 127;
+
+// Packed layout of a (rows, columns) matrix: panels of `block` columns, each a run of
+// groups of `group` consecutive rows. One group of a panel is 64 bytes, byte
+// group * j + t holding W(group * g + t, block * p + j), which is exactly the operand
+// of one vpdpbusd: 16 int32 columns, each a dot product over 4 rows. Padding is zero.
+inline constexpr size_t group = 4;
+inline constexpr size_t block = 16;
+inline constexpr size_t group_bytes = group * block;
+
+inline size_t groups(size_t rows) { return (rows + group - 1) / group; }
+inline size_t blocks(size_t columns) { return (columns + block - 1) / block; }
+
+// Scale mapping [-max_abs, max_abs] onto [-127, 127]; 1 for an all-zero range.
+inline float scale_for(float max_abs) { return max_abs > 0 ? max_abs / float(limit) : 1.0f; }
+
+// Adding 1.5 * 2^23 to a float of magnitude below 2^22 rounds it to an integer (to
+// nearest even) held in the low mantissa bits, so its low byte is that integer as an
+// int8. Unlike nearbyint and float-to-int8 conversions this vectorizes on every target.
+inline constexpr float round_magic = 12582912.0f;
+
+// Round to nearest, saturating at +-127.
+inline int8_t quantize(float value, float inverse_scale) {
+  const float q = std::clamp(value * inverse_scale, -float(limit), float(limit)) + round_magic;
+  return int8_t(uint8_t(std::bit_cast<uint32_t>(q)));
+}
+
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+template<size_t Lanes>
+struct byte_registers {
+  typedef int8_t words __attribute__((vector_size(4 * Lanes)));
+  typedef int8_t bytes __attribute__((vector_size(Lanes)));
+};
+
+// Byte 0 of every 32-bit lane (little endian).
+template<size_t Lanes, size_t... I>
+UTEC_ALWAYS_INLINE typename byte_registers<Lanes>::bytes low_bytes(typename byte_registers<Lanes>::words w,
+                                                                   std::index_sequence<I...>) {
+  return __builtin_shufflevector(w, w, (4 * I)...);
+}
+#endif
+
+// q[0:n) = quantize(x[0:n)), float packets of Bytes at a time.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void quantize(size_t n, const T* UTEC_RESTRICT x, float inverse_scale, int8_t* UTEC_RESTRICT q) {
+  size_t i = 0;
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+  if constexpr (std::is_same_v<T, float>) {
+    using P = simd::packet<float, Bytes>;
+    using R = typename P::register_type;
+    constexpr size_t L = P::lanes;
+    for (; i + L <= n; i += L) {
+      R v = P::load(x + i).v * inverse_scale;
+      v = v < -float(limit) ? R{} - float(limit) : v;
+      v = v > float(limit) ? R{} + float(limit) : v;
+      v = v + round_magic;
+      typename byte_registers<L>::words w;
+      std::memcpy(&w, &v, sizeof(w));
+      const auto b = low_bytes<L>(w, std::make_index_sequence<L>{});
+      std::memcpy(q + i, &b, sizeof(b));
+    }
+  }
+#endif
+  for (; i < n; ++i) q[i] = quantize(float(x[i]), inverse_scale);
+}
+
+// Kernel of rows [first, last) of c = a W: a holds k int8 values per row (row stride
+// lda), W is packed as above with its `bias` (128 times the column sums, used by the
+// VNNI kernel), and n int32 values of every c row (stride ldc) are written.
+using gemm_kernel = void (*)(size_t first, size_t last, size_t k, size_t n, const int8_t* a, size_t lda,
+                             const int8_t* packed, const int32_t* bias, int32_t* c, size_t ldc);
+
+// The 4 int8 values of group g of x (zero past k).
+UTEC_ALWAYS_INLINE int32_t group_word(const int8_t* x, size_t k, size_t g) {
+  int32_t word = 0;
+  if (group * (g + 1) <= k) std::memcpy(&word, x + group * g, group);
+  else for (size_t t = group * g; t < k; ++t) word |= int32_t(uint8_t(x[t])) << (8 * (t - group * g));
+  return word;
+}
+
+#if defined(__SSE2__)
+// SSE2 (every x86-64 CPU): vpmaddwd on weights sign-extended to int16, as in the AVX2
+// kernel below, leaving the sums of rows (0, 1) and (2, 3) of every column in adjacent
+// lanes of 8 accumulators that are added pairwise at the end.
+inline void gemm_native(size_t first, size_t last, size_t k, size_t n, const int8_t* a, size_t lda,
+                        const int8_t* packed, const int32_t*, int32_t* c, size_t ldc) {
+  const size_t kg = groups(k);
+  for (size_t r = first; r < last; ++r) {
+    const int8_t* x = a + r * lda;
+    int32_t* y = c + r * ldc;
+    for (size_t p = 0; p * block < n; ++p) {
+      const int8_t* panel = packed + p * kg * group_bytes;
+      __m128i acc[8];
+      for (auto& v : acc) v = _mm_setzero_si128();
+      for (size_t g = 0; g < kg; ++g) {
+        const __m128i word = _mm_cvtsi32_si128(group_word(x, k, g));
+        const __m128i xs = _mm_shuffle_epi32(_mm_srai_epi16(_mm_unpacklo_epi8(word, word), 8), 0x44);
+        const int8_t* w = panel + g * group_bytes;
+        for (size_t i = 0; i < 4; ++i) {
+          const __m128i wi = _mm_load_si128(reinterpret_cast<const __m128i*>(w + 16 * i));
+          const __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(wi, wi), 8);
+          const __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(wi, wi), 8);
+          acc[2 * i] = _mm_add_epi32(acc[2 * i], _mm_madd_epi16(lo, xs));
+          acc[2 * i + 1] = _mm_add_epi32(acc[2 * i + 1], _mm_madd_epi16(hi, xs));
+        }
+      }
+      alignas(16) int32_t sums[block];
+      for (size_t i = 0; i < 4; ++i) {
+        const __m128 u = _mm_castsi128_ps(acc[2 * i]);
+        const __m128 v = _mm_castsi128_ps(acc[2 * i + 1]);
+        const __m128i even = _mm_castps_si128(_mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(u, v, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(sums + 4 * i), _mm_add_epi32(even, odd));
+      }
+      std::copy_n(sums, std::min(block, n - p * block), y + p * block);
+    }
+  }
+}
+#else
+// Portable kernel: int32 accumulation of int8 products, one panel of 16 columns at a
+// time.
+inline void gemm_native(size_t first, size_t last, size_t k, size_t n, const int8_t* a, size_t lda,
+                        const int8_t* packed, const int32_t*, int32_t* c, size_t ldc) {
+  const size_t kg = groups(k);
+  for (size_t r = first; r < last; ++r) {
+    const int8_t* x = a + r * lda;
+    int32_t* y = c + r * ldc;
+    for (size_t p = 0; p * block < n; ++p) {
+      const int8_t* panel = packed + p * kg * group_bytes;
+      int32_t acc[block] = {};
+      for (size_t g = 0; g < kg; ++g) {
+        int32_t xs[group];
+        for (size_t t = 0; t < group; ++t) xs[t] = group * g + t < k ? x[group * g + t] : 0;
+        const int8_t* w = panel + g * group_bytes;
+        for (size_t j = 0; j < block; ++j)
+          for (size_t t = 0; t < group; ++t) acc[j] += xs[t] * int32_t(w[group * j + t]);
+      }
+      std::copy_n(acc, std::min(block, n - p * block), y + p * block);
+    }
+  }
+}
+#endif
+
+#if UTEC_RUNTIME_DISPATCH
+// AVX2 without VNNI: the SSE2 scheme on 256-bit registers, with one hadd per pair of
+// accumulators and a permute restoring column order.
+UTEC_TARGET_AVX2 inline void gemm_avx2(size_t first, size_t last, size_t k, size_t n, const int8_t* a, size_t lda,
+                                       const int8_t* packed, const int32_t*, int32_t* c, size_t ldc) {
+  const size_t kg = groups(k);
+  const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+  for (size_t r = first; r < last; ++r) {
+    const int8_t* x = a + r * lda;
+    int32_t* y = c + r * ldc;
+    for (size_t p = 0; p * block < n; ++p) {
+      const int8_t* panel = packed + p * kg * group_bytes;
+      __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(),
+                        _mm256_setzero_si256()};
+      for (size_t g = 0; g < kg; ++g) {
+        const __m256i xs = _mm256_broadcastq_epi64(_mm_cvtepi8_epi16(_mm_cvtsi32_si128(group_word(x, k, g))));
+        const int8_t* w = panel + g * group_bytes;
+        for (size_t i = 0; i < 4; ++i) {
+          const __m256i wi = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(w + 16 * i)));
+          acc[i] = _mm256_add_epi32(acc[i], _mm256_madd_epi16(wi, xs));
+        }
+      }
+      alignas(32) int32_t sums[block];
+      _mm256_store_si256(reinterpret_cast<__m256i*>(sums),
+                         _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(acc[0], acc[1]), order));
+      _mm256_store_si256(reinterpret_cast<__m256i*>(sums + 8),
+                         _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(acc[2], acc[3]), order));
+      std::copy_n(sums, std::min(block, n - p * block), y + p * block);
+    }
+  }
+}
+
+// `Panels` adjacent panels of one row, sharing each broadcast of 4 activation bytes.
+// vpdpbusd multiplies unsigned by signed bytes, so the activations are offset to
+// x + 128 (flipping their sign bit) and 128 * column sum is subtracted at the end.
+template<size_t Panels>
+UTEC_TARGET_AVX512_VNNI inline void vnni_panels(size_t k, size_t n, size_t column, const int8_t* x,
+                                                const int8_t* panel, size_t panel_bytes, const int32_t* bias,
+                                                int32_t* y) {
+  const __m512i flip = _mm512_set1_epi32(int32_t(0x80808080u));
+  __m512i acc[Panels];
+  for (size_t i = 0; i < Panels; ++i) acc[i] = _mm512_setzero_si512();
+  const size_t kg = groups(k);
+  for (size_t g = 0; g < kg; ++g) {
+    const __m512i xs = _mm512_xor_si512(_mm512_set1_epi32(group_word(x, k, g)), flip);
+    for (size_t i = 0; i < Panels; ++i)
+      acc[i] = _mm512_dpbusd_epi32(acc[i], xs, _mm512_load_si512(panel + i * panel_bytes + g * group_bytes));
+  }
+  for (size_t i = 0; i < Panels; ++i) {
+    const size_t j = column + i * block;
+    const __m512i sum = _mm512_sub_epi32(acc[i], _mm512_load_si512(bias + j));
+    if (j + block <= n) _mm512_storeu_si512(y + j, sum);
+    else _mm512_mask_storeu_epi32(y + j, __mmask16((1u << (n - j)) - 1), sum);
+  }
+}
+
+UTEC_TARGET_AVX512_VNNI inline void gemm_vnni(size_t first, size_t last, size_t k, size_t n, const int8_t* a,
+                                              size_t lda, const int8_t* packed, const int32_t* bias, int32_t* c,
+                                              size_t ldc) {
+  const size_t panel_bytes = groups(k) * group_bytes;
+  const size_t panels = blocks(n);
+  for (size_t r = first; r < last; ++r) {
+    const int8_t* x = a + r * lda;
+    int32_t* y = c + r * ldc;
+    size_t p = 0;
+    for (; p + 8 <= panels; p += 8)
+      vnni_panels<8>(k, n, p * block, x, packed + p * panel_bytes, panel_bytes, bias, y);
+    for (; p + 4 <= panels; p += 4)
+      vnni_panels<4>(k, n, p * block, x, packed + p * panel_bytes, panel_bytes, bias, y);
+    for (; p < panels; ++p) vnni_panels<1>(k, n, p * block, x, packed + p * panel_bytes, panel_bytes, bias, y);
+  }
+}
+#endif
+
+// The VNNI kernel when the CPU has it (see dispatch::vnni), the AVX2 one on other
+// AVX2 or AVX-512 CPUs, else the portable one.
+inline gemm_kernel select_gemm() {
+#if UTEC_RUNTIME_DISPATCH
+  if (dispatch::vnni()) return &gemm_vnni;
+  if (dispatch::vector_bytes() >= 32) return &gemm_avx2;
+#endif
+  return &gemm_native;
+}
+
+}
+
+// A (rows, columns) floating point matrix quantized to int8 with one scale per column,
+// W(i, j) ~= scale(j) * value(i, j): for weights stored (in, out), one scale per output
+// channel. The values are kept only in the packed layout of the int8 matrix_product,
+// at a quarter of the size of float storage plus 8 bytes per column.
+class QuantizedTensor {
+ private:
+  std::array<size_t, 2> shape_{};
+  std::vector<int8_t, aligned_allocator<int8_t>> packed_;
+  std::vector<int32_t, aligned_allocator<int32_t>> bias_;
+  std::vector<float> scales_;
+
+  size_t index(size_t i, size_t j) const {
+    using namespace quantization;
+    return ((j / block) * groups(shape_[0]) + i / group) * group_bytes + (j % block) * group + i % group;
+  }
+
+ public:
+  QuantizedTensor() = default;
+
+  template<tensor_operand W>
+    requires (!is_expression_v<W>)
+  explicit QuantizedTensor(const W& weights) {
+    static_assert(detail::operand_traits<std::remove_cvref_t<W>>::rank == 2, "QuantizedTensor requires a matrix");
+    static_assert(std::is_floating_point_v<detail::operand_value_t<W>>, "Only floating point values are quantized");
+    using namespace quantization;
+    const auto w = detail::const_view(weights);
+    shape_ = w.shape();
+    const size_t rows = shape_[0];
+    const size_t columns = shape_[1];
+    packed_.assign(blocks(columns) * groups(rows) * group_bytes, 0);
+    bias_.assign(blocks(columns) * block, 0);
+    scales_.assign(columns, 1.0f);
+    for (size_t j = 0; j < columns; ++j) {
+      float max_abs = 0;
+      for (size_t i = 0; i < rows; ++i) max_abs = std::max(max_abs, float(std::abs(w(i, j))));
+      scales_[j] = scale_for(max_abs);
+      const float inverse = 1.0f / scales_[j];
+      int32_t sum = 0;
+      for (size_t i = 0; i < rows; ++i) {
+        const int8_t q = quantize(float(w(i, j)), inverse);
+        packed_[index(i, j)] = q;
+        sum += q;
+      }
+      bias_[j] = 128 * sum;
+    }
+  }
+
+  const std::array<size_t, 2>& shape() const { return shape_; }
+  size_t rows() const { return shape_[0]; }
+  size_t columns() const { return shape_[1]; }
+
+  int8_t value(size_t i, size_t j) const {
+    if (i >= shape_[0] || j >= shape_[1]) throw std::out_of_range("QuantizedTensor index out of range");
+    return packed_[index(i, j)];
+  }
+  float scale(size_t j) const { return scales_.at(j); }
+  const std::vector<float>& scales() const { return scales_; }
+
+  // Storage of the values, scales and column sums.
+  size_t bytes() const {
+    return packed_.size() * sizeof(int8_t) + bias_.size() * sizeof(int32_t) + scales_.size() * sizeof(float);
+  }
+
+  const int8_t* packed() const { return packed_.data(); }
+  const int32_t* packed_bias() const { return bias_.data(); }
+
+  template<typename T = float>
+  Tensor<T, 2> dequantize() const {
+    Tensor<T, 2> result(shape_[0], shape_[1]);
+    for (size_t i = 0; i < shape_[0]; ++i)
+      for (size_t j = 0; j < shape_[1]; ++j) result(i, j) = T(scales_[j] * float(packed_[index(i, j)]));
+    return result;
+  }
+};
+
+// out(r, j) = sum_i a(r, i) * b.value(i, j), exact in int32: a is a contiguous (m, rows)
+// int8 tensor or view and out a (m, columns) int32 tensor (reshaped) or contiguous
+// view. The result scaled by the row's activation scale and b.scale(j) approximates
+// the floating point product. Rows are split across threads for large products.
+template<tensor_operand A, tensor_output Out>
+  requires (!is_expression_v<A>)
+void matrix_product(const A& a, const QuantizedTensor& b, Out&& out) {
+  static_assert(std::is_same_v<detail::operand_value_t<A>, int8_t>, "Quantized products take int8 operands");
+  static_assert(std::is_same_v<detail::operand_value_t<Out>, int32_t>, "Quantized products write int32 values");
+  const auto av = detail::const_view(a);
+  if (av.shape()[1] != b.rows()) throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
+  if (!av.is_contiguous()) throw std::runtime_error("Quantized product operand must be contiguous");
+  const std::array<size_t, 2> shape{av.shape()[0], b.columns()};
+  if constexpr (is_tensor_v<Out>) {
+    if (out.shape() != shape) out.reshape(shape);
+  } else {
+    if (out.shape() != shape || !out.is_contiguous())
+      throw std::runtime_error("Output view must be contiguous and match the product shape");
+  }
+
+  const size_t m = shape[0];
+  const size_t k = b.rows();
+  const size_t n = b.columns();
+  UTEC_PROFILE_SCOPE("matrix_product.int8", 2 * m * n * k);
+  if (m == 0 || n == 0) return;
+  const auto kernel = quantization::select_gemm();
+  const int8_t* x = av.data();
+  int32_t* c = out.data();
+  const size_t grain = std::max<size_t>(1, parallel::config().gemm_grain / std::max<size_t>(1, k * n));
+  parallel::parallel_for(0, m, grain, [&](size_t first, size_t last) {
+    kernel(first, last, k, n, x, k, b.packed(), b.packed_bias(), c, n);
+  });
+}
+
+}
+
+#endif //QUANTIZED_H
@@ -0,0 +1,622 @@
+//
+// Reductions (sum, mean, max, argmax) and softmax over all elements or along an axis.
+//
+
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/half.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/simd.h"
+#include "utec/algebra/tensor.h"
+
+namespace utec::algebra {
+
+namespace reduction {
+
+// Partial sums are combined like a binary counter: the k-th pushed value is added to
+// the ones before it as a balanced tree, so n values summed block by block carry an
+// O(log n) rounding error instead of O(n), at the cost of one add per block.
+template<typename V>
+struct cascade {
+  V levels[64];
+  size_t top = 0;
+  size_t count = 0;
+
+  UTEC_ALWAYS_INLINE void push(V value) {
+    for (size_t c = count++; c & 1; c >>= 1) value = levels[--top] + value;
+    levels[top++] = value;
+  }
+
+  UTEC_ALWAYS_INLINE V total(V zero) const {
+    for (size_t i = top; i-- > 0;) zero = levels[i] + zero;
+    return zero;
+  }
+};
+
+template<typename T>
+inline constexpr bool packed_v = simd::is_vectorizable_v<T> && std::is_same_v<accumulator_t<T>, T>;
+
+// Rows summed directly, as packets, before a block goes into the cascade.
+inline constexpr size_t block_rows = 64;
+
+// Sum of n contiguous values: four packet accumulators per block of 16 packets, blocks
+// combined pairwise.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE accumulator_t<T> sum_contiguous(size_t n, const T* UTEC_RESTRICT x) {
+  using Acc = accumulator_t<T>;
+  size_t i = 0;
+  Acc total{0};
+  if constexpr (packed_v<T>) {
+    using P = simd::packet<T, Bytes>;
+    constexpr size_t L = P::lanes;
+    constexpr size_t block = 16 * L;
+    cascade<P> partial;
+    for (; i + block <= n; i += block) {
+      P a0 = P::load(x + i), a1 = P::load(x + i + L), a2 = P::load(x + i + 2 * L), a3 = P::load(x + i + 3 * L);
+      for (size_t j = 4 * L; j < block; j += 4 * L) {
+        a0 = a0 + P::load(x + i + j);
+        a1 = a1 + P::load(x + i + j + L);
+        a2 = a2 + P::load(x + i + j + 2 * L);
+        a3 = a3 + P::load(x + i + j + 3 * L);
+      }
+      partial.push((a0 + a1) + (a2 + a3));
+    }
+    total = simd::reduce_add(partial.total(P::zero()));
+  } else {
+    cascade<Acc> partial;
+    for (; i + block_rows <= n; i += block_rows) {
+      Acc s{0};
+      for (size_t j = 0; j < block_rows; ++j) s += Acc(x[i + j]);
+      partial.push(s);
+    }
+    total = partial.total(Acc{0});
+  }
+  Acc tail{0};
+  for (; i < n; ++i) tail += Acc(x[i]);
+  return total + tail;
+}
+
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T max_contiguous(size_t n, const T* UTEC_RESTRICT x) {
+  size_t i = 0;
+  T best = x[0];
+  if constexpr (packed_v<T>) {
+    using P = simd::packet<T, Bytes>;
+    constexpr size_t L = P::lanes;
+    if (n >= 4 * L) {
+      P m0 = P::load(x), m1 = P::load(x + L), m2 = P::load(x + 2 * L), m3 = P::load(x + 3 * L);
+      for (i = 4 * L; i + 4 * L <= n; i += 4 * L) {
+        m0 = simd::max(m0, P::load(x + i));
+        m1 = simd::max(m1, P::load(x + i + L));
+        m2 = simd::max(m2, P::load(x + i + 2 * L));
+        m3 = simd::max(m3, P::load(x + i + 3 * L));
+      }
+      best = simd::reduce_max(simd::max(simd::max(m0, m1), simd::max(m2, m3)));
+    }
+  }
+  for (; i < n; ++i) best = x[i] > best ? x[i] : best;
+  return best;
+}
+
+// out[j] = sum over k rows of x[r * stride + j], j < width. Columns are processed four
+// packets at a time, summing block_rows rows in registers per cascade entry.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void sum_columns(size_t rows, size_t width, size_t stride, const T* UTEC_RESTRICT x,
+                                    T* UTEC_RESTRICT out) {
+  using Acc = accumulator_t<T>;
+  size_t j = 0;
+  if constexpr (packed_v<T>) {
+    using P = simd::packet<T, Bytes>;
+    constexpr size_t L = P::lanes;
+    struct tile {
+      P v[4];
+      UTEC_ALWAYS_INLINE tile operator+(const tile& o) const {
+        return {{v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]}};
+      }
+    };
+    for (; j + 4 * L <= width; j += 4 * L) {
+      cascade<tile> partial;
+      for (size_t r0 = 0; r0 < rows; r0 += block_rows) {
+        tile s{{P::zero(), P::zero(), P::zero(), P::zero()}};
+        for (size_t r = r0; r < std::min(rows, r0 + block_rows); ++r) {
+          const T* row = x + r * stride + j;
+          for (size_t q = 0; q < 4; ++q) s.v[q] = s.v[q] + P::load(row + q * L);
+        }
+        partial.push(s);
+      }
+      const tile total = partial.total(tile{{P::zero(), P::zero(), P::zero(), P::zero()}});
+      for (size_t q = 0; q < 4; ++q) total.v[q].store(out + j + q * L);
+    }
+  }
+  for (; j < width; ++j) {
+    cascade<Acc> partial;
+    for (size_t r0 = 0; r0 < rows; r0 += block_rows) {
+      Acc s{0};
+      for (size_t r = r0; r < std::min(rows, r0 + block_rows); ++r) s += Acc(x[r * stride + j]);
+      partial.push(s);
+    }
+    out[j] = T(partial.total(Acc{0}));
+  }
+}
+
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void max_columns(size_t rows, size_t width, size_t stride, const T* UTEC_RESTRICT x,
+                                    T* UTEC_RESTRICT out) {
+  size_t j = 0;
+  if constexpr (packed_v<T>) {
+    using P = simd::packet<T, Bytes>;
+    constexpr size_t L = P::lanes;
+    for (; j + 2 * L <= width; j += 2 * L) {
+      P m0 = P::load(x + j), m1 = P::load(x + j + L);
+      for (size_t r = 1; r < rows; ++r) {
+        m0 = simd::max(m0, P::load(x + r * stride + j));
+        m1 = simd::max(m1, P::load(x + r * stride + j + L));
+      }
+      m0.store(out + j);
+      m1.store(out + j + L);
+    }
+  }
+  for (; j < width; ++j) {
+    T best = x[j];
+    for (size_t r = 1; r < rows; ++r) best = x[r * stride + j] > best ? x[r * stride + j] : best;
+    out[j] = best;
+  }
+}
+
+// softmax(x) into y over n contiguous values: max, then exp(x - max) stored while
+// summing, then one scaling pass.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void softmax_contiguous(size_t n, const T* UTEC_RESTRICT x, T* UTEC_RESTRICT y) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  const T m = max_contiguous<T, Bytes>(n, x);
+  const P mp = P::broadcast(m);
+  P s0 = P::zero(), s1 = P::zero();
+  size_t i = 0;
+  for (; i + 2 * L <= n; i += 2 * L) {
+    const P e0 = simd::exp(P::load(x + i) - mp);
+    const P e1 = simd::exp(P::load(x + i + L) - mp);
+    e0.store(y + i);
+    e1.store(y + i + L);
+    s0 = s0 + e0;
+    s1 = s1 + e1;
+  }
+  T total = simd::reduce_add(s0 + s1);
+  for (; i < n; ++i) {
+    y[i] = std::exp(x[i] - m);
+    total += y[i];
+  }
+  const T inverse = T{1} / total;
+  const P ip = P::broadcast(inverse);
+  for (i = 0; i + L <= n; i += L) (P::load(y + i) * ip).store(y + i);
+  for (; i < n; ++i) y[i] *= inverse;
+}
+
+// softmax down the columns of a (rows, width) block with row stride `stride`; scratch
+// holds width values.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void softmax_columns(size_t rows, size_t width, size_t stride, const T* UTEC_RESTRICT x,
+                                        T* UTEC_RESTRICT y, T* UTEC_RESTRICT scratch) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  max_columns<T, Bytes>(rows, width, stride, x, scratch);
+  for (size_t j = 0; j < width; ++j) y[j] = T{0};
+  size_t j = 0;
+  for (; j + L <= width; j += L) {
+    const P m = P::load(scratch + j);
+    P s = P::zero();
+    for (size_t r = 0; r < rows; ++r) {
+      const P e = simd::exp(P::load(x + r * stride + j) - m);
+      e.store(y + r * stride + j);
+      s = s + e;
+    }
+    (P::broadcast(T{1}) / s).store(scratch + j);
+  }
+  for (; j < width; ++j) {
+    T s{0};
+    for (size_t r = 0; r < rows; ++r) {
+      y[r * stride + j] = std::exp(x[r * stride + j] - scratch[j]);
+      s += y[r * stride + j];
+    }
+    scratch[j] = T{1} / s;
+  }
+  for (size_t r = 0; r < rows; ++r) {
+    T* row = y + r * stride;
+    for (j = 0; j + L <= width; j += L) (P::load(row + j) * P::load(scratch + j)).store(row + j);
+    for (; j < width; ++j) row[j] *= scratch[j];
+  }
+}
+
+// Kernel families: run<Bytes> processes `count` independent rows (row length n) or
+// column blocks, so one dispatched call covers a whole parallel chunk.
+template<typename T, typename Out = T>
+struct sum_rows {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t count, size_t n, const T* x, Out* out) {
+    for (size_t r = 0; r < count; ++r) out[r] = Out(sum_contiguous<T, Bytes>(n, x + r * n));
+  }
+};
+
+template<typename T>
+struct max_rows {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t count, size_t n, const T* x, T* out) {
+    for (size_t r = 0; r < count; ++r) out[r] = max_contiguous<T, Bytes>(n, x + r * n);
+  }
+};
+
+template<typename T>
+struct argmax_rows {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t count, size_t n, const T* x, size_t* out) {
+    for (size_t r = 0; r < count; ++r) {
+      const T* row = x + r * n;
+      const T best = max_contiguous<T, Bytes>(n, row);
+      size_t i = 0;
+      while (i + 1 < n && !(row[i] == best)) ++i;
+      out[r] = i;
+    }
+  }
+};
+
+template<typename T>
+struct softmax_rows {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t count, size_t n, const T* x, T* y) {
+    for (size_t r = 0; r < count; ++r) softmax_contiguous<T, Bytes>(n, x + r * n, y + r * n);
+  }
+};
+
+template<typename T>
+struct sum_blocks {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t rows, size_t width, size_t stride, const T* x, T* out) {
+    sum_columns<T, Bytes>(rows, width, stride, x, out);
+  }
+};
+
+template<typename T>
+struct max_blocks {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t rows, size_t width, size_t stride, const T* x, T* out) {
+    max_columns<T, Bytes>(rows, width, stride, x, out);
+  }
+};
+
+template<typename T>
+struct softmax_blocks {
+  template<size_t Bytes>
+  static UTEC_ALWAYS_INLINE void run(size_t rows, size_t width, size_t stride, const T* x, T* y, T* scratch) {
+    softmax_columns<T, Bytes>(rows, width, stride, x, y, scratch);
+  }
+};
+
+template<typename Kernel, typename... Args>
+void run_native(Args... args) {
+  Kernel::template run<simd::native_bytes>(args...);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename Kernel, typename... Args>
+UTEC_TARGET_AVX2 void run_avx2(Args... args) {
+  Kernel::template run<32>(args...);
+}
+
+template<typename Kernel, typename... Args>
+UTEC_TARGET_AVX512 void run_avx512(Args... args) {
+  Kernel::template run<64>(args...);
+}
+#endif
+
+// Runs a kernel family with the widest variant the CPU supports.
+template<typename Kernel, typename... Args>
+void run(Args... args) {
+  dispatch::select(&run_native<Kernel, Args...>
+                   UTEC_DISPATCH_VARIANTS(, &run_avx2<Kernel, Args...>, &run_avx512<Kernel, Args...>))(args...);
+}
+
+// Columns per task when reducing along a non-last axis.
+inline constexpr size_t column_block = 256;
+
+// A reduction along `axis` of a contiguous tensor, seen as (outer, extent, inner).
+struct axis_layout {
+  size_t outer = 1;
+  size_t extent = 1;
+  size_t inner = 1;
+};
+
+template<size_t N>
+axis_layout layout(const std::array<size_t, N>& shape, size_t axis) {
+  if (axis >= N) throw std::out_of_range("Axis is out of the tensor rank");
+  axis_layout l;
+  for (size_t d = 0; d < axis; ++d) l.outer *= shape[d];
+  l.extent = shape[axis];
+  for (size_t d = axis + 1; d < N; ++d) l.inner *= shape[d];
+  return l;
+}
+
+// out (outer * inner values) = RowKernel over each row when inner == 1, else
+// BlockKernel over column blocks; both split across threads.
+template<typename RowKernel, typename T, typename Out>
+void reduce_rows(const axis_layout& l, const T* x, Out* out) {
+  parallel::parallel_for(0, l.outer, std::max<size_t>(1, parallel::grain_size() / l.extent),
+                         [&](size_t first, size_t last) {
+    run<RowKernel>(last - first, l.extent, x + first * l.extent, out + first);
+  });
+}
+
+template<typename RowKernel, typename BlockKernel, typename T, typename Out>
+void reduce_axis(const axis_layout& l, const T* x, Out* out) {
+  if (l.inner == 1) return reduce_rows<RowKernel>(l, x, out);
+  const size_t grain = parallel::grain_size();
+  const size_t blocks = (l.inner + column_block - 1) / column_block;
+  parallel::parallel_for(0, l.outer * blocks, std::max<size_t>(1, grain / (l.extent * column_block)),
+                         [&](size_t first, size_t last) {
+    for (size_t task = first; task < last; ++task) {
+      const size_t o = task / blocks;
+      const size_t j = task % blocks * column_block;
+      const size_t width = std::min(column_block, l.inner - j);
+      run<BlockKernel>(l.extent, width, l.inner, x + o * l.extent * l.inner + j, out + o * l.inner + j);
+    }
+  });
+}
+
+// Calls f(data, shape) with the operand's elements in a contiguous row-major buffer,
+// materializing strided views and expressions first.
+template<typename X, typename F>
+decltype(auto) with_contiguous(const X& x, F&& f) {
+  using T = detail::operand_value_t<X>;
+  constexpr size_t N = detail::operand_traits<std::remove_cvref_t<X>>::rank;
+  if constexpr (is_tensor_v<X>) {
+    return f(x.data(), x.shape());
+  } else if constexpr (is_tensor_view_v<X>) {
+    if (x.is_contiguous()) return f(static_cast<const T*>(x.data()), x.shape());
+    const Tensor<T, N> copy(x);
+    return f(static_cast<const T*>(copy.data()), copy.shape());
+  } else {
+    const Tensor<T, N> copy(x);
+    return f(static_cast<const T*>(copy.data()), copy.shape());
+  }
+}
+
+template<size_t N>
+std::array<size_t, N> reduced_shape(std::array<size_t, N> shape, size_t axis) {
+  shape[axis] = 1;
+  return shape;
+}
+
+template<typename T, size_t N, typename Allocator>
+void prepare_output(Tensor<T, N, Allocator>& out, const std::array<size_t, N>& shape) {
+  if (out.shape() != shape) out.reshape(shape);
+}
+
+template<typename T, size_t N>
+void prepare_output(const TensorView<T, N>& out, const std::array<size_t, N>& shape) {
+  if (out.shape() != shape || !out.is_contiguous())
+    throw std::runtime_error("Output view must be contiguous and match the reduced shape");
+}
+
+}
+
+// Sum of all elements, accumulated in accumulator_t<T> with pairwise summation and
+// split across threads for large tensors (the chunking does not depend on the thread
+// count, so the result is reproducible).
+template<tensor_operand X>
+auto sum(const X& x) {
+  UTEC_PROFILE_SCOPE("sum", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  using Acc = accumulator_t<T>;
+  return reduction::with_contiguous(x, [](const T* data, const auto& shape) {
+    const size_t n = detail::shape_size(shape);
+    const size_t chunk = std::max<size_t>(parallel::grain_size(), 4096);
+    const size_t chunks = (n + chunk - 1) / chunk;
+    if (chunks <= 1) {
+      Acc total{0};
+      reduction::run<reduction::sum_rows<T, Acc>>(size_t{1}, n, data, &total);
+      return total;
+    }
+    std::vector<Acc> partial(chunks);
+    parallel::parallel_for(0, chunks, 1, [&](size_t first, size_t last) {
+      for (size_t c = first; c < last; ++c) {
+        const size_t begin = c * chunk;
+        reduction::run<reduction::sum_rows<T, Acc>>(size_t{1}, std::min(chunk, n - begin), data + begin, &partial[c]);
+      }
+    });
+    Acc total{0};
+    reduction::run<reduction::sum_rows<Acc>>(size_t{1}, chunks, static_cast<const Acc*>(partial.data()), &total);
+    return total;
+  });
+}
+
+// Sums along `axis` into out, whose shape is x's with that axis set to 1 (so the result
+// broadcasts back against x). out is a tensor, reshaped as needed, or a contiguous
+// view of exactly that shape.
+template<tensor_operand X, tensor_output Out>
+void sum(const X& x, size_t axis, Out&& out) {
+  UTEC_PROFILE_SCOPE("sum", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  static_assert(std::is_same_v<T, detail::operand_value_t<Out>>, "Output must have the operand's value type");
+  reduction::with_contiguous(x, [&](const T* data, const auto& shape) {
+    const auto l = reduction::layout(shape, axis);
+    reduction::prepare_output(out, reduction::reduced_shape(shape, axis));
+    if (l.outer * l.inner == 0) return;
+    if (l.extent == 0) return out.fill(T{0});
+    reduction::reduce_axis<reduction::sum_rows<T>, reduction::sum_blocks<T>>(l, data, out.data());
+  });
+}
+
+template<tensor_operand X>
+auto sum(const X& x, size_t axis) {
+  Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank> out;
+  sum(x, axis, out);
+  return out;
+}
+
+// Arithmetic mean, in accumulator_t<T>.
+template<tensor_operand X>
+auto mean(const X& x) {
+  using Acc = accumulator_t<detail::operand_value_t<X>>;
+  const size_t n = detail::shape_size(x.shape());
+  if (n == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+  return Acc(sum(x) / Acc(n));
+}
+
+template<tensor_operand X, typename Allocator>
+void mean(const X& x, size_t axis, Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank, Allocator>& out) {
+  using T = detail::operand_value_t<X>;
+  using Acc = accumulator_t<T>;
+  reduction::layout(x.shape(), axis);
+  const size_t extent = x.shape()[axis];
+  if (extent == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+  sum(x, axis, out);
+  for (auto& value : out) value = T(Acc(value) / Acc(extent));
+}
+
+template<tensor_operand X>
+auto mean(const X& x, size_t axis) {
+  Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank> out;
+  mean(x, axis, out);
+  return out;
+}
+
+template<tensor_operand X>
+auto max(const X& x) {
+  UTEC_PROFILE_SCOPE("max", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  return reduction::with_contiguous(x, [](const T* data, const auto& shape) {
+    const size_t n = detail::shape_size(shape);
+    if (n == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+    T best;
+    reduction::run<reduction::max_rows<T>>(size_t{1}, n, data, &best);
+    return best;
+  });
+}
+
+template<tensor_operand X, typename Allocator>
+void max(const X& x, size_t axis, Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank, Allocator>& out) {
+  UTEC_PROFILE_SCOPE("max", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  reduction::with_contiguous(x, [&](const T* data, const auto& shape) {
+    const auto l = reduction::layout(shape, axis);
+    if (l.extent == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+    reduction::prepare_output(out, reduction::reduced_shape(shape, axis));
+    if (l.outer * l.inner == 0) return;
+    reduction::reduce_axis<reduction::max_rows<T>, reduction::max_blocks<T>>(l, data, out.data());
+  });
+}
+
+template<tensor_operand X>
+auto max(const X& x, size_t axis) {
+  Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank> out;
+  max(x, axis, out);
+  return out;
+}
+
+// Flat (row-major) index of the first largest element.
+template<tensor_operand X>
+size_t argmax(const X& x) {
+  UTEC_PROFILE_SCOPE("argmax", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  return reduction::with_contiguous(x, [](const T* data, const auto& shape) {
+    const size_t n = detail::shape_size(shape);
+    if (n == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+    size_t index;
+    reduction::run<reduction::argmax_rows<T>>(size_t{1}, n, data, &index);
+    return index;
+  });
+}
+
+// Index along `axis` of the first largest element of every lane; same output shape as
+// the axis-wise max.
+template<tensor_operand X, typename Allocator>
+void argmax(const X& x, size_t axis, Tensor<size_t, detail::operand_traits<std::remove_cvref_t<X>>::rank, Allocator>& out) {
+  UTEC_PROFILE_SCOPE("argmax", detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  reduction::with_contiguous(x, [&](const T* data, const auto& shape) {
+    const auto l = reduction::layout(shape, axis);
+    if (l.extent == 0) throw std::runtime_error("Cannot reduce an empty tensor");
+    reduction::prepare_output(out, reduction::reduced_shape(shape, axis));
+    if (l.outer * l.inner == 0) return;
+    size_t* indices = out.data();
+    if (l.inner == 1) {
+      reduction::reduce_rows<reduction::argmax_rows<T>>(l, data, indices);
+      return;
+    }
+    parallel::parallel_for(0, l.outer, 1, [&](size_t first, size_t last) {
+      for (size_t o = first; o < last; ++o) {
+        const T* block = data + o * l.extent * l.inner;
+        size_t* best = indices + o * l.inner;
+        std::fill(best, best + l.inner, size_t{0});
+        for (size_t k = 1; k < l.extent; ++k)
+          for (size_t j = 0; j < l.inner; ++j)
+            if (block[k * l.inner + j] > block[best[j] * l.inner + j]) best[j] = k;
+      }
+    });
+  });
+}
+
+template<tensor_operand X>
+auto argmax(const X& x, size_t axis) {
+  Tensor<size_t, detail::operand_traits<std::remove_cvref_t<X>>::rank> out;
+  argmax(x, axis, out);
+  return out;
+}
+
+// exp(x - max) / sum(exp(x - max)) along `axis`, so large inputs do not overflow. out
+// gets x's shape and must not alias x.
+template<tensor_operand X, typename Allocator>
+void softmax(const X& x, size_t axis, Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank, Allocator>& out) {
+  UTEC_PROFILE_SCOPE("softmax", 4 * detail::shape_size(x.shape()));
+  using T = detail::operand_value_t<X>;
+  static_assert(std::is_floating_point_v<T>, "softmax requires float or double elements");
+  reduction::with_contiguous(x, [&](const T* data, const auto& shape) {
+    const auto l = reduction::layout(shape, axis);
+    if (out.shape() != shape) out.reshape(shape);
+    if (detail::shape_size(shape) == 0) return;
+    if (out.data() == data) throw std::runtime_error("Output tensor must not overlap the operands");
+    T* y = out.data();
+    const size_t grain = parallel::grain_size();
+    if (l.inner == 1) {
+      parallel::parallel_for(0, l.outer, std::max<size_t>(1, grain / l.extent), [&](size_t first, size_t last) {
+        reduction::run<reduction::softmax_rows<T>>(last - first, l.extent, data + first * l.extent,
+                                                   y + first * l.extent);
+      });
+      return;
+    }
+    const size_t blocks = (l.inner + reduction::column_block - 1) / reduction::column_block;
+    parallel::parallel_for(0, l.outer * blocks, std::max<size_t>(1, grain / (l.extent * reduction::column_block)),
+                           [&](size_t first, size_t last) {
+      T scratch[reduction::column_block];
+      for (size_t task = first; task < last; ++task) {
+        const size_t o = task / blocks;
+        const size_t j = task % blocks * reduction::column_block;
+        const size_t offset = o * l.extent * l.inner + j;
+        reduction::run<reduction::softmax_blocks<T>>(l.extent, std::min(reduction::column_block, l.inner - j),
+                                                     l.inner, data + offset, y + offset, scratch + 0);
+      }
+    });
+  });
+}
+
+template<tensor_operand X>
+auto softmax(const X& x, size_t axis) {
+  Tensor<detail::operand_value_t<X>, detail::operand_traits<std::remove_cvref_t<X>>::rank> out;
+  softmax(x, axis, out);
+  return out;
+}
+
+}
+
+#endif //REDUCTION_H
@@ -0,0 +1,248 @@
+//
+// Versioned binary tensor files and read-only memory-mapped tensors.
+//
+
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/half.h"
+#include "utec/algebra/tensor_view.h"
+
+namespace utec::algebra {
+
+// File layout (little-endian):
+//   0  "UTNS"            magic
+//   4  uint16 version    currently 1
+//   6  uint8  dtype      see serialization::dtype
+//   7  uint8  rank
+//   8  uint64 offset     of the raw data, a multiple of tensor_alignment
+//   16 uint64 shape[rank]
+//   ... zero padding, then the row-major elements
+namespace serialization {
+
+inline constexpr char magic[4] = {'U', 'T', 'N', 'S'};
+inline constexpr uint16_t version = 1;
+inline constexpr size_t fixed_header = 16;
+
+enum class dtype : uint8_t { float32 = 1, float64, int8, uint8, int16, uint16, int32, uint32, int64, uint64,
+                             bfloat16, float16 };
+
+template<typename T>
+constexpr dtype dtype_of() {
+  if constexpr (std::is_same_v<T, float>) return dtype::float32;
+  else if constexpr (std::is_same_v<T, double>) return dtype::float64;
+  else if constexpr (std::is_same_v<T, bfloat16>) return dtype::bfloat16;
+  else if constexpr (std::is_same_v<T, float16>) return dtype::float16;
+  else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && std::is_signed_v<T>)
+    return sizeof(T) == 1 ? dtype::int8 : sizeof(T) == 2 ? dtype::int16 : sizeof(T) == 4 ? dtype::int32 : dtype::int64;
+  else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    return sizeof(T) == 1 ? dtype::uint8 : sizeof(T) == 2 ? dtype::uint16 : sizeof(T) == 4 ? dtype::uint32
+                                                                                               : dtype::uint64;
+  else static_assert(sizeof(T) == 0, "Tensor element type has no binary format");
+}
+
+inline size_t data_offset(size_t rank) {
+  return (fixed_header + 8 * rank + tensor_alignment - 1) / tensor_alignment * tensor_alignment;
+}
+
+inline void require_little_endian() {
+  if constexpr (std::endian::native != std::endian::little)
+    throw std::runtime_error("Tensor files require a little-endian host");
+}
+
+template<typename T, size_t N>
+void write(std::ostream& out, const T* data, const std::array<size_t, N>& shape) {
+  require_little_endian();
+  const size_t offset = data_offset(N);
+  std::vector<char> header(offset, 0);
+  std::memcpy(header.data(), magic, 4);
+  std::memcpy(header.data() + 4, &version, 2);
+  header[6] = char(dtype_of<T>());
+  header[7] = char(N);
+  const uint64_t offset64 = offset;
+  std::memcpy(header.data() + 8, &offset64, 8);
+  for (size_t d = 0; d < N; ++d) {
+    const uint64_t extent = shape[d];
+    std::memcpy(header.data() + fixed_header + 8 * d, &extent, 8);
+  }
+  size_t count = 1;
+  for (auto d : shape) count *= d;
+  out.write(header.data(), std::streamsize(offset));
+  out.write(reinterpret_cast<const char*>(data), std::streamsize(count * sizeof(T)));
+  if (!out) throw std::runtime_error("Failed to write tensor data");
+}
+
+template<typename T, size_t N>
+void save(const std::string& path, const T* data, const std::array<size_t, N>& shape) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::runtime_error("Cannot open " + path + " for writing");
+  write(out, data, shape);
+}
+
+// Checks a file image against Tensor<T, N> and returns its shape; the data starts at
+// bytes + data_offset(N).
+template<typename T, size_t N>
+std::array<size_t, N> parse(const std::byte* bytes, size_t size) {
+  require_little_endian();
+  if (size < fixed_header || std::memcmp(bytes, magic, 4) != 0) throw std::runtime_error("Not a tensor file");
+  uint16_t file_version;
+  uint64_t offset;
+  std::memcpy(&file_version, bytes + 4, 2);
+  std::memcpy(&offset, bytes + 8, 8);
+  if (file_version != version) throw std::runtime_error("Unsupported tensor file version");
+  if (dtype(bytes[6]) != dtype_of<T>()) throw std::runtime_error("Tensor file has a different element type");
+  if (size_t(bytes[7]) != N) throw std::runtime_error("Tensor file has a different rank");
+  if (offset != data_offset(N) || size < offset) throw std::runtime_error("Tensor file is truncated");
+  // The element count and its byte size must fit in size_t, or a forged shape could wrap
+  // to a small count and pass the size check below.
+  constexpr size_t max_count = std::numeric_limits<size_t>::max() / sizeof(T);
+  std::array<size_t, N> shape{};
+  size_t count = 1;
+  for (size_t d = 0; d < N; ++d) {
+    uint64_t extent;
+    std::memcpy(&extent, bytes + fixed_header + 8 * d, 8);
+    if (extent > std::numeric_limits<size_t>::max()) throw std::runtime_error("Tensor file has an invalid shape");
+    shape[d] = size_t(extent);
+    if (shape[d] != 0 && count > max_count / shape[d]) throw std::runtime_error("Tensor file has an invalid shape");
+    count *= shape[d];
+  }
+  if ((size - offset) / sizeof(T) < count) throw std::runtime_error("Tensor file is truncated");
+  return shape;
+}
+
+// Read-only mapping of a whole file, unmapped on destruction. Without mmap (Windows)
+// the file is read into an aligned buffer instead.
+class mapped_file {
+ private:
+  const std::byte* data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  std::vector<std::byte, aligned_allocator<std::byte>> buffer_;
+#endif
+
+  void release() {
+#if !defined(_WIN32)
+    if (data_ != nullptr && size_ > 0) ::munmap(const_cast<std::byte*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+ public:
+  explicit mapped_file(const std::string& path) {
+#if defined(_WIN32)
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    buffer_.resize(size_t(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer_.data()), std::streamsize(buffer_.size()));
+    if (!in) throw std::runtime_error("Cannot read " + path);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Cannot read " + path);
+    }
+    size_ = size_t(info.st_size);
+    if (size_ > 0) {
+      void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Cannot map " + path);
+      }
+      data_ = static_cast<const std::byte*>(address);
+    }
+    ::close(fd);
+#endif
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+#if defined(_WIN32)
+        , buffer_(std::move(other.buffer_))
+#endif
+  {}
+
+  mapped_file& operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+      release();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+#if defined(_WIN32)
+      buffer_ = std::move(other.buffer_);
+#endif
+    }
+    return *this;
+  }
+
+  ~mapped_file() { release(); }
+
+  const std::byte* data() const { return data_; }
+  size_t size() const { return size_; }
+};
+
+}
+
+// A tensor file mapped read-only (see Tensor::load_mmap). The elements are the file's
+// pages, loaded lazily by the OS on first touch and never copied; view() and the
+// conversion to TensorView<const T, N> hand them to any kernel that reads views.
+template<typename T, size_t N>
+class MappedTensor {
+ private:
+  serialization::mapped_file file_;
+  std::array<size_t, N> shape_{};
+  const T* data_ = nullptr;
+
+ public:
+  explicit MappedTensor(const std::string& path) : file_(path) {
+    shape_ = serialization::parse<T, N>(file_.data(), file_.size());
+    data_ = reinterpret_cast<const T*>(file_.data() + serialization::data_offset(N));
+  }
+
+  const std::array<size_t, N>& shape() const { return shape_; }
+  size_t size() const { return detail::shape_size(shape_); }
+  const T* data() const { return data_; }
+
+  TensorView<const T, N> view() const { return TensorView<const T, N>(data_, shape_); }
+  operator TensorView<const T, N>() const { return view(); }
+
+  template<typename... Indices>
+  const T& operator()(Indices... indices) const {
+    return view()(indices...);
+  }
+};
+
+}
+
+#endif //SERIALIZATION_H
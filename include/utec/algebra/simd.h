@@ -0,0 +1,265 @@
+//
+// Thin SIMD packet abstraction used by the tensor kernels.
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define UTEC_SIMD_VECTOR_EXTENSIONS 1
+#define UTEC_ALWAYS_INLINE inline __attribute__((always_inline))
+#define UTEC_RESTRICT __restrict__
+#define UTEC_PREFETCH(address) __builtin_prefetch(address)
+#elif defined(_MSC_VER)
+#define UTEC_SIMD_VECTOR_EXTENSIONS 0
+#define UTEC_ALWAYS_INLINE __forceinline
+#define UTEC_RESTRICT __restrict
+#define UTEC_PREFETCH(address) ((void)(address))
+#else
+#define UTEC_SIMD_VECTOR_EXTENSIONS 0
+#define UTEC_ALWAYS_INLINE inline
+#define UTEC_RESTRICT
+#define UTEC_PREFETCH(address) ((void)(address))
+#endif
+
+namespace utec::algebra::simd {
+
+// Width in bytes of the widest vector register enabled at compile time.
+#if defined(__AVX512F__)
+inline constexpr size_t native_bytes = 64;
+#elif defined(__AVX__)
+inline constexpr size_t native_bytes = 32;
+#elif defined(__SSE2__) || defined(__ARM_NEON) || defined(_M_X64)
+inline constexpr size_t native_bytes = 16;
+#else
+inline constexpr size_t native_bytes = 8;
+#endif
+
+template<typename T>
+inline constexpr bool is_vectorizable_v =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+// A register-sized group of lanes. With GCC/Clang vector extensions this lowers to
+// SSE/AVX/AVX-512/NEON instructions depending on Bytes and the enabled target.
+template<typename T, size_t Bytes = native_bytes>
+struct packet {
+  static_assert(is_vectorizable_v<T>, "packet requires an arithmetic lane type");
+  static constexpr size_t lanes = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+  typedef T register_type __attribute__((vector_size(lanes * sizeof(T))));
+  register_type v;
+
+  static UTEC_ALWAYS_INLINE packet load(const T* p) {
+    packet r;
+    std::memcpy(&r.v, p, sizeof(r.v));
+    return r;
+  }
+  static UTEC_ALWAYS_INLINE packet broadcast(T x) {
+    packet r;
+    r.v = register_type{} + x;
+    return r;
+  }
+  static UTEC_ALWAYS_INLINE packet zero() { return packet{register_type{}}; }
+  static UTEC_ALWAYS_INLINE packet gather(const T* p, size_t stride) {
+    packet r;
+    for (size_t i = 0; i < lanes; ++i) r.v[i] = p[i * stride];
+    return r;
+  }
+  UTEC_ALWAYS_INLINE void store(T* p) const { std::memcpy(p, &v, sizeof(v)); }
+
+  friend UTEC_ALWAYS_INLINE packet operator+(const packet& a, const packet& b) { return {a.v + b.v}; }
+  friend UTEC_ALWAYS_INLINE packet operator-(const packet& a, const packet& b) { return {a.v - b.v}; }
+  friend UTEC_ALWAYS_INLINE packet operator*(const packet& a, const packet& b) { return {a.v * b.v}; }
+  friend UTEC_ALWAYS_INLINE packet operator/(const packet& a, const packet& b) { return {a.v / b.v}; }
+#else
+  T v[lanes];
+
+  static UTEC_ALWAYS_INLINE packet load(const T* p) {
+    packet r;
+    std::memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  static UTEC_ALWAYS_INLINE packet broadcast(T x) {
+    packet r;
+    for (size_t i = 0; i < lanes; ++i) r.v[i] = x;
+    return r;
+  }
+  static UTEC_ALWAYS_INLINE packet zero() { return broadcast(T{}); }
+  static UTEC_ALWAYS_INLINE packet gather(const T* p, size_t stride) {
+    packet r;
+    for (size_t i = 0; i < lanes; ++i) r.v[i] = p[i * stride];
+    return r;
+  }
+  UTEC_ALWAYS_INLINE void store(T* p) const { std::memcpy(p, v, sizeof(v)); }
+
+#define UTEC_SIMD_FALLBACK_OP(op)                                                  \
+  friend UTEC_ALWAYS_INLINE packet operator op(const packet& a, const packet& b) { \
+    packet r;                                                                      \
+    for (size_t i = 0; i < lanes; ++i) r.v[i] = a.v[i] op b.v[i];                  \
+    return r;                                                                      \
+  }
+  UTEC_SIMD_FALLBACK_OP(+)
+  UTEC_SIMD_FALLBACK_OP(-)
+  UTEC_SIMD_FALLBACK_OP(*)
+  UTEC_SIMD_FALLBACK_OP(/)
+#undef UTEC_SIMD_FALLBACK_OP
+#endif
+};
+
+template<typename X>
+struct is_packet : std::false_type {};
+
+template<typename T, size_t Bytes>
+struct is_packet<packet<T, Bytes>> : std::true_type {};
+
+template<typename X>
+inline constexpr bool is_packet_v = is_packet<std::remove_cvref_t<X>>::value;
+
+// Lane-wise maximum.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> max(const packet<T, Bytes>& a, const packet<T, Bytes>& b) {
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+  return {a.v > b.v ? a.v : b.v};
+#else
+  packet<T, Bytes> r;
+  for (size_t i = 0; i < packet<T, Bytes>::lanes; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+  return r;
+#endif
+}
+
+// a * b + c; contracted to a fused multiply-add when the target has one.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> fmadd(const packet<T, Bytes>& a, const packet<T, Bytes>& b, const packet<T, Bytes>& c) {
+  return a * b + c;
+}
+
+// Sum of the lanes.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T reduce_add(const packet<T, Bytes>& a) {
+  T total = a.v[0];
+  for (size_t i = 1; i < packet<T, Bytes>::lanes; ++i) total += a.v[i];
+  return total;
+}
+
+// Largest lane.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T reduce_max(const packet<T, Bytes>& a) {
+  T best = a.v[0];
+  for (size_t i = 1; i < packet<T, Bytes>::lanes; ++i) best = a.v[i] > best ? a.v[i] : best;
+  return best;
+}
+
+// Lane-wise square root. GCC only vectorizes std::sqrt under -fno-math-errno, and the
+// sqrt intrinsics cannot be inlined through the target-neutral kernel bodies, so x86
+// builds emit the packed instruction with inline asm. As with every packet, a 64-byte
+// one must be used from an UTEC_TARGET_AVX512 function and a 32-byte one from AVX or
+// wider.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> sqrt(const packet<T, Bytes>& a) {
+  static_assert(std::is_floating_point_v<T>, "simd::sqrt requires float or double lanes");
+  packet<T, Bytes> r;
+#if UTEC_SIMD_VECTOR_EXTENSIONS && (defined(__x86_64__) || defined(__i386__))
+  constexpr bool single = std::is_same_v<T, float>;
+  if constexpr (Bytes == 16 && single) asm("sqrtps {%1, %0|%0, %1}" : "=x"(r.v) : "x"(a.v));
+  else if constexpr (Bytes == 16) asm("sqrtpd {%1, %0|%0, %1}" : "=x"(r.v) : "x"(a.v));
+  else if constexpr ((Bytes == 32 || Bytes == 64) && single) asm("vsqrtps {%1, %0|%0, %1}" : "=v"(r.v) : "v"(a.v));
+  else if constexpr (Bytes == 32 || Bytes == 64) asm("vsqrtpd {%1, %0|%0, %1}" : "=v"(r.v) : "v"(a.v));
+  else
+#endif
+    for (size_t i = 0; i < packet<T, Bytes>::lanes; ++i) r.v[i] = std::sqrt(a.v[i]);
+  return r;
+}
+
+// Lane-wise e^x for float and double. x = n ln2 + r with |r| <= ln2 / 2 (ln2 split in
+// two parts so r stays exact), e^r from its Taylor polynomial and 2^n written straight
+// into the exponent bits. Relative error is about one ulp; inputs are clamped to the
+// range where the result is a finite normal number.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> exp(const packet<T, Bytes>& x) {
+  static_assert(std::is_floating_point_v<T>, "simd::exp requires float or double lanes");
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+  using P = packet<T, Bytes>;
+  using R = typename P::register_type;
+  using I = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+  typedef I integer_register __attribute__((vector_size(sizeof(R))));
+  constexpr bool single = sizeof(T) == 4;
+  constexpr T lo = single ? T(-87) : T(-708);
+  constexpr T hi = single ? T(88) : T(709);
+  constexpr T log2e = T(1.44269504088896340736);
+  constexpr T ln2_hi = single ? T(0.693359375) : T(0.693145751953125);
+  constexpr T ln2_lo = single ? T(-2.12194440e-4) : T(1.42860682030941723212e-6);
+  constexpr int degree = single ? 7 : 13;
+  constexpr int mantissa = single ? 23 : 52;
+  constexpr I bias = single ? 127 : 1023;
+
+  R v = x.v < lo ? R{} + lo : x.v;
+  v = v > hi ? R{} + hi : v;
+  const R t = v * log2e;
+  const integer_register n = __builtin_convertvector(t + (t < T(0) ? R{} - T(0.5) : R{} + T(0.5)), integer_register);
+  const R nf = __builtin_convertvector(n, R);
+  const R r = (v - nf * ln2_hi) - nf * ln2_lo;
+  T inverse_factorial = T(1);
+  for (int k = 2; k <= degree; ++k) inverse_factorial /= T(k);
+  R p = R{} + inverse_factorial;
+  for (int k = degree; k > 0; --k) {
+    inverse_factorial *= T(k);
+    p = p * r + inverse_factorial;
+  }
+  const integer_register bits = (n + bias) << mantissa;
+  R scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return P{p * scale};
+#else
+  packet<T, Bytes> r;
+  for (size_t i = 0; i < packet<T, Bytes>::lanes; ++i) r.v[i] = std::exp(x.v[i]);
+  return r;
+#endif
+}
+
+namespace detail {
+
+#if UTEC_SIMD_VECTOR_EXTENSIONS
+template<size_t Offset, typename T, size_t Bytes, size_t... I>
+UTEC_ALWAYS_INLINE packet<T, Bytes> interleave(const packet<T, Bytes>& a, const packet<T, Bytes>& b,
+                                               std::index_sequence<I...>) {
+  constexpr size_t lanes = packet<T, Bytes>::lanes;
+  return {__builtin_shufflevector(a.v, b.v, (I % 2 ? lanes + Offset + I / 2 : Offset + I / 2)...)};
+}
+#else
+template<size_t Offset, typename T, size_t Bytes, size_t... I>
+UTEC_ALWAYS_INLINE packet<T, Bytes> interleave(const packet<T, Bytes>& a, const packet<T, Bytes>& b,
+                                               std::index_sequence<I...>) {
+  packet<T, Bytes> r;
+  ((r.v[I] = (I % 2 ? b.v[Offset + I / 2] : a.v[Offset + I / 2])), ...);
+  return r;
+}
+#endif
+
+}
+
+// {a0, b0, a1, b1, ...} from the low halves of a and b.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> interleave_low(const packet<T, Bytes>& a, const packet<T, Bytes>& b) {
+  return detail::interleave<0>(a, b, std::make_index_sequence<packet<T, Bytes>::lanes>{});
+}
+
+// {a[L/2], b[L/2], a[L/2+1], b[L/2+1], ...} from the high halves of a and b.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE packet<T, Bytes> interleave_high(const packet<T, Bytes>& a, const packet<T, Bytes>& b) {
+  return detail::interleave<packet<T, Bytes>::lanes / 2>(a, b, std::make_index_sequence<packet<T, Bytes>::lanes>{});
+}
+
+}
+
+#endif //SIMD_H
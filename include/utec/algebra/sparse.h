@@ -0,0 +1,383 @@
+//
+// Compressed sparse row matrices and their products with dense tensors.
+//
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/gemm.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/simd.h"
+#include "utec/algebra/tensor.h"
+
+namespace utec::algebra {
+
+// A (rows, columns) matrix holding only its nonzero entries, in compressed sparse row
+// form: the entries of row i are values[row_offsets[i], row_offsets[i + 1]), in
+// increasing column order, with their columns in column_indices. Meant for pruned
+// weights: at density d it takes about d * (sizeof(T) + 4) bytes per element, and the
+// matrix_product overloads below do work proportional to the nonzeros.
+template<typename T>
+class SparseTensor {
+  static_assert(std::is_arithmetic_v<T>, "SparseTensor requires an arithmetic value type");
+
+ private:
+  std::array<size_t, 2> shape_{};
+  std::vector<size_t> row_offsets_{0};
+  std::vector<uint32_t> column_indices_;
+  std::vector<T> values_;
+
+ public:
+  SparseTensor() = default;
+
+  // Keeps the entries with |value| > threshold; pruned weights are exact zeros, which
+  // the default drops.
+  template<tensor_operand X>
+    requires (!is_expression_v<X>)
+  explicit SparseTensor(const X& dense, T threshold = T{0}) {
+    static_assert(detail::operand_traits<std::remove_cvref_t<X>>::rank == 2, "SparseTensor requires a matrix");
+    static_assert(std::is_same_v<detail::operand_value_t<X>, T>, "Dense operand must have the same value type");
+    const auto d = detail::const_view(dense);
+    shape_ = d.shape();
+    if (shape_[1] > std::numeric_limits<uint32_t>::max())
+      throw std::runtime_error("SparseTensor supports at most 2^32 - 1 columns");
+    row_offsets_.assign(1, 0);
+    row_offsets_.reserve(shape_[0] + 1);
+    for (size_t i = 0; i < shape_[0]; ++i) {
+      for (size_t j = 0; j < shape_[1]; ++j) {
+        const T v = d(i, j);
+        if ((v < T{0} ? T(-v) : v) > threshold) {
+          column_indices_.push_back(uint32_t(j));
+          values_.push_back(v);
+        }
+      }
+      row_offsets_.push_back(values_.size());
+    }
+  }
+
+  const std::array<size_t, 2>& shape() const { return shape_; }
+  size_t rows() const { return shape_[0]; }
+  size_t columns() const { return shape_[1]; }
+  size_t nonzeros() const { return values_.size(); }
+  double density() const {
+    const size_t size = shape_[0] * shape_[1];
+    return size == 0 ? 0.0 : double(values_.size()) / double(size);
+  }
+
+  // Storage of the offsets, indices and values.
+  size_t bytes() const {
+    return row_offsets_.size() * sizeof(size_t) + column_indices_.size() * sizeof(uint32_t) +
+           values_.size() * sizeof(T);
+  }
+
+  const std::vector<size_t>& row_offsets() const { return row_offsets_; }
+  const std::vector<uint32_t>& column_indices() const { return column_indices_; }
+  // The nonzero values may be updated in place, e.g. when fine-tuning pruned weights;
+  // the sparsity pattern is fixed.
+  std::vector<T>& values() { return values_; }
+  const std::vector<T>& values() const { return values_; }
+
+  // Zero outside the stored entries.
+  T operator()(size_t i, size_t j) const {
+    if (i >= shape_[0] || j >= shape_[1]) throw std::out_of_range("SparseTensor index out of range");
+    const auto first = column_indices_.begin() + std::ptrdiff_t(row_offsets_[i]);
+    const auto last = column_indices_.begin() + std::ptrdiff_t(row_offsets_[i + 1]);
+    const auto it = std::lower_bound(first, last, uint32_t(j));
+    return it != last && *it == j ? values_[size_t(it - column_indices_.begin())] : T{0};
+  }
+
+  Tensor<T, 2> to_dense() const {
+    Tensor<T, 2> result(shape_[0], shape_[1]);
+    result.fill(T{0});
+    for (size_t i = 0; i < shape_[0]; ++i)
+      for (size_t e = row_offsets_[i]; e < row_offsets_[i + 1]; ++e) result(i, column_indices_[e]) = values_[e];
+    return result;
+  }
+};
+
+namespace sparse {
+
+// Rows [first, last) of c = a b for CSR a and dense b with unit column stride: every
+// nonzero a(i, k) adds a(i, k) * b(k, :) to row i, kept in registers `tile` packets of
+// columns at a time, and the epilogue runs once on the finished tile.
+template<typename T, size_t Bytes, typename Epilogue>
+UTEC_ALWAYS_INLINE void sparse_dense(size_t first, size_t last, size_t n, const size_t* UTEC_RESTRICT offsets,
+                                     const uint32_t* UTEC_RESTRICT columns, const T* UTEC_RESTRICT values,
+                                     const T* UTEC_RESTRICT b, size_t ldb, T* UTEC_RESTRICT c, size_t ldc,
+                                     const Epilogue& epilogue) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  constexpr size_t tile = 4;
+  for (size_t i = first; i < last; ++i) {
+    const size_t begin = offsets[i];
+    const size_t end = offsets[i + 1];
+    T* y = c + i * ldc;
+    size_t j = 0;
+    for (; j + tile * L <= n; j += tile * L) {
+      P acc[tile];
+      for (size_t t = 0; t < tile; ++t) acc[t] = P::zero();
+      for (size_t e = begin; e < end; ++e) {
+        const P v = P::broadcast(values[e]);
+        const T* row = b + size_t(columns[e]) * ldb + j;
+        for (size_t t = 0; t < tile; ++t) acc[t] = simd::fmadd(v, P::load(row + t * L), acc[t]);
+      }
+      for (size_t t = 0; t < tile; ++t) epilogue(acc[t], j + t * L).store(y + j + t * L);
+    }
+    for (; j + L <= n; j += L) {
+      P acc = P::zero();
+      for (size_t e = begin; e < end; ++e)
+        acc = simd::fmadd(P::broadcast(values[e]), P::load(b + size_t(columns[e]) * ldb + j), acc);
+      epilogue(acc, j).store(y + j);
+    }
+    for (; j < n; ++j) {
+      T acc{0};
+      for (size_t e = begin; e < end; ++e) acc += values[e] * b[size_t(columns[e]) * ldb + j];
+      y[j] = epilogue(acc, j);
+    }
+  }
+}
+
+// Per-thread transposed tiles of dense_sparse.
+template<typename T>
+std::vector<T, aligned_allocator<T>>& tile_scratch() {
+  thread_local std::vector<T, aligned_allocator<T>> buffer;
+  return buffer;
+}
+
+// Rows [first, last) of c = a b for dense a (strides rsa, csa) and CSR b. Rows are
+// taken a packet of lanes at a time and transposed, so every nonzero b(i, j) is one
+// packet multiply-add of column i of the tile into column j of the transposed result;
+// the epilogue runs while the result is transposed back. Leftover rows scatter
+// a(r, i) * b(i, :) into row r, skipping zero activations (e.g. after a ReLU).
+template<typename T, size_t Bytes, typename Epilogue>
+UTEC_ALWAYS_INLINE void dense_sparse(size_t first, size_t last, size_t k, size_t n, const T* UTEC_RESTRICT a,
+                                     size_t rsa, size_t csa, const size_t* UTEC_RESTRICT offsets,
+                                     const uint32_t* UTEC_RESTRICT columns, const T* UTEC_RESTRICT values,
+                                     T* UTEC_RESTRICT c, size_t ldc, const Epilogue& epilogue, T* UTEC_RESTRICT xt,
+                                     T* UTEC_RESTRICT yt) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  size_t r = first;
+  for (; r + L <= last; r += L) {
+    for (size_t i = 0; i < k; ++i)
+      for (size_t l = 0; l < L; ++l) xt[i * L + l] = a[(r + l) * rsa + i * csa];
+    std::fill_n(yt, n * L, T{0});
+    for (size_t i = 0; i < k; ++i) {
+      const P x = P::load(xt + i * L);
+      for (size_t e = offsets[i]; e < offsets[i + 1]; ++e) {
+        T* column = yt + size_t(columns[e]) * L;
+        simd::fmadd(P::broadcast(values[e]), x, P::load(column)).store(column);
+      }
+    }
+    for (size_t l = 0; l < L; ++l) {
+      T* y = c + (r + l) * ldc;
+      size_t j = 0;
+      for (; j + L <= n; j += L) epilogue(P::gather(yt + j * L + l, L), j).store(y + j);
+      for (; j < n; ++j) y[j] = epilogue(yt[j * L + l], j);
+    }
+  }
+  for (; r < last; ++r) {
+    T* y = c + r * ldc;
+    std::fill_n(y, n, T{0});
+    for (size_t i = 0; i < k; ++i) {
+      const T x = a[r * rsa + i * csa];
+      if (x == T{0}) continue;
+      for (size_t e = offsets[i]; e < offsets[i + 1]; ++e) y[columns[e]] += x * values[e];
+    }
+    size_t j = 0;
+    for (; j + L <= n; j += L) epilogue(P::load(y + j), j).store(y + j);
+    for (; j < n; ++j) y[j] = epilogue(y[j], j);
+  }
+}
+
+template<typename T, typename Epilogue>
+void sparse_dense_native(size_t first, size_t last, size_t n, const size_t* offsets, const uint32_t* columns,
+                         const T* values, const T* b, size_t ldb, T* c, size_t ldc, const Epilogue& epilogue) {
+  sparse_dense<T, simd::native_bytes>(first, last, n, offsets, columns, values, b, ldb, c, ldc, epilogue);
+}
+
+template<typename T, typename Epilogue>
+void dense_sparse_native(size_t first, size_t last, size_t k, size_t n, const T* a, size_t rsa, size_t csa,
+                         const size_t* offsets, const uint32_t* columns, const T* values, T* c, size_t ldc,
+                         const Epilogue& epilogue, T* xt, T* yt) {
+  dense_sparse<T, simd::native_bytes>(first, last, k, n, a, rsa, csa, offsets, columns, values, c, ldc, epilogue, xt,
+                                      yt);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX2 void sparse_dense_avx2(size_t first, size_t last, size_t n, const size_t* offsets,
+                                        const uint32_t* columns, const T* values, const T* b, size_t ldb, T* c,
+                                        size_t ldc, const Epilogue& epilogue) {
+  sparse_dense<T, 32>(first, last, n, offsets, columns, values, b, ldb, c, ldc, epilogue);
+}
+
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX512 void sparse_dense_avx512(size_t first, size_t last, size_t n, const size_t* offsets,
+                                            const uint32_t* columns, const T* values, const T* b, size_t ldb,
+                                            T* c, size_t ldc, const Epilogue& epilogue) {
+  sparse_dense<T, 64>(first, last, n, offsets, columns, values, b, ldb, c, ldc, epilogue);
+}
+
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX2 void dense_sparse_avx2(size_t first, size_t last, size_t k, size_t n, const T* a, size_t rsa,
+                                        size_t csa, const size_t* offsets, const uint32_t* columns,
+                                        const T* values, T* c, size_t ldc, const Epilogue& epilogue, T* xt,
+                                        T* yt) {
+  dense_sparse<T, 32>(first, last, k, n, a, rsa, csa, offsets, columns, values, c, ldc, epilogue, xt, yt);
+}
+
+template<typename T, typename Epilogue>
+UTEC_TARGET_AVX512 void dense_sparse_avx512(size_t first, size_t last, size_t k, size_t n, const T* a,
+                                            size_t rsa, size_t csa, const size_t* offsets,
+                                            const uint32_t* columns, const T* values, T* c, size_t ldc,
+                                            const Epilogue& epilogue, T* xt, T* yt) {
+  dense_sparse<T, 64>(first, last, k, n, a, rsa, csa, offsets, columns, values, c, ldc, epilogue, xt, yt);
+}
+#endif
+
+template<typename T, typename Epilogue>
+using sparse_dense_kernel = void (*)(size_t, size_t, size_t, const size_t*, const uint32_t*, const T*, const T*,
+                                     size_t, T*, size_t, const Epilogue&);
+
+template<typename T, typename Epilogue>
+using dense_sparse_kernel = void (*)(size_t, size_t, size_t, size_t, const T*, size_t, size_t, const size_t*,
+                                     const uint32_t*, const T*, T*, size_t, const Epilogue&, T*, T*);
+
+template<typename T, typename Epilogue>
+sparse_dense_kernel<T, Epilogue> select_sparse_dense() {
+  return dispatch::select(&sparse_dense_native<T, Epilogue>
+                          UTEC_DISPATCH_VARIANTS(, &sparse_dense_avx2<T, Epilogue>, &sparse_dense_avx512<T, Epilogue>));
+}
+
+template<typename T, typename Epilogue>
+dense_sparse_kernel<T, Epilogue> select_dense_sparse() {
+  return dispatch::select(&dense_sparse_native<T, Epilogue>
+                          UTEC_DISPATCH_VARIANTS(, &dense_sparse_avx2<T, Epilogue>, &dense_sparse_avx512<T, Epilogue>));
+}
+
+// Rows per task so that a task does about gemm_grain multiply-adds.
+inline size_t row_grain(size_t rows, size_t work) {
+  const size_t per_row = std::max<size_t>(1, work / std::max<size_t>(1, rows));
+  return std::max<size_t>(1, parallel::config().gemm_grain / per_row);
+}
+
+template<typename T, typename Out>
+void prepare_output(Out& out, const std::array<size_t, 2>& shape) {
+  if constexpr (is_tensor_v<Out>) {
+    if (out.shape() != shape) out.reshape(shape);
+  } else {
+    if (out.shape() != shape || !out.is_contiguous())
+      throw std::runtime_error("Output view must be contiguous and match the product shape");
+  }
+}
+
+}
+
+// Sparse-dense product out = a b, with b a (columns, n) tensor or view and out a
+// (rows, n) tensor (reshaped) or contiguous view that must not overlap b. Vectorized
+// over the columns of b and split across threads by rows of a; the epilogue is that
+// of the dense matrix_product (see tensor.h).
+template<typename T, tensor_operand B, tensor_output Out, typename Epilogue = gemm::identity_epilogue>
+  requires (!is_expression_v<B>)
+void matrix_product(const SparseTensor<T>& a, const B& b, Out&& out, const Epilogue& epilogue = {}) {
+  static_assert(std::is_same_v<detail::operand_value_t<B>, T>, "Tensor operands must have the same value type");
+  static_assert(std::is_same_v<detail::operand_value_t<Out>, T>, "Output must have the operands' value type");
+  const auto bv = detail::const_view(b);
+  if (bv.shape()[0] != a.columns()) throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
+  const std::array<size_t, 2> shape{a.rows(), bv.shape()[1]};
+  sparse::prepare_output<T>(out, shape);
+  if (detail::regions_alias<T, 2>(out.data(), shape, detail::contiguous_strides(shape), bv.data(), bv.shape(),
+                                  bv.strides()) ||
+      (out.data() == bv.data() && bv.size() > 0))
+    throw std::runtime_error("Output tensor must not overlap the operands");
+
+  const size_t n = shape[1];
+  UTEC_PROFILE_SCOPE("matrix_product.sparse", 2 * a.nonzeros() * n);
+  if (shape[0] == 0 || n == 0) return;
+  // The kernel reads rows of b with unit stride; other layouts are copied once.
+  Tensor<T, 2> copy;
+  const T* bp = bv.data();
+  size_t ldb = bv.strides()[0];
+  if (bv.strides()[1] != 1) {
+    copy = Tensor<T, 2>(bv);
+    bp = copy.data();
+    ldb = n;
+  }
+  const auto kernel = sparse::select_sparse_dense<T, Epilogue>();
+  T* c = out.data();
+  parallel::parallel_for(0, a.rows(), sparse::row_grain(a.rows(), a.nonzeros() * n), [&](size_t first, size_t last) {
+    kernel(first, last, n, a.row_offsets().data(), a.column_indices().data(), a.values().data(), bp, ldb, c, n,
+           epilogue);
+  });
+}
+
+// Dense-sparse product out = a b, e.g. a minibatch times pruned (in, out) Dense
+// weights, with a an (m, rows) tensor or view and out as above; split across threads
+// by rows of a.
+template<typename T, tensor_operand A, tensor_output Out, typename Epilogue = gemm::identity_epilogue>
+  requires (!is_expression_v<A>)
+void matrix_product(const A& a, const SparseTensor<T>& b, Out&& out, const Epilogue& epilogue = {}) {
+  static_assert(std::is_same_v<detail::operand_value_t<A>, T>, "Tensor operands must have the same value type");
+  static_assert(std::is_same_v<detail::operand_value_t<Out>, T>, "Output must have the operands' value type");
+  const auto av = detail::const_view(a);
+  if (av.shape()[1] != b.rows()) throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
+  const std::array<size_t, 2> shape{av.shape()[0], b.columns()};
+  sparse::prepare_output<T>(out, shape);
+  if (detail::regions_alias<T, 2>(out.data(), shape, detail::contiguous_strides(shape), av.data(), av.shape(),
+                                  av.strides()) ||
+      (out.data() == av.data() && av.size() > 0))
+    throw std::runtime_error("Output tensor must not overlap the operands");
+
+  const size_t m = shape[0];
+  const size_t n = shape[1];
+  UTEC_PROFILE_SCOPE("matrix_product.sparse", 2 * m * b.nonzeros());
+  if (m == 0 || n == 0) return;
+  const auto kernel = sparse::select_dense_sparse<T, Epilogue>();
+  const T* ap = av.data();
+  T* c = out.data();
+  const size_t k = b.rows();
+  // Tiles are as wide as the widest packet, whatever kernel variant runs.
+  constexpr size_t lanes = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+  parallel::parallel_for(0, m, sparse::row_grain(m, m * (b.nonzeros() + n)), [&](size_t first, size_t last) {
+    auto& scratch = sparse::tile_scratch<T>();
+    if (scratch.size() < (k + n) * lanes) scratch.resize((k + n) * lanes);
+    kernel(first, last, k, n, ap, av.strides()[0], av.strides()[1], b.row_offsets().data(),
+           b.column_indices().data(), b.values().data(), c, n, epilogue, scratch.data(), scratch.data() + k * lanes);
+  });
+}
+
+template<typename T, tensor_operand B>
+  requires (!is_expression_v<B>)
+Tensor<T, 2> matrix_product(const SparseTensor<T>& a, const B& b) {
+  Tensor<T, 2> out;
+  matrix_product(a, b, out);
+  return out;
+}
+
+template<typename T, tensor_operand A>
+  requires (!is_expression_v<A>)
+Tensor<T, 2> matrix_product(const A& a, const SparseTensor<T>& b) {
+  Tensor<T, 2> out;
+  matrix_product(a, b, out);
+  return out;
+}
+
+}
+
+#endif //SPARSE_H
@@ -0,0 +1,327 @@
+//
+// Tensors whose shape is part of the type, for small fixed-size layers.
+//
+
+#ifndef STATIC_TENSOR_H
+#define STATIC_TENSOR_H
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <initializer_list>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "utec/algebra/tensor.h"
+
+namespace utec::algebra {
+
+template<typename T, size_t... Dims>
+class StaticTensor;
+
+namespace detail {
+
+template<size_t N>
+constexpr std::array<size_t, N> static_contiguous_strides(const std::array<size_t, N>& shape) {
+  std::array<size_t, N> strides{};
+  size_t stride = 1;
+  for (size_t d = N; d-- > 0;) {
+    strides[d] = stride;
+    stride *= shape[d];
+  }
+  return strides;
+}
+
+// Row-major strides of `shape` read as an operand broadcast to a larger shape: axes of
+// extent 1 get stride 0.
+template<size_t N>
+constexpr std::array<size_t, N> static_broadcast_strides(const std::array<size_t, N>& shape) {
+  std::array<size_t, N> strides = static_contiguous_strides(shape);
+  for (size_t d = 0; d < N; ++d)
+    if (shape[d] == 1) strides[d] = 0;
+  return strides;
+}
+
+// Small tensors are aligned to their own (power-of-two rounded) size, so a 4-float
+// tensor fits one 16-byte register load; larger ones to a cache line.
+template<typename T, size_t Size>
+constexpr size_t static_alignment() {
+  return std::max(alignof(T), std::min(tensor_alignment, std::bit_ceil(Size * sizeof(T))));
+}
+
+template<typename T, auto Shape, typename = std::make_index_sequence<Shape.size()>>
+struct static_tensor_for;
+
+template<typename T, auto Shape, size_t... I>
+struct static_tensor_for<T, Shape, std::index_sequence<I...>> {
+  using type = StaticTensor<T, Shape[I]...>;
+};
+
+// Nested loop over Shape with compile-time trip counts, carrying one offset per strided
+// operand; fn(a, b, out) receives the element offsets of the current position.
+template<size_t D, auto Shape, auto A, auto B, auto Out, typename Fn>
+constexpr void static_loop(size_t a, size_t b, size_t out, Fn& fn) {
+  if constexpr (D == Shape.size()) {
+    fn(a, b, out);
+  } else {
+    for (size_t k = 0; k < Shape[D]; ++k)
+      static_loop<D + 1, Shape, A, B, Out>(a + k * A[D], b + k * B[D], out + k * Out[D], fn);
+  }
+}
+
+}
+
+// Fixed-shape tensor stored inline in a std::array: no heap allocation, and shape,
+// strides and every index computation are compile-time constants. Arithmetic between
+// StaticTensors (with compile-time broadcasting) and matrix_product are plain loops of
+// constant length, so the compiler can unroll and vectorize them completely. view()
+// and to_tensor() bridge to the dynamic Tensor API. It is a standalone value type for
+// user code: layers and the inference path keep their shapes at run time and use Tensor.
+template<typename T, size_t... Dims>
+class StaticTensor {
+  static_assert(sizeof...(Dims) > 0, "StaticTensor needs at least one dimension");
+  static_assert(((Dims > 0) && ...), "StaticTensor dimensions must be positive");
+
+ public:
+  using value_type = T;
+  static constexpr size_t rank = sizeof...(Dims);
+  static constexpr size_t static_size = (Dims * ...);
+  static constexpr std::array<size_t, rank> static_shape{Dims...};
+  static constexpr std::array<size_t, rank> static_strides = detail::static_contiguous_strides(static_shape);
+
+ private:
+  alignas(detail::static_alignment<T, static_size>()) std::array<T, static_size> data_{};
+
+ public:
+  constexpr StaticTensor() = default;
+
+  constexpr explicit StaticTensor(const T& value) { data_.fill(value); }
+
+  // Copies (broadcasting if needed) from a Tensor, view or expression of the same rank.
+  template<typename U>
+    requires std::is_same_v<std::remove_const_t<U>, T>
+  explicit StaticTensor(const TensorView<U, rank>& source) {
+    view().assign(source);
+  }
+
+  template<typename Allocator>
+  explicit StaticTensor(const Tensor<T, rank, Allocator>& source) : StaticTensor(source.view()) {}
+
+  template<typename E>
+    requires (std::is_same_v<typename E::value_type, T> && E::rank == rank)
+  explicit StaticTensor(const tensor_expression<E>& expression) {
+    view().assign(expression.derived());
+  }
+
+  static constexpr const std::array<size_t, rank>& shape() { return static_shape; }
+  static constexpr const std::array<size_t, rank>& strides() { return static_strides; }
+  static constexpr size_t size() { return static_size; }
+
+  constexpr T* data() { return data_.data(); }
+  constexpr const T* data() const { return data_.data(); }
+
+  template<typename... Indices>
+  constexpr T& operator()(Indices... indices) {
+    return data_[offset(indices...)];
+  }
+
+  template<typename... Indices>
+  constexpr const T& operator()(Indices... indices) const {
+    return data_[offset(indices...)];
+  }
+
+  template<typename... Indices>
+  static constexpr size_t offset(Indices... indices) {
+    static_assert(sizeof...(Indices) == rank, "Number of indices must match the tensor rank");
+    size_t result = 0;
+    size_t d = 0;
+    ((result += static_cast<size_t>(indices) * static_strides[d++]), ...);
+    return result;
+  }
+
+  constexpr auto begin() { return data_.begin(); }
+  constexpr auto end() { return data_.end(); }
+  constexpr auto begin() const { return data_.begin(); }
+  constexpr auto end() const { return data_.end(); }
+  constexpr auto cbegin() const { return data_.cbegin(); }
+  constexpr auto cend() const { return data_.cend(); }
+
+  constexpr void fill(const T& value) { data_.fill(value); }
+
+  constexpr StaticTensor& operator=(std::initializer_list<T> list) {
+    if (list.size() != static_size) throw std::runtime_error("Data size does not match tensor size");
+    std::copy(list.begin(), list.end(), data_.begin());
+    return *this;
+  }
+
+  TensorView<T, rank> view() { return TensorView<T, rank>(data(), static_shape, static_strides); }
+  TensorView<const T, rank> view() const { return TensorView<const T, rank>(data(), static_shape, static_strides); }
+  operator TensorView<T, rank>() { return view(); }
+  operator TensorView<const T, rank>() const { return view(); }
+
+  template<typename Allocator = aligned_allocator<T>>
+  Tensor<T, rank, Allocator> to_tensor() const {
+    Tensor<T, rank, Allocator> result(static_shape);
+    std::copy(data_.begin(), data_.end(), result.begin());
+    return result;
+  }
+
+  template<size_t... Other>
+  constexpr StaticTensor& operator+=(const StaticTensor<T, Other...>& other) {
+    return *this = *this + other;
+  }
+
+  template<size_t... Other>
+  constexpr StaticTensor& operator-=(const StaticTensor<T, Other...>& other) {
+    return *this = *this - other;
+  }
+
+  template<size_t... Other>
+  constexpr StaticTensor& operator*=(const StaticTensor<T, Other...>& other) {
+    return *this = *this * other;
+  }
+
+  template<size_t... Other>
+  constexpr StaticTensor& operator/=(const StaticTensor<T, Other...>& other) {
+    return *this = *this / other;
+  }
+
+  constexpr StaticTensor& operator+=(const T& scalar) {
+    for (auto& x : data_) x += scalar;
+    return *this;
+  }
+
+  constexpr StaticTensor& operator-=(const T& scalar) {
+    for (auto& x : data_) x -= scalar;
+    return *this;
+  }
+
+  constexpr StaticTensor& operator*=(const T& scalar) {
+    for (auto& x : data_) x *= scalar;
+    return *this;
+  }
+
+  constexpr StaticTensor& operator/=(const T& scalar) {
+    for (auto& x : data_) x /= scalar;
+    return *this;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const StaticTensor& tensor) {
+    return os << tensor.to_tensor();
+  }
+};
+
+namespace detail {
+
+// op applied elementwise with compile-time broadcasting; the result has extent
+// max(A[d], B[d]) on every axis. Same-shape operands reduce to one flat loop.
+template<typename Op, typename T, size_t... A, size_t... B>
+constexpr auto static_binary(const StaticTensor<T, A...>& a, const StaticTensor<T, B...>& b, Op op) {
+  static_assert(sizeof...(A) == sizeof...(B), "StaticTensor operands must have the same rank");
+  static_assert(((A == B || A == 1 || B == 1) && ...),
+                "Shapes do not match and they are not compatible for broadcasting");
+  StaticTensor<T, (A == 1 ? B : A)...> out;
+  if constexpr (((A == B) && ...)) {
+    for (size_t i = 0; i < out.size(); ++i) out.data()[i] = op(a.data()[i], b.data()[i]);
+  } else {
+    constexpr auto shape = decltype(out)::static_shape;
+    constexpr auto a_strides = static_broadcast_strides(StaticTensor<T, A...>::static_shape);
+    constexpr auto b_strides = static_broadcast_strides(StaticTensor<T, B...>::static_shape);
+    constexpr auto out_strides = decltype(out)::static_strides;
+    auto fn = [&](size_t i, size_t j, size_t o) { out.data()[o] = op(a.data()[i], b.data()[j]); };
+    static_loop<0, shape, a_strides, b_strides, out_strides>(0, 0, 0, fn);
+  }
+  return out;
+}
+
+template<typename Op, typename T, size_t... Dims>
+constexpr StaticTensor<T, Dims...> static_scalar(const StaticTensor<T, Dims...>& a, const T& scalar, Op op) {
+  StaticTensor<T, Dims...> out;
+  for (size_t i = 0; i < out.size(); ++i) out.data()[i] = op(a.data()[i], scalar);
+  return out;
+}
+
+}
+
+#define UTEC_STATIC_TENSOR_OPERATOR(op, functor)                                                   \
+  template<typename T, size_t... A, size_t... B>                                                   \
+  constexpr auto operator op(const StaticTensor<T, A...>& lhs, const StaticTensor<T, B...>& rhs) { \
+    return detail::static_binary(lhs, rhs, elementwise::functor{});                                \
+  }                                                                                                \
+                                                                                                   \
+  template<typename T, size_t... Dims>                                                             \
+  constexpr StaticTensor<T, Dims...> operator op(const StaticTensor<T, Dims...>& lhs,              \
+                                                 const std::type_identity_t<T>& rhs) {             \
+    return detail::static_scalar(lhs, rhs, elementwise::functor{});                                \
+  }                                                                                                \
+                                                                                                   \
+  template<typename T, size_t... Dims>                                                             \
+  constexpr StaticTensor<T, Dims...> operator op(const std::type_identity_t<T>& lhs,               \
+                                                 const StaticTensor<T, Dims...>& rhs) {            \
+    return detail::static_scalar(rhs, lhs, [](const T& x, const T& s) { return s op x; });         \
+  }
+
+UTEC_STATIC_TENSOR_OPERATOR(+, plus)
+UTEC_STATIC_TENSOR_OPERATOR(-, minus)
+UTEC_STATIC_TENSOR_OPERATOR(*, multiplies)
+UTEC_STATIC_TENSOR_OPERATOR(/, divides)
+
+#undef UTEC_STATIC_TENSOR_OPERATOR
+
+// (..., M, K) x (..., K, N) -> (..., M, N) with every extent known at compile time. Each
+// output row accumulates K scaled rows of B, so the N-long inner loop vectorizes and all
+// loop bounds are constants.
+template<typename T, size_t... A, size_t... B>
+constexpr auto matrix_product(const StaticTensor<T, A...>& lhs, const StaticTensor<T, B...>& rhs) {
+  constexpr size_t R = sizeof...(A);
+  static_assert(R == sizeof...(B), "StaticTensor operands must have the same rank");
+  static_assert(R >= 2, "Matrix multiplication requires at least 2 dimensions");
+  constexpr std::array<size_t, R> a_shape{A...};
+  constexpr std::array<size_t, R> b_shape{B...};
+  constexpr size_t m = a_shape[R - 2];
+  constexpr size_t k = a_shape[R - 1];
+  constexpr size_t n = b_shape[R - 1];
+  static_assert(k == b_shape[R - 2], "Matrix dimensions are incompatible for multiplication");
+  static_assert(std::equal(a_shape.begin(), a_shape.end() - 2, b_shape.begin()),
+                "Matrix dimensions are compatible for multiplication but batch dimensions do not match");
+
+  constexpr std::array<size_t, R> shape = [=] {
+    std::array<size_t, R> s = a_shape;
+    s[R - 1] = n;
+    return s;
+  }();
+  typename detail::static_tensor_for<T, shape>::type out;
+  constexpr size_t batches = out.size() / (m * n);
+
+  for (size_t batch = 0; batch < batches; ++batch) {
+    const T* a = lhs.data() + batch * m * k;
+    const T* b = rhs.data() + batch * k * n;
+    T* c = out.data() + batch * m * n;
+    for (size_t i = 0; i < m; ++i) {
+      std::array<T, n> acc{};
+      for (size_t p = 0; p < k; ++p) {
+        const T aip = a[i * k + p];
+        for (size_t j = 0; j < n; ++j) acc[j] += aip * b[p * n + j];
+      }
+      std::copy(acc.begin(), acc.end(), c + i * n);
+    }
+  }
+  return out;
+}
+
+template<typename T, size_t Rows, size_t Cols>
+constexpr StaticTensor<T, Cols, Rows> transpose_2d(const StaticTensor<T, Rows, Cols>& input) {
+  StaticTensor<T, Cols, Rows> out;
+  for (size_t i = 0; i < Rows; ++i)
+    for (size_t j = 0; j < Cols; ++j) out(j, i) = input(i, j);
+  return out;
+}
+
+}
+
+#endif //STATIC_TENSOR_H
@@ -13,35 +13,31 @@
 #include <stdexcept>
 #include <initializer_list>
 #include <algorithm>
+#include <cstring>
 #include <numeric>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/elementwise.h"
+#include "utec/algebra/expression.h"
+#include "utec/algebra/gemm.h"
+#include "utec/algebra/half.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/serialization.h"
+#include "utec/algebra/tensor_view.h"
+#include "utec/algebra/transpose.h"
 
 
 namespace utec::algebra {
 
-inline bool can_broadcast(const std::array<size_t, 2>& a, const std::array<size_t, 2>& b) {
-  for (size_t i = 0; i < a.size(); ++i) {
-    if (a[i] != b[i] && a[i] != 1 && b[i] != 1) return false;
-  }
-  return true;
-}
-
-template<size_t N>
-inline bool can_broadcast(const std::array<size_t, N>& a, const std::array<size_t, N>& b) {
-  for (size_t i = 0; i < a.size(); ++i) {
-    if (a[i] != b[i] && a[i] != 1 && b[i] != 1) return false;
-  }
-  return true;
-}
-
-inline size_t broadcast_index(size_t i, size_t dim_size) {
-  return (dim_size == 1) ? 0 : i;
-}
-
-template<typename T, size_t N>
+template<typename T, size_t N, typename Allocator>
 class Tensor {
  private:
   std::array<size_t, N> dimensions_{};
-  std::vector<T> data_;
+  std::vector<T, Allocator> data_;
 
   size_t compute_flat_index(const std::array<size_t, N>& indices) const {
     size_t flat_index = 0;
@@ -53,8 +49,20 @@ class Tensor {
     return flat_index;
   }
 
+  // In-place update: the broadcast result must keep this tensor's shape.
+  template<typename E>
+  Tensor& update(const tensor_expression<E>& expression) {
+    if (expression.derived().shape() != dimensions_)
+      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
+    return *this = expression;
+  }
+
  public:
+  using value_type = T;
+  using allocator_type = Allocator;
+
   template<typename... Dims>
+    requires (std::is_integral_v<Dims> && ...)
   Tensor(Dims... dims) {
     if (sizeof...(Dims) != N) {
       throw std::runtime_error("Number of dimensions do not match with " + std::to_string(N));
@@ -77,7 +85,59 @@ class Tensor {
     data_.resize(1);
   }
 
+  template<typename OtherAllocator>
+    requires (!std::is_same_v<OtherAllocator, Allocator>)
+  explicit Tensor(const Tensor<T, N, OtherAllocator>& other)
+      : dimensions_(other.shape()), data_(other.begin(), other.end()) {}
+
+  template<typename U>
+    requires std::is_same_v<std::remove_const_t<U>, T>
+  explicit Tensor(const TensorView<U, N>& view) : Tensor(detail::as_expression(view)) {}
+
+  template<typename E>
+    requires (std::is_same_v<typename E::value_type, T> && E::rank == N)
+  Tensor(const tensor_expression<E>& expression) : dimensions_(expression.derived().shape()) {
+    data_.resize(detail::shape_size(dimensions_));
+    evaluate(expression, data_.data());
+  }
+
+  template<typename E>
+    requires (std::is_same_v<typename E::value_type, T> && E::rank == N)
+  Tensor& operator=(const tensor_expression<E>& expression) {
+    const auto strides = detail::contiguous_strides(dimensions_);
+    if (expression.derived().shape() != dimensions_ ||
+        expression.derived().may_alias(data_.data(), dimensions_, strides)) {
+      *this = Tensor(expression);
+      return *this;
+    }
+    evaluate(expression, data_.data());
+    return *this;
+  }
+
   const std::array<size_t, N>& shape() const { return dimensions_; }
+  size_t size() const { return data_.size(); }
+
+  T* data() { return data_.data(); }
+  const T* data() const { return data_.data(); }
+
+  TensorView<T, N> view() { return TensorView<T, N>(data_.data(), dimensions_); }
+  TensorView<const T, N> view() const { return TensorView<const T, N>(data_.data(), dimensions_); }
+  operator TensorView<T, N>() { return view(); }
+  operator TensorView<const T, N>() const { return view(); }
+
+  TensorView<T, N> transpose_view() { return view().transposed(); }
+  TensorView<const T, N> transpose_view() const { return view().transposed(); }
+
+  TensorView<T, N> slice(size_t axis, size_t begin, size_t end) { return view().slice(axis, begin, end); }
+  TensorView<const T, N> slice(size_t axis, size_t begin, size_t end) const { return view().slice(axis, begin, end); }
+
+  TensorView<T, N - 1> select(size_t axis, size_t index) { return view().select(axis, index); }
+  TensorView<const T, N - 1> select(size_t axis, size_t index) const { return view().select(axis, index); }
+
+  template<typename... Dims>
+  TensorView<T, sizeof...(Dims)> reshape_view(Dims... dims) { return view().reshape(dims...); }
+  template<typename... Dims>
+  TensorView<const T, sizeof...(Dims)> reshape_view(Dims... dims) const { return view().reshape(dims...); }
 
   template<typename... Indices>
   T& operator()(Indices... indices) {
@@ -93,16 +153,16 @@ class Tensor {
     return data_[compute_flat_index(idx)];
   }
 
-  typename std::vector<T>::iterator begin() { return data_.begin(); }
-  typename std::vector<T>::iterator end() { return data_.end(); }
-  typename std::vector<T>::const_iterator begin() const { return data_.begin(); }
-  typename std::vector<T>::const_iterator end() const { return data_.end(); }
-  typename std::vector<T>::const_iterator cbegin() const { return data_.cbegin(); }
-  typename std::vector<T>::const_iterator cend() const { return data_.cend(); }
+  typename std::vector<T, Allocator>::iterator begin() { return data_.begin(); }
+  typename std::vector<T, Allocator>::iterator end() { return data_.end(); }
+  typename std::vector<T, Allocator>::const_iterator begin() const { return data_.begin(); }
+  typename std::vector<T, Allocator>::const_iterator end() const { return data_.end(); }
+  typename std::vector<T, Allocator>::const_iterator cbegin() const { return data_.cbegin(); }
+  typename std::vector<T, Allocator>::const_iterator cend() const { return data_.cend(); }
 
   void fill(const T& value) { std::fill(data_.begin(), data_.end(), value); }
 
-  Tensor<T, N>& operator=(std::initializer_list<T> list) {
+  Tensor& operator=(std::initializer_list<T> list) {
     if (list.size() != data_.size()) throw std::runtime_error("Data size does not match tensor size");
     std::copy(list.begin(), list.end(), data_.begin());
     return *this;
@@ -113,7 +173,10 @@ class Tensor {
     if (sizeof...(Dims) != N) {
       throw std::runtime_error("Number of dimensions do not match with " + std::to_string(N));
     }
-    std::array<size_t, N> new_shape = std::array<size_t, N>{static_cast<size_t>(new_dims)...};
+    reshape(std::array<size_t, N>{static_cast<size_t>(new_dims)...});
+  }
+
+  void reshape(const std::array<size_t, N>& new_shape) {
     size_t new_total = 1;
     for (auto d : new_shape) new_total *= d;
 
@@ -125,101 +188,44 @@ class Tensor {
     data_.resize(new_total);
   }
 
-  Tensor<T, N> operator+(const Tensor<T, N>& other) const {
-    if (!can_broadcast(dimensions_, other.dimensions_))
-      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
-
-    Tensor<T, N> result(dimensions_);
-
-    std::array<size_t, N> indices{};
-    for (size_t i = 0; i < data_.size(); ++i) {
-      size_t temp = i;
-      for (int d = N - 1; d >= 0; --d) {
-        indices[d] = temp % dimensions_[d];
-        temp /= dimensions_[d];
-      }
-
-      std::array<size_t, N> other_indices{};
-      for (size_t d = 0; d < N; ++d) {
-        other_indices[d] = broadcast_index(indices[d], other.dimensions_[d]);
-      }
-
-      result.data_[i] = data_[i] + other.data_[other.compute_flat_index(other_indices)];
-    }
-    return result;
-  }
-
-  Tensor<T, N> operator-(const Tensor<T, N>& other) const {
-    if (!can_broadcast(dimensions_, other.dimensions_))
-      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
-
-    Tensor<T, N> result(dimensions_);
-
-    std::array<size_t, N> indices{};
-    for (size_t i = 0; i < data_.size(); ++i) {
-      size_t temp = i;
-      for (int d = N - 1; d >= 0; --d) {
-        indices[d] = temp % dimensions_[d];
-        temp /= dimensions_[d];
-      }
-
-      std::array<size_t, N> other_indices{};
-      for (size_t d = 0; d < N; ++d) {
-        other_indices[d] = broadcast_index(indices[d], other.dimensions_[d]);
-      }
-
-      result.data_[i] = data_[i] - other.data_[other.compute_flat_index(other_indices)];
-    }
-    return result;
+  // Binary format (see serialization.h): a header with element type, rank and shape,
+  // then the raw elements at a 64-byte aligned offset.
+  void save(const std::string& path) const {
+    UTEC_PROFILE_SCOPE("tensor.save", 0);
+    serialization::save(path, data_.data(), dimensions_);
   }
-
-  Tensor<T, N> operator*(const Tensor<T, N>& other) const {
-    if (!can_broadcast(dimensions_, other.dimensions_))
-      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
-
-    Tensor<T, N> result(dimensions_);
-
-    std::array<size_t, N> indices{};
-    for (size_t i = 0; i < data_.size(); ++i) {
-      size_t temp = i;
-      for (int d = N - 1; d >= 0; --d) {
-        indices[d] = temp % dimensions_[d];
-        temp /= dimensions_[d];
-      }
-
-      std::array<size_t, N> other_indices{};
-      for (size_t d = 0; d < N; ++d) {
-        other_indices[d] = broadcast_index(indices[d], other.dimensions_[d]);
-      }
-
-      result.data_[i] = data_[i] * other.data_[other.compute_flat_index(other_indices)];
-    }
-    return result;
+  void save(std::ostream& out) const {
+    UTEC_PROFILE_SCOPE("tensor.save", 0);
+    serialization::write(out, data_.data(), dimensions_);
   }
 
-  Tensor<T, N> operator+(const T& scalar) const {
-    Tensor<T, N> result = *this;
-    for (auto& x : result.data_) x += scalar;
+  // Reads a file written by save() into a new tensor.
+  static Tensor load(const std::string& path) {
+    UTEC_PROFILE_SCOPE("tensor.load", 0);
+    const serialization::mapped_file file(path);
+    Tensor result(serialization::parse<T, N>(file.data(), file.size()));
+    std::memcpy(static_cast<void*>(result.data()), file.data() + serialization::data_offset(N),
+                result.size() * sizeof(T));
     return result;
   }
 
-  Tensor<T, N> operator-(const T& scalar) const {
-    Tensor<T, N> result = *this;
-    for (auto& x : result.data_) x -= scalar;
-    return result;
-  }
+  // Maps a file written by save() read-only and uses its pages in place, without
+  // reading or copying the elements up front.
+  static MappedTensor<T, N> load_mmap(const std::string& path) { return MappedTensor<T, N>(path); }
 
-  Tensor<T, N> operator*(const T& scalar) const {
-    Tensor<T, N> result = *this;
-    for (auto& x : result.data_) x *= scalar;
-    return result;
-  }
+  template<tensor_operand X>
+  Tensor& operator+=(X&& other) { return update(*this + std::forward<X>(other)); }
+  template<tensor_operand X>
+  Tensor& operator-=(X&& other) { return update(*this - std::forward<X>(other)); }
+  template<tensor_operand X>
+  Tensor& operator*=(X&& other) { return update(*this * std::forward<X>(other)); }
+  template<tensor_operand X>
+  Tensor& operator/=(X&& other) { return update(*this / std::forward<X>(other)); }
 
-  Tensor<T, N> operator/(const T& scalar) const {
-    Tensor<T, N> result = *this;
-    for (auto& x : result.data_) x /= scalar;
-    return result;
-  }
+  Tensor& operator+=(const T& scalar) { return update(*this + scalar); }
+  Tensor& operator-=(const T& scalar) { return update(*this - scalar); }
+  Tensor& operator*=(const T& scalar) { return update(*this * scalar); }
+  Tensor& operator/=(const T& scalar) { return update(*this / scalar); }
 
   friend std::ostream& operator<<(std::ostream& os, const Tensor& tensor) {
     if constexpr (N == 1) {
@@ -268,143 +274,312 @@ class Tensor {
   }
 };
 
-template<typename T, size_t N>
-Tensor<T, N> operator+(const T& scalar, const Tensor<T, N>& tensor) {
-  return tensor + scalar;
-}
-
-template<typename T, size_t N>
-Tensor<T, N> operator-(const T& scalar, const Tensor<T, N>& tensor) {
-  Tensor<T, N> result = tensor;
-  for (auto& x : result.begin()) x = scalar - x;
-  return result;
-}
-
-template<typename T, size_t N>
-Tensor<T, N> operator*(const T& scalar, const Tensor<T, N>& tensor) {
-  return tensor * scalar;
+// Swaps the last two axes of every matrix slice, tile by tile (see transpose.h).
+template<typename T, size_t N, typename Allocator>
+Tensor<T, N, Allocator> transpose_2d(const Tensor<T, N, Allocator>& input) {
+  if constexpr (N < 2) {
+    throw std::runtime_error("Cannot transpose 1D tensor: need at least 2 dimensions");
+  } else {
+    UTEC_PROFILE_SCOPE("transpose_2d", 0);
+    const auto& shape = input.shape();
+    std::array<size_t, N> new_shape = shape;
+    std::swap(new_shape[N - 1], new_shape[N - 2]);
+
+    Tensor<T, N, Allocator> result(new_shape);
+    const size_t rows = shape[N - 2];
+    const size_t cols = shape[N - 1];
+    size_t batches = 1;
+    for (size_t d = 0; d + 2 < N; ++d) batches *= shape[d];
+    transpose::transpose(batches, rows, cols, input.data(), cols, rows * cols, result.data(), rows, rows * cols);
+    return result;
+  }
 }
 
+// Views whose matrix slices are row-major with a uniform batch stride use the blocked
+// kernel as well; any other layout is gathered through the expression evaluator.
 template<typename T, size_t N>
-Tensor<T, N> transpose_2d(const Tensor<T, N>& input) {
+Tensor<std::remove_const_t<T>, N> transpose_2d(const TensorView<T, N>& input) {
   if constexpr (N < 2) {
     throw std::runtime_error("Cannot transpose 1D tensor: need at least 2 dimensions");
-  }
+  } else {
+    UTEC_PROFILE_SCOPE("transpose_2d", 0);
+    using U = std::remove_const_t<T>;
+    const auto& shape = input.shape();
+    const auto& strides = input.strides();
+    const size_t rows = shape[N - 2];
+    const size_t cols = shape[N - 1];
+    size_t batches = 1;
+    size_t batch_stride = 0;
+    size_t expected = 0;
+    bool innermost = true;
+    bool uniform = cols <= 1 || strides[N - 1] == 1;
+    for (size_t d = N - 2; d-- > 0;) {
+      batches *= shape[d];
+      if (shape[d] == 1) continue;
+      if (innermost) {
+        batch_stride = strides[d];
+        innermost = false;
+      } else if (strides[d] != expected) {
+        uniform = false;
+      }
+      expected = strides[d] * shape[d];
+    }
+    if (!uniform) return Tensor<U, N>(detail::as_expression(input.transposed()));
 
-  auto shape = input.shape();
-  std::array<size_t, N> new_shape = shape;
-  std::swap(new_shape[N - 1], new_shape[N - 2]);
-
-  Tensor<T, N> result;
-  if constexpr (N == 2) {
-    result = Tensor<T, N>(new_shape[0], new_shape[1]);
-  } else if constexpr (N == 3) {
-    result = Tensor<T, N>(new_shape[0], new_shape[1], new_shape[2]);
-  } else if constexpr (N == 4) {
-    result = Tensor<T, N>(new_shape[0], new_shape[1], new_shape[2], new_shape[3]);
+    std::array<size_t, N> new_shape = shape;
+    std::swap(new_shape[N - 1], new_shape[N - 2]);
+    Tensor<U, N> result(new_shape);
+    transpose::transpose(batches, rows, cols, input.data(), strides[N - 2], batch_stride, result.data(), rows,
+                         rows * cols);
+    return result;
   }
+}
 
-  std::array<size_t, N> idx{};
-  std::array<size_t, N> transposed_idx{};
-
-  size_t total_elements = 1;
-  for (auto dim : shape) total_elements *= dim;
+namespace detail {
 
-  for (size_t i = 0; i < total_elements; ++i) {
-    size_t temp = i;
-    for (int d = N - 1; d >= 0; --d) {
-      idx[d] = temp % shape[d];
-      temp /= shape[d];
+template<size_t N>
+std::array<size_t, N> matrix_product_shape(const std::array<size_t, N>& a_shape, const std::array<size_t, N>& b_shape) {
+  if constexpr (N < 2) {
+    throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
+  } else {
+    if (a_shape[N - 1] != b_shape[N - 2]) {
+      throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
     }
-    transposed_idx = idx;
-    std::swap(transposed_idx[N - 1], transposed_idx[N - 2]);
 
-    if constexpr (N == 2) {
-      result(transposed_idx[0], transposed_idx[1]) = input(idx[0], idx[1]);
-    } else if constexpr (N == 3) {
-      result(transposed_idx[0], transposed_idx[1], transposed_idx[2]) = input(idx[0], idx[1], idx[2]);
-    } else if constexpr (N == 4) {
-      result(transposed_idx[0], transposed_idx[1], transposed_idx[2], transposed_idx[3]) = input(idx[0], idx[1], idx[2], idx[3]);
+    for (size_t i = 0; i < N - 2; ++i) {
+      if (a_shape[i] != b_shape[i]) {
+        throw std::runtime_error("Matrix dimensions are compatible for multiplication but batch dimensions do not match");
+      }
     }
-  }
 
-  return result;
+    std::array<size_t, N> result_shape = a_shape;
+    result_shape[N - 1] = b_shape[N - 1];
+    result_shape[N - 2] = a_shape[N - 2];
+    return result_shape;
+  }
 }
 
-template<typename T, size_t N>
-Tensor<T, N> matrix_product(const Tensor<T, N>& A, const Tensor<T, N>& B) {
+// C = A x B for every batch slice, C being a contiguous buffer of the product shape.
+// A and B may be arbitrary strided views (e.g. transposed), which the GEMM packing
+// absorbs without materializing them. The epilogue is applied to each output value as it
+// is written (see gemm::micro_kernel).
+//
+// Sums are accumulated in Acc. When T differs from a float or double Acc (bfloat16,
+// float16, or float accumulated in double) the packing converts A and B to Acc, the
+// GEMM writes an Acc scratch slice, and the epilogue runs on each Acc value as it is
+// rounded into C.
+template<typename T, size_t N, typename Epilogue = gemm::identity_epilogue, typename Acc = accumulator_t<T>>
+void matrix_product_into(const TensorView<const T, N>& A, const TensorView<const T, N>& B, T* c,
+                         const Epilogue& epilogue = {}) {
   const auto& a_shape = A.shape();
   const auto& b_shape = B.shape();
+  const auto& as = A.strides();
+  const auto& bs = B.strides();
+  const size_t m = a_shape[N - 2];
+  const size_t k = a_shape[N - 1];
+  const size_t n = b_shape[N - 1];
+  size_t batches = 1;
+  for (size_t i = 0; i + 2 < N; ++i) batches *= a_shape[i];
+  UTEC_PROFILE_SCOPE("matrix_product", 2 * batches * m * n * k);
+
+  // Independent batches are split across tasks first; each gemm can still split its own
+  // output tiles when there are fewer batches than threads.
+  const size_t batch_grain = std::max<size_t>(1, parallel::config().gemm_grain / std::max<size_t>(1, m * n * k));
+  parallel::parallel_for(0, batches, batch_grain, [&](size_t first, size_t last) {
+    for (size_t batch = first; batch < last; ++batch) {
+      size_t a_offset = 0;
+      size_t b_offset = 0;
+      for (size_t d = N - 2, rest = batch; d-- > 0;) {
+        const size_t idx = rest % a_shape[d];
+        rest /= a_shape[d];
+        a_offset += idx * as[d];
+        b_offset += idx * bs[d];
+      }
+      const T* a = A.data() + a_offset;
+      const T* b = B.data() + b_offset;
+      T* out = c + batch * m * n;
+
+      if constexpr (std::is_same_v<T, Acc> && (std::is_same_v<T, float> || std::is_same_v<T, double>)) {
+        gemm::gemm(m, n, k, a, as[N - 2], as[N - 1], b, bs[N - 2], bs[N - 1], out, n, false, epilogue);
+      } else if constexpr (std::is_same_v<Acc, float> || std::is_same_v<Acc, double>) {
+        auto& scratch = gemm::scratch_c<Acc>();
+        if (scratch.size() < m * n) scratch.resize(m * n);
+        Acc* wide = scratch.data();
+        gemm::gemm(m, n, k, a, as[N - 2], as[N - 1], b, bs[N - 2], bs[N - 1], wide, n);
+        for (size_t i = 0; i < m; ++i)
+          for (size_t j = 0; j < n; ++j) out[i * n + j] = T(epilogue(wide[i * n + j], j));
+      } else {
+        for (size_t i = 0; i < m; ++i) {
+          for (size_t j = 0; j < n; ++j) {
+            Acc sum = 0;
+            for (size_t p = 0; p < k; ++p) {
+              sum += Acc(a[i * as[N - 2] + p * as[N - 1]]) * Acc(b[p * bs[N - 2] + j * bs[N - 1]]);
+            }
+            out[i * n + j] = T(epilogue(sum, j));
+          }
+        }
+      }
+    }
+  });
+}
 
-  if constexpr (N < 2) {
-    throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
-  }
-
-  if (a_shape[N - 1] != b_shape[N - 2]) {
-    throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
-  }
+template<typename T, size_t N, typename Allocator = aligned_allocator<T>, typename Acc = accumulator_t<T>>
+Tensor<T, N, Allocator> matrix_product_views(const TensorView<const T, N>& A, const TensorView<const T, N>& B) {
+  Tensor<T, N, Allocator> result(matrix_product_shape(A.shape(), B.shape()));
+  matrix_product_into<T, N, gemm::identity_epilogue, Acc>(A, B, result.data());
+  return result;
+}
 
-  for (size_t i = 0; i < N - 2; ++i) {
-    if (a_shape[i] != b_shape[i]) {
-      throw std::runtime_error("Matrix dimensions are compatible for multiplication but batch dimensions do not match");
+// Evaluates the expression into a preallocated destination. A Tensor is reshaped to
+// the result shape (reusing its storage when it is large enough); a view must
+// already have a shape the result broadcasts to.
+template<typename T, size_t N, typename Allocator, typename E>
+void assign_to(Tensor<T, N, Allocator>& out, const tensor_expression<E>& expression) {
+  if (out.shape() != expression.derived().shape()) {
+    const bool aliases = expression.derived().may_alias(out.data(), out.shape(), contiguous_strides(out.shape()));
+    if (aliases) {
+      out = Tensor<T, N, Allocator>(expression);
+      return;
     }
+    out.reshape(expression.derived().shape());
   }
+  out = expression;
+}
+
+template<typename T, size_t N, typename E>
+void assign_to(const TensorView<T, N>& out, const tensor_expression<E>& expression) {
+  out.assign(expression.derived());
+}
 
-  std::array<size_t, N> result_shape = a_shape;
-  result_shape[N - 1] = b_shape[N - 1];
-  result_shape[N - 2] = a_shape[N - 2];
-
-  Tensor<T, N> result;
-  if constexpr (N == 2) {
-    result = Tensor<T, N>(result_shape[0], result_shape[1]);
-  } else if constexpr (N == 3) {
-    result = Tensor<T, N>(result_shape[0], result_shape[1], result_shape[2]);
-  } else if constexpr (N == 4) {
-    result = Tensor<T, N>(result_shape[0], result_shape[1], result_shape[2], result_shape[3]);
+template<typename X>
+auto const_view(const X& x) {
+  using T = operand_value_t<X>;
+  constexpr size_t N = operand_traits<std::remove_cvref_t<X>>::rank;
+  if constexpr (is_tensor_v<X>) {
+    return x.view();
+  } else {
+    return TensorView<const T, N>(x.data(), x.shape(), x.strides());
   }
+}
 
-  std::array<size_t, N> idx{};
-  std::array<size_t, N> a_idx{};
-  std::array<size_t, N> b_idx{};
+}
 
-  size_t total_elements = 1;
-  for (auto dim : result_shape) total_elements *= dim;
+template<typename T, size_t N, typename Allocator>
+Tensor<T, N, Allocator> matrix_product(const Tensor<T, N, Allocator>& A, const Tensor<T, N, Allocator>& B) {
+  return detail::matrix_product_views<T, N, Allocator>(A.view(), B.view());
+}
 
-  for (size_t i = 0; i < total_elements; ++i) {
-    size_t temp = i;
-    for (int d = N - 1; d >= 0; --d) {
-      idx[d] = temp % result_shape[d];
-      temp /= result_shape[d];
-    }
+// matrix_product accumulating in Acc rather than accumulator_t<T>, e.g.
+// matrix_product<double>(a, b) for float tensors. The result keeps the operands' type.
+template<typename Acc, typename T, size_t N, typename Allocator>
+  requires (!std::is_same_v<Acc, T>)
+Tensor<T, N, Allocator> matrix_product(const Tensor<T, N, Allocator>& A, const Tensor<T, N, Allocator>& B) {
+  return detail::matrix_product_views<T, N, Allocator, Acc>(A.view(), B.view());
+}
 
-    T sum = 0;
-    for (size_t k = 0; k < a_shape[N - 1]; ++k) {
-      for (size_t d = 0; d < N; ++d) {
-        a_idx[d] = idx[d];
-        b_idx[d] = idx[d];
-      }
-      a_idx[N - 1] = k;
-      b_idx[N - 2] = k;
-
-      if constexpr (N == 2) {
-        sum += A(a_idx[0], a_idx[1]) * B(b_idx[0], b_idx[1]);
-      } else if constexpr (N == 3) {
-        sum += A(a_idx[0], a_idx[1], a_idx[2]) * B(b_idx[0], b_idx[1], b_idx[2]);
-      } else if constexpr (N == 4) {
-        sum += A(a_idx[0], a_idx[1], a_idx[2], a_idx[3]) * B(b_idx[0], b_idx[1], b_idx[2], b_idx[3]);
-      }
-    }
+// Converts every element to U (rounding to the nearest 16-bit value when U is bfloat16
+// or float16), vectorized between float and the 16-bit types.
+template<typename U, typename T, size_t N, typename Allocator>
+Tensor<U, N> convert(const Tensor<T, N, Allocator>& input) {
+  UTEC_PROFILE_SCOPE("convert", 0);
+  Tensor<U, N> result(input.shape());
+  half::convert(input.size(), input.data(), result.data());
+  return result;
+}
 
-    if constexpr (N == 2) {
-      result(idx[0], idx[1]) = sum;
-    } else if constexpr (N == 3) {
-      result(idx[0], idx[1], idx[2]) = sum;
-    } else if constexpr (N == 4) {
-      result(idx[0], idx[1], idx[2], idx[3]) = sum;
-    }
+template<typename T, size_t N, typename Allocator, typename U, typename OtherAllocator>
+void convert(const Tensor<T, N, Allocator>& input, Tensor<U, N, OtherAllocator>& out) {
+  UTEC_PROFILE_SCOPE("convert", 0);
+  if (out.shape() != input.shape()) out.reshape(input.shape());
+  half::convert(input.size(), input.data(), out.data());
+}
+
+template<typename E>
+auto transpose_2d(const tensor_expression<E>& expression) {
+  return transpose_2d(expression.eval());
+}
+
+template<typename Out>
+concept tensor_output = is_tensor_v<Out> || (is_tensor_view_v<Out> && !std::is_const_v<typename std::remove_cvref_t<Out>::element_type>);
+
+// Out-parameter forms of the arithmetic operators. Operands can be tensors, views,
+// expressions or scalars; `out` is reused so a steady-state loop does not allocate.
+template<typename A, typename B, tensor_output Out>
+void add(const A& a, const B& b, Out&& out) { detail::assign_to(out, a + b); }
+
+template<typename A, typename B, tensor_output Out>
+void subtract(const A& a, const B& b, Out&& out) { detail::assign_to(out, a - b); }
+
+template<typename A, typename B, tensor_output Out>
+void multiply(const A& a, const B& b, Out&& out) { detail::assign_to(out, a * b); }
+
+template<typename A, typename B, tensor_output Out>
+void divide(const A& a, const B& b, Out&& out) { detail::assign_to(out, a / b); }
+
+// matrix_product writing into a preallocated destination, which must not overlap A or B,
+// with sums accumulated in Acc (see detail::matrix_product_into).
+// epilogue(value, column) post-processes every output value while its tile is still in
+// registers; value is a single element or a simd::packet of consecutive columns starting
+// at `column`, so the functor must accept both (see gemm::identity_epilogue).
+template<typename Acc, tensor_operand A, tensor_operand B, tensor_output Out,
+         typename Epilogue = gemm::identity_epilogue>
+  requires (!tensor_operand<Acc> && !is_expression_v<A> && !is_expression_v<B>)
+void matrix_product(const A& a, const B& b, Out&& out, const Epilogue& epilogue = {}) {
+  using T = detail::operand_value_t<A>;
+  constexpr size_t N = detail::operand_traits<std::remove_cvref_t<A>>::rank;
+  static_assert(std::is_same_v<T, detail::operand_value_t<B>>, "Tensor operands must have the same value type");
+  static_assert(std::is_same_v<T, detail::operand_value_t<Out>>, "Output must have the operands' value type");
+
+  const auto av = detail::const_view(a);
+  const auto bv = detail::const_view(b);
+  const auto shape = detail::matrix_product_shape(av.shape(), bv.shape());
+  if constexpr (is_tensor_v<Out>) {
+    if (out.shape() != shape) out.reshape(shape);
+  } else {
+    if (out.shape() != shape || !out.is_contiguous())
+      throw std::runtime_error("Output view must be contiguous and match the product shape");
   }
 
-  return result;
+  const auto strides = detail::contiguous_strides(shape);
+  if (detail::regions_alias<T, N>(out.data(), shape, strides, av.data(), av.shape(), av.strides()) ||
+      detail::regions_alias<T, N>(out.data(), shape, strides, bv.data(), bv.shape(), bv.strides()) ||
+      (out.data() == av.data() && av.size() > 0) || (out.data() == bv.data() && bv.size() > 0))
+    throw std::runtime_error("Output tensor must not overlap the operands");
+  detail::matrix_product_into<T, N, Epilogue, Acc>(av, bv, out.data(), epilogue);
+}
+
+template<tensor_operand A, tensor_operand B, tensor_output Out, typename Epilogue = gemm::identity_epilogue>
+  requires (!is_expression_v<A> && !is_expression_v<B>)
+void matrix_product(const A& a, const B& b, Out&& out, const Epilogue& epilogue = {}) {
+  matrix_product<accumulator_t<detail::operand_value_t<A>>>(a, b, std::forward<Out>(out), epilogue);
+}
+
+// Any mix of tensors, views and expressions; expressions are materialized first.
+template<tensor_operand A, tensor_operand B>
+  requires (!(is_tensor_v<A> && is_tensor_v<B> && std::is_same_v<std::remove_cvref_t<A>, std::remove_cvref_t<B>>))
+auto matrix_product(const A& a, const B& b) {
+  using T = detail::operand_value_t<A>;
+  constexpr size_t N = detail::operand_traits<std::remove_cvref_t<A>>::rank;
+  static_assert(std::is_same_v<T, detail::operand_value_t<B>>, "Tensor operands must have the same value type");
+  if constexpr (is_expression_v<A>) {
+    const Tensor<T, N> a_value(a);
+    return matrix_product(a_value, b);
+  } else if constexpr (is_expression_v<B>) {
+    const Tensor<T, N> b_value(b);
+    return matrix_product(a, b_value);
+  } else {
+    return detail::matrix_product_views<T, N>(detail::const_view(a), detail::const_view(b));
+  }
+}
+
+template<typename T, size_t N, typename Allocator>
+TensorView<T, N> transpose_view(Tensor<T, N, Allocator>& tensor) {
+  return tensor.transpose_view();
+}
+
+template<typename T, size_t N, typename Allocator>
+TensorView<const T, N> transpose_view(const Tensor<T, N, Allocator>& tensor) {
+  return tensor.transpose_view();
 }
 
 }
@@ -0,0 +1,139 @@
+//
+// Non-owning strided view over tensor storage.
+//
+
+#ifndef TENSOR_VIEW_H
+#define TENSOR_VIEW_H
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "utec/algebra/expression.h"
+
+namespace utec::algebra {
+
+// Pointer + shape + strides (in elements). Transposes, slices and reshapes of a view
+// only rewrite the metadata; the viewed storage must outlive the view.
+template<typename T, size_t N>
+class TensorView {
+ private:
+  T* data_ = nullptr;
+  std::array<size_t, N> shape_{};
+  std::array<size_t, N> strides_{};
+
+ public:
+  using value_type = std::remove_const_t<T>;
+  using element_type = T;
+
+  TensorView() = default;
+
+  TensorView(T* data, const std::array<size_t, N>& shape, const std::array<size_t, N>& strides)
+      : data_(data), shape_(shape), strides_(strides) {}
+
+  TensorView(T* data, const std::array<size_t, N>& shape)
+      : data_(data), shape_(shape), strides_(detail::contiguous_strides(shape)) {}
+
+  template<typename U>
+    requires (std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+  TensorView(const TensorView<U, N>& other) : data_(other.data()), shape_(other.shape()), strides_(other.strides()) {}
+
+  T* data() const { return data_; }
+  const std::array<size_t, N>& shape() const { return shape_; }
+  const std::array<size_t, N>& strides() const { return strides_; }
+  size_t size() const { return detail::shape_size(shape_); }
+
+  bool is_contiguous() const {
+    size_t stride = 1;
+    for (size_t d = N; d-- > 0;) {
+      if (shape_[d] != 1 && strides_[d] != stride) return false;
+      stride *= shape_[d];
+    }
+    return true;
+  }
+
+  template<typename... Indices>
+  T& operator()(Indices... indices) const {
+    static_assert(sizeof...(Indices) == N, "Access must use N indices");
+    const std::array<size_t, N> idx = {static_cast<size_t>(indices)...};
+    size_t offset = 0;
+    for (size_t d = 0; d < N; ++d) offset += idx[d] * strides_[d];
+    return data_[offset];
+  }
+
+  TensorView<T, N> transposed() const {
+    static_assert(N >= 2, "Cannot transpose 1D tensor: need at least 2 dimensions");
+    TensorView<T, N> result = *this;
+    std::swap(result.shape_[N - 1], result.shape_[N - 2]);
+    std::swap(result.strides_[N - 1], result.strides_[N - 2]);
+    return result;
+  }
+
+  // Elements [begin, end) along `axis`; the rank is preserved.
+  TensorView<T, N> slice(size_t axis, size_t begin, size_t end) const {
+    if (axis >= N || begin > end || end > shape_[axis])
+      throw std::out_of_range("Slice is out of the tensor bounds");
+    TensorView<T, N> result = *this;
+    result.data_ = data_ + begin * strides_[axis];
+    result.shape_[axis] = end - begin;
+    return result;
+  }
+
+  // The sub-tensor at `index` along `axis`, with that axis removed.
+  TensorView<T, N - 1> select(size_t axis, size_t index) const {
+    static_assert(N >= 2, "Cannot select from a 1D tensor");
+    if (axis >= N || index >= shape_[axis])
+      throw std::out_of_range("Index is out of the tensor bounds");
+    std::array<size_t, N - 1> shape{};
+    std::array<size_t, N - 1> strides{};
+    for (size_t d = 0, k = 0; d < N; ++d) {
+      if (d == axis) continue;
+      shape[k] = shape_[d];
+      strides[k++] = strides_[d];
+    }
+    return TensorView<T, N - 1>(data_ + index * strides_[axis], shape, strides);
+  }
+
+  template<typename... Dims>
+  TensorView<T, sizeof...(Dims)> reshape(Dims... dims) const {
+    constexpr size_t M = sizeof...(Dims);
+    const std::array<size_t, M> shape = {static_cast<size_t>(dims)...};
+    if (detail::shape_size(shape) != size())
+      throw std::runtime_error("Reshape must preserve the number of elements");
+    if (!is_contiguous())
+      throw std::runtime_error("Only contiguous views can be reshaped without copying");
+    return TensorView<T, M>(data_, shape);
+  }
+
+  // Writes a Tensor, view or expression (broadcast to this shape) into the viewed elements.
+  template<tensor_operand X>
+  const TensorView& assign(X&& source) const {
+    static_assert(!std::is_const_v<T>, "Cannot assign through a view of const elements");
+    auto expression = detail::as_expression(std::forward<X>(source));
+    if (broadcast_shape(shape_, expression.shape()) != shape_ || !can_broadcast(shape_, expression.shape()))
+      throw std::runtime_error("Shapes do not match and they are not compatible for broadcasting");
+    if (expression.may_alias(data_, shape_, strides_)) {
+      const Tensor<value_type, N> copy(expression);
+      evaluate(detail::as_expression(copy), data_, shape_, strides_);
+    } else {
+      evaluate(expression, data_, shape_, strides_);
+    }
+    return *this;
+  }
+
+  void fill(const value_type& value) const { assign(scalar_expression<value_type, N>(value)); }
+};
+
+template<typename T, size_t N>
+TensorView<T, N> transpose_view(const TensorView<T, N>& view) {
+  return view.transposed();
+}
+
+}
+
+#endif //TENSOR_VIEW_H
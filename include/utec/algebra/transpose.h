@@ -0,0 +1,134 @@
+//
+// Blocked matrix transpose with an in-register micro-transpose.
+//
+
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/simd.h"
+
+namespace utec::algebra::transpose {
+
+// Side of the cache tile. A 32 x 32 source block and its destination block take 8 KB
+// for 4-byte elements, so both stay in L1 even when power-of-two row strides map all
+// their lines to the same few sets; each line is then fetched once per tile.
+inline constexpr size_t tile = 32;
+
+// Register width used for the micro-transpose of T: at most 16 lanes (16 registers
+// per micro tile), and 0 when T is not vectorizable or a packet holds a single lane.
+template<typename T, size_t Bytes>
+constexpr size_t micro_bytes() {
+  if constexpr (!simd::is_vectorizable_v<T>) {
+    return 0;
+  } else {
+    const size_t bytes = std::min(Bytes, 16 * sizeof(T));
+    return bytes / sizeof(T) >= 2 ? bytes : 0;
+  }
+}
+
+// Transposes one L x L block (L = lanes) held in L registers. Each of the log2(L)
+// rounds interleaves register k with register k + L/2 (a perfect shuffle of the rows).
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void micro_transpose(const T* src, size_t lds, T* dst, size_t ldd) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  P r[L];
+  for (size_t i = 0; i < L; ++i) r[i] = P::load(src + i * lds);
+  for (size_t round = L; round > 1; round /= 2) {
+    P t[L];
+    for (size_t k = 0; k < L / 2; ++k) {
+      t[2 * k] = simd::interleave_low(r[k], r[k + L / 2]);
+      t[2 * k + 1] = simd::interleave_high(r[k], r[k + L / 2]);
+    }
+    for (size_t i = 0; i < L; ++i) r[i] = t[i];
+  }
+  for (size_t i = 0; i < L; ++i) r[i].store(dst + i * ldd);
+}
+
+// dst[j, i] = src[i, j] for a rows x cols block of at most tile x tile elements.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void transpose_tile(size_t rows, size_t cols, const T* src, size_t lds, T* dst, size_t ldd) {
+  size_t i = 0;
+  if constexpr (micro_bytes<T, Bytes>() > 0) {
+    constexpr size_t L = simd::packet<T, micro_bytes<T, Bytes>()>::lanes;
+    for (; i + L <= rows; i += L) {
+      size_t j = 0;
+      for (; j + L <= cols; j += L)
+        micro_transpose<T, micro_bytes<T, Bytes>()>(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+      for (; j < cols; ++j)
+        for (size_t r = i; r < i + L; ++r) dst[j * ldd + r] = src[r * lds + j];
+    }
+  }
+  for (; i < rows; ++i)
+    for (size_t j = 0; j < cols; ++j) dst[j * ldd + i] = src[i * lds + j];
+}
+
+// All tiles of one band: source columns [c0, c1), i.e. destination rows [c0, c1).
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void transpose_band(size_t rows, size_t c0, size_t c1, const T* src, size_t lds, T* dst,
+                                       size_t ldd) {
+  for (size_t i = 0; i < rows; i += tile)
+    transpose_tile<T, Bytes>(std::min(tile, rows - i), c1 - c0, src + i * lds + c0, lds, dst + c0 * ldd + i, ldd);
+}
+
+template<typename T>
+using band_kernel = void (*)(size_t, size_t, size_t, const T*, size_t, T*, size_t);
+
+template<typename T>
+void transpose_band_native(size_t rows, size_t c0, size_t c1, const T* src, size_t lds, T* dst, size_t ldd) {
+  transpose_band<T, simd::native_bytes>(rows, c0, c1, src, lds, dst, ldd);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T>
+UTEC_TARGET_AVX2 void transpose_band_avx2(size_t rows, size_t c0, size_t c1, const T* src, size_t lds, T* dst,
+                                          size_t ldd) {
+  transpose_band<T, 32>(rows, c0, c1, src, lds, dst, ldd);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 void transpose_band_avx512(size_t rows, size_t c0, size_t c1, const T* src, size_t lds, T* dst,
+                                              size_t ldd) {
+  transpose_band<T, 64>(rows, c0, c1, src, lds, dst, ldd);
+}
+#endif
+
+template<typename T>
+band_kernel<T> select_band_kernel() {
+  if constexpr (simd::is_vectorizable_v<T>)
+    return dispatch::select(&transpose_band_native<T>
+                            UTEC_DISPATCH_VARIANTS(, &transpose_band_avx2<T>, &transpose_band_avx512<T>));
+  else
+    return &transpose_band_native<T>;
+}
+
+// dst (cols x rows, row stride ldd) = transpose of each of `batches` rows x cols slices
+// of src (row stride lds, unit column stride); slice b starts at src + b * src_batch and
+// dst + b * dst_batch. Tile-wide column bands of every slice are spread across threads.
+template<typename T>
+void transpose(size_t batches, size_t rows, size_t cols,
+               const T* src, size_t lds, size_t src_batch,
+               T* dst, size_t ldd, size_t dst_batch) {
+  if (batches == 0 || rows == 0 || cols == 0) return;
+  const band_kernel<T> kernel = select_band_kernel<T>();
+  const size_t bands = (cols + tile - 1) / tile;
+  const size_t grain = std::max<size_t>(1, parallel::grain_size() / (rows * tile));
+  parallel::parallel_for(0, batches * bands, grain, [&](size_t first, size_t last) {
+    for (size_t t = first; t < last; ++t) {
+      const size_t b = t / bands;
+      const size_t c0 = (t % bands) * tile;
+      kernel(rows, c0, std::min(cols, c0 + tile), src + b * src_batch, lds, dst + b * dst_batch, ldd);
+    }
+  });
+}
+
+}
+
+#endif //TRANSPOSE_H
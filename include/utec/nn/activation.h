@@ -5,4 +5,148 @@
 #ifndef ACTIVATION_H
 #define ACTIVATION_H
 
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+#include "utec/algebra/simd.h"
+#include "utec/nn/graph.h"
+#include "utec/nn/inference.h"
+#include "utec/nn/layer.h"
+#include "utec/nn/quantized_network.h"
+
+namespace utec::neural_network {
+
+namespace detail {
+
+template<typename T, typename Activation>
+const Tensor<T, 2>& activation_forward(const Tensor<T, 2>& input, Tensor<T, 2>& output) {
+  UTEC_PROFILE_SCOPE("activation.forward", input.size());
+  resize(output, input.shape());
+  const T* x = input.data();
+  T* y = output.data();
+  for (size_t i = 0; i < input.size(); ++i) y[i] = Activation::activate(x[i]);
+  return output;
+}
+
+template<typename T, typename Activation>
+const Tensor<T, 2>& activation_backward(const Tensor<T, 2>& grad_output, const Tensor<T, 2>& output,
+                                        Tensor<T, 2>& grad_input) {
+  UTEC_PROFILE_SCOPE("activation.backward", 2 * output.size());
+  if (grad_output.shape() != output.shape())
+    throw std::runtime_error("Gradient shape does not match the layer output");
+  resize(grad_input, output.shape());
+  const T* g = grad_output.data();
+  const T* y = output.data();
+  T* dx = grad_input.data();
+  for (size_t i = 0; i < output.size(); ++i) dx[i] = g[i] * Activation::derivative(y[i]);
+  return grad_input;
+}
+
+}
+
+// Each activation is both a standalone layer and the policy type Dense fuses into its
+// GEMM epilogue. activate() accepts a scalar or a simd::packet; derivative() is written
+// in terms of the activation's output y, which is what the layers keep for backward.
+
+template<typename T>
+class Identity final : public ILayer<T> {
+ public:
+  template<typename V>
+  static UTEC_ALWAYS_INLINE V activate(const V& x) { return x; }
+
+  static T derivative(const T&) { return T{1}; }
+
+  const Tensor<T, 2>& forward(const Tensor<T, 2>& input) override { return input; }
+  const Tensor<T, 2>& backward(const Tensor<T, 2>& grad_output) override { return grad_output; }
+
+  void freeze_into(FrozenNetwork<T>&) const override {}
+
+  void quantize_into(QuantizedNetwork<T>&) const override {}
+
+  size_t capture_into(Graph<T>&, size_t input) override { return input; }
+
+  std::unique_ptr<ILayer<T>> clone() const override { return std::make_unique<Identity>(*this); }
+};
+
+template<typename T>
+class ReLU final : public ILayer<T> {
+ private:
+  Tensor<T, 2> output_;
+  Tensor<T, 2> grad_input_;
+
+ public:
+  template<typename V>
+  static UTEC_ALWAYS_INLINE V activate(const V& x) {
+    if constexpr (algebra::simd::is_packet_v<V>) {
+      return algebra::simd::max(x, V::zero());
+    } else {
+      return x > V{0} ? x : V{0};
+    }
+  }
+
+  static T derivative(const T& y) { return y > T{0} ? T{1} : T{0}; }
+
+  const Tensor<T, 2>& forward(const Tensor<T, 2>& input) override {
+    return detail::activation_forward<T, ReLU>(input, output_);
+  }
+
+  const Tensor<T, 2>& backward(const Tensor<T, 2>& grad_output) override {
+    return detail::activation_backward<T, ReLU>(grad_output, output_, grad_input_);
+  }
+
+  void freeze_into(FrozenNetwork<T>& frozen) const override { frozen.template add_activation<ReLU>(); }
+
+  void quantize_into(QuantizedNetwork<T>& quantized) const override { quantized.template add_activation<ReLU>(); }
+
+  size_t capture_into(Graph<T>& graph, size_t input) override {
+    return neural_network::activate<ReLU>(GraphValue<T>{&graph, input}).id;
+  }
+
+  std::unique_ptr<ILayer<T>> clone() const override { return std::make_unique<ReLU>(*this); }
+};
+
+template<typename T>
+class Sigmoid final : public ILayer<T> {
+ private:
+  Tensor<T, 2> output_;
+  Tensor<T, 2> grad_input_;
+
+ public:
+  template<typename V>
+  static UTEC_ALWAYS_INLINE V activate(const V& x) {
+    if constexpr (algebra::simd::is_packet_v<V>) {
+      return V::broadcast(T{1}) / (V::broadcast(T{1}) + algebra::simd::exp(V::zero() - x));
+    } else {
+      return V{1} / (V{1} + std::exp(-x));
+    }
+  }
+
+  static T derivative(const T& y) { return y * (T{1} - y); }
+
+  const Tensor<T, 2>& forward(const Tensor<T, 2>& input) override {
+    return detail::activation_forward<T, Sigmoid>(input, output_);
+  }
+
+  const Tensor<T, 2>& backward(const Tensor<T, 2>& grad_output) override {
+    return detail::activation_backward<T, Sigmoid>(grad_output, output_, grad_input_);
+  }
+
+  void freeze_into(FrozenNetwork<T>& frozen) const override { frozen.template add_activation<Sigmoid>(); }
+
+  void quantize_into(QuantizedNetwork<T>& quantized) const override {
+    quantized.template add_activation<Sigmoid>();
+  }
+
+  size_t capture_into(Graph<T>& graph, size_t input) override {
+    return neural_network::activate<Sigmoid>(GraphValue<T>{&graph, input}).id;
+  }
+
+  std::unique_ptr<ILayer<T>> clone() const override { return std::make_unique<Sigmoid>(*this); }
+};
+
+}
+
 #endif //ACTIVATION_H
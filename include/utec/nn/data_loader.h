@@ -0,0 +1,228 @@
+//
+// Streaming minibatch reader over binary tensor files, double-buffered.
+//
+
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utec/algebra/serialization.h"
+#include "utec/algebra/tensor.h"
+
+namespace utec::neural_network {
+
+using algebra::Tensor;
+
+// One minibatch: rows of the inputs file and the matching rows of the targets file.
+template<typename T>
+struct Batch {
+  Tensor<T, 2> inputs;
+  Tensor<T, 2> targets;
+
+  size_t rows() const { return inputs.shape()[0]; }
+};
+
+// Reads (samples, features) inputs and (samples, outputs) targets saved with
+// Tensor::save, chunk by chunk, so the files never have to fit in memory. A background
+// thread fills one of two reusable Batch buffers while the caller trains on the other.
+//
+// Shuffling uses a window of `window` rows: every output row is drawn uniformly from
+// the window, and its slot is refilled with the next row of the file. Each batch makes
+// the producer read exactly one batch of new rows, so the I/O cost is the same for
+// every step. window = 0 keeps the file order.
+template<typename T>
+class DataLoader {
+ private:
+  struct source {
+    std::ifstream file;
+    std::string path;
+    size_t offset = 0;
+    size_t samples = 0;
+    size_t width = 0;
+
+    explicit source(const std::string& p) : file(p, std::ios::binary | std::ios::ate), path(p) {
+      if (!file) throw std::runtime_error("Cannot open " + path);
+      const size_t size = size_t(file.tellg());
+      std::vector<std::byte> header(std::min(size, algebra::serialization::data_offset(2)));
+      file.seekg(0);
+      file.read(reinterpret_cast<char*>(header.data()), std::streamsize(header.size()));
+      const auto shape = algebra::serialization::parse<T, 2>(header.data(), size);
+      offset = algebra::serialization::data_offset(2);
+      samples = shape[0];
+      width = shape[1];
+    }
+
+    void rewind() {
+      file.clear();
+      file.seekg(std::streamoff(offset));
+    }
+
+    void read(size_t rows, T* out) {
+      file.read(reinterpret_cast<char*>(out), std::streamsize(rows * width * sizeof(T)));
+      if (!file) throw std::runtime_error("Cannot read " + path);
+    }
+  };
+
+  source inputs_;
+  source targets_;
+  size_t batch_size_;
+  size_t window_;
+  std::mt19937 engine_;
+
+  // Producer-side state: the shuffle window and the rows read but not yet moved into it.
+  Tensor<T, 2> window_inputs_;
+  Tensor<T, 2> window_targets_;
+  Tensor<T, 2> chunk_inputs_;
+  Tensor<T, 2> chunk_targets_;
+  size_t filled_ = 0;
+  size_t read_ = 0;
+
+  Batch<T> slots_[2];
+  bool ready_[2] = {false, false};
+  bool end_[2] = {false, false};
+  size_t consumer_slot_ = 0;
+  bool holding_ = false;
+  std::exception_ptr error_;
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread producer_;
+
+  void start_epoch() {
+    inputs_.rewind();
+    targets_.rewind();
+    read_ = std::min(window_, inputs_.samples);
+    filled_ = read_;
+    inputs_.read(read_, window_inputs_.data());
+    targets_.read(read_, window_targets_.data());
+  }
+
+  static void copy_row(const Tensor<T, 2>& from, size_t i, Tensor<T, 2>& to, size_t j) {
+    const size_t width = from.shape()[1];
+    std::copy_n(from.data() + i * width, width, to.data() + j * width);
+  }
+
+  // Fills batch with the next rows of the epoch; returns false once it is exhausted.
+  bool produce(Batch<T>& batch) {
+    const size_t fresh = std::min(batch_size_, inputs_.samples - read_);
+    const size_t rows = window_ == 0 ? fresh : std::min(batch_size_, filled_ + fresh);
+    if (rows == 0) return false;
+    batch.inputs.reshape(rows, inputs_.width);
+    batch.targets.reshape(rows, targets_.width);
+    if (window_ == 0) {
+      inputs_.read(rows, batch.inputs.data());
+      targets_.read(rows, batch.targets.data());
+      read_ += rows;
+      return true;
+    }
+    chunk_inputs_.reshape(std::max<size_t>(fresh, 1), inputs_.width);
+    chunk_targets_.reshape(std::max<size_t>(fresh, 1), targets_.width);
+    inputs_.read(fresh, chunk_inputs_.data());
+    targets_.read(fresh, chunk_targets_.data());
+    read_ += fresh;
+    for (size_t i = 0; i < rows; ++i) {
+      const size_t slot = std::uniform_int_distribution<size_t>(0, filled_ - 1)(engine_);
+      copy_row(window_inputs_, slot, batch.inputs, i);
+      copy_row(window_targets_, slot, batch.targets, i);
+      if (i < fresh) {
+        copy_row(chunk_inputs_, i, window_inputs_, slot);
+        copy_row(chunk_targets_, i, window_targets_, slot);
+      } else {
+        --filled_;
+        copy_row(window_inputs_, filled_, window_inputs_, slot);
+        copy_row(window_targets_, filled_, window_targets_, slot);
+      }
+    }
+    return true;
+  }
+
+  void run() {
+    try {
+      start_epoch();
+      for (size_t slot = 0;; slot ^= 1) {
+        {
+          std::unique_lock lock(mutex_);
+          changed_.wait(lock, [&] { return stop_ || !ready_[slot]; });
+          if (stop_) return;
+        }
+        const bool more = produce(slots_[slot]);
+        if (!more) start_epoch();
+        {
+          std::lock_guard lock(mutex_);
+          end_[slot] = !more;
+          ready_[slot] = true;
+        }
+        changed_.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      error_ = std::current_exception();
+      ready_[0] = ready_[1] = true;
+      changed_.notify_all();
+    }
+  }
+
+ public:
+  DataLoader(const std::string& inputs_path, const std::string& targets_path, size_t batch_size,
+             size_t window = 0, unsigned seed = 42)
+      : inputs_(inputs_path), targets_(targets_path), batch_size_(batch_size), window_(window), engine_(seed),
+        window_inputs_(std::max<size_t>(window, 1), inputs_.width),
+        window_targets_(std::max<size_t>(window, 1), targets_.width) {
+    if (inputs_.samples != targets_.samples)
+      throw std::runtime_error("Inputs and targets have a different number of samples");
+    if (batch_size == 0) throw std::runtime_error("Batch size must be positive");
+    producer_ = std::thread([this] { run(); });
+  }
+
+  DataLoader(const DataLoader&) = delete;
+  DataLoader& operator=(const DataLoader&) = delete;
+
+  ~DataLoader() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    producer_.join();
+  }
+
+  size_t samples() const { return inputs_.samples; }
+  size_t features() const { return inputs_.width; }
+  size_t outputs() const { return targets_.width; }
+  size_t batch_size() const { return batch_size_; }
+
+  // The next minibatch, valid until the following call, or nullptr at the end of an
+  // epoch; the call after that starts the next epoch. Only waits when the producer has
+  // not finished the batch yet. Rethrows errors from the reader thread.
+  const Batch<T>* next() {
+    UTEC_PROFILE_SCOPE("DataLoader.next", 0);
+    std::unique_lock lock(mutex_);
+    if (holding_) {
+      ready_[consumer_slot_] = false;
+      consumer_slot_ ^= 1;
+      holding_ = false;
+      changed_.notify_all();
+    }
+    changed_.wait(lock, [&] { return ready_[consumer_slot_] || error_; });
+    if (error_) std::rethrow_exception(error_);
+    holding_ = true;
+    return end_[consumer_slot_] ? nullptr : &slots_[consumer_slot_];
+  }
+};
+
+}
+
+#endif //DATA_LOADER_H
@@ -0,0 +1,169 @@
+//
+// Data-parallel minibatch training of a NeuralNetwork across threads.
+//
+
+#ifndef DATA_PARALLEL_H
+#define DATA_PARALLEL_H
+
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "utec/algebra/parallel.h"
+#include "utec/nn/neural_network.h"
+
+namespace utec::neural_network {
+
+// Trains a NeuralNetwork with each minibatch split into contiguous row shards, one per
+// worker. Worker 0 runs the network's own layers and every other worker a clone, each
+// with its own activation, gradient and minibatch buffers. After the shards' backward
+// passes, the gradients are reduced into the network's gradient buffers: every thread
+// owns a disjoint element range of each parameter and sums the workers' values for it
+// in one pass, so the reduction takes no locks and no intermediate rounds. The
+// optimizer then steps the network, and each replica copies the current weights at the
+// start of every shard.
+//
+// Shard gradients are weighted by their share of the minibatch rows, which matches a
+// single-threaded step for losses that average over samples (such as MSELoss).
+template<typename T>
+class DataParallelTrainer {
+ private:
+  struct replica {
+    std::vector<std::unique_ptr<ILayer<T>>> owned;
+    std::vector<ILayer<T>*> layers;
+    std::vector<parameter<T>> parameters;
+    Tensor<T, 2> input;
+    Tensor<T, 2> target;
+    size_t first = 0;
+    size_t rows = 0;
+    T loss{0};
+  };
+
+  NeuralNetwork<T>& network_;
+  std::vector<replica> replicas_;
+  std::vector<size_t> order_;
+  std::mt19937 engine_;
+  std::any losses_;  // one Loss per worker, kept across train calls
+
+  template<template<typename> class Loss>
+  std::vector<Loss<T>>& losses_for() {
+    if (auto* losses = std::any_cast<std::vector<Loss<T>>>(&losses_)) return *losses;
+    return losses_.template emplace<std::vector<Loss<T>>>(replicas_.size());
+  }
+
+  template<typename Loss>
+  void run_shard(replica& r, Loss& loss, const Tensor<T, 2>& X, const Tensor<T, 2>& Y, bool sync) {
+    if (sync) {
+      for (size_t p = 0; p < r.parameters.size(); ++p) {
+        const Tensor<T, 2>& source = *network_.parameters()[p].value;
+        std::copy(source.begin(), source.end(), r.parameters[p].value->begin());
+      }
+    }
+    detail::gather_rows(X, order_, r.first, r.rows, r.input);
+    detail::gather_rows(Y, order_, r.first, r.rows, r.target);
+    const Tensor<T, 2>* current = &r.input;
+    for (auto* layer : r.layers) current = &layer->forward(*current);
+    r.loss = loss.compute(*current, r.target);
+    const Tensor<T, 2>* gradient = &loss.gradient();
+    for (size_t i = r.layers.size(); i-- > 0;) gradient = &r.layers[i]->backward(*gradient);
+  }
+
+  // network gradient = sum over active workers of (rows_w / count) * gradient_w.
+  void reduce(size_t shards, size_t count) {
+    const auto& master = network_.parameters();
+    for (size_t p = 0; p < master.size(); ++p) {
+      T* out = master[p].gradient->data();
+      algebra::parallel::parallel_for(0, master[p].gradient->size(), algebra::parallel::grain_size(),
+                                      [&](size_t first, size_t last) {
+        const T scale0 = T(replicas_[0].rows) / T(count);
+        for (size_t e = first; e < last; ++e) out[e] *= scale0;
+        for (size_t w = 1; w < shards; ++w) {
+          const T scale = T(replicas_[w].rows) / T(count);
+          const T* in = replicas_[w].parameters[p].gradient->data();
+          for (size_t e = first; e < last; ++e) out[e] += scale * in[e];
+        }
+      });
+    }
+  }
+
+  template<typename Loss, typename Optimizer>
+  T fit(std::vector<Loss>& losses, Optimizer& optimizer, const Tensor<T, 2>& X, const Tensor<T, 2>& Y,
+        size_t epochs, size_t batch_size) {
+    if (X.shape()[0] != Y.shape()[0])
+      throw std::runtime_error("Inputs and targets have a different number of samples");
+    if (batch_size == 0) throw std::runtime_error("Batch size must be positive");
+
+    const size_t samples = X.shape()[0];
+    for (auto& r : replicas_) r.layers.front()->set_input_gradient(false);
+    detail::prepare_order(order_, samples);
+
+    T epoch_loss{0};
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+      std::shuffle(order_.begin(), order_.end(), engine_);
+      epoch_loss = T{0};
+      for (size_t first = 0; first < samples; first += batch_size) {
+        const size_t count = std::min(batch_size, samples - first);
+        const size_t shards = std::min(replicas_.size(), count);
+        for (size_t w = 0; w < shards; ++w) {
+          replicas_[w].first = first + count * w / shards;
+          replicas_[w].rows = first + count * (w + 1) / shards - replicas_[w].first;
+        }
+        algebra::parallel::parallel_for(0, shards, 1, [&](size_t w0, size_t w1) {
+          for (size_t w = w0; w < w1; ++w) run_shard(replicas_[w], losses[w], X, Y, w > 0);
+        });
+        reduce(shards, count);
+        optimizer.step(network_.parameters());
+        for (size_t w = 0; w < shards; ++w) epoch_loss += replicas_[w].loss * T(replicas_[w].rows);
+      }
+      epoch_loss /= T(std::max<size_t>(1, samples));
+    }
+    return epoch_loss;
+  }
+
+ public:
+  explicit DataParallelTrainer(NeuralNetwork<T>& network, size_t workers = algebra::parallel::num_threads(),
+                               unsigned seed = 42)
+      : network_(network), replicas_(std::max<size_t>(1, workers)), engine_(seed) {
+    if (network.num_layers() == 0) throw std::runtime_error("NeuralNetwork has no layers");
+    for (size_t i = 0; i < network.num_layers(); ++i) replicas_[0].layers.push_back(&network.layer(i));
+    replicas_[0].parameters = network.parameters();
+    for (size_t w = 1; w < replicas_.size(); ++w) {
+      replica& r = replicas_[w];
+      for (size_t i = 0; i < network.num_layers(); ++i) {
+        r.owned.push_back(network.layer(i).clone());
+        r.layers.push_back(r.owned.back().get());
+        auto layer_parameters = r.layers.back()->parameters();
+        r.parameters.insert(r.parameters.end(), layer_parameters.begin(), layer_parameters.end());
+      }
+    }
+  }
+
+  size_t num_workers() const { return replicas_.size(); }
+
+  // Same contract as NeuralNetwork::train, stepping the network's optimizer (see
+  // NeuralNetwork::use_optimizer), so its state carries over between calls and to the
+  // network's own train. Minibatches with fewer rows than workers use one worker per
+  // row.
+  template<template<typename> class Loss = MSELoss, template<typename> class Optimizer = SGD>
+  T train(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size, T learning_rate) {
+    return fit(losses_for<Loss>(), network_.template use_optimizer<Optimizer>(learning_rate), X, Y, epochs,
+               batch_size);
+  }
+
+  // Same, stepping the optimizer set on the network with NeuralNetwork::set_optimizer.
+  template<template<typename> class Loss = MSELoss>
+  T train(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size) {
+    if (network_.optimizer() == nullptr)
+      throw std::runtime_error("NeuralNetwork has no optimizer; set one or pass a learning rate");
+    return fit(losses_for<Loss>(), *network_.optimizer(), X, Y, epochs, batch_size);
+  }
+};
+
+}
+
+#endif //DATA_PARALLEL_H
@@ -5,4 +5,160 @@
 #ifndef DENSE_H
 #define DENSE_H
 
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+#include "utec/algebra/reduction.h"
+#include "utec/nn/activation.h"
+#include "utec/nn/inference.h"
+#include "utec/nn/layer.h"
+#include "utec/nn/quantized_network.h"
+
+namespace utec::neural_network {
+
+namespace detail {
+
+// GEMM epilogue of Dense: adds the bias of the output column and applies the
+// activation while the tile is still in registers.
+template<typename T, typename Activation>
+struct bias_activation {
+  const T* bias;
+
+  template<typename V>
+  UTEC_ALWAYS_INLINE V operator()(const V& value, size_t column) const {
+    if constexpr (algebra::simd::is_packet_v<V>) {
+      return Activation::activate(value + V::load(bias + column));
+    } else {
+      return Activation::activate(value + bias[column]);
+    }
+  }
+};
+
+}
+
+// Fully connected layer y = f(x W + b), with x (batch, in), W (in, out), b (1, out) and
+// f one of the activations in activation.h. forward is a single matrix_product whose
+// epilogue adds b and applies f, so the output is written exactly once and, after the
+// first batch of a given size, nothing is allocated.
+template<typename T, template<typename> class Activation = Identity>
+class Dense final : public ILayer<T> {
+  static_assert(std::is_floating_point_v<T>, "Dense requires a floating point value type");
+
+ private:
+  Tensor<T, 2> weights_;
+  Tensor<T, 2> bias_;
+  Tensor<T, 2> grad_weights_;
+  Tensor<T, 2> grad_bias_;
+  Tensor<T, 2> output_;
+  Tensor<T, 2> delta_;
+  Tensor<T, 2> grad_input_;
+  const Tensor<T, 2>* input_ = nullptr;
+  bool input_gradient_ = true;
+
+ public:
+  using activation_type = Activation<T>;
+
+  // Uniform He initialization for ReLU and Glorot otherwise; biases start at zero.
+  Dense(size_t in_features, size_t out_features, unsigned seed = 42)
+      : weights_(in_features, out_features), bias_(1, out_features),
+        grad_weights_(in_features, out_features), grad_bias_(1, out_features) {
+    const T fan = std::is_same_v<activation_type, ReLU<T>> ? T(in_features) : T(in_features + out_features);
+    const T limit = std::sqrt(T{6} / fan);
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<T> distribution(-limit, limit);
+    for (auto& w : weights_) w = distribution(engine);
+    bias_.fill(T{0});
+  }
+
+  // init_weights(W) and init_bias(b) fill the (in, out) and (1, out) parameters.
+  template<typename InitWeights, typename InitBias>
+  Dense(size_t in_features, size_t out_features, InitWeights init_weights, InitBias init_bias)
+      : weights_(in_features, out_features), bias_(1, out_features),
+        grad_weights_(in_features, out_features), grad_bias_(1, out_features) {
+    init_weights(weights_);
+    init_bias(bias_);
+  }
+
+  size_t in_features() const { return weights_.shape()[0]; }
+  size_t out_features() const { return weights_.shape()[1]; }
+
+  Tensor<T, 2>& weights() { return weights_; }
+  const Tensor<T, 2>& weights() const { return weights_; }
+  Tensor<T, 2>& bias() { return bias_; }
+  const Tensor<T, 2>& bias() const { return bias_; }
+  const Tensor<T, 2>& grad_weights() const { return grad_weights_; }
+  const Tensor<T, 2>& grad_bias() const { return grad_bias_; }
+
+  std::vector<parameter<T>> parameters() override {
+    return {{&weights_, &grad_weights_}, {&bias_, &grad_bias_}};
+  }
+
+  void set_input_gradient(bool enabled) override { input_gradient_ = enabled; }
+
+  void freeze_into(FrozenNetwork<T>& frozen) const override {
+    frozen.template add_dense<activation_type>(weights_, bias_);
+  }
+
+  void quantize_into(QuantizedNetwork<T>& quantized) const override {
+    quantized.template add_dense<activation_type>(weights_, bias_);
+  }
+
+  // f(x W + b), which Graph::compile fuses back into one matrix_product.
+  size_t capture_into(Graph<T>& graph, size_t input) override {
+    const GraphValue<T> x{&graph, input};
+    const auto w = graph.parameter(weights_, grad_weights_);
+    const auto b = graph.parameter(bias_, grad_bias_);
+    return activate<Activation>(matrix_product(x, w) + b).id;
+  }
+
+  std::unique_ptr<ILayer<T>> clone() const override {
+    auto copy = std::make_unique<Dense>(*this);
+    copy->input_ = nullptr;
+    return copy;
+  }
+
+  const Tensor<T, 2>& forward(const Tensor<T, 2>& input) override {
+    UTEC_PROFILE_SCOPE("Dense.forward", 2 * input.size() * out_features());
+    if (input.shape()[1] != in_features())
+      throw std::runtime_error("Input features do not match the layer input size");
+    input_ = &input;
+    algebra::matrix_product(input, weights_, output_, detail::bias_activation<T, activation_type>{bias_.data()});
+    return output_;
+  }
+
+  // dW = x^T delta, db = column sums of delta and dx = delta W^T, where delta is the
+  // incoming gradient scaled by f'(y). The transposes are strided views. dx is not
+  // computed while the input gradient is disabled.
+  const Tensor<T, 2>& backward(const Tensor<T, 2>& grad_output) override {
+    UTEC_PROFILE_SCOPE("Dense.backward", 4 * grad_output.shape()[0] * weights_.size());
+    if (input_ == nullptr) throw std::runtime_error("Dense::backward called before forward");
+    if (grad_output.shape() != output_.shape())
+      throw std::runtime_error("Gradient shape does not match the layer output");
+
+    const Tensor<T, 2>* delta = &grad_output;
+    if constexpr (!std::is_same_v<activation_type, Identity<T>>) {
+      detail::resize(delta_, output_.shape());
+      const T* g = grad_output.data();
+      const T* y = output_.data();
+      T* d = delta_.data();
+      for (size_t i = 0; i < output_.size(); ++i) d[i] = g[i] * activation_type::derivative(y[i]);
+      delta = &delta_;
+    }
+
+    algebra::matrix_product(input_->transpose_view(), *delta, grad_weights_);
+
+    algebra::sum(*delta, 0, grad_bias_);
+
+    if (input_gradient_) algebra::matrix_product(*delta, weights_.transpose_view(), grad_input_);
+    return grad_input_;
+  }
+};
+
+}
+
 #endif //DENSE_H
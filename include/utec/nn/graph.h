@@ -0,0 +1,773 @@
+//
+// Captured computation graphs: record once, differentiate, fuse, plan and replay.
+//
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/profiler.h"
+#include "utec/algebra/reduction.h"
+#include "utec/algebra/simd.h"
+#include "utec/nn/layer.h"
+#include "utec/nn/memory_plan.h"
+
+namespace utec::neural_network {
+
+template<typename T>
+class Identity;
+template<typename T>
+class ReLU;
+template<typename T>
+class Sigmoid;
+
+// A value recorded in a Graph. The free functions at the end of this file (operators,
+// matrix_product, activate, sum, mse) add nodes instead of computing anything.
+template<typename T>
+struct GraphValue {
+  Graph<T>* graph;
+  size_t id;
+
+  const std::array<size_t, 2>& shape() const;
+};
+
+namespace graph {
+
+inline constexpr size_t none = static_cast<size_t>(-1);
+
+enum class op { input, parameter, constant, matrix_product, elementwise, sum, mse };
+
+enum class activation { identity, relu, sigmoid };
+
+// An elementwise node copies its source (broadcast to the node's shape) and applies
+// its steps in order: add, subtract and multiply combine with another node, also
+// broadcast; scale multiplies by a constant; activate applies the activation; and
+// activation_grad multiplies by its derivative at the operand, the activation's output.
+// A matrix_product node applies its steps to the product as a GEMM epilogue.
+enum class step_kind { add, subtract, multiply, scale, activate, activation_grad };
+
+template<typename T>
+struct step {
+  step_kind kind;
+  size_t operand = none;
+  T scalar = T{0};
+  activation function = activation::identity;
+};
+
+template<typename T>
+struct node {
+  op kind;
+  std::array<size_t, 2> shape{};
+  // matrix_product: A and B; elementwise and sum: the source; mse: prediction, target.
+  std::vector<size_t> inputs;
+  std::vector<step<T>> steps;
+  std::array<bool, 2> summed{};  // sum: the axes reduced to extent 1
+  bool transpose_a = false;
+  bool transpose_b = false;
+  bool requires_grad = false;
+  bool fused = false;
+  bool kept = false;
+  const Tensor<T, 2>* tensor = nullptr;  // the bound input or parameter
+  Tensor<T, 2>* output = nullptr;        // a parameter gradient the value is written to
+  Tensor<T, 2> owned;                    // the value of a constant
+  size_t offset = none;                  // where other values live in the arena, in elements
+};
+
+// A step with its operand resolved to memory. Row r of the operand starts at
+// data + r * row_stride (0 for a single row); broadcast marks a single column.
+template<typename T>
+struct bound_step {
+  step_kind kind = step_kind::add;
+  activation function = activation::identity;
+  T scalar = T{0};
+  const T* data = nullptr;
+  size_t row_stride = 0;
+  bool broadcast = false;
+};
+
+template<template<typename> class Activation, typename T>
+constexpr activation activation_of() {
+  if constexpr (std::is_same_v<Activation<T>, Identity<T>>) return activation::identity;
+  else if constexpr (std::is_same_v<Activation<T>, ReLU<T>>) return activation::relu;
+  else if constexpr (std::is_same_v<Activation<T>, Sigmoid<T>>) return activation::sigmoid;
+  else static_assert(sizeof(T) == 0, "Activation has no graph kernel");
+}
+
+template<typename T, typename V>
+UTEC_ALWAYS_INLINE V apply_activation(activation f, const V& x) {
+  switch (f) {
+    case activation::relu: return ReLU<T>::activate(x);
+    case activation::sigmoid: return Sigmoid<T>::activate(x);
+    default: return x;
+  }
+}
+
+template<typename T>
+UTEC_ALWAYS_INLINE T activation_derivative(activation f, T y) {
+  switch (f) {
+    case activation::relu: return ReLU<T>::derivative(y);
+    case activation::sigmoid: return Sigmoid<T>::derivative(y);
+    default: return T{1};
+  }
+}
+
+template<typename V>
+UTEC_ALWAYS_INLINE V combine(step_kind kind, const V& a, const V& b) {
+  switch (kind) {
+    case step_kind::add: return a + b;
+    case step_kind::subtract: return a - b;
+    default: return a * b;
+  }
+}
+
+// Rows [first, last) of an elementwise node with n columns. The whole chain runs on
+// one row before moving on, so every step after the first reads and writes L1.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void program_body(size_t first, size_t last, size_t n, const bound_step<T>& source,
+                                     const bound_step<T>* steps, size_t count, T* out) {
+  using P = algebra::simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  for (size_t r = first; r < last; ++r) {
+    T* UTEC_RESTRICT y = out + r * n;
+    const T* s = source.data + r * source.row_stride;
+    if (source.broadcast) std::fill(y, y + n, s[0]);
+    else std::copy_n(s, n, y);
+    for (size_t q = 0; q < count; ++q) {
+      const bound_step<T>& st = steps[q];
+      const T* UTEC_RESTRICT o = st.data == nullptr ? nullptr : st.data + r * st.row_stride;
+      size_t j = 0;
+      switch (st.kind) {
+        case step_kind::scale: {
+          const P b = P::broadcast(st.scalar);
+          for (; j + L <= n; j += L) (P::load(y + j) * b).store(y + j);
+          for (; j < n; ++j) y[j] *= st.scalar;
+          break;
+        }
+        case step_kind::activate:
+          for (; j + L <= n; j += L) apply_activation<T>(st.function, P::load(y + j)).store(y + j);
+          for (; j < n; ++j) y[j] = apply_activation<T>(st.function, y[j]);
+          break;
+        case step_kind::activation_grad:
+          for (; j < n; ++j) y[j] *= activation_derivative(st.function, o[st.broadcast ? 0 : j]);
+          break;
+        default:
+          if (st.broadcast) {
+            const P b = P::broadcast(o[0]);
+            for (; j + L <= n; j += L) combine(st.kind, P::load(y + j), b).store(y + j);
+            for (; j < n; ++j) y[j] = combine(st.kind, y[j], o[0]);
+          } else {
+            for (; j + L <= n; j += L) combine(st.kind, P::load(y + j), P::load(o + j)).store(y + j);
+            for (; j < n; ++j) y[j] = combine(st.kind, y[j], o[j]);
+          }
+          break;
+      }
+    }
+  }
+}
+
+template<typename T>
+void program_native(size_t first, size_t last, size_t n, const bound_step<T>& source, const bound_step<T>* steps,
+                    size_t count, T* out) {
+  program_body<T, algebra::simd::native_bytes>(first, last, n, source, steps, count, out);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T>
+UTEC_TARGET_AVX2 void program_avx2(size_t first, size_t last, size_t n, const bound_step<T>& source,
+                                   const bound_step<T>* steps, size_t count, T* out) {
+  program_body<T, 32>(first, last, n, source, steps, count, out);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 void program_avx512(size_t first, size_t last, size_t n, const bound_step<T>& source,
+                                       const bound_step<T>* steps, size_t count, T* out) {
+  program_body<T, 64>(first, last, n, source, steps, count, out);
+}
+#endif
+
+template<typename T>
+void program(size_t first, size_t last, size_t n, const bound_step<T>& source, const bound_step<T>* steps,
+             size_t count, T* out) {
+  algebra::dispatch::select(&program_native<T> UTEC_DISPATCH_VARIANTS(, &program_avx2<T>, &program_avx512<T>))(
+      first, last, n, source, steps, count, out);
+}
+
+// The steps of a fused matrix_product, applied while its tile is in registers. Only
+// steps whose operands are single rows (or scalars) are fused, since an epilogue
+// knows the column of a value but not its row.
+template<typename T>
+struct program_epilogue {
+  const bound_step<T>* steps;
+  size_t count;
+
+  template<typename V>
+  UTEC_ALWAYS_INLINE V operator()(V value, size_t column) const {
+    for (size_t q = 0; q < count; ++q) {
+      const bound_step<T>& st = steps[q];
+      if (st.kind == step_kind::activate) {
+        value = apply_activation<T>(st.function, value);
+      } else if constexpr (algebra::simd::is_packet_v<V>) {
+        value = combine(st.kind, value, st.kind == step_kind::scale ? V::broadcast(st.scalar)
+                                        : st.broadcast            ? V::broadcast(st.data[0])
+                                                                  : V::load(st.data + column));
+      } else {
+        value = combine(st.kind, value, st.kind == step_kind::scale ? st.scalar
+                                        : st.broadcast            ? st.data[0]
+                                                                  : st.data[column]);
+      }
+    }
+    return value;
+  }
+};
+
+inline std::array<size_t, 2> broadcast_shape(const std::array<size_t, 2>& a, const std::array<size_t, 2>& b) {
+  std::array<size_t, 2> shape{};
+  for (size_t d = 0; d < 2; ++d) {
+    if (a[d] != b[d] && a[d] != 1 && b[d] != 1) throw std::runtime_error("Shapes are not compatible for broadcasting");
+    shape[d] = a[d] == 1 ? b[d] : a[d];
+  }
+  return shape;
+}
+
+}
+
+// A (batch, features) computation recorded once and replayed every step:
+//
+//   Graph<float> g;
+//   auto x = g.input(X), y = g.input(Y);
+//   auto loss = mse(activate<ReLU>(matrix_product(x, g.parameter(W, dW)) + g.parameter(b, db)), y);
+//   g.backward(loss);
+//   for (...) { refill X and Y; g.run(); optimizer.step(g.parameters()); }
+//
+// Inputs and parameters are bound by reference, so refilling their tensors is all a
+// replay needs; their shapes must stay as captured. backward appends the reverse-mode
+// gradient graph of a (1, 1) loss and writes the gradient of every parameter into its
+// gradient tensor. compile, which the first run calls, then
+//   - fuses elementwise chains into one pass over the data, and folds the steps that
+//     follow a matrix_product into its epilogue when their operands are rows (bias,
+//     scale, activation), so x W + b -> f is a single kernel;
+//   - plans storage: every intermediate is a view at a fixed offset of one arena,
+//     and values with disjoint lifetimes share memory (see memory_plan.h), so the
+//     arena is the only allocation and runs allocate nothing.
+// Only values passed to keep (and the loss) can be read after a run.
+template<typename T>
+class Graph {
+  static_assert(std::is_floating_point_v<T>, "Graph requires a floating point value type");
+
+ private:
+  using node = graph::node<T>;
+  using step = graph::step<T>;
+  using step_kind = graph::step_kind;
+  using value = GraphValue<T>;
+
+  std::deque<node> nodes_;
+  std::deque<Tensor<T, 2>> gradients_;
+  std::vector<neural_network::parameter<T>> parameters_;
+  std::vector<size_t> schedule_;
+  std::vector<std::vector<graph::bound_step<T>>> bound_;
+  std::vector<T, algebra::aligned_allocator<T>> arena_;
+  size_t loss_ = graph::none;
+  size_t unplanned_bytes_ = 0;
+  bool compiled_ = false;
+
+  size_t record(node n) {
+    if (compiled_) throw std::runtime_error("Graph is already compiled");
+    nodes_.push_back(std::move(n));
+    return nodes_.size() - 1;
+  }
+
+  value wrap(size_t id) { return {this, id}; }
+
+  size_t id_of(const value& v) const {
+    if (v.graph != this) throw std::runtime_error("Value belongs to a different graph");
+    return v.id;
+  }
+
+  static bool computed(const node& n) {
+    return n.kind != graph::op::input && n.kind != graph::op::parameter && n.kind != graph::op::constant;
+  }
+
+  static std::vector<size_t> dependencies(const node& n) {
+    std::vector<size_t> result = n.inputs;
+    for (const auto& s : n.steps)
+      if (s.operand != graph::none) result.push_back(s.operand);
+    return result;
+  }
+
+  T* storage(node& n) {
+    if (n.output != nullptr) return n.output->data();
+    if (n.offset != graph::none) return arena_.data() + n.offset;
+    return n.owned.data();
+  }
+
+  const T* read(size_t id) {
+    node& n = nodes_[id];
+    if (n.tensor != nullptr) return n.tensor->data();
+    return storage(n);
+  }
+
+  size_t elementwise(size_t source, std::vector<step> steps, const std::array<size_t, 2>& shape) {
+    node n;
+    n.kind = graph::op::elementwise;
+    n.shape = shape;
+    n.inputs = {source};
+    n.requires_grad = nodes_[source].requires_grad;
+    for (const auto& s : steps)
+      if (s.operand != graph::none) n.requires_grad = n.requires_grad || nodes_[s.operand].requires_grad;
+    n.steps = std::move(steps);
+    return record(std::move(n));
+  }
+
+  size_t binary(step_kind kind, size_t a, size_t b) {
+    const auto shape = graph::broadcast_shape(nodes_[a].shape, nodes_[b].shape);
+    // A commutative op keeps the full-shape operand as its source, so b + x W fuses.
+    if (kind != step_kind::subtract && nodes_[a].shape != shape) std::swap(a, b);
+    return elementwise(a, {{kind, b}}, shape);
+  }
+
+  size_t scaled(size_t a, T factor) { return elementwise(a, {{step_kind::scale, graph::none, factor}}, nodes_[a].shape); }
+
+  size_t product(size_t a, size_t b, bool transpose_a, bool transpose_b) {
+    const auto& sa = nodes_[a].shape;
+    const auto& sb = nodes_[b].shape;
+    if ((transpose_a ? sa[0] : sa[1]) != (transpose_b ? sb[1] : sb[0]))
+      throw std::runtime_error("Matrix dimensions are incompatible for multiplication");
+    node n;
+    n.kind = graph::op::matrix_product;
+    n.shape = {transpose_a ? sa[1] : sa[0], transpose_b ? sb[0] : sb[1]};
+    n.inputs = {a, b};
+    n.transpose_a = transpose_a;
+    n.transpose_b = transpose_b;
+    n.requires_grad = nodes_[a].requires_grad || nodes_[b].requires_grad;
+    return record(std::move(n));
+  }
+
+  // Sums a gradient over the axes its operand was broadcast along.
+  size_t reduce_to(size_t gradient, const std::array<size_t, 2>& shape) {
+    if (nodes_[gradient].shape == shape) return gradient;
+    node n;
+    n.kind = graph::op::sum;
+    n.shape = shape;
+    n.summed = {nodes_[gradient].shape[0] != shape[0], nodes_[gradient].shape[1] != shape[1]};
+    n.inputs = {gradient};
+    n.requires_grad = true;
+    return record(std::move(n));
+  }
+
+  // Propagates the gradient g of node i to the nodes it reads.
+  void differentiate(size_t i, size_t g, size_t seed, std::vector<std::vector<size_t>>& grads) {
+    const node& n = nodes_[i];
+    const auto contribute = [&](size_t target, size_t gradient) {
+      if (nodes_[target].requires_grad) grads[target].push_back(reduce_to(gradient, nodes_[target].shape));
+    };
+    switch (n.kind) {
+      case graph::op::matrix_product: {
+        const size_t a = n.inputs[0], b = n.inputs[1];
+        const bool ta = n.transpose_a, tb = n.transpose_b;
+        if (nodes_[a].requires_grad) grads[a].push_back(ta ? product(b, g, tb, true) : product(g, b, false, !tb));
+        if (nodes_[b].requires_grad) grads[b].push_back(tb ? product(g, a, true, ta) : product(a, g, !ta, false));
+        break;
+      }
+      case graph::op::elementwise: {
+        const size_t source = n.inputs[0];
+        const auto shape = n.shape;
+        if (n.steps.empty()) {
+          contribute(source, g);
+          break;
+        }
+        const step s = n.steps.front();
+        switch (s.kind) {
+          case step_kind::add:
+            contribute(source, g);
+            contribute(s.operand, g);
+            break;
+          case step_kind::subtract:
+            contribute(source, g);
+            if (nodes_[s.operand].requires_grad) contribute(s.operand, scaled(g, T(-1)));
+            break;
+          case step_kind::multiply:
+            if (nodes_[source].requires_grad) contribute(source, elementwise(g, {{step_kind::multiply, s.operand}}, shape));
+            if (nodes_[s.operand].requires_grad) contribute(s.operand, elementwise(g, {{step_kind::multiply, source}}, shape));
+            break;
+          case step_kind::scale:
+            contribute(source, scaled(g, s.scalar));
+            break;
+          case step_kind::activate:
+            contribute(source, elementwise(g, {{step_kind::activation_grad, i, T{0}, s.function}}, shape));
+            break;
+          case step_kind::activation_grad:
+            throw std::runtime_error("Graph does not support second-order gradients");
+        }
+        break;
+      }
+      case graph::op::sum: {
+        const size_t source = n.inputs[0];
+        contribute(source, elementwise(g, {}, nodes_[source].shape));
+        break;
+      }
+      case graph::op::mse: {
+        const size_t p = n.inputs[0], y = n.inputs[1];
+        const auto shape = nodes_[p].shape;
+        const T factor = T{2} / T(std::max<size_t>(1, shape[0] * shape[1]));
+        std::vector<step> steps = {{step_kind::subtract, y}, {step_kind::scale, graph::none, factor}};
+        if (g != seed) steps.push_back({step_kind::multiply, g});
+        const size_t dp = elementwise(p, std::move(steps), shape);
+        contribute(p, dp);
+        if (nodes_[y].requires_grad) contribute(y, scaled(dp, T(-1)));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // Merges each elementwise node with the single-use node it reads: the steps of an
+  // elementwise source are prepended to its own, and a matrix_product source takes
+  // the steps as its epilogue when all of them fit one.
+  void fuse() {
+    std::vector<size_t> uses(nodes_.size(), 0);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+      if (nodes_[i].kept || nodes_[i].output != nullptr) ++uses[i];
+      for (size_t d : dependencies(nodes_[i])) ++uses[d];
+    }
+    const auto fits_epilogue = [&](const step& s, size_t columns) {
+      if (s.kind == step_kind::scale || s.kind == step_kind::activate) return true;
+      if (s.kind == step_kind::activation_grad) return false;
+      const auto& shape = nodes_[s.operand].shape;
+      return shape[0] == 1 && (shape[1] == columns || shape[1] == 1);
+    };
+    for (auto& n : nodes_) {
+      if (n.kind != graph::op::elementwise) continue;
+      node& source = nodes_[n.inputs[0]];
+      if (uses[n.inputs[0]] != 1 || source.shape != n.shape) continue;
+      if (source.kind == graph::op::elementwise) {
+        n.inputs = source.inputs;
+      } else if (source.kind == graph::op::matrix_product &&
+                 std::all_of(n.steps.begin(), n.steps.end(), [&](const step& s) { return fits_epilogue(s, n.shape[1]); })) {
+        n.kind = graph::op::matrix_product;
+        n.inputs = source.inputs;
+        n.transpose_a = source.transpose_a;
+        n.transpose_b = source.transpose_b;
+      } else {
+        continue;
+      }
+      n.steps.insert(n.steps.begin(), source.steps.begin(), source.steps.end());
+      source.fused = true;
+    }
+  }
+
+  // Places every computed value in one arena (see memory_plan.h). A value is live
+  // from the step producing it to its last reader; kept values stay live to the end,
+  // and parameter gradients are written straight into their tensors.
+  void plan() {
+    std::vector<size_t> last(nodes_.size(), graph::none);
+    for (size_t p = 0; p < schedule_.size(); ++p) {
+      last[schedule_[p]] = p;
+      for (size_t d : dependencies(nodes_[schedule_[p]])) last[d] = p;
+    }
+    std::vector<buffer_lifetime> lifetimes;
+    std::vector<size_t> placed;
+    for (size_t p = 0; p < schedule_.size(); ++p) {
+      const node& n = nodes_[schedule_[p]];
+      if (n.output != nullptr) continue;
+      lifetimes.push_back({n.shape[0] * n.shape[1] * sizeof(T), p, n.kept ? schedule_.size() : last[schedule_[p]]});
+      placed.push_back(schedule_[p]);
+    }
+    const memory_plan plan = plan_memory(lifetimes);
+    for (size_t i = 0; i < placed.size(); ++i) nodes_[placed[i]].offset = plan.offsets[i] / sizeof(T);
+    arena_.assign(plan.arena_bytes / sizeof(T), T{0});
+    unplanned_bytes_ = plan.total_bytes;
+  }
+
+  graph::bound_step<T> bind(const step& s, const std::array<size_t, 2>& shape) {
+    graph::bound_step<T> b;
+    b.kind = s.kind;
+    b.function = s.function;
+    b.scalar = s.scalar;
+    if (s.operand != graph::none) {
+      const auto& operand = nodes_[s.operand].shape;
+      b.data = read(s.operand);
+      b.row_stride = operand[0] == 1 ? 0 : operand[1];
+      b.broadcast = operand[1] == 1 && shape[1] != 1;
+    }
+    return b;
+  }
+
+  void execute(size_t p) {
+    node& n = nodes_[schedule_[p]];
+    auto& steps = bound_[p];
+    for (size_t q = 0; q < n.steps.size(); ++q) steps[q] = bind(n.steps[q], n.shape);
+    T* out = storage(n);
+    const size_t rows = n.shape[0], columns = n.shape[1];
+    switch (n.kind) {
+      case graph::op::matrix_product: {
+        auto a = algebra::TensorView<const T, 2>(read(n.inputs[0]), nodes_[n.inputs[0]].shape);
+        auto b = algebra::TensorView<const T, 2>(read(n.inputs[1]), nodes_[n.inputs[1]].shape);
+        if (n.transpose_a) a = a.transposed();
+        if (n.transpose_b) b = b.transposed();
+        algebra::TensorView<T, 2> c(out, n.shape);
+        if (steps.empty()) algebra::matrix_product(a, b, c);
+        else algebra::matrix_product(a, b, c, graph::program_epilogue<T>{steps.data(), steps.size()});
+        break;
+      }
+      case graph::op::elementwise: {
+        const auto source = bind({step_kind::add, n.inputs[0]}, n.shape);
+        const size_t count = steps.size();
+        const auto* chain = steps.data();
+        const size_t grain = std::max<size_t>(1, algebra::parallel::grain_size() / std::max<size_t>(1, columns));
+        algebra::parallel::parallel_for(0, rows, grain, [&](size_t first, size_t last) {
+          graph::program(first, last, columns, source, chain, count, out);
+        });
+        break;
+      }
+      case graph::op::sum: {
+        const auto& from = nodes_[n.inputs[0]].shape;
+        const algebra::TensorView<const T, 2> x(read(n.inputs[0]), from);
+        // Summing an axis of extent 1 leaves the values as they are.
+        const bool down = n.summed[0] && from[0] > 1;
+        const bool across = n.summed[1] && from[1] > 1;
+        if (down && across) out[0] = T(algebra::sum(x));
+        else if (down || across) algebra::sum(x, down ? 0 : 1, algebra::TensorView<T, 2>(out, n.shape));
+        else std::copy_n(x.data(), rows * columns, out);
+        break;
+      }
+      case graph::op::mse: {
+        const auto& shape = nodes_[n.inputs[0]].shape;
+        const size_t count = shape[0] * shape[1];
+        const T* prediction = read(n.inputs[0]);
+        const T* target = read(n.inputs[1]);
+        algebra::accumulator_t<T> total{0};
+        for (size_t i = 0; i < count; ++i) {
+          const T d = prediction[i] - target[i];
+          total += d * d;
+        }
+        out[0] = T(total / algebra::accumulator_t<T>(std::max<size_t>(1, count)));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+ public:
+  Graph() = default;
+  Graph(const Graph&) = delete;
+  Graph& operator=(const Graph&) = delete;
+
+  value input(const Tensor<T, 2>& tensor) {
+    node n;
+    n.kind = graph::op::input;
+    n.shape = tensor.shape();
+    n.tensor = &tensor;
+    return wrap(record(std::move(n)));
+  }
+
+  // A trainable tensor; each run writes dLoss/dValue into gradient. Binding the same
+  // tensor again returns its existing node.
+  value parameter(Tensor<T, 2>& tensor, Tensor<T, 2>& gradient) {
+    for (size_t i = 0; i < nodes_.size(); ++i)
+      if (nodes_[i].kind == graph::op::parameter && nodes_[i].tensor == &tensor) return wrap(i);
+    if (gradient.shape() != tensor.shape()) throw std::runtime_error("Gradient shape does not match the parameter");
+    node n;
+    n.kind = graph::op::parameter;
+    n.shape = tensor.shape();
+    n.tensor = &tensor;
+    n.requires_grad = true;
+    const size_t id = record(std::move(n));
+    parameters_.push_back({&tensor, &gradient});
+    return wrap(id);
+  }
+
+  // Same, with a gradient tensor owned by the graph.
+  value parameter(Tensor<T, 2>& tensor) {
+    for (size_t i = 0; i < nodes_.size(); ++i)
+      if (nodes_[i].kind == graph::op::parameter && nodes_[i].tensor == &tensor) return wrap(i);
+    return parameter(tensor, gradients_.emplace_back(tensor.shape()));
+  }
+
+  // op(a) op(b), where op transposes when its flag is set.
+  value matrix_product(const value& a, const value& b, bool transpose_a = false, bool transpose_b = false) {
+    return wrap(product(id_of(a), id_of(b), transpose_a, transpose_b));
+  }
+
+  // Elementwise, broadcasting axes of extent 1.
+  value add(const value& a, const value& b) { return wrap(binary(step_kind::add, id_of(a), id_of(b))); }
+  value subtract(const value& a, const value& b) { return wrap(binary(step_kind::subtract, id_of(a), id_of(b))); }
+  value multiply(const value& a, const value& b) { return wrap(binary(step_kind::multiply, id_of(a), id_of(b))); }
+  value scale(const value& a, T factor) { return wrap(scaled(id_of(a), factor)); }
+
+  template<template<typename> class Activation>
+  value activate(const value& a) {
+    constexpr auto f = graph::activation_of<Activation, T>();
+    if constexpr (f == graph::activation::identity) return a;
+    else return wrap(elementwise(id_of(a), {{step_kind::activate, graph::none, T{0}, f}}, nodes_[a.id].shape));
+  }
+
+  // Sums along axis 0 (to one row) or axis 1 (to one column).
+  value sum(const value& a, size_t axis) {
+    if (axis > 1) throw std::out_of_range("Axis is out of the tensor rank");
+    node n;
+    n.kind = graph::op::sum;
+    n.shape = nodes_[id_of(a)].shape;
+    n.shape[axis] = 1;
+    n.summed[axis] = true;
+    n.inputs = {a.id};
+    n.requires_grad = nodes_[a.id].requires_grad;
+    return wrap(record(std::move(n)));
+  }
+
+  // Mean squared error, a (1, 1) value.
+  value mse(const value& prediction, const value& target) {
+    if (nodes_[id_of(prediction)].shape != nodes_[id_of(target)].shape)
+      throw std::runtime_error("Prediction and target shapes do not match");
+    node n;
+    n.kind = graph::op::mse;
+    n.shape = {1, 1};
+    n.inputs = {prediction.id, target.id};
+    n.requires_grad = nodes_[prediction.id].requires_grad || nodes_[target.id].requires_grad;
+    return wrap(record(std::move(n)));
+  }
+
+  // Appends the gradient graph of loss, which must be (1, 1), and keeps the loss.
+  void backward(const value& loss) {
+    if (loss_ != graph::none) throw std::runtime_error("Graph already has a backward pass");
+    if (nodes_[id_of(loss)].shape != std::array<size_t, 2>{1, 1})
+      throw std::runtime_error("Backward needs a (1, 1) loss");
+    node one;
+    one.kind = graph::op::constant;
+    one.shape = {1, 1};
+    one.owned = Tensor<T, 2>(1, 1);
+    one.owned.fill(T{1});
+    const size_t seed = record(std::move(one));
+    loss_ = loss.id;
+    nodes_[loss_].kept = true;
+
+    std::vector<std::vector<size_t>> grads(loss_ + 1);
+    grads[loss_].push_back(seed);
+    for (size_t i = loss_ + 1; i-- > 0;) {
+      if (grads[i].empty() || !nodes_[i].requires_grad) continue;
+      size_t g = grads[i].front();
+      for (size_t c = 1; c < grads[i].size(); ++c) g = binary(step_kind::add, g, grads[i][c]);
+      if (nodes_[i].kind != graph::op::parameter) {
+        differentiate(i, g, seed, grads);
+        continue;
+      }
+      if (!computed(nodes_[g]) || nodes_[g].output != nullptr || nodes_[g].kept) g = elementwise(g, {}, nodes_[g].shape);
+      for (const auto& p : parameters_)
+        if (p.value == nodes_[i].tensor) nodes_[g].output = p.gradient;
+    }
+    // Parameters the loss does not depend on get a zero gradient.
+    for (const auto& p : parameters_) {
+      const bool bound = std::any_of(nodes_.begin(), nodes_.end(), [&](const node& n) { return n.output == p.gradient; });
+      if (!bound) p.gradient->fill(T{0});
+    }
+  }
+
+  // Makes value_of(v) readable after each run.
+  void keep(const value& v) {
+    if (compiled_) throw std::runtime_error("Graph is already compiled");
+    nodes_[id_of(v)].kept = true;
+  }
+
+  void compile() {
+    if (compiled_) return;
+    fuse();
+    compiled_ = true;
+    for (size_t i = 0; i < nodes_.size(); ++i)
+      if (computed(nodes_[i]) && !nodes_[i].fused) schedule_.push_back(i);
+    plan();
+    for (size_t id : schedule_) bound_.emplace_back(nodes_[id].steps.size());
+  }
+
+  // Evaluates the graph on the current contents of its inputs and parameters.
+  void run() {
+    compile();
+    UTEC_PROFILE_SCOPE("Graph.run", 0);
+    for (const auto& n : nodes_)
+      if (n.tensor != nullptr && n.tensor->shape() != n.shape)
+        throw std::runtime_error("Graph input shape changed since capture");
+    for (size_t p = 0; p < schedule_.size(); ++p) execute(p);
+  }
+
+  const std::array<size_t, 2>& shape(const value& v) const { return nodes_[id_of(v)].shape; }
+
+  // The value of a kept node, an input or a parameter after the last run, valid
+  // until the next run.
+  algebra::TensorView<const T, 2> value_of(const value& v) {
+    const node& n = nodes_[id_of(v)];
+    if (n.tensor == nullptr && !n.kept) throw std::runtime_error("Graph value is not kept");
+    if (n.tensor == nullptr && !compiled_) throw std::runtime_error("Graph has not been run");
+    return {read(v.id), n.shape};
+  }
+
+  // The loss of the last run.
+  T loss() {
+    if (loss_ == graph::none) throw std::runtime_error("Graph has no backward pass");
+    return value_of(wrap(loss_))(0, 0);
+  }
+
+  const std::vector<neural_network::parameter<T>>& parameters() const { return parameters_; }
+
+  // Kernels launched per run, after fusion.
+  size_t kernels() const { return schedule_.size(); }
+
+  // The arena holding every intermediate, and what one allocation per value would take.
+  size_t planned_bytes() const { return arena_.size() * sizeof(T); }
+  size_t unplanned_bytes() const { return unplanned_bytes_; }
+};
+
+template<typename T>
+const std::array<size_t, 2>& GraphValue<T>::shape() const {
+  return graph->shape(*this);
+}
+
+template<typename T>
+GraphValue<T> operator+(const GraphValue<T>& a, const GraphValue<T>& b) { return a.graph->add(a, b); }
+
+template<typename T>
+GraphValue<T> operator-(const GraphValue<T>& a, const GraphValue<T>& b) { return a.graph->subtract(a, b); }
+
+template<typename T>
+GraphValue<T> operator*(const GraphValue<T>& a, const GraphValue<T>& b) { return a.graph->multiply(a, b); }
+
+template<typename T>
+GraphValue<T> operator*(const GraphValue<T>& a, std::type_identity_t<T> factor) { return a.graph->scale(a, factor); }
+
+template<typename T>
+GraphValue<T> operator*(std::type_identity_t<T> factor, const GraphValue<T>& a) { return a.graph->scale(a, factor); }
+
+template<typename T>
+GraphValue<T> matrix_product(const GraphValue<T>& a, const GraphValue<T>& b, bool transpose_a = false,
+                             bool transpose_b = false) {
+  return a.graph->matrix_product(a, b, transpose_a, transpose_b);
+}
+
+template<template<typename> class Activation, typename T>
+GraphValue<T> activate(const GraphValue<T>& a) {
+  return a.graph->template activate<Activation>(a);
+}
+
+template<typename T>
+GraphValue<T> sum(const GraphValue<T>& a, size_t axis) { return a.graph->sum(a, axis); }
+
+template<typename T>
+GraphValue<T> mse(const GraphValue<T>& prediction, const GraphValue<T>& target) {
+  return prediction.graph->mse(prediction, target);
+}
+
+}
+
+#endif //GRAPH_H
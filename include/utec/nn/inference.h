@@ -0,0 +1,244 @@
+//
+// Frozen single-observation inference: packed weights and GEMV kernels.
+//
+
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/simd.h"
+#include "utec/nn/layer.h"
+
+namespace utec::neural_network {
+
+template<typename T>
+class Identity;
+
+namespace inference {
+
+namespace simd = algebra::simd;
+
+// Every width is padded to a whole 64-byte line of T, which is a whole number of
+// packets for every kernel variant, so the kernels have no remainder loops.
+template<typename T>
+constexpr size_t padded(size_t n) {
+  constexpr size_t line = algebra::tensor_alignment / sizeof(T);
+  return (n + line - 1) / line * line;
+}
+
+// Kernel of one stage: y[0:out) = f(x[0:in) W + b) for a dense stage, with W packed
+// row-major as (in, out) so each x[i] scales one contiguous row; y = f(x) over out
+// values for an activation stage (in, w and b unused).
+template<typename T>
+using stage_kernel = void (*)(size_t in, size_t out, const T* x, const T* w, const T* b, T* y);
+
+// Keeps `block` packets of y in registers across the whole reduction over in.
+template<typename T, size_t Bytes, typename Activation>
+UTEC_ALWAYS_INLINE void gemv(size_t in, size_t out, const T* UTEC_RESTRICT x, const T* UTEC_RESTRICT w,
+                             const T* UTEC_RESTRICT b, T* UTEC_RESTRICT y) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  constexpr size_t block = 4;
+  size_t j = 0;
+  for (; j + block * L <= out; j += block * L) {
+    P acc[block];
+    for (size_t k = 0; k < block; ++k) acc[k] = P::load(b + j + k * L);
+    for (size_t i = 0; i < in; ++i) {
+      const P xi = P::broadcast(x[i]);
+      const T* row = w + i * out + j;
+      for (size_t k = 0; k < block; ++k) acc[k] = simd::fmadd(xi, P::load(row + k * L), acc[k]);
+    }
+    for (size_t k = 0; k < block; ++k) Activation::activate(acc[k]).store(y + j + k * L);
+  }
+  for (; j < out; j += L) {
+    P acc = P::load(b + j);
+    for (size_t i = 0; i < in; ++i) acc = simd::fmadd(P::broadcast(x[i]), P::load(w + i * out + j), acc);
+    Activation::activate(acc).store(y + j);
+  }
+}
+
+template<typename T, size_t Bytes, typename Activation>
+UTEC_ALWAYS_INLINE void activate(size_t, size_t out, const T* UTEC_RESTRICT x, const T*, const T*,
+                                 T* UTEC_RESTRICT y) {
+  using P = simd::packet<T, Bytes>;
+  for (size_t j = 0; j < out; j += P::lanes) Activation::activate(P::load(x + j)).store(y + j);
+}
+
+template<typename T, typename Activation>
+void gemv_native(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  gemv<T, simd::native_bytes, Activation>(in, out, x, w, b, y);
+}
+
+template<typename T, typename Activation>
+void activate_native(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  activate<T, simd::native_bytes, Activation>(in, out, x, w, b, y);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T, typename Activation>
+UTEC_TARGET_AVX2 void gemv_avx2(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  gemv<T, 32, Activation>(in, out, x, w, b, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX512 void gemv_avx512(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  gemv<T, 64, Activation>(in, out, x, w, b, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX2 void activate_avx2(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  activate<T, 32, Activation>(in, out, x, w, b, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX512 void activate_avx512(size_t in, size_t out, const T* x, const T* w, const T* b, T* y) {
+  activate<T, 64, Activation>(in, out, x, w, b, y);
+}
+#endif
+
+template<typename T, typename Activation>
+stage_kernel<T> select_gemv() {
+  return algebra::dispatch::select(&gemv_native<T, Activation>
+                                   UTEC_DISPATCH_VARIANTS(, &gemv_avx2<T, Activation>, &gemv_avx512<T, Activation>));
+}
+
+template<typename T, typename Activation>
+stage_kernel<T> select_activate() {
+  return algebra::dispatch::select(&activate_native<T, Activation>
+                                   UTEC_DISPATCH_VARIANTS(, &activate_avx2<T, Activation>,
+                                                          &activate_avx512<T, Activation>));
+}
+
+}
+
+// Read-only inference copy of a layer sequence for one observation at a time. Building
+// it (from NeuralNetwork layers through ILayer::freeze_into) packs every Dense into a
+// padded row-major block of one aligned arena, folds a standalone activation into the
+// Dense before it when that Dense has none, and picks each stage's kernel variant
+// once. forward() then only runs the kernels between two preallocated buffers: no
+// allocation, no exceptions, no shape checks and no batched matrix_product path.
+template<typename T>
+class FrozenNetwork {
+ private:
+  struct stage {
+    inference::stage_kernel<T> kernel;
+    size_t in;
+    size_t out;
+    size_t weights;
+    size_t bias;
+    bool foldable;
+  };
+
+  std::vector<stage> stages_;
+  std::vector<size_t> dense_stages_;
+  std::vector<T, algebra::aligned_allocator<T>> parameters_;
+  std::vector<T, algebra::aligned_allocator<T>> buffers_;
+  size_t inputs_ = 0;
+  size_t outputs_ = 0;
+  size_t width_ = 0;
+  size_t refresh_index_ = 0;
+  bool refreshing_ = false;
+
+  void pack(const stage& s, const Tensor<T, 2>& weights, const Tensor<T, 2>& bias) {
+    const size_t out = weights.shape()[1];
+    T* w = parameters_.data() + s.weights;
+    for (size_t i = 0; i < s.in; ++i) std::copy_n(weights.data() + i * out, out, w + i * s.out);
+    std::copy_n(bias.data(), out, parameters_.data() + s.bias);
+  }
+
+ public:
+  template<typename Layers>
+  explicit FrozenNetwork(const Layers& layers) {
+    for (size_t i = 0; i < layers.num_layers(); ++i) layers.layer(i).freeze_into(*this);
+    if (stages_.empty()) throw std::runtime_error("Cannot freeze a network without layers");
+    width_ = inference::padded<T>(inputs_);
+    for (const auto& s : stages_) width_ = std::max(width_, s.out);
+    buffers_.assign(2 * width_, T{0});
+  }
+
+  // Repacks the weights of a network with the same layers, e.g. after a weight update,
+  // without allocating.
+  template<typename Layers>
+  void refresh(const Layers& layers) {
+    refreshing_ = true;
+    refresh_index_ = 0;
+    try {
+      for (size_t i = 0; i < layers.num_layers(); ++i) layers.layer(i).freeze_into(*this);
+    } catch (...) {
+      refreshing_ = false;
+      throw;
+    }
+    refreshing_ = false;
+    if (refresh_index_ != dense_stages_.size()) throw std::runtime_error("Network does not match the frozen layers");
+  }
+
+  // Called by Dense::freeze_into.
+  template<typename Activation>
+  void add_dense(const Tensor<T, 2>& weights, const Tensor<T, 2>& bias) {
+    const size_t in = weights.shape()[0];
+    const size_t out = weights.shape()[1];
+    if (refreshing_) {
+      if (refresh_index_ >= dense_stages_.size()) throw std::runtime_error("Network does not match the frozen layers");
+      const stage& s = stages_[dense_stages_[refresh_index_++]];
+      if (s.in != in || s.out != inference::padded<T>(out))
+        throw std::runtime_error("Network does not match the frozen layers");
+      pack(s, weights, bias);
+      return;
+    }
+    if (stages_.empty()) inputs_ = in;
+    else if (in != outputs_) throw std::runtime_error("Layer sizes do not chain");
+    stage s{inference::select_gemv<T, Activation>(), in, inference::padded<T>(out), 0, 0,
+            std::is_same_v<Activation, Identity<T>>};
+    s.weights = parameters_.size();
+    s.bias = s.weights + in * s.out;
+    parameters_.resize(s.bias + s.out, T{0});
+    pack(s, weights, bias);
+    dense_stages_.push_back(stages_.size());
+    stages_.push_back(s);
+    outputs_ = out;
+  }
+
+  // Called by the activation layers' freeze_into.
+  template<typename Activation>
+  void add_activation() {
+    if (refreshing_) return;
+    if (stages_.empty()) throw std::runtime_error("A frozen network must start with a Dense layer");
+    stage& last = stages_.back();
+    if (last.foldable) {
+      last.kernel = inference::select_gemv<T, Activation>();
+      last.foldable = false;
+    } else {
+      stages_.push_back({inference::select_activate<T, Activation>(), last.out, last.out, 0, 0, false});
+    }
+  }
+
+  size_t inputs() const { return inputs_; }
+  size_t outputs() const { return outputs_; }
+
+  // Reads inputs() values and returns a pointer to outputs() values, valid until the
+  // next call.
+  const T* forward(const T* input) noexcept {
+    UTEC_PROFILE_SCOPE("FrozenNetwork.forward", 0);
+    T* x = buffers_.data();
+    T* y = x + width_;
+    std::copy_n(input, inputs_, x);
+    for (const auto& s : stages_) {
+      s.kernel(s.in, s.out, x, parameters_.data() + s.weights, parameters_.data() + s.bias, y);
+      std::swap(x, y);
+    }
+    return x;
+  }
+};
+
+}
+
+#endif //INFERENCE_H
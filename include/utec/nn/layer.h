@@ -5,4 +5,92 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "utec/algebra/tensor.h"
+
+namespace utec::neural_network {
+
+using algebra::Tensor;
+
+template<typename T>
+class FrozenNetwork;
+
+template<typename T>
+class Graph;
+
+template<typename T>
+class QuantizedNetwork;
+
+// A trainable tensor and the buffer where backward leaves dLoss/dValue.
+template<typename T>
+struct parameter {
+  Tensor<T, 2>* value;
+  Tensor<T, 2>* gradient;
+};
+
+// A layer maps a (batch, features) tensor to another. forward and backward return
+// buffers owned by the layer, valid until its next call, so steady-state training does
+// not allocate. A layer may keep a pointer to the input of forward for use in
+// backward; that input must stay alive until backward has run.
+template<typename T>
+class ILayer {
+ public:
+  virtual ~ILayer() = default;
+
+  virtual const Tensor<T, 2>& forward(const Tensor<T, 2>& input) = 0;
+
+  // Takes dLoss/dOutput of the last forward call and returns dLoss/dInput.
+  virtual const Tensor<T, 2>& backward(const Tensor<T, 2>& grad_output) = 0;
+
+  // The trainable tensors of the layer; empty for layers without parameters. The
+  // pointers stay valid for the lifetime of the layer.
+  virtual std::vector<parameter<T>> parameters() { return {}; }
+
+  // When disabled, backward may skip computing dLoss/dInput and return a stale buffer.
+  // NeuralNetwork disables it on its first layer, whose input gradient is never used.
+  virtual void set_input_gradient(bool enabled) { (void)enabled; }
+
+  // Appends the layer to a frozen inference network (see inference.h).
+  virtual void freeze_into(FrozenNetwork<T>& frozen) const {
+    (void)frozen;
+    throw std::runtime_error("Layer does not support inference mode");
+  }
+
+  // Appends the layer to an int8 inference network (see quantized_network.h).
+  virtual void quantize_into(QuantizedNetwork<T>& quantized) const {
+    (void)quantized;
+    throw std::runtime_error("Layer does not support quantization");
+  }
+
+  // Records the forward pass on the graph node `input` and returns the output node
+  // (see graph.h). The graph binds the layer's parameters by reference.
+  virtual size_t capture_into(Graph<T>& graph, size_t input) {
+    (void)graph;
+    (void)input;
+    throw std::runtime_error("Layer does not support graph capture");
+  }
+
+  // An independent copy (parameters and buffers), e.g. for a per-thread replica.
+  virtual std::unique_ptr<ILayer<T>> clone() const {
+    throw std::runtime_error("Layer does not support cloning");
+  }
+};
+
+namespace detail {
+
+// Gives a layer-owned buffer the requested shape, reusing its storage.
+template<typename T>
+void resize(Tensor<T, 2>& buffer, const std::array<size_t, 2>& shape) {
+  if (buffer.shape() != shape) buffer.reshape(shape);
+}
+
+}
+
+}
+
 #endif //LAYER_H
@@ -5,4 +5,200 @@
 #ifndef LOSS_H
 #define LOSS_H
 
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/simd.h"
+#include "utec/nn/layer.h"
+
+namespace utec::neural_network {
+
+namespace loss {
+
+namespace simd = algebra::simd;
+
+// sum((p - y)^2) over n values, writing scale * (p - y) to g in the same pass.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T mse_body(size_t n, T scale, const T* UTEC_RESTRICT p, const T* UTEC_RESTRICT y,
+                              T* UTEC_RESTRICT g) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  const P s = P::broadcast(scale);
+  P acc0 = P::zero(), acc1 = P::zero();
+  size_t i = 0;
+  for (; i + 2 * L <= n; i += 2 * L) {
+    const P d0 = P::load(p + i) - P::load(y + i);
+    const P d1 = P::load(p + i + L) - P::load(y + i + L);
+    acc0 = simd::fmadd(d0, d0, acc0);
+    acc1 = simd::fmadd(d1, d1, acc1);
+    (s * d0).store(g + i);
+    (s * d1).store(g + i + L);
+  }
+  T total = simd::reduce_add(acc0 + acc1);
+  for (; i < n; ++i) {
+    const T d = p[i] - y[i];
+    total += d * d;
+    g[i] = scale * d;
+  }
+  return total;
+}
+
+// Softmax cross-entropy of one row of c logits z against target weights y:
+// loss = sum(y) * logsumexp(z) - sum(y z) and g = scale * (softmax(z) sum(y) - y).
+// Subtracting max(z) before exponentiating keeps every exponent <= 0, so nothing
+// overflows. The row is read three times, but it sits in L1 after the first.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T cross_entropy_row(size_t c, T scale, const T* UTEC_RESTRICT z, const T* UTEC_RESTRICT y,
+                                       T* UTEC_RESTRICT g) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  size_t j = 0;
+  T max = z[0];
+  if (c >= L) {
+    P m = P::load(z);
+    for (j = L; j + L <= c; j += L) m = simd::max(m, P::load(z + j));
+    max = simd::reduce_max(m);
+  }
+  for (; j < c; ++j) max = z[j] > max ? z[j] : max;
+
+  const P m = P::broadcast(max);
+  P sum = P::zero(), weight = P::zero(), dot = P::zero();
+  for (j = 0; j + L <= c; j += L) {
+    const P zj = P::load(z + j);
+    const P yj = P::load(y + j);
+    const P e = simd::exp(zj - m);
+    e.store(g + j);
+    sum = sum + e;
+    weight = weight + yj;
+    dot = simd::fmadd(yj, zj, dot);
+  }
+  T total = simd::reduce_add(sum), total_weight = simd::reduce_add(weight), total_dot = simd::reduce_add(dot);
+  for (; j < c; ++j) {
+    const T e = std::exp(z[j] - max);
+    g[j] = e;
+    total += e;
+    total_weight += y[j];
+    total_dot += y[j] * z[j];
+  }
+
+  const T ratio = total_weight / total;
+  const P a = P::broadcast(scale * ratio);
+  const P s = P::broadcast(scale);
+  for (j = 0; j + L <= c; j += L) (a * P::load(g + j) - s * P::load(y + j)).store(g + j);
+  for (; j < c; ++j) g[j] = scale * (ratio * g[j] - y[j]);
+  return total_weight * (max + std::log(total)) - total_dot;
+}
+
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE T cross_entropy_body(size_t rows, size_t c, T scale, const T* z, const T* y, T* g) {
+  T total{0};
+  for (size_t r = 0; r < rows; ++r) total += cross_entropy_row<T, Bytes>(c, scale, z + r * c, y + r * c, g + r * c);
+  return total;
+}
+
+template<typename T>
+T mse_native(size_t n, T scale, const T* p, const T* y, T* g) {
+  return mse_body<T, simd::native_bytes>(n, scale, p, y, g);
+}
+
+template<typename T>
+T cross_entropy_native(size_t rows, size_t c, T scale, const T* z, const T* y, T* g) {
+  return cross_entropy_body<T, simd::native_bytes>(rows, c, scale, z, y, g);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T>
+UTEC_TARGET_AVX2 T mse_avx2(size_t n, T scale, const T* p, const T* y, T* g) {
+  return mse_body<T, 32>(n, scale, p, y, g);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 T mse_avx512(size_t n, T scale, const T* p, const T* y, T* g) {
+  return mse_body<T, 64>(n, scale, p, y, g);
+}
+
+template<typename T>
+UTEC_TARGET_AVX2 T cross_entropy_avx2(size_t rows, size_t c, T scale, const T* z, const T* y, T* g) {
+  return cross_entropy_body<T, 32>(rows, c, scale, z, y, g);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 T cross_entropy_avx512(size_t rows, size_t c, T scale, const T* z, const T* y, T* g) {
+  return cross_entropy_body<T, 64>(rows, c, scale, z, y, g);
+}
+#endif
+
+template<typename T>
+void check_shapes(const Tensor<T, 2>& input, const Tensor<T, 2>& target, Tensor<T, 2>& gradient) {
+  if (input.shape() != target.shape()) throw std::runtime_error("Prediction and target shapes do not match");
+  if (input.size() == 0) throw std::runtime_error("Loss of an empty batch");
+  detail::resize(gradient, input.shape());
+}
+
+}
+
+// Mean squared error over every element: returns mean((p - y)^2) and writes
+// dLoss/dp = 2 (p - y) / size into gradient (reshaped if needed) in the same pass.
+template<typename T>
+T mse(const Tensor<T, 2>& prediction, const Tensor<T, 2>& target, Tensor<T, 2>& gradient) {
+  UTEC_PROFILE_SCOPE("loss.mse", 4 * prediction.size());
+  loss::check_shapes(prediction, target, gradient);
+  const size_t n = prediction.size();
+  const T scale = T{2} / T(n);
+  const auto kernel = algebra::dispatch::select(&loss::mse_native<T>
+                                                UTEC_DISPATCH_VARIANTS(, &loss::mse_avx2<T>, &loss::mse_avx512<T>));
+  return kernel(n, scale, prediction.data(), target.data(), gradient.data()) / T(n);
+}
+
+// Softmax cross-entropy of (batch, classes) logits against target distributions (one
+// row per sample, e.g. one-hot): returns the mean over samples of
+// -sum_j y_j log softmax(z)_j and writes dLoss/dz = (softmax(z) sum(y) - y) / batch.
+template<typename T>
+T softmax_cross_entropy(const Tensor<T, 2>& logits, const Tensor<T, 2>& target, Tensor<T, 2>& gradient) {
+  UTEC_PROFILE_SCOPE("loss.softmax_cross_entropy", 6 * logits.size());
+  loss::check_shapes(logits, target, gradient);
+  const size_t rows = logits.shape()[0];
+  const size_t c = logits.shape()[1];
+  const T scale = T{1} / T(rows);
+  const auto kernel = algebra::dispatch::select(
+      &loss::cross_entropy_native<T>
+      UTEC_DISPATCH_VARIANTS(, &loss::cross_entropy_avx2<T>, &loss::cross_entropy_avx512<T>));
+  return kernel(rows, c, scale, logits.data(), target.data(), gradient.data()) * scale;
+}
+
+// Loss objects for NeuralNetwork::train: compute returns the loss and leaves
+// dLoss/dInput in gradient(), a buffer owned by the loss and reused across calls.
+
+template<typename T>
+class MSELoss {
+ private:
+  Tensor<T, 2> gradient_;
+
+ public:
+  T compute(const Tensor<T, 2>& prediction, const Tensor<T, 2>& target) {
+    return mse(prediction, target, gradient_);
+  }
+
+  const Tensor<T, 2>& gradient() const { return gradient_; }
+};
+
+// Expects the network to output logits (a final Dense without activation).
+template<typename T>
+class SoftmaxCrossEntropyLoss {
+ private:
+  Tensor<T, 2> gradient_;
+
+ public:
+  T compute(const Tensor<T, 2>& logits, const Tensor<T, 2>& target) {
+    return softmax_cross_entropy(logits, target, gradient_);
+  }
+
+  const Tensor<T, 2>& gradient() const { return gradient_; }
+};
+
+}
+
 #endif //LOSS_H
@@ -0,0 +1,80 @@
+//
+// Liveness-based placement of short-lived buffers inside one arena.
+//
+
+#ifndef MEMORY_PLAN_H
+#define MEMORY_PLAN_H
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+
+namespace utec::neural_network {
+
+// A buffer of `bytes` written at step `first` and last read at step `last`. Buffers
+// whose step ranges intersect are live together and must not overlap in memory; a
+// buffer produced in the same step as another's last read counts as overlapping it,
+// so an operation never writes over its own operands.
+struct buffer_lifetime {
+  size_t bytes;
+  size_t first;
+  size_t last;
+};
+
+struct memory_plan {
+  std::vector<size_t> offsets;  // byte offset of every buffer, a multiple of tensor_alignment
+  size_t arena_bytes = 0;       // the block holding all of them
+  size_t total_bytes = 0;       // what one allocation per buffer would take
+};
+
+// Greedy by size: buffers are placed largest first, each in the smallest gap that
+// fits it between the already placed buffers it is live with, or above all of them
+// when no gap does. Placing large buffers first keeps small ones from fragmenting the
+// arena; the result is usually close to the peak live size.
+inline memory_plan plan_memory(const std::vector<buffer_lifetime>& buffers) {
+  constexpr size_t alignment = algebra::tensor_alignment;
+  const auto aligned = [](size_t bytes) { return (bytes + alignment - 1) / alignment * alignment; };
+
+  memory_plan plan;
+  plan.offsets.assign(buffers.size(), 0);
+  std::vector<size_t> order(buffers.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return aligned(buffers[a].bytes) > aligned(buffers[b].bytes); });
+
+  std::vector<size_t> placed;
+  std::vector<size_t> live;
+  for (size_t i : order) {
+    const buffer_lifetime& b = buffers[i];
+    const size_t size = aligned(b.bytes);
+    plan.total_bytes += size;
+    live.clear();
+    for (size_t j : placed)
+      if (buffers[j].first <= b.last && b.first <= buffers[j].last) live.push_back(j);
+    std::sort(live.begin(), live.end(), [&](size_t x, size_t y) { return plan.offsets[x] < plan.offsets[y]; });
+
+    size_t cursor = 0;
+    size_t best = static_cast<size_t>(-1);
+    size_t best_gap = static_cast<size_t>(-1);
+    for (size_t j : live) {
+      if (plan.offsets[j] >= cursor + size && plan.offsets[j] - cursor < best_gap) {
+        best = cursor;
+        best_gap = plan.offsets[j] - cursor;
+      }
+      cursor = std::max(cursor, plan.offsets[j] + aligned(buffers[j].bytes));
+    }
+    plan.offsets[i] = best == static_cast<size_t>(-1) ? cursor : best;
+    plan.arena_bytes = std::max(plan.arena_bytes, plan.offsets[i] + size);
+    placed.push_back(i);
+  }
+  return plan;
+}
+
+}
+
+#endif //MEMORY_PLAN_H
@@ -5,4 +5,297 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "utec/nn/graph.h"
+#include "utec/nn/layer.h"
+#include "utec/nn/loss.h"
+#include "utec/nn/optimizer.h"
+
+namespace utec::neural_network {
+
+namespace detail {
+
+// Copies rows order[first, first + count) of source into a (count, features) batch.
+template<typename T>
+void gather_rows(const Tensor<T, 2>& source, const std::vector<size_t>& order, size_t first, size_t count,
+                 Tensor<T, 2>& batch) {
+  const size_t features = source.shape()[1];
+  resize(batch, {count, features});
+  for (size_t i = 0; i < count; ++i)
+    std::copy_n(source.data() + order[first + i] * features, features, batch.data() + i * features);
+}
+
+// Sets order to 0, ..., samples - 1 unless it already holds a permutation of that many
+// samples, so that consecutive train calls continue one sequence of shuffles.
+inline void prepare_order(std::vector<size_t>& order, size_t samples) {
+  if (order.size() == samples) return;
+  order.resize(samples);
+  std::iota(order.begin(), order.end(), size_t{0});
+}
+
+}
+
+// A sequence of layers trained with minibatch gradient descent. Each step runs the
+// whole (batch, features) minibatch through the layers as matrices. The minibatch
+// copies, the layer buffers, the loss gradient and the optimizer state get their
+// storage on the first step and keep it afterwards (a shorter final batch only shrinks
+// them), so steady-state training does not allocate. The loss and the optimizer are
+// kept across train calls: momenta and Adam's moments and step count carry on from one
+// call to the next.
+template<typename T>
+class NeuralNetwork {
+ private:
+  std::vector<std::unique_ptr<ILayer<T>>> layers_;
+  std::vector<parameter<T>> parameters_;
+  Tensor<T, 2> batch_input_;
+  Tensor<T, 2> batch_target_;
+  std::vector<size_t> order_;
+  std::mt19937 engine_;
+  std::unique_ptr<IOptimizer<T>> optimizer_;
+  std::any loss_;
+
+  template<template<typename> class Loss>
+  Loss<T>& loss_for() {
+    if (auto* loss = std::any_cast<Loss<T>>(&loss_)) return *loss;
+    return loss_.template emplace<Loss<T>>();
+  }
+
+  // A captured training step for minibatches of one size.
+  struct planned_step {
+    Tensor<T, 2> input;
+    Tensor<T, 2> target;
+    Graph<T> graph;
+  };
+  std::deque<planned_step> planned_;
+
+  planned_step& planned_for(size_t rows, size_t features, size_t outputs) {
+    for (auto& s : planned_)
+      if (s.input.shape()[0] == rows && s.input.shape()[1] == features && s.target.shape()[1] == outputs) return s;
+    planned_step& s = planned_.emplace_back();
+    s.input = Tensor<T, 2>(rows, features);
+    s.target = Tensor<T, 2>(rows, outputs);
+    s.graph.backward(mse(capture(s.graph, s.input), s.graph.input(s.target)));
+    s.graph.compile();
+    return s;
+  }
+
+  // One optimizer step on a minibatch; returns its loss.
+  template<typename Loss, typename Optimizer>
+  T step(Loss& loss, Optimizer& optimizer, const Tensor<T, 2>& input, const Tensor<T, 2>& target) {
+    UTEC_PROFILE_SCOPE("NeuralNetwork.step", 0);
+    const T value = loss.compute(forward(input), target);
+    const Tensor<T, 2>* gradient = &loss.gradient();
+    for (size_t i = layers_.size(); i-- > 0;) gradient = &layers_[i]->backward(*gradient);
+    optimizer.step(parameters_);
+    return value;
+  }
+
+  // The bodies of the train overloads.
+  template<typename Loss, typename Optimizer>
+  T fit(Loss& loss, Optimizer& optimizer, const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs,
+        size_t batch_size) {
+    if (layers_.empty()) throw std::runtime_error("NeuralNetwork has no layers");
+    if (X.shape()[0] != Y.shape()[0])
+      throw std::runtime_error("Inputs and targets have a different number of samples");
+    if (batch_size == 0) throw std::runtime_error("Batch size must be positive");
+
+    const size_t samples = X.shape()[0];
+    layers_.front()->set_input_gradient(false);
+    detail::prepare_order(order_, samples);
+
+    T epoch_loss{0};
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+      std::shuffle(order_.begin(), order_.end(), engine_);
+      epoch_loss = T{0};
+      for (size_t first = 0; first < samples; first += batch_size) {
+        const size_t count = std::min(batch_size, samples - first);
+        detail::gather_rows(X, order_, first, count, batch_input_);
+        detail::gather_rows(Y, order_, first, count, batch_target_);
+        epoch_loss += step(loss, optimizer, batch_input_, batch_target_) * T(count);
+      }
+      epoch_loss /= T(std::max<size_t>(1, samples));
+    }
+    return epoch_loss;
+  }
+
+  template<typename Loss, typename Optimizer, typename Loader>
+  T fit_loader(Loss& loss, Optimizer& optimizer, Loader& loader, size_t epochs) {
+    if (layers_.empty()) throw std::runtime_error("NeuralNetwork has no layers");
+    layers_.front()->set_input_gradient(false);
+
+    T epoch_loss{0};
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+      epoch_loss = T{0};
+      size_t samples = 0;
+      while (const auto* batch = loader.next()) {
+        epoch_loss += step(loss, optimizer, batch->inputs, batch->targets) * T(batch->rows());
+        samples += batch->rows();
+      }
+      epoch_loss /= T(std::max<size_t>(1, samples));
+    }
+    return epoch_loss;
+  }
+
+  template<typename Optimizer>
+  T fit_planned(Optimizer& optimizer, const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs,
+                size_t batch_size) {
+    if (layers_.empty()) throw std::runtime_error("NeuralNetwork has no layers");
+    if (X.shape()[0] != Y.shape()[0])
+      throw std::runtime_error("Inputs and targets have a different number of samples");
+    if (batch_size == 0) throw std::runtime_error("Batch size must be positive");
+
+    const size_t samples = X.shape()[0];
+    detail::prepare_order(order_, samples);
+
+    T epoch_loss{0};
+    for (size_t epoch = 0; epoch < epochs; ++epoch) {
+      std::shuffle(order_.begin(), order_.end(), engine_);
+      epoch_loss = T{0};
+      for (size_t first = 0; first < samples; first += batch_size) {
+        const size_t count = std::min(batch_size, samples - first);
+        planned_step& s = planned_for(count, X.shape()[1], Y.shape()[1]);
+        detail::gather_rows(X, order_, first, count, s.input);
+        detail::gather_rows(Y, order_, first, count, s.target);
+        s.graph.run();
+        optimizer.step(s.graph.parameters());
+        epoch_loss += s.graph.loss() * T(count);
+      }
+      epoch_loss /= T(std::max<size_t>(1, samples));
+    }
+    return epoch_loss;
+  }
+
+  IOptimizer<T>& configured_optimizer() {
+    if (!optimizer_) throw std::runtime_error("NeuralNetwork has no optimizer; set one or pass a learning rate");
+    return *optimizer_;
+  }
+
+ public:
+  // The seed drives the per-epoch shuffling of the training samples.
+  explicit NeuralNetwork(unsigned seed = 42) : engine_(seed) {}
+
+  void add_layer(std::unique_ptr<ILayer<T>> layer) {
+    auto layer_parameters = layer->parameters();
+    parameters_.insert(parameters_.end(), layer_parameters.begin(), layer_parameters.end());
+    layers_.push_back(std::move(layer));
+  }
+
+  // Constructs a Layer in place, e.g. net.emplace_layer<Dense<float, ReLU>>(784, 128).
+  template<typename Layer, typename... Args>
+  Layer& emplace_layer(Args&&... args) {
+    auto layer = std::make_unique<Layer>(std::forward<Args>(args)...);
+    Layer& result = *layer;
+    add_layer(std::move(layer));
+    return result;
+  }
+
+  size_t num_layers() const { return layers_.size(); }
+  ILayer<T>& layer(size_t i) { return *layers_.at(i); }
+  const ILayer<T>& layer(size_t i) const { return *layers_.at(i); }
+  const std::vector<parameter<T>>& parameters() const { return parameters_; }
+
+  // The optimizer train steps with, or null before the first train call.
+  IOptimizer<T>* optimizer() const { return optimizer_.get(); }
+
+  // Replaces the optimizer (and its state), e.g. with a configured
+  // std::make_unique<SGD<T>>(0.1, 0.9); train calls without a learning rate step it.
+  void set_optimizer(std::unique_ptr<IOptimizer<T>> optimizer) { optimizer_ = std::move(optimizer); }
+
+  // The network's optimizer if it is an Optimizer<T>, with its learning rate set to
+  // learning_rate; otherwise it is replaced by a new Optimizer<T>(learning_rate).
+  template<template<typename> class Optimizer = SGD>
+  Optimizer<T>& use_optimizer(T learning_rate) {
+    if (auto* current = dynamic_cast<Optimizer<T>*>(optimizer_.get())) {
+      current->set_learning_rate(learning_rate);
+      return *current;
+    }
+    auto created = std::make_unique<Optimizer<T>>(learning_rate);
+    Optimizer<T>& result = *created;
+    optimizer_ = std::move(created);
+    return result;
+  }
+
+  // Output of the last layer, owned by that layer and valid until its next forward.
+  const Tensor<T, 2>& forward(const Tensor<T, 2>& input) {
+    if (layers_.empty()) throw std::runtime_error("NeuralNetwork has no layers");
+    const Tensor<T, 2>* current = &input;
+    for (auto& layer : layers_) current = &layer->forward(*current);
+    return *current;
+  }
+
+  Tensor<T, 2> predict(const Tensor<T, 2>& input) { return forward(input); }
+
+  // Records the forward pass over `input` into graph and returns the output value, to
+  // be combined with a loss and replayed with Graph::run (see graph.h).
+  GraphValue<T> capture(Graph<T>& graph, const Tensor<T, 2>& input) {
+    if (layers_.empty()) throw std::runtime_error("NeuralNetwork has no layers");
+    size_t current = graph.input(input).id;
+    for (auto& layer : layers_) current = layer->capture_into(graph, current);
+    return {&graph, current};
+  }
+
+  // Runs `epochs` passes over the samples (rows) of X and Y in a fresh random order,
+  // one optimizer step per minibatch of batch_size rows, with use_optimizer<Optimizer>.
+  // Returns the mean loss of the last epoch.
+  template<template<typename> class Loss = MSELoss, template<typename> class Optimizer = SGD>
+  T train(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size, T learning_rate) {
+    return fit(loss_for<Loss>(), use_optimizer<Optimizer>(learning_rate), X, Y, epochs, batch_size);
+  }
+
+  // Same, stepping the optimizer given to set_optimizer (or left by an earlier call).
+  template<template<typename> class Loss = MSELoss>
+  T train(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size) {
+    return fit(loss_for<Loss>(), configured_optimizer(), X, Y, epochs, batch_size);
+  }
+
+  // Same as above over the minibatches of a DataLoader (see data_loader.h), which
+  // does the reading and shuffling on its own thread; one epoch is one pass over its
+  // files.
+  template<template<typename> class Loss = MSELoss, template<typename> class Optimizer = SGD, typename Loader>
+  T train(Loader& loader, size_t epochs, T learning_rate) {
+    return fit_loader(loss_for<Loss>(), use_optimizer<Optimizer>(learning_rate), loader, epochs);
+  }
+
+  template<template<typename> class Loss = MSELoss, typename Loader>
+  T train(Loader& loader, size_t epochs) {
+    return fit_loader(loss_for<Loss>(), configured_optimizer(), loader, epochs);
+  }
+
+  // train() with MSELoss, with each step replayed from a captured Graph (see graph.h).
+  // A step's activations and gradients are placed by a liveness plan in one arena, so
+  // peak memory is that of the values live at once, and after the first epoch nothing
+  // is allocated. One graph is captured per minibatch size (two when the last batch is
+  // shorter) and kept for later calls. Every layer must support graph capture; the
+  // graphs share the layers' parameters and gradients.
+  template<template<typename> class Optimizer = SGD>
+  T train_planned(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size, T learning_rate) {
+    return fit_planned(use_optimizer<Optimizer>(learning_rate), X, Y, epochs, batch_size);
+  }
+
+  T train_planned(const Tensor<T, 2>& X, const Tensor<T, 2>& Y, size_t epochs, size_t batch_size) {
+    return fit_planned(configured_optimizer(), X, Y, epochs, batch_size);
+  }
+
+  // Arena bytes of the graph train_planned uses for minibatches of `rows`, or 0 when
+  // none was captured.
+  size_t planned_bytes(size_t rows) const {
+    for (const auto& s : planned_)
+      if (s.input.shape()[0] == rows) return s.graph.planned_bytes();
+    return 0;
+  }
+};
+
+}
+
 #endif //NEURAL_NETWORK_H
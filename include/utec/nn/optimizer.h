@@ -0,0 +1,246 @@
+//
+// Optimizers that update layer parameters in place from their gradients.
+//
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/simd.h"
+#include "utec/nn/layer.h"
+
+namespace utec::neural_network {
+
+namespace optimizer {
+
+namespace simd = algebra::simd;
+
+// velocity = momentum * velocity + g; w -= learning_rate * velocity. Without momentum
+// velocity is unused and this is w -= learning_rate * g.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void sgd_body(size_t n, T learning_rate, T momentum, T* UTEC_RESTRICT w,
+                                 const T* UTEC_RESTRICT g, T* UTEC_RESTRICT velocity) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  const P lr = P::broadcast(learning_rate);
+  size_t i = 0;
+  if (velocity == nullptr) {
+    for (; i + L <= n; i += L) (P::load(w + i) - lr * P::load(g + i)).store(w + i);
+    for (; i < n; ++i) w[i] -= learning_rate * g[i];
+    return;
+  }
+  const P mu = P::broadcast(momentum);
+  for (; i + L <= n; i += L) {
+    const P v = simd::fmadd(mu, P::load(velocity + i), P::load(g + i));
+    v.store(velocity + i);
+    (P::load(w + i) - lr * v).store(w + i);
+  }
+  for (; i < n; ++i) {
+    velocity[i] = momentum * velocity[i] + g[i];
+    w[i] -= learning_rate * velocity[i];
+  }
+}
+
+// m = beta1 m + (1 - beta1) g; v = beta2 v + (1 - beta2) g^2;
+// w -= step_size * m / (sqrt(v) + epsilon), with the bias corrections of the current
+// step already folded into step_size and epsilon.
+template<typename T, size_t Bytes>
+UTEC_ALWAYS_INLINE void adam_body(size_t n, T step_size, T beta1, T beta2, T epsilon, T* UTEC_RESTRICT w,
+                                  const T* UTEC_RESTRICT g, T* UTEC_RESTRICT m, T* UTEC_RESTRICT v) {
+  using P = simd::packet<T, Bytes>;
+  constexpr size_t L = P::lanes;
+  const P b1 = P::broadcast(beta1), c1 = P::broadcast(T{1} - beta1);
+  const P b2 = P::broadcast(beta2), c2 = P::broadcast(T{1} - beta2);
+  const P lr = P::broadcast(step_size), eps = P::broadcast(epsilon);
+  size_t i = 0;
+  for (; i + L <= n; i += L) {
+    const P gi = P::load(g + i);
+    const P mi = simd::fmadd(b1, P::load(m + i), c1 * gi);
+    const P vi = simd::fmadd(b2, P::load(v + i), c2 * gi * gi);
+    mi.store(m + i);
+    vi.store(v + i);
+    (P::load(w + i) - lr * mi / (simd::sqrt(vi) + eps)).store(w + i);
+  }
+  for (; i < n; ++i) {
+    m[i] = beta1 * m[i] + (T{1} - beta1) * g[i];
+    v[i] = beta2 * v[i] + (T{1} - beta2) * g[i] * g[i];
+    w[i] -= step_size * m[i] / (std::sqrt(v[i]) + epsilon);
+  }
+}
+
+template<typename T>
+using sgd_kernel = void (*)(size_t, T, T, T*, const T*, T*);
+
+template<typename T>
+using adam_kernel = void (*)(size_t, T, T, T, T, T*, const T*, T*, T*);
+
+template<typename T>
+void sgd_native(size_t n, T learning_rate, T momentum, T* w, const T* g, T* velocity) {
+  sgd_body<T, simd::native_bytes>(n, learning_rate, momentum, w, g, velocity);
+}
+
+template<typename T>
+void adam_native(size_t n, T step_size, T beta1, T beta2, T epsilon, T* w, const T* g, T* m, T* v) {
+  adam_body<T, simd::native_bytes>(n, step_size, beta1, beta2, epsilon, w, g, m, v);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T>
+UTEC_TARGET_AVX2 void sgd_avx2(size_t n, T learning_rate, T momentum, T* w, const T* g, T* velocity) {
+  sgd_body<T, 32>(n, learning_rate, momentum, w, g, velocity);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 void sgd_avx512(size_t n, T learning_rate, T momentum, T* w, const T* g, T* velocity) {
+  sgd_body<T, 64>(n, learning_rate, momentum, w, g, velocity);
+}
+
+template<typename T>
+UTEC_TARGET_AVX2 void adam_avx2(size_t n, T step_size, T beta1, T beta2, T epsilon, T* w, const T* g, T* m, T* v) {
+  adam_body<T, 32>(n, step_size, beta1, beta2, epsilon, w, g, m, v);
+}
+
+template<typename T>
+UTEC_TARGET_AVX512 void adam_avx512(size_t n, T step_size, T beta1, T beta2, T epsilon, T* w, const T* g, T* m,
+                                    T* v) {
+  adam_body<T, 64>(n, step_size, beta1, beta2, epsilon, w, g, m, v);
+}
+#endif
+
+template<typename T>
+sgd_kernel<T> select_sgd() {
+  return algebra::dispatch::select(&sgd_native<T> UTEC_DISPATCH_VARIANTS(, &sgd_avx2<T>, &sgd_avx512<T>));
+}
+
+template<typename T>
+adam_kernel<T> select_adam() {
+  return algebra::dispatch::select(&adam_native<T> UTEC_DISPATCH_VARIANTS(, &adam_avx2<T>, &adam_avx512<T>));
+}
+
+// Per-parameter state buffers (momentum, moments), allocated on the first step.
+template<typename T>
+using state = std::vector<T, algebra::aligned_allocator<T>>;
+
+template<typename T>
+void prepare(std::vector<state<T>>& buffers, const std::vector<parameter<T>>& parameters) {
+  if (buffers.empty()) {
+    for (const auto& p : parameters) buffers.emplace_back(p.value->size(), T{0});
+    return;
+  }
+  bool matches = buffers.size() == parameters.size();
+  for (size_t i = 0; matches && i < parameters.size(); ++i) matches = buffers[i].size() == parameters[i].value->size();
+  if (!matches) throw std::runtime_error("Optimizer parameters changed between steps");
+}
+
+template<typename T>
+size_t elements(const std::vector<parameter<T>>& parameters) {
+  size_t total = 0;
+  for (const auto& p : parameters) total += p.value->size();
+  return total;
+}
+
+}
+
+// What NeuralNetwork holds its optimizer through, so that one optimizer and its state
+// persist across train calls.
+template<typename T>
+class IOptimizer {
+ public:
+  virtual ~IOptimizer() = default;
+
+  virtual void step(const std::vector<parameter<T>>& parameters) = 0;
+  virtual T learning_rate() const = 0;
+  virtual void set_learning_rate(T learning_rate) = 0;
+};
+
+// Stochastic gradient descent with optional (heavy-ball) momentum. Each parameter is
+// updated in one vectorized pass over its value, gradient and velocity; tensors larger
+// than the parallel grain size are split across threads.
+template<typename T>
+class SGD final : public IOptimizer<T> {
+ private:
+  T learning_rate_;
+  T momentum_;
+  optimizer::sgd_kernel<T> kernel_;
+  std::vector<optimizer::state<T>> velocity_;
+
+ public:
+  explicit SGD(T learning_rate, T momentum = T{0})
+      : learning_rate_(learning_rate), momentum_(momentum), kernel_(optimizer::select_sgd<T>()) {}
+
+  T learning_rate() const override { return learning_rate_; }
+  void set_learning_rate(T learning_rate) override { learning_rate_ = learning_rate; }
+  T momentum() const { return momentum_; }
+
+  void step(const std::vector<parameter<T>>& parameters) override {
+    UTEC_PROFILE_SCOPE("SGD.step", (momentum_ != T{0} ? 4 : 2) * optimizer::elements(parameters));
+    if (momentum_ != T{0}) optimizer::prepare(velocity_, parameters);
+    for (size_t k = 0; k < parameters.size(); ++k) {
+      T* w = parameters[k].value->data();
+      const T* g = parameters[k].gradient->data();
+      T* velocity = momentum_ != T{0} ? velocity_[k].data() : nullptr;
+      algebra::parallel::parallel_for(0, parameters[k].value->size(), algebra::parallel::grain_size(),
+                                      [&](size_t first, size_t last) {
+        kernel_(last - first, learning_rate_, momentum_, w + first, g + first, velocity ? velocity + first : nullptr);
+      });
+    }
+  }
+};
+
+// Adam (Kingma & Ba) with bias-corrected moments, fused like SGD: one pass per
+// parameter reads the gradient once and updates both moments and the value.
+template<typename T>
+class Adam final : public IOptimizer<T> {
+ private:
+  T learning_rate_;
+  T beta1_;
+  T beta2_;
+  T epsilon_;
+  size_t steps_ = 0;
+  optimizer::adam_kernel<T> kernel_;
+  std::vector<optimizer::state<T>> first_moment_;
+  std::vector<optimizer::state<T>> second_moment_;
+
+ public:
+  explicit Adam(T learning_rate, T beta1 = T(0.9), T beta2 = T(0.999), T epsilon = T(1e-8))
+      : learning_rate_(learning_rate), beta1_(beta1), beta2_(beta2), epsilon_(epsilon),
+        kernel_(optimizer::select_adam<T>()) {}
+
+  T learning_rate() const override { return learning_rate_; }
+  void set_learning_rate(T learning_rate) override { learning_rate_ = learning_rate; }
+  size_t steps() const { return steps_; }
+
+  void step(const std::vector<parameter<T>>& parameters) override {
+    UTEC_PROFILE_SCOPE("Adam.step", 12 * optimizer::elements(parameters));
+    optimizer::prepare(first_moment_, parameters);
+    optimizer::prepare(second_moment_, parameters);
+    ++steps_;
+    // m_hat / (sqrt(v_hat) + eps) == m * sqrt(c2) / c1 / (sqrt(v) + eps * sqrt(c2)).
+    const T c1 = T{1} - std::pow(beta1_, T(steps_));
+    const T root_c2 = std::sqrt(T{1} - std::pow(beta2_, T(steps_)));
+    const T step_size = learning_rate_ * root_c2 / c1;
+    const T epsilon = epsilon_ * root_c2;
+    for (size_t k = 0; k < parameters.size(); ++k) {
+      T* w = parameters[k].value->data();
+      const T* g = parameters[k].gradient->data();
+      T* m = first_moment_[k].data();
+      T* v = second_moment_[k].data();
+      algebra::parallel::parallel_for(0, parameters[k].value->size(), algebra::parallel::grain_size(),
+                                      [&](size_t first, size_t last) {
+        kernel_(last - first, step_size, beta1_, beta2_, epsilon, w + first, g + first, m + first, v + first);
+      });
+    }
+  }
+};
+
+}
+
+#endif //OPTIMIZER_H
@@ -0,0 +1,277 @@
+//
+// Int8 single-observation inference: per-channel quantized weights and calibrated
+// activation scales.
+//
+
+#ifndef QUANTIZED_NETWORK_H
+#define QUANTIZED_NETWORK_H
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/quantized.h"
+#include "utec/algebra/simd.h"
+#include "utec/nn/inference.h"
+#include "utec/nn/layer.h"
+
+namespace utec::neural_network {
+
+template<typename T>
+class Identity;
+
+namespace quantized {
+
+namespace simd = algebra::simd;
+
+// One stage of a QuantizedNetwork. Widths past `out` are padded as in inference.h,
+// with zero scales and biases.
+template<typename T>
+struct stage;
+
+// y[0:out) = f(dequantize(quantize(x[0:in)) W) + b) for a dense stage, through the
+// int8 buffer q and the int32 buffer acc; y = f(x) for an activation stage.
+template<typename T>
+using stage_kernel = void (*)(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y);
+
+// f over n values in place, for the float calibration pass.
+template<typename T>
+using activation_kernel = void (*)(size_t n, T* y);
+
+template<typename T>
+struct stage {
+  stage_kernel<T> kernel = nullptr;
+  activation_kernel<T> activation = nullptr;
+  algebra::quantization::gemm_kernel gemm = nullptr;
+  algebra::QuantizedTensor weights;
+  std::vector<T, algebra::aligned_allocator<T>> scales;  // input scale times each column's weight scale
+  std::vector<T, algebra::aligned_allocator<T>> bias;
+  float input_scale = 1;
+  size_t in = 0;
+  size_t out = 0;
+  bool dense = false;
+  bool foldable = false;
+};
+
+template<typename T, typename Activation>
+void activate(size_t n, T* y) {
+  for (size_t i = 0; i < n; ++i) y[i] = Activation::activate(y[i]);
+}
+
+template<typename T, size_t Bytes, typename Activation>
+UTEC_ALWAYS_INLINE void dense(const stage<T>& s, const T* UTEC_RESTRICT x, int8_t* UTEC_RESTRICT q,
+                              int32_t* UTEC_RESTRICT acc, T* UTEC_RESTRICT y) {
+  using P = simd::packet<T, Bytes>;
+  algebra::quantization::quantize<T, Bytes>(s.in, x, 1.0f / s.input_scale, q);
+  s.gemm(0, 1, s.in, s.weights.columns(), q, s.in, s.weights.packed(), s.weights.packed_bias(), acc, s.out);
+  for (size_t j = 0; j < s.out; j += P::lanes) {
+    P sum;
+    for (size_t i = 0; i < P::lanes; ++i) sum.v[i] = T(acc[j + i]);
+    Activation::activate(sum * P::load(s.scales.data() + j) + P::load(s.bias.data() + j)).store(y + j);
+  }
+}
+
+template<typename T, size_t Bytes, typename Activation>
+UTEC_ALWAYS_INLINE void activation(const stage<T>& s, const T* UTEC_RESTRICT x, int8_t*, int32_t*,
+                                   T* UTEC_RESTRICT y) {
+  using P = simd::packet<T, Bytes>;
+  for (size_t j = 0; j < s.out; j += P::lanes) Activation::activate(P::load(x + j)).store(y + j);
+}
+
+template<typename T, typename Activation>
+void dense_native(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  dense<T, simd::native_bytes, Activation>(s, x, q, acc, y);
+}
+
+template<typename T, typename Activation>
+void activation_native(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  activation<T, simd::native_bytes, Activation>(s, x, q, acc, y);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+template<typename T, typename Activation>
+UTEC_TARGET_AVX2 void dense_avx2(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  dense<T, 32, Activation>(s, x, q, acc, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX512 void dense_avx512(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  dense<T, 64, Activation>(s, x, q, acc, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX2 void activation_avx2(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  activation<T, 32, Activation>(s, x, q, acc, y);
+}
+
+template<typename T, typename Activation>
+UTEC_TARGET_AVX512 void activation_avx512(const stage<T>& s, const T* x, int8_t* q, int32_t* acc, T* y) {
+  activation<T, 64, Activation>(s, x, q, acc, y);
+}
+#endif
+
+template<typename T, typename Activation>
+stage_kernel<T> select_dense() {
+  return algebra::dispatch::select(&dense_native<T, Activation>
+                                   UTEC_DISPATCH_VARIANTS(, &dense_avx2<T, Activation>, &dense_avx512<T, Activation>));
+}
+
+template<typename T, typename Activation>
+stage_kernel<T> select_activation() {
+  return algebra::dispatch::select(&activation_native<T, Activation>
+                                   UTEC_DISPATCH_VARIANTS(, &activation_avx2<T, Activation>,
+                                                          &activation_avx512<T, Activation>));
+}
+
+}
+
+// Post-training int8 copy of a layer sequence for one observation at a time, the
+// quantized counterpart of FrozenNetwork (see inference.h). Building it (through
+// ILayer::quantize_into) quantizes every Dense weight matrix per output channel into a
+// QuantizedTensor and calibrates one scale per Dense input: the largest |x| that input
+// takes in a float pass over the calibration samples. forward() quantizes each input,
+// runs the int8 product into int32 and converts back with y = f(acc sx sw + b) in
+// the same kernel; the float weights are not kept.
+template<typename T>
+class QuantizedNetwork {
+ private:
+  using stage = quantized::stage<T>;
+
+  std::vector<stage> stages_;
+  std::vector<Tensor<T, 2>> float_weights_;  // only while calibrating
+  std::vector<T, algebra::aligned_allocator<T>> buffers_;
+  std::vector<int8_t, algebra::aligned_allocator<int8_t>> quantized_input_;
+  std::vector<int32_t, algebra::aligned_allocator<int32_t>> accumulators_;
+  size_t inputs_ = 0;
+  size_t outputs_ = 0;
+  size_t width_ = 0;
+
+  // The float forward pass over the samples, recording the input range of every Dense.
+  void calibrate(const Tensor<T, 2>& samples) {
+    if (samples.shape()[0] == 0) throw std::runtime_error("Calibration needs at least one sample");
+    if (samples.shape()[1] != inputs_) throw std::runtime_error("Calibration samples do not match the network input");
+    Tensor<T, 2> x = samples;
+    Tensor<T, 2> y;
+    size_t dense = 0;
+    for (auto& s : stages_) {
+      if (s.dense) {
+        T max_abs{0};
+        for (const T v : x) max_abs = std::max(max_abs, std::abs(v));
+        s.input_scale = algebra::quantization::scale_for(float(max_abs));
+        algebra::matrix_product(x, float_weights_[dense++], y);
+        for (size_t r = 0; r < y.shape()[0]; ++r)
+          for (size_t j = 0; j < y.shape()[1]; ++j) y(r, j) += s.bias[j];
+        std::swap(x, y);
+      }
+      if (s.activation != nullptr) s.activation(x.size(), x.data());
+    }
+  }
+
+ public:
+  template<typename Layers>
+  QuantizedNetwork(const Layers& layers, const Tensor<T, 2>& calibration_samples) {
+    for (size_t i = 0; i < layers.num_layers(); ++i) layers.layer(i).quantize_into(*this);
+    if (stages_.empty()) throw std::runtime_error("Cannot quantize a network without layers");
+    calibrate(calibration_samples);
+
+    size_t dense = 0;
+    width_ = inference::padded<T>(inputs_);
+    for (auto& s : stages_) {
+      width_ = std::max(width_, s.out);
+      if (!s.dense) continue;
+      s.weights = algebra::QuantizedTensor(float_weights_[dense++]);
+      for (size_t j = 0; j < s.weights.columns(); ++j) s.scales[j] = T(s.input_scale * s.weights.scale(j));
+    }
+    float_weights_.clear();
+    float_weights_.shrink_to_fit();
+    buffers_.assign(2 * width_, T{0});
+    quantized_input_.assign(width_, 0);
+    accumulators_.assign(width_, 0);
+  }
+
+  // Called by Dense::quantize_into.
+  template<typename Activation>
+  void add_dense(const Tensor<T, 2>& weights, const Tensor<T, 2>& bias) {
+    const size_t in = weights.shape()[0];
+    const size_t out = weights.shape()[1];
+    if (stages_.empty()) inputs_ = in;
+    else if (in != outputs_) throw std::runtime_error("Layer sizes do not chain");
+    stage s;
+    s.kernel = quantized::select_dense<T, Activation>();
+    s.gemm = algebra::quantization::select_gemm();
+    s.in = in;
+    s.out = inference::padded<T>(out);
+    s.scales.assign(s.out, T{0});
+    s.bias.assign(s.out, T{0});
+    std::copy_n(bias.data(), out, s.bias.begin());
+    s.dense = true;
+    if constexpr (std::is_same_v<Activation, Identity<T>>) s.foldable = true;
+    else s.activation = &quantized::activate<T, Activation>;
+    float_weights_.push_back(weights);
+    stages_.push_back(std::move(s));
+    outputs_ = out;
+  }
+
+  // Called by the activation layers' quantize_into.
+  template<typename Activation>
+  void add_activation() {
+    if (stages_.empty()) throw std::runtime_error("A quantized network must start with a Dense layer");
+    stage& last = stages_.back();
+    if (last.foldable) {
+      last.kernel = quantized::select_dense<T, Activation>();
+      last.activation = &quantized::activate<T, Activation>;
+      last.foldable = false;
+      return;
+    }
+    stage s;
+    s.kernel = quantized::select_activation<T, Activation>();
+    s.activation = &quantized::activate<T, Activation>;
+    s.in = s.out = last.out;
+    stages_.push_back(std::move(s));
+  }
+
+  size_t inputs() const { return inputs_; }
+  size_t outputs() const { return outputs_; }
+
+  // Storage of the quantized weights, their scales and the biases.
+  size_t parameter_bytes() const {
+    size_t bytes = 0;
+    for (const auto& s : stages_)
+      if (s.dense) bytes += s.weights.bytes() + (s.scales.size() + s.bias.size()) * sizeof(T);
+    return bytes;
+  }
+
+  // Calibrated scale of the input of the i-th Dense.
+  float input_scale(size_t i) const {
+    for (const auto& s : stages_)
+      if (s.dense && i-- == 0) return s.input_scale;
+    throw std::out_of_range("Quantized network has no such Dense layer");
+  }
+
+  // Reads inputs() values and returns a pointer to outputs() values, valid until the
+  // next call.
+  const T* forward(const T* input) noexcept {
+    UTEC_PROFILE_SCOPE("QuantizedNetwork.forward", 0);
+    T* x = buffers_.data();
+    T* y = x + width_;
+    std::copy_n(input, inputs_, x);
+    for (const auto& s : stages_) {
+      s.kernel(s, x, quantized_input_.data(), accumulators_.data(), y);
+      std::swap(x, y);
+    }
+    return x;
+  }
+};
+
+}
+
+#endif //QUANTIZED_NETWORK_H
@@ -1,6 +1,81 @@
+//
+// Created by Romina Valeria on 7/06/25.
+//
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <vector>
+
+#include "utec/agent/PongAgent.h"
+#include "utec/agent/inference_batcher.h"
+#include "utec/agent/scheduler.h"
+#include "utec/algebra/profiler.h"
+#include "utec/nn/dense.h"
+
+using namespace utec::agent;
+using namespace utec::neural_network;
+
+// Un episodio de hasta `steps` pasos; cada acción se pide al batcher compartido.
+task<void> evaluate(InferenceBatcher& batcher, unsigned seed, size_t steps, float& total) {
+    EnvGym env(seed);
+    State state = env.reset();
+    float reward = 0;
+    bool done = false;
+    for (size_t t = 0; t < steps && !done; ++t) {
+        state = env.step(co_await batcher.act(state), reward, done);
+        total += reward;
+    }
+}
 
 int main() {
-    std::cout << "Hola Mundo" << std::endl;
+    // Con -DUTEC_PROFILE=ON, UTEC_TRACE=archivo.json guarda la traza y muestra los contadores
+    namespace profiler = utec::algebra::profiler;
+    const char* trace = profiler::enabled ? std::getenv("UTEC_TRACE") : nullptr;
+    if (trace) profiler::start_trace();
+
+    auto make_network = [] {
+        NeuralNetwork<float> net;
+        net.emplace_layer<Dense<float, ReLU>>(state_dim, 32, 1);
+        net.emplace_layer<Dense<float>>(32, num_actions, 2);
+        return net;
+    };
+
+    ActorLearner pipeline(make_network);
+    const ActorLearnerStats stats = pipeline.run();
+    std::cout << "Transiciones: " << stats.transitions << ", pasos de entrenamiento: " << stats.train_steps
+              << ", pesos publicados: " << stats.published << ", episodios: " << stats.episodes
+              << ", recompensa total: " << stats.total_reward << std::endl;
+
+    // Evaluación sin exploración
+    PongAgent& agent = pipeline.agent();
+    EnvGym env(2025);
+    State state = env.reset();
+    float reward = 0, total = 0;
+    bool done = false;
+    size_t steps = 0;
+    for (; steps < 5000 && !done; ++steps) {
+        state = env.step(agent.act(state), reward, done);
+        total += reward;
+    }
+    std::cout << "Evaluación: " << steps << " pasos, recompensa " << total << std::endl;
+
+    // Evaluación concurrente: cada entorno es una corrutina y sus consultas se agrupan en lotes
+    scheduler pool;
+    InferenceBatcher batcher(pool, make_network(), state_dim, {32, std::chrono::microseconds(200)});
+    batcher.load(*agent.snapshot(1));
+    std::vector<float> totals(64, 0.0f);
+    std::vector<task<void>> episodes;
+    for (unsigned e = 0; e < totals.size(); ++e) episodes.push_back(evaluate(batcher, 3000 + e, 1000, totals[e]));
+    pool.run(pool.when_all(std::move(episodes)));
+    float sum = 0;
+    for (const float t : totals) sum += t;
+    const InferenceBatcherStats batches = batcher.stats();
+    std::cout << "Evaluación concurrente: " << totals.size() << " entornos, " << batches.requests << " consultas en "
+              << batches.batches << " lotes, recompensa media " << sum / float(totals.size()) << std::endl;
+    if (trace) {
+        profiler::stop_trace();
+        profiler::write_trace(trace);
+        profiler::print(std::cout);
+    }
     return 0;
 }
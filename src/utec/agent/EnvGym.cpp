@@ -1,3 +1,146 @@
 //
 // Created by Romina Valeria on 7/06/25.
 //
+
+#include "utec/agent/EnvGym.h"
+
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/transpose.h"
+
+namespace utec::agent {
+
+namespace {
+
+// Rows of VectorEnv::state_.
+enum component : size_t { ball_x, ball_y, ball_vx, ball_vy, paddle_y };
+
+// Comparisons would keep GCC from if-converting the loop (they may trap under the
+// default -ftrapping-math), so the step is written with abs and copysign only, which
+// lower to bit operations and let every variant vectorize.
+
+// v clamped to [lo, hi].
+UTEC_ALWAYS_INLINE float clamp_between(float v, float lo, float hi) {
+  return 0.5f * (lo + hi + std::abs(v - lo) - std::abs(v - hi));
+}
+
+// 1 where v >= 0, 0 where v < 0.
+UTEC_ALWAYS_INLINE float non_negative(float v) { return 0.5f + std::copysign(0.5f, v); }
+
+// Advances n environments by one frame.
+UTEC_ALWAYS_INLINE void step_body(size_t n, float* UTEC_RESTRICT x, float* UTEC_RESTRICT y,
+                                  float* UTEC_RESTRICT vx, float* UTEC_RESTRICT vy, float* UTEC_RESTRICT paddle,
+                                  const int* UTEC_RESTRICT actions, float* UTEC_RESTRICT rewards,
+                                  float* UTEC_RESTRICT dones) {
+  for (size_t i = 0; i < n; ++i) {
+    const float move = clamp_between(float(actions[i]), -1.0f, 1.0f) * paddle_speed;
+    const float p = clamp_between(paddle[i] + move, paddle_half_height, 1.0f - paddle_half_height);
+    const float moved_x = x[i] + vx[i];
+    const float moved_y = y[i] + vy[i];
+    // Reflections off the left wall and off the top and bottom walls.
+    const float bx = std::abs(moved_x);
+    const float by = 1.0f - std::abs(1.0f - std::abs(moved_y));
+    const float reached = non_negative(bx - 1.0f);
+    const float hit = reached * non_negative(paddle_half_height - std::abs(by - p));
+    x[i] = bx - 2.0f * hit * (bx - 1.0f);
+    y[i] = by;
+    vx[i] = std::copysign(1.0f, moved_x) * (1.0f - 2.0f * hit) * vx[i];
+    vy[i] = std::copysign(1.0f, moved_y * (1.0f - moved_y)) * vy[i];
+    paddle[i] = p;
+    rewards[i] = 2.0f * hit - reached;
+    dones[i] = reached - hit;
+  }
+}
+
+using step_kernel = void (*)(size_t, float*, float*, float*, float*, float*, const int*, float*, float*);
+
+void step_native(size_t n, float* x, float* y, float* vx, float* vy, float* paddle, const int* actions,
+                 float* rewards, float* dones) {
+  step_body(n, x, y, vx, vy, paddle, actions, rewards, dones);
+}
+
+#if UTEC_RUNTIME_DISPATCH
+UTEC_TARGET_AVX2 void step_avx2(size_t n, float* x, float* y, float* vx, float* vy, float* paddle,
+                                const int* actions, float* rewards, float* dones) {
+  step_body(n, x, y, vx, vy, paddle, actions, rewards, dones);
+}
+
+UTEC_TARGET_AVX512 void step_avx512(size_t n, float* x, float* y, float* vx, float* vy, float* paddle,
+                                    const int* actions, float* rewards, float* dones) {
+  step_body(n, x, y, vx, vy, paddle, actions, rewards, dones);
+}
+#endif
+
+step_kernel select_step_kernel() {
+  return algebra::dispatch::select(&step_native UTEC_DISPATCH_VARIANTS(, &step_avx2, &step_avx512));
+}
+
+// Ball in the middle of the left half heading right at a random angle, paddle centred.
+State initial_state(std::mt19937& engine) {
+  std::uniform_real_distribution<float> height(0.2f, 0.8f);
+  std::uniform_real_distribution<float> angle(-std::numbers::pi_v<float> / 4, std::numbers::pi_v<float> / 4);
+  const float theta = angle(engine);
+  return {0.25f, height(engine), ball_speed * std::cos(theta), ball_speed * std::sin(theta), 0.5f};
+}
+
+}
+
+EnvGym::EnvGym(unsigned seed) : engine_(seed) { reset(); }
+
+State EnvGym::reset() {
+  state_ = initial_state(engine_);
+  return state_;
+}
+
+State EnvGym::step(int action, float& reward, bool& done) {
+  float ended = 0.0f;
+  step_body(1, &state_.ball_x, &state_.ball_y, &state_.ball_vx, &state_.ball_vy, &state_.paddle_y, &action,
+            &reward, &ended);
+  done = ended != 0.0f;
+  return state_;
+}
+
+VectorEnv::VectorEnv(size_t envs, unsigned seed)
+    : state_(state_dim, envs), observation_(envs, state_dim), rewards_(envs), dones_(envs), engine_(seed) {
+  if (envs == 0) throw std::runtime_error("VectorEnv needs at least one environment");
+  reset();
+}
+
+void VectorEnv::reset_env(size_t i) {
+  const State s = initial_state(engine_);
+  state_(ball_x, i) = s.ball_x;
+  state_(ball_y, i) = s.ball_y;
+  state_(ball_vx, i) = s.ball_vx;
+  state_(ball_vy, i) = s.ball_vy;
+  state_(paddle_y, i) = s.paddle_y;
+}
+
+void VectorEnv::observe() {
+  algebra::transpose::transpose(1, state_dim, size(), state_.data(), size(), 0, observation_.data(), state_dim, 0);
+}
+
+const Tensor<float, 2>& VectorEnv::reset() {
+  for (size_t i = 0; i < size(); ++i) reset_env(i);
+  rewards_.fill(0.0f);
+  dones_.fill(0.0f);
+  observe();
+  return observation_;
+}
+
+const Tensor<float, 2>& VectorEnv::step(std::span<const int> actions) {
+  if (actions.size() != size()) throw std::runtime_error("Number of actions does not match the number of environments");
+  static const step_kernel kernel = select_step_kernel();
+  const size_t n = size();
+  float* s = state_.data();
+  kernel(n, s + ball_x * n, s + ball_y * n, s + ball_vx * n, s + ball_vy * n, s + paddle_y * n, actions.data(),
+         rewards_.data(), dones_.data());
+  for (size_t i = 0; i < n; ++i)
+    if (dones_.data()[i] != 0.0f) reset_env(i);
+  observe();
+  return observation_;
+}
+
+}
@@ -1,3 +1,190 @@
 //
 // Created by Romina Valeria on 7/06/25.
 //
+
+#include "utec/agent/PongAgent.h"
+
+#include <algorithm>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "utec/agent/bounded_queue.h"
+#include "utec/algebra/reduction.h"
+
+namespace utec::agent {
+
+PongAgent::PongAgent(NeuralNetwork<float> network) : network_(std::move(network)), observation_(1, state_dim) {}
+
+int PongAgent::act(const State& state) {
+  write_state(state, observation_.data());
+  if (quantized_) {
+    const float* s = quantized_->forward(observation_.data());
+    return int(algebra::argmax(algebra::TensorView<const float, 1>(s, {num_actions}))) - 1;
+  }
+  if (frozen_) {
+    const float* s = frozen_->forward(observation_.data());
+    return int(algebra::argmax(algebra::TensorView<const float, 1>(s, {num_actions}))) - 1;
+  }
+  const Tensor<float, 2>& scores = network_.forward(observation_);
+  if (scores.shape()[1] != num_actions) throw std::runtime_error("PongAgent network must output one score per action");
+  return int(algebra::argmax(scores)) - 1;
+}
+
+void PongAgent::freeze() {
+  auto frozen = std::make_unique<FrozenNetwork<float>>(network_);
+  if (frozen->inputs() != state_dim || frozen->outputs() != num_actions)
+    throw std::runtime_error("PongAgent network must map a state to one score per action");
+  frozen_ = std::move(frozen);
+}
+
+void PongAgent::quantize(const std::vector<State>& calibration) {
+  Tensor<float, 2> samples(calibration.size(), state_dim);
+  for (size_t i = 0; i < calibration.size(); ++i) write_state(calibration[i], samples.data() + i * state_dim);
+  auto quantized = std::make_unique<QuantizedNetwork<float>>(network_, samples);
+  if (quantized->inputs() != state_dim || quantized->outputs() != num_actions)
+    throw std::runtime_error("PongAgent network must map a state to one score per action");
+  quantized_ = std::move(quantized);
+  calibration_ = std::move(samples);
+}
+
+void copy_weights(const WeightsSnapshot& snapshot, NeuralNetwork<float>& network) {
+  const auto& parameters = network.parameters();
+  if (snapshot.values.size() != parameters.size())
+    throw std::runtime_error("Snapshot does not match the network parameters");
+  for (size_t p = 0; p < parameters.size(); ++p) {
+    if (snapshot.values[p].shape() != parameters[p].value->shape())
+      throw std::runtime_error("Snapshot does not match the network parameters");
+    std::copy(snapshot.values[p].begin(), snapshot.values[p].end(), parameters[p].value->begin());
+  }
+}
+
+void PongAgent::load(const WeightsSnapshot& snapshot) {
+  if (snapshot.version == version_) return;
+  copy_weights(snapshot, network_);
+  if (frozen_) frozen_->refresh(network_);
+  if (quantized_) quantized_ = std::make_unique<QuantizedNetwork<float>>(network_, calibration_);
+  version_ = snapshot.version;
+}
+
+std::shared_ptr<const WeightsSnapshot> PongAgent::snapshot(size_t version) const {
+  auto snapshot = std::make_shared<WeightsSnapshot>();
+  snapshot->version = version;
+  for (const auto& p : network_.parameters()) snapshot->values.push_back(*p.value);
+  return snapshot;
+}
+
+ActorLearner::ActorLearner(std::function<NeuralNetwork<float>()> make_network, ActorLearnerConfig config)
+    : make_network_(std::move(make_network)), config_(config), learner_(make_network_()) {
+  if (config_.actors == 0 || config_.batch_size == 0 || config_.train_every == 0 || config_.publish_every == 0 ||
+      config_.replay_capacity < config_.batch_size)
+    throw std::runtime_error("Invalid actor/learner configuration");
+  if (config_.make_optimizer) learner_.network().set_optimizer(config_.make_optimizer(config_.learning_rate));
+  else learner_.network().use_optimizer<neural_network::SGD>(config_.learning_rate);
+  published_.store(learner_.snapshot(1));
+}
+
+ActorLearnerStats ActorLearner::run() {
+  bounded_queue<Transition> queue(config_.queue_capacity);
+  std::atomic<size_t> finished{0};
+  std::atomic<bool> stop{false};
+  std::vector<std::exception_ptr> errors(config_.actors);
+  std::vector<std::thread> actors;
+
+  for (size_t a = 0; a < config_.actors; ++a) {
+    actors.emplace_back([&, a] {
+      try {
+        PongAgent agent(make_network_());
+        agent.freeze();
+        std::mt19937 engine(config_.seed + 1 + unsigned(a));
+        std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+        std::uniform_int_distribution<int> random_action(-1, 1);
+        EnvGym env(config_.seed + 1 + unsigned(a));
+        State state = env.reset();
+        for (size_t step = 0; step < config_.steps_per_actor && !stop.load(std::memory_order_relaxed); ++step) {
+          agent.load(*published_.load(std::memory_order_acquire));
+          const int action = coin(engine) < config_.epsilon ? random_action(engine) : agent.act(state);
+          Transition t{state, action, 0.0f, {}, false};
+          t.next = env.step(action, t.reward, t.done);
+          while (!queue.try_push(t) && !stop.load(std::memory_order_relaxed)) std::this_thread::yield();
+          state = t.done ? env.reset() : t.next;
+        }
+      } catch (...) {
+        errors[a] = std::current_exception();
+      }
+      finished.fetch_add(1, std::memory_order_release);
+    });
+  }
+
+  ActorLearnerStats stats;
+  ReplayBuffer replay(config_.replay_capacity, config_.prioritized);
+  ReplayBatch sampled;
+  size_t pending = 0;
+  std::mt19937 engine(config_.seed);
+  const size_t batch = config_.batch_size;
+  Tensor<float, 2> targets(batch, num_actions);
+  Tensor<float, 2> next_values(batch, 1);
+  std::vector<float> td_targets(batch);
+  std::vector<float> priorities(batch);
+  NeuralNetwork<float>& network = learner_.network();
+
+  // With prioritized replay the squared error of sample i is weighted by w_i. Moving its
+  // target to q + w_i (y - q) gives the same gradient under the unweighted MSELoss.
+  auto train_step = [&] {
+    replay.sample(batch, engine, sampled);
+    algebra::max(network.forward(sampled.next_states), 1, next_values);
+    for (size_t i = 0; i < batch; ++i)
+      td_targets[i] = sampled.rewards(i) + (1.0f - sampled.dones(i)) * config_.gamma * next_values(i, 0);
+    const Tensor<float, 2>& scores = network.forward(sampled.states);
+    for (size_t i = 0; i < batch; ++i) {
+      for (size_t a = 0; a < num_actions; ++a) targets(i, a) = scores(i, a);
+      const size_t a = size_t(sampled.actions(i) + 1);
+      const float error = td_targets[i] - scores(i, a);
+      targets(i, a) = scores(i, a) + sampled.weights(i) * error;
+      priorities[i] = std::abs(error) + 1e-3f;
+    }
+    replay.update_priorities(sampled.indices, priorities);
+    network.train(sampled.states, targets, 1, batch);
+    if (++stats.train_steps % config_.publish_every == 0) {
+      published_.store(learner_.snapshot(stats.published + 2), std::memory_order_release);
+      ++stats.published;
+    }
+  };
+
+  std::exception_ptr learner_error;
+  try {
+    Transition t;
+    while (true) {
+      const bool actors_done = finished.load(std::memory_order_acquire) == config_.actors;
+      size_t drained = 0;
+      while (queue.try_pop(t)) {
+        ++drained;
+        replay.push(t);
+        ++stats.transitions;
+        stats.total_reward += t.reward;
+        stats.episodes += t.done;
+        if (++pending >= config_.train_every && replay.size() >= batch) {
+          pending = 0;
+          train_step();
+        }
+      }
+      if (drained == 0) {
+        if (actors_done) break;
+        std::this_thread::yield();
+      }
+    }
+  } catch (...) {
+    learner_error = std::current_exception();
+    stop.store(true, std::memory_order_relaxed);
+  }
+
+  for (auto& actor : actors) actor.join();
+  if (learner_error) std::rethrow_exception(learner_error);
+  for (const auto& error : errors)
+    if (error) std::rethrow_exception(error);
+  return stats;
+}
+
+}
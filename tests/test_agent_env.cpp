@@ -1,3 +1,480 @@
 //
 // Created by Romina Valeria on 7/06/25.
 //
+
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "utec/agent/EnvGym.h"
+#include "utec/agent/PongAgent.h"
+#include "utec/agent/bounded_queue.h"
+#include "utec/agent/inference_batcher.h"
+#include "utec/agent/replay_buffer.h"
+#include "utec/agent/scheduler.h"
+#include "utec/nn/dense.h"
+
+using namespace utec::agent;
+using namespace utec::neural_network;
+
+// Mueve la paleta hacia la altura de la pelota.
+int follow(float ball_y, float paddle_y) {
+    return ball_y > paddle_y + 0.01f ? 1 : ball_y < paddle_y - 0.01f ? -1 : 0;
+}
+
+void test_case_1() {
+    // EnvGym: siguiendo la pelota nunca se pierde; quieto, se pierde con recompensa -1
+    EnvGym env(5);
+    State s = env.reset();
+    float reward = 0, total = 0;
+    bool done = false;
+    for (int t = 0; t < 2000; ++t) {
+        s = env.step(follow(s.ball_y, s.paddle_y), reward, done);
+        assert(!done);
+        assert(s.ball_x >= 0 && s.ball_x <= 1 && s.ball_y >= 0 && s.ball_y <= 1);
+        total += reward;
+    }
+    assert(total > 0);
+
+    env.reset();
+    int steps = 0;
+    do {
+        s = env.step(s.ball_y > 0.5f ? -1 : 1, reward, done);
+        ++steps;
+    } while (!done && steps < 10000);
+    assert(done && reward == -1);
+    std::cout << "Caso 1 OK\n";
+}
+
+void test_case_2() {
+    // VectorEnv con un entorno reproduce EnvGym con la misma semilla
+    EnvGym single(9);
+    VectorEnv batch(1, 9);
+    float reward = 0;
+    bool done = false;
+    State s = single.state();
+    for (int t = 0; t < 500; ++t) {
+        const int action = (t / 7) % 3 - 1;
+        s = single.step(action, reward, done);
+        if (done) s = single.reset();
+        const std::vector<int> actions{action};
+        const auto& obs = batch.step(actions);
+        assert(obs(0, 0) == s.ball_x && obs(0, 1) == s.ball_y && obs(0, 4) == s.paddle_y);
+        assert(batch.rewards()(0) == reward && batch.dones()(0) == (done ? 1.0f : 0.0f));
+    }
+    std::cout << "Caso 2 OK\n";
+}
+
+void test_case_3() {
+    // VectorEnv: observaciones (B, state_dim) y número de acciones incorrecto
+    VectorEnv env(37);
+    const auto& obs = env.reset();
+    assert(obs.shape()[0] == 37 && obs.shape()[1] == state_dim);
+    std::vector<int> actions(37);
+    for (int t = 0; t < 1000; ++t) {
+        for (size_t i = 0; i < 37; ++i) actions[i] = follow(obs(i, 1), obs(i, 4));
+        env.step(actions);
+        for (size_t i = 0; i < 37; ++i) assert(env.dones()(i) == 0 && env.rewards()(i) >= 0);
+    }
+
+    bool exception_thrown = false;
+    try {
+        std::vector<int> wrong(3);
+        env.step(wrong);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 3 OK\n";
+}
+
+void test_case_4() {
+    // Cola acotada sin locks: 2 productores y 2 consumidores, cada valor sale una sola vez
+    bounded_queue<int> queue(100);
+    assert(queue.capacity() == 128);
+    const int per_producer = 20000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> popped{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 2; ++p)
+        threads.emplace_back([&, p] {
+            for (int i = 1; i <= per_producer; ++i)
+                while (!queue.try_push(p * per_producer + i)) std::this_thread::yield();
+        });
+    for (int c = 0; c < 2; ++c)
+        threads.emplace_back([&] {
+            int value;
+            while (popped.load() < 2 * per_producer) {
+                if (queue.try_pop(value)) {
+                    sum += value;
+                    ++popped;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    for (auto& t : threads) t.join();
+    const long long n = 2 * per_producer;
+    assert(popped == n && sum == n * (n + 1) / 2);
+    int value;
+    assert(!queue.try_pop(value));
+    std::cout << "Caso 4 OK\n";
+}
+
+NeuralNetwork<float> make_network() {
+    NeuralNetwork<float> net;
+    net.emplace_layer<Dense<float, ReLU>>(state_dim, 16, 1);
+    net.emplace_layer<Dense<float>>(16, num_actions, 2);
+    return net;
+}
+
+void test_case_5() {
+    // PongAgent con snapshots de pesos y el pipeline actor/learner completo
+    PongAgent a(make_network()), b(make_network());
+    b.network().parameters()[0].value->fill(0.5f);
+    a.load(*b.snapshot(7));
+    assert(a.version() == 7 && (*a.network().parameters()[0].value)(3, 2) == 0.5f);
+    const State s{0.5f, 0.3f, 0.01f, 0.0f, 0.5f};
+    assert(a.act(s) == b.act(s));
+    assert(a.act(s) >= -1 && a.act(s) <= 1);
+    PongAgent frozen(make_network());
+    frozen.freeze();
+    frozen.load(*b.snapshot(8));
+    assert(frozen.frozen() && frozen.act(s) == b.act(s));
+    for (int i = 0; i < 50; ++i) {
+        const State q{0.02f * float(i), 1.0f - 0.02f * float(i), 0.01f, -0.02f, 0.3f};
+        assert(frozen.act(q) == b.act(q));
+    }
+
+    ActorLearnerConfig config;
+    config.actors = 2;
+    config.steps_per_actor = 500;
+    config.queue_capacity = 64;
+    config.replay_capacity = 256;
+    config.batch_size = 16;
+    config.publish_every = 5;
+    ActorLearner pipeline(make_network, config);
+    const ActorLearnerStats stats = pipeline.run();
+    assert(stats.transitions == 1000);
+    assert(stats.train_steps > 0 && stats.published > 0);
+
+    config.prioritized = true;
+    ActorLearner prioritized(make_network, config);
+    assert(prioritized.run().transitions == 1000);
+
+    // El optimizador configurado se construye una vez y conserva su estado entre pasos
+    config.make_optimizer = [](float learning_rate) {
+        return std::make_unique<Adam<float>>(learning_rate, 0.8f, 0.99f);
+    };
+    ActorLearner adam(make_network, config);
+    const ActorLearnerStats adam_stats = adam.run();
+    const auto* optimizer = dynamic_cast<const Adam<float>*>(adam.agent().network().optimizer());
+    assert(optimizer != nullptr && optimizer->steps() == adam_stats.train_steps);
+    std::cout << "Caso 5 OK\n";
+}
+
+Transition numbered(int i) {
+    const float f = float(i);
+    return {{f, f + 0.5f, 0, 0, 0}, i % 3 - 1, -f, {f + 1, f + 1.5f, 0, 0, 0}, i % 2 == 0};
+}
+
+void test_case_6() {
+    // ReplayBuffer uniforme: el anillo sobrescribe lo más antiguo y el muestreo copia filas completas
+    ReplayBuffer replay(10);
+    for (int i = 0; i < 25; ++i) replay.push(numbered(i));
+    assert(replay.size() == 10 && replay.capacity() == 10);
+    std::mt19937 engine(3);
+    ReplayBatch batch;
+    replay.sample(32, engine, batch);
+    assert(batch.states.shape()[0] == 32 && batch.states.shape()[1] == state_dim);
+    for (size_t i = 0; i < 32; ++i) {
+        const int id = int(batch.states(i, 0));
+        assert(id >= 15 && id < 25);
+        assert(batch.states(i, 1) == id + 0.5f && batch.next_states(i, 0) == id + 1);
+        assert(batch.actions(i) == id % 3 - 1 && batch.rewards(i) == -id);
+        assert(batch.dones(i) == (id % 2 == 0 ? 1.0f : 0.0f) && batch.weights(i) == 1.0f);
+    }
+    std::cout << "Caso 6 OK\n";
+}
+
+void test_case_7() {
+    // ReplayBuffer priorizado: el sum-tree favorece las transiciones con mayor prioridad
+    ReplayBuffer replay(6, true, 1.0f);
+    for (int i = 0; i < 6; ++i) replay.push(numbered(i));
+    assert(std::abs(replay.total_priority() - 6) < 1e-6f);
+    const std::vector<size_t> slots{0, 1, 2, 3, 4, 5};
+    const std::vector<float> priorities{1, 1, 1, 1, 1, 95};
+    replay.update_priorities(slots, priorities);
+    assert(std::abs(replay.total_priority() - 100) < 1e-4f);
+
+    std::mt19937 engine(11);
+    ReplayBatch batch;
+    size_t favourite = 0, total = 0;
+    for (int round = 0; round < 50; ++round) {
+        replay.sample(20, engine, batch);
+        for (size_t i = 0; i < 20; ++i, ++total) {
+            if (batch.indices[i] == 5) {
+                ++favourite;
+                assert(batch.states(i, 0) == 5 && batch.weights(i) < 1.0f);
+            } else {
+                assert(std::abs(batch.weights(i) - 1.0f) < 1e-6f);
+            }
+        }
+    }
+    assert(std::abs(double(favourite) / double(total) - 0.95) < 0.03);
+    std::cout << "Caso 7 OK\n";
+}
+
+void test_case_8() {
+    // PongAgent cuantizado a int8: calibrado con estados de un episodio, elige casi siempre la misma acción
+    PongAgent reference(make_network()), quantized(make_network());
+    std::vector<State> calibration;
+    EnvGym env(5);
+    State state = env.reset();
+    for (int i = 0; i < 300; ++i) {
+        calibration.push_back(state);
+        float reward;
+        bool done;
+        state = env.step(reference.act(state), reward, done);
+        if (done) state = env.reset();
+    }
+    quantized.quantize(calibration);
+    assert(quantized.quantized());
+    size_t agree = 0;
+    for (const State& s : calibration) agree += quantized.act(s) == reference.act(s);
+    assert(agree * 10 >= calibration.size() * 9);
+
+    // load() vuelve a cuantizar los pesos nuevos con los mismos estados de calibración
+    PongAgent b(make_network());
+    b.network().parameters()[0].value->fill(0.5f);
+    quantized.load(*b.snapshot(3));
+    reference.load(*b.snapshot(3));
+    agree = 0;
+    for (const State& s : calibration) agree += quantized.act(s) == reference.act(s);
+    assert(agree * 10 >= calibration.size() * 9);
+
+    bool threw = false;
+    try { quantized.quantize({}); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw && quantized.quantized());
+    std::cout << "Caso 8 OK\n";
+}
+
+task<int> square_later(scheduler& pool, int x) {
+    co_await pool.schedule();
+    co_return x * x;
+}
+
+task<int> sum_squares(scheduler& pool, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) sum += co_await square_later(pool, i);
+    co_return sum;
+}
+
+task<void> count_after(scheduler& pool, std::atomic<int>& count, int ms) {
+    co_await pool.sleep_for(std::chrono::milliseconds(ms));
+    ++count;
+}
+
+task<void> fail(scheduler& pool) {
+    co_await pool.schedule();
+    throw std::runtime_error("fallo");
+}
+
+task<void> run_nested(scheduler& pool) {
+    pool.run(sum_squares(pool, 3));
+    co_return;
+}
+
+void test_case_9() {
+    // Scheduler: tareas anidadas, when_all, temporizadores, spawn y excepciones
+    scheduler pool(4);
+    assert(pool.size() == 4);
+    assert(pool.run(sum_squares(pool, 100)) == 328350);
+
+    std::atomic<int> count = 0;
+    std::vector<task<void>> tasks;
+    for (int i = 0; i < 200; ++i) tasks.push_back(count_after(pool, count, i % 5));
+    const auto start = scheduler::clock::now();
+    pool.run(pool.when_all(std::move(tasks)));
+    assert(count == 200);
+    assert(scheduler::clock::now() - start >= std::chrono::milliseconds(4));
+
+    bool threw = false;
+    try { pool.run(fail(pool)); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    tasks.clear();
+    tasks.push_back(count_after(pool, count, 1));
+    tasks.push_back(fail(pool));
+    threw = false;
+    try { pool.run(pool.when_all(std::move(tasks))); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw && count == 201);
+
+    // run() desde un worker lanzaría un interbloqueo: se rechaza
+    threw = false;
+    try { pool.run(run_nested(pool)); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    // El destructor espera las tareas lanzadas con spawn
+    count = 0;
+    {
+        scheduler detached(2);
+        for (int i = 0; i < 50; ++i) detached.spawn(count_after(detached, count, 2));
+    }
+    assert(count == 50);
+    std::cout << "Caso 9 OK\n";
+}
+
+task<void> play(InferenceBatcher& batcher, unsigned seed, size_t steps, std::atomic<size_t>& frames) {
+    EnvGym env(seed);
+    State state = env.reset();
+    for (size_t t = 0; t < steps; ++t) {
+        const int action = co_await batcher.act(state);
+        assert(action >= -1 && action <= 1);
+        float reward;
+        bool done;
+        state = env.step(action, reward, done);
+        if (done) state = env.reset();
+        ++frames;
+    }
+}
+
+task<void> publish(scheduler& pool, InferenceBatcher& batcher, PongAgent& learner, size_t rounds) {
+    for (size_t v = 1; v <= rounds; ++v) {
+        co_await pool.sleep_for(std::chrono::microseconds(500));
+        learner.network().parameters()[0].value->fill(0.01f * float(v));
+        batcher.load(*learner.snapshot(v));
+    }
+}
+
+task<void> infer_all(InferenceBatcher& batcher, const Tensor<float, 2>& inputs, Tensor<float, 2>& outputs, size_t r) {
+    co_await batcher.infer(inputs.data() + r * inputs.shape()[1], outputs.data() + r * outputs.shape()[1]);
+}
+
+void test_case_10() {
+    // InferenceBatcher: las peticiones de muchas corrutinas se agrupan en forwards por lotes
+    scheduler pool(4);
+    PongAgent reference(make_network());
+    InferenceBatcher batcher(pool, make_network(), state_dim, {16, std::chrono::milliseconds(20)});
+    assert(batcher.inputs() == state_dim && batcher.outputs() == num_actions);
+
+    // Mismas salidas que el forward fila a fila
+    std::mt19937 engine(3);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    constexpr size_t rows = 100;
+    Tensor<float, 2> inputs(rows, state_dim), outputs(rows, num_actions);
+    for (auto& v : inputs) v = dist(engine);
+    std::vector<task<void>> tasks;
+    for (size_t r = 0; r < rows; ++r) tasks.push_back(infer_all(batcher, inputs, outputs, r));
+    pool.run(pool.when_all(std::move(tasks)));
+    InferenceBatcherStats stats = batcher.stats();
+    assert(stats.requests == rows && stats.batches < rows && stats.largest_batch <= 16);
+    Tensor<float, 2> row(1, state_dim);
+    for (size_t r = 0; r < rows; ++r) {
+        std::copy_n(inputs.data() + r * state_dim, state_dim, row.data());
+        const Tensor<float, 2>& expected = reference.network().forward(row);
+        for (size_t a = 0; a < num_actions; ++a) assert(std::abs(expected(0, a) - outputs(r, a)) < 1e-5f);
+    }
+
+    // 64 actores juegan mientras un learner publica pesos nuevos
+    std::atomic<size_t> frames = 0;
+    PongAgent learner(make_network());
+    tasks.clear();
+    for (unsigned a = 0; a < 64; ++a) tasks.push_back(play(batcher, a, 50, frames));
+    tasks.push_back(publish(pool, batcher, learner, 10));
+    pool.run(pool.when_all(std::move(tasks)));
+    assert(frames == 64 * 50);
+    stats = batcher.stats();
+    assert(stats.requests == rows + 64 * 50 && stats.batches - 1 < stats.requests / 4 && stats.largest_batch <= 16);
+
+    // Una petición sola sale por latencia máxima
+    InferenceBatcher lone(pool, make_network(), state_dim, {64, std::chrono::milliseconds(5)});
+    const auto start = scheduler::clock::now();
+    const int action = pool.run(lone.act(State{0.5f, 0.5f, 0.01f, 0.01f, 0.5f}));
+    assert(action >= -1 && action <= 1);
+    assert(scheduler::clock::now() - start >= std::chrono::milliseconds(4));
+    assert(lone.stats().batches == 1 && lone.stats().requests == 1);
+
+    bool threw = false;
+    try { InferenceBatcher wrong(pool, make_network(), state_dim + 1); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    threw = false;
+    try { InferenceBatcher wrong(pool, make_network(), state_dim, {0, std::chrono::milliseconds(1)}); }
+    catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    // act() exige una puntuación por acción; el error llega a quien espera
+    NeuralNetwork<float> wide;
+    wide.emplace_layer<Dense<float>>(state_dim, num_actions + 1, 4);
+    InferenceBatcher scores(pool, std::move(wide), state_dim);
+    threw = false;
+    try { pool.run(scores.act(State{})); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "Caso 10 OK\n";
+}
+
+task<bool> await_empty() {
+    task<void> empty;
+    try {
+        co_await empty;
+    } catch (const std::runtime_error&) {
+        co_return true;
+    }
+    co_return false;
+}
+
+task<void> check_wakeup(scheduler& pool, std::atomic<int>& late, int us) {
+    const auto due = scheduler::clock::now() + std::chrono::microseconds(us);
+    co_await pool.sleep_until(due);
+    if (scheduler::clock::now() < due) ++late;
+}
+
+void test_case_11() {
+    // Esperar una tarea vacía lanza en lugar de leer un promise nulo
+    scheduler pool(3);
+    assert(pool.run(await_empty()));
+
+    // Temporizadores mezclados: ninguno despierta antes de tiempo
+    std::atomic<int> early = 0;
+    std::vector<task<void>> tasks;
+    for (int i = 0; i < 300; ++i) tasks.push_back(check_wakeup(pool, early, (i * 37) % 3000));
+    pool.run(pool.when_all(std::move(tasks)));
+    assert(early == 0);
+
+    // Muchos run() seguidos desde fuera con los workers dormidos: no se pierde ningún aviso
+    for (int i = 0; i < 2000; ++i) assert(pool.run(square_later(pool, i % 10)) == (i % 10) * (i % 10));
+
+    // Con un único worker dormido hasta un temporizador lejano, uno más cercano lo despierta antes
+    std::atomic<int> count = 0;
+    {
+        scheduler single(1);
+        single.spawn(count_after(single, count, 300));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        const auto start = scheduler::clock::now();
+        single.run(count_after(single, count, 2));
+        assert(count == 1);
+        assert(scheduler::clock::now() - start < std::chrono::milliseconds(200));
+    }
+    assert(count == 2);
+    std::cout << "Caso 11 OK\n";
+}
+
+int main() {
+    test_case_1();
+    test_case_2();
+    test_case_3();
+    test_case_4();
+    test_case_5();
+    test_case_6();
+    test_case_7();
+    test_case_8();
+    test_case_9();
+    test_case_10();
+    test_case_11();
+    std::cout << "Todos los tests pasaron correctamente ✅\n";
+    return 0;
+}
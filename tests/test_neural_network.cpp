@@ -1,3 +1,735 @@
 //
 // Created by Romina Valeria on 7/06/25.
 //
+
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include "utec/nn/dense.h"
+#include "utec/nn/neural_network.h"
+#include "utec/nn/data_parallel.h"
+#include "utec/nn/data_loader.h"
+#include "utec/nn/graph.h"
+#include "utec/nn/memory_plan.h"
+#include "utec/nn/quantized_network.h"
+#include "utec/algebra/quantized.h"
+#include "utec/algebra/sparse.h"
+#include "utec/algebra/profiler.h"
+
+using namespace utec::neural_network;
+using utec::algebra::Tensor;
+using utec::algebra::QuantizedTensor;
+using utec::algebra::SparseTensor;
+
+void test_case_1() {
+    // Dense con ReLU: la fusión GEMM + bias + activación coincide con las tres operaciones separadas
+    Dense<float, ReLU> layer(3, 2, [](Tensor<float, 2>& w) { w = {1, -1, 2, 0, -1, 3}; },
+                             [](Tensor<float, 2>& b) { b = {0.5f, -10}; });
+    Tensor<float, 2> x(2, 3);
+    x = {1, 2, 3, -1, 0, 1};
+    const auto& y = layer.forward(x);
+    assert(y.shape()[0] == 2 && y.shape()[1] == 2);
+    assert(y(0, 0) == 1 * 1 + 2 * 2 + 3 * -1 + 0.5f);
+    assert(y(0, 1) == 0);
+    assert(y(1, 0) == 0);
+    assert(y(1, 1) == 0);
+    std::cout << "Caso 1 OK\n";
+}
+
+void test_case_2() {
+    // Sigmoid en el epílogo, con más columnas que un registro y una fila parcial
+    Dense<double, Sigmoid> layer(5, 19, 3);
+    Tensor<double, 2> x(7, 5);
+    for (size_t i = 0; i < x.size(); ++i) x.data()[i] = std::sin(double(i));
+    const auto& y = layer.forward(x);
+    const auto reference = utec::algebra::matrix_product(x, layer.weights());
+    for (size_t i = 0; i < 7; ++i)
+        for (size_t j = 0; j < 19; ++j)
+            assert(std::abs(y(i, j) - 1 / (1 + std::exp(-(reference(i, j) + layer.bias()(0, j))))) < 1e-12);
+    std::cout << "Caso 2 OK\n";
+}
+
+void test_case_3() {
+    // backward contra diferencias finitas, con pérdida = suma(y * c)
+    Dense<double, Sigmoid> layer(4, 3, 11);
+    Tensor<double, 2> x(2, 4), c(2, 3);
+    for (size_t i = 0; i < x.size(); ++i) x.data()[i] = std::cos(double(i));
+    for (size_t i = 0; i < c.size(); ++i) c.data()[i] = 0.5 - double(i % 3);
+    auto loss = [&] {
+        const auto& y = layer.forward(x);
+        double total = 0;
+        for (size_t i = 0; i < y.size(); ++i) total += y.data()[i] * c.data()[i];
+        return total;
+    };
+    layer.forward(x);
+    const Tensor<double, 2> dx = layer.backward(c);
+    const Tensor<double, 2> dw = layer.grad_weights();
+    const Tensor<double, 2> db = layer.grad_bias();
+    const double h = 1e-6;
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            double& w = layer.weights()(i, j);
+            const double original = w;
+            w = original + h;
+            const double up = loss();
+            w = original - h;
+            const double down = loss();
+            w = original;
+            assert(std::abs((up - down) / (2 * h) - dw(i, j)) < 1e-6);
+        }
+    }
+    for (size_t j = 0; j < 3; ++j) {
+        double& b = layer.bias()(0, j);
+        const double original = b;
+        b = original + h;
+        const double up = loss();
+        b = original - h;
+        const double down = loss();
+        b = original;
+        assert(std::abs((up - down) / (2 * h) - db(0, j)) < 1e-6);
+    }
+    double& v = x(1, 2);
+    const double original = v;
+    v = original + h;
+    const double up = loss();
+    v = original - h;
+    const double down = loss();
+    v = original;
+    assert(std::abs((up - down) / (2 * h) - dx(1, 2)) < 1e-6);
+    std::cout << "Caso 3 OK\n";
+}
+
+void test_case_4() {
+    // Capas de activación independientes y error de dimensiones
+    ReLU<float> relu;
+    Tensor<float, 2> x(2, 2);
+    x = {-1, 2, -3, 4};
+    const auto& y = relu.forward(x);
+    assert(y(0, 0) == 0 && y(0, 1) == 2 && y(1, 1) == 4);
+    Tensor<float, 2> g(2, 2);
+    g.fill(1);
+    const auto& dx = relu.backward(g);
+    assert(dx(0, 0) == 0 && dx(1, 1) == 1);
+
+    bool exception_thrown = false;
+    try {
+        Dense<float> layer(3, 2);
+        Tensor<float, 2> wrong(1, 4);
+        layer.forward(wrong);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 4 OK\n";
+}
+
+void test_case_5() {
+    // Entrenamiento por minibatches: XOR con lotes de 3 (el último lote es parcial)
+    NeuralNetwork<double> net(7);
+    net.emplace_layer<Dense<double, Sigmoid>>(2, 8, 1);
+    net.emplace_layer<Dense<double, Sigmoid>>(8, 1, 2);
+    Tensor<double, 2> X(4, 2), Y(4, 1);
+    X = {0, 0, 0, 1, 1, 0, 1, 1};
+    Y = {0, 1, 1, 0};
+    const double initial = net.train(X, Y, 1, 3, 0.0);
+    const double final_loss = net.train(X, Y, 5000, 3, 2.0);
+    assert(final_loss < initial && final_loss < 0.01);
+    const auto prediction = net.predict(X);
+    for (size_t i = 0; i < 4; ++i) assert(std::abs(prediction(i, 0) - Y(i, 0)) < 0.2);
+    std::cout << "Caso 5 OK\n";
+}
+
+void test_case_6() {
+    // Entrenamiento en paralelo con 3 réplicas: con lote completo coincide con el entrenamiento serial
+    utec::algebra::parallel::set_num_threads(3);
+    Tensor<double, 2> X(10, 5), Y(10, 2);
+    for (size_t i = 0; i < X.size(); ++i) X.data()[i] = std::sin(double(i));
+    for (size_t i = 0; i < Y.size(); ++i) Y.data()[i] = std::cos(double(i));
+    NeuralNetwork<double> serial, parallel;
+    for (auto* net : {&serial, &parallel}) {
+        net->emplace_layer<Dense<double, Sigmoid>>(5, 4, 1);
+        net->emplace_layer<Dense<double>>(4, 2, 2);
+    }
+    const double serial_loss = serial.train(X, Y, 20, 10, 0.5);
+    DataParallelTrainer<double> trainer(parallel, 3);
+    const double parallel_loss = trainer.train(X, Y, 20, 10, 0.5);
+    assert(std::abs(serial_loss - parallel_loss) < 1e-12);
+    for (size_t p = 0; p < serial.parameters().size(); ++p)
+        for (size_t e = 0; e < serial.parameters()[p].value->size(); ++e)
+            assert(std::abs(serial.parameters()[p].value->data()[e] - parallel.parameters()[p].value->data()[e]) < 1e-12);
+    utec::algebra::parallel::set_num_threads(std::thread::hardware_concurrency());
+    std::cout << "Caso 6 OK\n";
+}
+
+void test_case_7() {
+    // FrozenNetwork: GEMV empaquetado coincide con forward, una ReLU suelta se fusiona y refresh sigue a los pesos
+    NeuralNetwork<double> net;
+    net.emplace_layer<Dense<double, Sigmoid>>(3, 21, 4);
+    net.emplace_layer<Dense<double>>(21, 70, 5);
+    net.add_layer(std::make_unique<ReLU<double>>());
+    net.emplace_layer<Dense<double>>(70, 2, 6);
+    net.add_layer(std::make_unique<Sigmoid<double>>());
+    FrozenNetwork<double> frozen(net);
+    assert(frozen.inputs() == 3 && frozen.outputs() == 2);
+    Tensor<double, 2> x(1, 3);
+    x = {0.3, -1.2, 2.0};
+    auto check = [&] {
+        const Tensor<double, 2> expected = net.forward(x);
+        const double* y = frozen.forward(x.data());
+        for (size_t j = 0; j < 2; ++j) assert(std::abs(y[j] - expected(0, j)) < 1e-12);
+    };
+    check();
+    for (auto& p : net.parameters()) *p.value *= 0.5;
+    frozen.refresh(net);
+    check();
+
+    bool exception_thrown = false;
+    try {
+        NeuralNetwork<double> other;
+        other.emplace_layer<Dense<double>>(3, 4);
+        frozen.refresh(other);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 7 OK\n";
+}
+
+void test_case_8() {
+    // Pérdidas fusionadas: MSE y softmax + entropía cruzada contra la fórmula directa, con 19 clases (cola parcial)
+    Tensor<double, 2> z(7, 19), y(7, 19), g;
+    for (size_t i = 0; i < z.size(); ++i) z.data()[i] = 3 * std::sin(double(i));
+    y.fill(0);
+    for (size_t i = 0; i < 7; ++i) y(i, (5 * i) % 19) = 1;
+
+    const double mse_loss = mse(z, y, g);
+    double expected = 0;
+    for (size_t i = 0; i < z.size(); ++i) expected += (z.data()[i] - y.data()[i]) * (z.data()[i] - y.data()[i]);
+    assert(std::abs(mse_loss - expected / double(z.size())) < 1e-12);
+    for (size_t i = 0; i < z.size(); ++i)
+        assert(std::abs(g.data()[i] - 2 * (z.data()[i] - y.data()[i]) / double(z.size())) < 1e-12);
+
+    const double ce_loss = softmax_cross_entropy(z, y, g);
+    expected = 0;
+    for (size_t i = 0; i < 7; ++i) {
+        double sum = 0;
+        for (size_t j = 0; j < 19; ++j) sum += std::exp(z(i, j));
+        for (size_t j = 0; j < 19; ++j) {
+            expected -= y(i, j) * std::log(std::exp(z(i, j)) / sum);
+            assert(std::abs(g(i, j) - (std::exp(z(i, j)) / sum - y(i, j)) / 7) < 1e-12);
+        }
+    }
+    assert(std::abs(ce_loss - expected / 7) < 1e-12);
+
+    bool exception_thrown = false;
+    try {
+        Tensor<double, 2> other(7, 18);
+        softmax_cross_entropy(z, other, g);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 8 OK\n";
+}
+
+void test_case_9() {
+    // Estabilidad: logits enormes en float no producen inf ni NaN
+    Tensor<float, 2> z(2, 33), y(2, 33), g;
+    for (size_t j = 0; j < 33; ++j) {
+        z(0, j) = 1e4f + float(j);
+        z(1, j) = -1e4f * float(j);
+    }
+    y.fill(0);
+    y(0, 32) = 1;
+    y(1, 3) = 1;
+    const float loss = softmax_cross_entropy(z, y, g);
+    // fila 0: -log softmax = log(sum_k e^(k - 32)); fila 1: la clase 3 está 3e4 por debajo del máximo
+    double row0 = 0;
+    for (int k = 0; k <= 32; ++k) row0 += std::exp(double(k - 32));
+    assert(std::isfinite(loss));
+    assert(std::abs(loss - float((std::log(row0) + 3e4) / 2)) < 1e-2f);
+    for (size_t i = 0; i < 2; ++i) {
+        float row_sum = 0;
+        for (size_t j = 0; j < 33; ++j) {
+            assert(std::isfinite(g(i, j)));
+            row_sum += g(i, j);
+        }
+        assert(std::abs(row_sum) < 1e-6f);
+    }
+    assert(std::abs(g(1, 0) - 0.5f) < 1e-6f && std::abs(g(1, 3) + 0.5f) < 1e-6f);
+    std::cout << "Caso 9 OK\n";
+}
+
+void test_case_10() {
+    // Optimizadores fusionados: SGD con momentum y Adam contra la fórmula escalar, en paralelo con grano pequeño
+    const size_t previous_grain = utec::algebra::parallel::grain_size();
+    const size_t previous_threads = utec::algebra::parallel::num_threads();
+    utec::algebra::parallel::set_num_threads(3);
+    utec::algebra::parallel::set_grain_size(8);
+    Tensor<double, 2> w1(5, 37), g1(5, 37), w2(1, 5), g2(1, 5);
+    for (size_t i = 0; i < w1.size(); ++i) w1.data()[i] = std::sin(double(i));
+    for (size_t i = 0; i < w2.size(); ++i) w2.data()[i] = std::cos(double(i));
+    const std::vector<parameter<double>> parameters{{&w1, &g1}, {&w2, &g2}};
+
+    auto run = [&](auto& optimizer, auto&& reference) {
+        const Tensor<double, 2> start1 = w1, start2 = w2;
+        std::vector<double> expected(w1.begin(), w1.end());
+        expected.insert(expected.end(), w2.begin(), w2.end());
+        std::vector<double> m(expected.size(), 0), v(expected.size(), 0);
+        for (int t = 1; t <= 3; ++t) {
+            for (size_t i = 0; i < expected.size(); ++i) {
+                const double g = std::sin(3.0 * double(i) + t);
+                (i < w1.size() ? g1.data()[i] : g2.data()[i - w1.size()]) = g;
+                expected[i] = reference(expected[i], g, m[i], v[i], t);
+            }
+            optimizer.step(parameters);
+        }
+        for (size_t i = 0; i < w1.size(); ++i) assert(std::abs(w1.data()[i] - expected[i]) < 1e-12);
+        for (size_t i = 0; i < w2.size(); ++i) assert(std::abs(w2.data()[i] - expected[w1.size() + i]) < 1e-12);
+        w1 = start1;
+        w2 = start2;
+    };
+
+    SGD<double> sgd(0.1, 0.9);
+    run(sgd, [](double w, double g, double& velocity, double&, int) {
+        velocity = 0.9 * velocity + g;
+        return w - 0.1 * velocity;
+    });
+    Adam<double> adam(0.01);
+    run(adam, [](double w, double g, double& m, double& v, int t) {
+        m = 0.9 * m + 0.1 * g;
+        v = 0.999 * v + 0.001 * g * g;
+        const double m_hat = m / (1 - std::pow(0.9, t)), v_hat = v / (1 - std::pow(0.999, t));
+        return w - 0.01 * m_hat / (std::sqrt(v_hat) + 1e-8);
+    });
+    utec::algebra::parallel::set_grain_size(previous_grain);
+    utec::algebra::parallel::set_num_threads(previous_threads);
+
+    // Adam entrena XOR desde el bucle de NeuralNetwork
+    NeuralNetwork<double> net(7);
+    net.emplace_layer<Dense<double, Sigmoid>>(2, 8, 1);
+    net.emplace_layer<Dense<double, Sigmoid>>(8, 1, 2);
+    Tensor<double, 2> X(4, 2), Y(4, 1);
+    X = {0, 0, 0, 1, 1, 0, 1, 1};
+    Y = {0, 1, 1, 0};
+    assert((net.train<MSELoss, Adam>(X, Y, 2000, 4, 0.05) < 0.01));
+    std::cout << "Caso 10 OK\n";
+}
+
+void test_case_11() {
+    // DataLoader: cada época entrega cada fila una vez con su objetivo, barajada dentro de la ventana
+    // Archivos por variante ISA: ctest puede correr las tres a la vez
+    const auto dir = std::filesystem::temp_directory_path();
+    const char* isa = std::getenv("UTEC_ISA");
+    const std::string suffix = std::string("_") + (isa ? isa : "native") + ".bin";
+    const std::string inputs = (dir / ("utec_test_inputs" + suffix)).string();
+    const std::string targets = (dir / ("utec_test_targets" + suffix)).string();
+    Tensor<double, 2> X(103, 2), Y(103, 1);
+    for (size_t i = 0; i < 103; ++i) {
+        X(i, 0) = double(i);
+        X(i, 1) = std::sin(double(i));
+        Y(i, 0) = 0.5 * X(i, 1) - 0.25;
+    }
+    X.save(inputs);
+    Y.save(targets);
+
+    for (size_t window : {size_t{0}, size_t{32}}) {
+        DataLoader<double> loader(inputs, targets, 10, window, 3);
+        assert(loader.samples() == 103 && loader.features() == 2 && loader.outputs() == 1);
+        for (int epoch = 0; epoch < 2; ++epoch) {
+            std::vector<int> seen(103, 0);
+            bool in_order = true;
+            size_t count = 0;
+            while (const auto* batch = loader.next()) {
+                assert(batch->rows() == std::min<size_t>(10, 103 - count));
+                for (size_t r = 0; r < batch->rows(); ++r, ++count) {
+                    const auto i = size_t(batch->inputs(r, 0));
+                    ++seen[i];
+                    in_order = in_order && i == count;
+                    assert(batch->inputs(r, 1) == X(i, 1) && batch->targets(r, 0) == Y(i, 0));
+                }
+            }
+            assert(count == 103 && std::all_of(seen.begin(), seen.end(), [](int c) { return c == 1; }));
+            assert(in_order == (window == 0));
+        }
+    }
+
+    // Entrenamiento desde el DataLoader: regresión lineal sobre la segunda columna (sin la columna índice)
+    for (size_t i = 0; i < 103; ++i) X(i, 0) = 0;
+    X.save(inputs);
+    NeuralNetwork<double> net;
+    net.emplace_layer<Dense<double>>(2, 1, 5);
+    DataLoader<double> loader(inputs, targets, 16, 64);
+    assert(net.train(loader, 300, 0.1) < 1e-4);
+
+    bool exception_thrown = false;
+    try {
+        Tensor<double, 2> short_targets(50, 1);
+        short_targets.save(targets);
+        DataLoader<double> mismatch(inputs, targets, 10);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::filesystem::remove(inputs);
+    std::filesystem::remove(targets);
+    std::cout << "Caso 11 OK\n";
+}
+
+void test_case_12() {
+    // Profiler: contadores por operación y traza Chrome (sin UTEC_PROFILE todo queda vacío)
+    namespace profiler = utec::algebra::profiler;
+    profiler::reset();
+    profiler::start_trace();
+    Tensor<float, 2> a(8, 16), b(16, 4);
+    a.fill(1);
+    b.fill(2);
+    const auto c = utec::algebra::matrix_product(a, b);
+    const Tensor<float, 2> d = c + c;
+    Dense<float, ReLU> layer(16, 4);
+    layer.forward(a);
+    layer.forward(a);
+    profiler::stop_trace();
+    assert(d(0, 0) == 64);
+
+    const auto stats = profiler::report();
+    std::ostringstream trace;
+    profiler::write_trace(trace);
+    assert(trace.str().find("\"traceEvents\"") != std::string::npos);
+    if (!profiler::enabled) {
+        assert(stats.empty());
+        std::cout << "Caso 12 OK (profiler desactivado)\n";
+        return;
+    }
+    auto find = [&](const std::string& name) {
+        for (const auto& s : stats)
+            if (s.name == name) return s;
+        return profiler::op_stats{};
+    };
+    const auto gemm = find("matrix_product");
+    assert(gemm.calls == 3 && gemm.flops == 3 * 2 * 8 * 16 * 4);
+    assert(find("Dense.forward").bytes_allocated >= 8 * 4 * sizeof(float));  // la salida, en la primera llamada
+    assert(find("elementwise").calls == 1 && find("elementwise").flops == 8 * 4);
+    assert(find("Dense.forward").calls == 2 && find("Dense.forward").seconds >= find("matrix_product").seconds / 3);
+    assert(trace.str().find("\"name\":\"Dense.forward\",\"cat\":\"utec\",\"ph\":\"X\"") != std::string::npos);
+    profiler::reset();
+    assert(profiler::report().empty());
+    std::cout << "Caso 12 OK\n";
+}
+
+void test_case_13() {
+    // Grafo capturado: pérdida y gradientes iguales a forward/backward de las capas
+    NeuralNetwork<double> eager(7), captured(7);
+    for (auto* net : {&eager, &captured}) {
+        net->emplace_layer<Dense<double, ReLU>>(2, 8, 1);
+        net->emplace_layer<Dense<double, Sigmoid>>(8, 1, 2);
+    }
+    Tensor<double, 2> X(4, 2), Y(4, 1);
+    X = {0, 0, 0, 1, 1, 0, 1, 1};
+    Y = {0, 1, 1, 0};
+
+    Graph<double> graph;
+    const auto output = captured.capture(graph, X);
+    graph.keep(output);
+    graph.backward(mse(output, graph.input(Y)));
+    graph.run();
+
+    MSELoss<double> loss;
+    const double expected = loss.compute(eager.forward(X), Y);
+    const Tensor<double, 2>* gradient = &loss.gradient();
+    for (size_t i = eager.num_layers(); i-- > 0;) gradient = &eager.layer(i).backward(*gradient);
+    assert(std::abs(graph.loss() - expected) < 1e-12);
+    assert(graph.parameters().size() == eager.parameters().size());
+    for (size_t p = 0; p < eager.parameters().size(); ++p) {
+        const auto& a = *eager.parameters()[p].gradient;
+        const auto& b = *graph.parameters()[p].gradient;
+        assert(a.shape() == b.shape());
+        for (size_t i = 0; i < a.size(); ++i) assert(std::abs(a.data()[i] - b.data()[i]) < 1e-12);
+    }
+    const auto prediction = graph.value_of(output);
+    for (size_t i = 0; i < 4; ++i) assert(std::abs(prediction(i, 0) - eager.forward(X)(i, 0)) < 1e-12);
+
+    // La fusión deja 10 kernels de las 16 operaciones y la planificación reutiliza buffers
+    assert(graph.kernels() == 10);
+    assert(graph.planned_bytes() < graph.unplanned_bytes());
+
+    // Capturar una vez y repetir: el grafo entrena XOR con SGD
+    SGD<double> sgd(0.5);
+    for (int step = 0; step < 5000; ++step) {
+        graph.run();
+        sgd.step(graph.parameters());
+    }
+    graph.run();
+    assert(graph.loss() < 0.01);
+
+    // Cambiar la forma de una entrada o leer un valor no conservado lanza excepción
+    Tensor<double, 2> Z(4, 2);
+    Graph<double> other;
+    const auto z = other.input(Z);
+    const auto hidden = activate<ReLU>(z * 2.0);
+    other.keep(sum(hidden, 1));
+    bool threw = false;
+    try { other.value_of(hidden); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    Z.reshape(3, 2);
+    threw = false;
+    try { other.run(); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "Caso 13 OK\n";
+}
+
+void test_case_14() {
+    // Planificador de memoria: una cadena de buffers reutiliza el espacio de los ya muertos
+    const auto plan = plan_memory({{100, 0, 1}, {100, 1, 2}, {100, 2, 3}, {32, 0, 3}});
+    assert(plan.total_bytes == 3 * 128 + 64);
+    assert(plan.arena_bytes == 2 * 128 + 64);
+    assert(plan.offsets[0] == plan.offsets[2]);
+    for (size_t i = 0; i < plan.offsets.size(); ++i) assert(plan.offsets[i] % 64 == 0);
+
+    // train_planned coincide con train y su arena ocupa mucho menos que un buffer por valor
+    NeuralNetwork<double> eager(3), planned(3);
+    for (auto* net : {&eager, &planned}) {
+        net->emplace_layer<Dense<double, ReLU>>(8, 64, 1);
+        net->emplace_layer<Dense<double, ReLU>>(64, 64, 2);
+        net->emplace_layer<Dense<double, ReLU>>(64, 64, 3);
+        net->emplace_layer<Dense<double, Sigmoid>>(64, 1, 4);
+    }
+    Tensor<double, 2> X(40, 8), Y(40, 1);
+    for (size_t i = 0; i < X.size(); ++i) X.data()[i] = std::sin(0.37 * double(i));
+    for (size_t i = 0; i < 40; ++i) Y(i, 0) = X(i, 0) * X(i, 1) > 0 ? 1 : 0;
+    const double expected = eager.train(X, Y, 20, 16, 0.1);
+    const double actual = planned.train_planned(X, Y, 20, 16, 0.1);
+    assert(std::abs(expected - actual) < 1e-12);
+    for (size_t p = 0; p < eager.parameters().size(); ++p) {
+        const auto& a = *eager.parameters()[p].value;
+        const auto& b = *planned.parameters()[p].value;
+        for (size_t i = 0; i < a.size(); ++i) assert(std::abs(a.data()[i] - b.data()[i]) < 1e-12);
+    }
+    // Lotes de 16 y un último lote de 8: un grafo por tamaño
+    assert(planned.planned_bytes(16) > 0 && planned.planned_bytes(8) > 0);
+
+    Graph<double> graph;
+    Tensor<double, 2> input(16, 8), target(16, 1);
+    graph.backward(mse(planned.capture(graph, input), graph.input(target)));
+    graph.compile();
+    assert(graph.planned_bytes() == planned.planned_bytes(16));
+    assert(graph.planned_bytes() * 10 < graph.unplanned_bytes() * 6);
+    std::cout << "Caso 14 OK\n";
+}
+
+void test_case_15() {
+    // Cuantización int8 por columna: error de redondeo de a lo más media escala
+    Tensor<float, 2> W(37, 21);
+    for (size_t i = 0; i < W.size(); ++i) W.data()[i] = std::sin(0.91f * float(i)) * float(1 + i % 5);
+    const QuantizedTensor Q(W);
+    assert(Q.shape() == W.shape() && Q.scales().size() == 21);
+    const auto restored = Q.dequantize();
+    for (size_t i = 0; i < 37; ++i)
+        for (size_t j = 0; j < 21; ++j) {
+            assert(std::abs(restored(i, j) - W(i, j)) <= 0.5f * Q.scale(j) + 1e-6f);
+            assert(Q.value(i, j) >= -127 && Q.value(i, j) <= 127);
+        }
+
+    // Producto int8 x int8 -> int32 exacto, con bordes de 4 filas y 16 columnas incompletos
+    Tensor<int8_t, 2> A(5, 37);
+    for (size_t i = 0; i < A.size(); ++i) A.data()[i] = int8_t(int(i * 37 % 255) - 127);
+    Tensor<int32_t, 2> C;
+    matrix_product(A, Q, C);
+    assert(C.shape()[0] == 5 && C.shape()[1] == 21);
+    for (size_t r = 0; r < 5; ++r)
+        for (size_t j = 0; j < 21; ++j) {
+            int32_t expected = 0;
+            for (size_t i = 0; i < 37; ++i) expected += int32_t(A(r, i)) * int32_t(Q.value(i, j));
+            assert(C(r, j) == expected);
+        }
+    bool threw = false;
+    try { matrix_product(Tensor<int8_t, 2>(5, 36), Q, C); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+
+    // Red cuantizada calibrada con muestras: salida cercana a la de punto flotante y ~4x menos bytes
+    NeuralNetwork<float> net;
+    net.emplace_layer<Dense<float>>(32, 128, 1);
+    net.emplace_layer<ReLU<float>>();
+    net.emplace_layer<Dense<float, ReLU>>(128, 128, 2);
+    net.emplace_layer<Dense<float>>(128, 4, 3);
+    Tensor<float, 2> X(64, 32);
+    for (size_t i = 0; i < X.size(); ++i) X.data()[i] = std::sin(0.37f * float(i));
+    QuantizedNetwork<float> quantized(net, X);
+    assert(quantized.inputs() == 32 && quantized.outputs() == 4);
+    float max_abs = 0;
+    for (size_t i = 0; i < X.size(); ++i) max_abs = std::max(max_abs, std::abs(X.data()[i]));
+    assert(std::abs(quantized.input_scale(0) - max_abs / 127) < 1e-6f);
+
+    const Tensor<float, 2> expected = net.forward(X);
+    float largest = 0, worst = 0;
+    for (size_t r = 0; r < 64; ++r) {
+        const float* y = quantized.forward(X.data() + r * 32);
+        for (size_t j = 0; j < 4; ++j) {
+            largest = std::max(largest, std::abs(expected(r, j)));
+            worst = std::max(worst, std::abs(y[j] - expected(r, j)));
+        }
+    }
+    assert(worst < 0.03f * largest);
+    size_t float_bytes = 0;
+    for (const auto& p : net.parameters()) float_bytes += p.value->size() * sizeof(float);
+    assert(quantized.parameter_bytes() * 3 < float_bytes);
+
+    // Calibrar con muestras de otro tamaño de entrada lanza excepción
+    threw = false;
+    try { QuantizedNetwork<float>(net, Tensor<float, 2>(4, 31)); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "Caso 15 OK\n";
+}
+
+void test_case_16() {
+    // Densa con pesos podados en CSR: x W + b con ReLU en el epílogo, igual que Dense::forward
+    Dense<double, ReLU> layer(37, 45, 5);
+    for (auto& w : layer.weights()) if (std::abs(w) < 0.2) w = 0;
+    for (size_t j = 0; j < 45; ++j) layer.bias()(0, j) = 0.01 * double(j);
+    const SparseTensor<double> pruned(layer.weights());
+    Tensor<double, 2> X(9, 37);
+    for (size_t i = 0; i < X.size(); ++i) X.data()[i] = i % 3 == 0 ? 0.0 : std::sin(0.7 * double(i));
+    Tensor<double, 2> Y;
+    matrix_product(X, pruned, Y, utec::neural_network::detail::bias_activation<double, ReLU<double>>{layer.bias().data()});
+    const auto& expected = layer.forward(X);
+    assert(Y.shape() == expected.shape());
+    for (size_t i = 0; i < Y.size(); ++i) assert(std::abs(Y.data()[i] - expected.data()[i]) < 1e-12);
+    std::cout << "Caso 16 OK\n";
+}
+
+void test_case_17() {
+    // El optimizador y su estado se conservan entre llamadas a train
+    auto make = [] {
+        NeuralNetwork<double> net(11);
+        net.emplace_layer<Dense<double, Sigmoid>>(2, 6, 1);
+        net.emplace_layer<Dense<double>>(6, 1, 2);
+        return net;
+    };
+    Tensor<double, 2> X(8, 2), Y(8, 1);
+    for (size_t i = 0; i < 8; ++i) {
+        X(i, 0) = double(i) / 8;
+        X(i, 1) = double(i % 3) / 3;
+        Y(i, 0) = X(i, 0) - X(i, 1);
+    }
+    NeuralNetwork<double> once = make(), twice = make();
+    assert(once.optimizer() == nullptr);
+    once.train<MSELoss, Adam>(X, Y, 4, 3, 0.01);
+    twice.train<MSELoss, Adam>(X, Y, 2, 3, 0.01);
+    auto* adam = dynamic_cast<Adam<double>*>(twice.optimizer());
+    assert(adam != nullptr && adam->steps() == 2 * 3);
+    twice.train<MSELoss, Adam>(X, Y, 2, 3, 0.01);
+    assert(twice.optimizer() == adam && adam->steps() == 4 * 3);
+    // Con los momentos conservados, 2 + 2 épocas dan exactamente los pesos de 4 seguidas
+    for (size_t p = 0; p < once.parameters().size(); ++p) {
+        const auto& a = *once.parameters()[p].value;
+        const auto& b = *twice.parameters()[p].value;
+        for (size_t i = 0; i < a.size(); ++i) assert(a.data()[i] == b.data()[i]);
+    }
+    // Otro tipo de optimizador lo reemplaza; el mismo tipo solo cambia la tasa
+    SGD<double>& sgd = twice.use_optimizer<SGD>(0.1);
+    assert(twice.optimizer() == &sgd && sgd.learning_rate() == 0.1);
+    assert(&twice.use_optimizer<SGD>(0.2) == &sgd && sgd.learning_rate() == 0.2);
+    std::cout << "Caso 17 OK\n";
+}
+
+void test_case_18() {
+    // Un optimizador configurado (momentum, betas) llega a train y a DataParallelTrainer
+    auto make = [] {
+        NeuralNetwork<double> net(5);
+        net.emplace_layer<Dense<double, Sigmoid>>(3, 8, 1);
+        net.emplace_layer<Dense<double>>(8, 2, 2);
+        return net;
+    };
+    Tensor<double, 2> X(24, 3), Y(24, 2);
+    for (size_t i = 0; i < 24; ++i) {
+        for (size_t j = 0; j < 3; ++j) X(i, j) = std::sin(double(i * 3 + j));
+        Y(i, 0) = X(i, 0) * X(i, 1);
+        Y(i, 1) = X(i, 2) - X(i, 0);
+    }
+    NeuralNetwork<double> net = make();
+    bool threw = false;
+    try { net.train(X, Y, 1, 8); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    net.set_optimizer(std::make_unique<SGD<double>>(0.2, 0.9));
+    const double first = net.train(X, Y, 1, 8);
+    const double last = net.train(X, Y, 200, 8);
+    assert(last < first);
+    assert(dynamic_cast<SGD<double>*>(net.optimizer())->momentum() == 0.9);
+
+    // DataParallelTrainer pasa por el optimizador de la red: Adam cuenta los pasos de ambas llamadas
+    const size_t previous_threads = utec::algebra::parallel::num_threads();
+    utec::algebra::parallel::set_num_threads(3);
+    NeuralNetwork<double> serial = make(), parallel = make();
+    serial.set_optimizer(std::make_unique<Adam<double>>(0.01, 0.8, 0.99));
+    parallel.set_optimizer(std::make_unique<Adam<double>>(0.01, 0.8, 0.99));
+    DataParallelTrainer<double> trainer(parallel, 3, 5);
+    serial.train(X, Y, 2, 12);
+    serial.train(X, Y, 2, 12);
+    trainer.train(X, Y, 2, 12);
+    trainer.train(X, Y, 2, 12);
+    assert(dynamic_cast<Adam<double>*>(parallel.optimizer())->steps() == 8);
+    for (size_t p = 0; p < serial.parameters().size(); ++p)
+        for (size_t e = 0; e < serial.parameters()[p].value->size(); ++e)
+            assert(std::abs(serial.parameters()[p].value->data()[e] - parallel.parameters()[p].value->data()[e]) < 1e-9);
+    utec::algebra::parallel::set_num_threads(previous_threads);
+    std::cout << "Caso 18 OK\n";
+}
+
+void test_case_19() {
+    // Graph: sum guarda su eje; sumar un eje de extensión 1 deja los valores como están
+    Tensor<double, 2> row(1, 3), column(4, 1), w(1, 3), target(1, 1);
+    row = {1, 2, 3};
+    column = {1, 2, 3, 4};
+    w = {0.5, -1, 2};
+    target = {0.5};
+    Graph<double> graph;
+    const auto r = graph.input(row);
+    const auto c = graph.input(column);
+    const auto kept_row = sum(r, 0);
+    const auto row_total = sum(r, 1);
+    const auto column_total = sum(c, 0);
+    const auto kept_column = sum(c, 1);
+    for (const auto& v : {kept_row, row_total, column_total, kept_column}) graph.keep(v);
+    const auto p = graph.parameter(w);
+    graph.backward(mse(sum(sum(p, 0), 1), graph.input(target)));
+    graph.run();
+
+    const auto a = graph.value_of(kept_row);
+    assert(a.shape()[0] == 1 && a.shape()[1] == 3 && a(0, 0) == 1 && a(0, 2) == 3);
+    assert(graph.value_of(row_total)(0, 0) == 6);
+    assert(graph.value_of(column_total)(0, 0) == 10);
+    const auto b = graph.value_of(kept_column);
+    assert(b.shape()[0] == 4 && b.shape()[1] == 1 && b(3, 0) == 4);
+    // (1.5 - 0.5)^2 y gradiente 2 (1.5 - 0.5) = 2 en cada peso
+    assert(std::abs(graph.loss() - 1.0) < 1e-12);
+    const auto& gradient = *graph.parameters()[0].gradient;
+    for (size_t j = 0; j < 3; ++j) assert(std::abs(gradient(0, j) - 2.0) < 1e-12);
+    std::cout << "Caso 19 OK\n";
+}
+
+int main() {
+    test_case_1();
+    test_case_2();
+    test_case_3();
+    test_case_4();
+    test_case_5();
+    test_case_6();
+    test_case_7();
+    test_case_8();
+    test_case_9();
+    test_case_10();
+    test_case_11();
+    test_case_12();
+    test_case_13();
+    test_case_14();
+    test_case_15();
+    test_case_16();
+    test_case_17();
+    test_case_18();
+    test_case_19();
+    std::cout << "Todos los tests pasaron correctamente ✅\n";
+    return 0;
+}
@@ -1,9 +1,65 @@
 #include <iostream>
 #include <cassert>
-#include "utec/algebra/Tensor.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utec/algebra/allocator.h"
+#include "utec/algebra/dispatch.h"
+#include "utec/algebra/half.h"
+#include "utec/algebra/parallel.h"
+#include "utec/algebra/reduction.h"
+#include "utec/algebra/simd.h"
+#include "utec/algebra/sparse.h"
+#include "utec/algebra/static_tensor.h"
+#include "utec/algebra/tensor.h"
 
 using namespace utec::algebra;
 
+// Valores reproducibles en [-1, 1]
+template<typename T, size_t N, typename Allocator>
+void randomize(Tensor<T, N, Allocator>& t, unsigned seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (auto& x : t) x = T(dist(engine));
+}
+
+// Producto de referencia con el triple bucle, acumulando en double
+template<typename A, typename B>
+auto naive_product(const A& a, const B& b) {
+    using T = std::remove_cvref_t<decltype(a(0, 0))>;
+    const size_t m = a.shape()[0], k = a.shape()[1], n = b.shape()[1];
+    Tensor<T, 2> c(m, n);
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            double sum = 0;
+            for (size_t p = 0; p < k; ++p) sum += double(a(i, p)) * double(b(p, j));
+            c(i, j) = T(sum);
+        }
+    }
+    return c;
+}
+
+template<typename T, size_t N>
+bool close(const Tensor<T, N>& x, const Tensor<T, N>& reference, double tolerance) {
+    if (x.shape() != reference.shape()) return false;
+    for (size_t i = 0; i < x.size(); ++i) {
+        const double r = double(reference.data()[i]);
+        if (std::abs(double(x.data()[i]) - r) > tolerance * (1.0 + std::abs(r))) return false;
+    }
+    return true;
+}
+
+template<typename T, size_t N>
+bool same(const Tensor<T, N>& x, const Tensor<T, N>& y) {
+    return x.shape() == y.shape() && std::equal(x.begin(), x.end(), y.begin());
+}
+
 void test_case_1() {
     Tensor<int, 2> t(2, 3);
     t.fill(7);
@@ -15,19 +71,21 @@ void test_case_1() {
 void test_case_2() {
     Tensor<int, 2> t2(2, 3);
     t2(1, 2) = 42;
-    t2.reshape({3, 2});
-    int y = t2({2, 1});
+    t2.reshape(3, 2);
+    int y = t2(2, 1);
     assert(y == 42);
     std::cout << "Caso 2 OK\n";
 }
 
 void test_case_3() {
+    // reshape redimensiona si cambia el número de elementos; un número de dimensiones distinto es un error
     bool exception_thrown = false;
     try {
         Tensor<int, 3> t3(2, 2, 2);
-        t3.reshape({2, 4, 1}); // 2*2*2=8 vs 2*4*1=8 => válido
-        t3.reshape({3, 3, 1}); // 9 != 8 => debe lanzar excepción
-    } catch (const std::invalid_argument&) {
+        t3.reshape(2, 4, 1); // 2*2*2=8 vs 2*4*1=8 => válido
+        assert(t3.size() == 8);
+        t3.reshape(3, 3); // 2 dimensiones para un tensor de rango 3 => debe lanzar excepción
+    } catch (const std::runtime_error&) {
         exception_thrown = true;
     }
     assert(exception_thrown);
@@ -77,13 +135,740 @@ void test_case_6() {
 void test_case_7() {
     Tensor<int, 2> m2(2, 3);
     m2(1, 0) = 99;
-    auto mt = m2.transpose_2d();
+    auto mt = transpose_2d(m2);
     auto expected_shape = std::array<size_t, 2>{3, 2};
     assert(mt.shape()[0] == expected_shape[0] && mt.shape()[1] == expected_shape[1]);
     assert(mt(0, 1) == 99);
     std::cout << "Caso 7 OK\n";
 }
 
+void test_case_8() {
+    // matrix_product contra el triple bucle, con tamaños impares que dejan bordes en los bloques
+    const size_t sizes[][3] = {{1, 1, 1}, {7, 13, 5}, {33, 65, 17}, {67, 31, 129}, {130, 257, 200}};
+    unsigned seed = 1;
+    for (const auto& s : sizes) {
+        const size_t m = s[0], k = s[1], n = s[2];
+        Tensor<float, 2> a(m, k), b(k, n);
+        randomize(a, seed++);
+        randomize(b, seed++);
+        assert(close(matrix_product(a, b), naive_product(a, b), 1e-5 * double(k)));
+
+        Tensor<double, 2> ad(m, k), bd(k, n);
+        randomize(ad, seed++);
+        randomize(bd, seed++);
+        assert(close(matrix_product(ad, bd), naive_product(ad, bd), 1e-13 * double(k)));
+
+        // Operandos transpuestos sin copia y filas con salto mayor que el ancho
+        Tensor<float, 2> at(k, m), bt(n, k), wide(m, k + 3);
+        randomize(at, seed++);
+        randomize(bt, seed++);
+        randomize(wide, seed++);
+        assert(close(matrix_product(at.transpose_view(), bt.transpose_view()),
+                     naive_product(at.transpose_view(), bt.transpose_view()), 1e-5 * double(k)));
+        const auto strided = wide.slice(1, 2, 2 + k);
+        assert(close(matrix_product(strided, b), naive_product(strided, b), 1e-5 * double(k)));
+    }
+
+    // Lotes: cada matriz de un tensor de rango 3 se multiplica por separado
+    Tensor<float, 3> x(3, 19, 23), y(3, 23, 11);
+    randomize(x, 40);
+    randomize(y, 41);
+    const auto z = matrix_product(x, y);
+    assert((z.shape() == std::array<size_t, 3>{3, 19, 11}));
+    for (size_t batch = 0; batch < 3; ++batch) {
+        const Tensor<float, 2> slice(z.select(0, batch));
+        assert(close(slice, naive_product(x.select(0, batch), y.select(0, batch)), 1e-4));
+    }
+
+    // Enteros: el camino sin kernel vectorial es exacto
+    Tensor<int, 2> ia(5, 7), ib(7, 3);
+    for (size_t i = 0; i < ia.size(); ++i) ia.data()[i] = int(i % 11) - 5;
+    for (size_t i = 0; i < ib.size(); ++i) ib.data()[i] = int(i % 7) - 3;
+    assert(same(matrix_product(ia, ib), naive_product(ia, ib)));
+
+    bool exception_thrown = false;
+    try {
+        (void)matrix_product(x, x);
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+
+    // Salida preasignada: se reutiliza su memoria y se rechaza si se solapa con un operando
+    Tensor<double, 2> p(20, 30), q(30, 20), out(20, 20), square(20, 20);
+    randomize(p, 42);
+    randomize(q, 43);
+    randomize(square, 44);
+    const double* storage = out.data();
+    matrix_product(p, q, out);
+    assert(out.data() == storage);
+    assert(close(out, naive_product(p, q), 1e-13 * 30));
+    bool overlap = false;
+    try {
+        matrix_product(square, square, square);
+    } catch (const std::runtime_error&) {
+        overlap = true;
+    }
+    assert(overlap);
+    std::cout << "Caso 8 OK\n";
+}
+
+template<typename T, size_t Bytes>
+void check_packets() {
+    using P = simd::packet<T, Bytes>;
+    constexpr size_t L = P::lanes;
+    T a[2 * L], b[L], out[L];
+    for (size_t i = 0; i < 2 * L; ++i) a[i] = T(i) - T(3.5);
+    for (size_t i = 0; i < L; ++i) b[i] = T(0.5) * T(i) + T(1);
+    const P x = P::load(a), y = P::load(b);
+
+    // Valores con pocos bits de mantisa: todas las operaciones son exactas
+    simd::fmadd(x, y, P::broadcast(T(2))).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == a[i] * b[i] + T(2));
+    (x - y).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == a[i] - b[i]);
+    (x / y).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == a[i] / b[i]);
+    (x + P::zero()).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == a[i]);
+    simd::max(x, y).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == std::max(a[i], b[i]));
+    P::gather(a, 2).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == a[2 * i]);
+
+    T total = 0;
+    for (size_t i = 0; i < L; ++i) total += a[i];
+    assert(simd::reduce_add(x) == total);
+    assert(simd::reduce_max(y) == b[L - 1]);
+    assert(simd::reduce_add(P::zero()) == T(0));
+
+    if constexpr (L >= 2) {
+        simd::interleave_low(x, y).store(out);
+        for (size_t i = 0; i < L; ++i) assert(out[i] == (i % 2 ? b[i / 2] : a[i / 2]));
+        simd::interleave_high(x, y).store(out);
+        for (size_t i = 0; i < L; ++i) assert(out[i] == (i % 2 ? b[L / 2 + i / 2] : a[L / 2 + i / 2]));
+    }
+}
+
+
+template<typename T>
+void check_packet_math() {
+    using P = simd::packet<T>;
+    constexpr size_t L = P::lanes;
+    T in[L], out[L];
+    for (size_t i = 0; i < L; ++i) in[i] = T(0.75) * T(i) + T(0.1);
+    simd::sqrt(P::load(in)).store(out);
+    for (size_t i = 0; i < L; ++i) assert(out[i] == std::sqrt(in[i]));
+    for (T start : {T(-20), T(-1.5), T(0), T(3), T(40)}) {
+        for (size_t i = 0; i < L; ++i) in[i] = start + T(0.37) * T(i);
+        simd::exp(P::load(in)).store(out);
+        const double tolerance = sizeof(T) == 4 ? 1e-6 : 1e-14;
+        for (size_t i = 0; i < L; ++i)
+            assert(std::abs(double(out[i]) - std::exp(double(in[i]))) <= tolerance * std::exp(double(in[i])));
+    }
+}
+
+void test_case_9() {
+    // Paquetes SIMD de 16, 32 y 64 bytes contra las operaciones escalares
+    check_packets<float, 16>();
+    check_packets<float, 32>();
+    check_packets<float, 64>();
+    check_packets<double, 16>();
+    check_packets<double, 32>();
+    check_packets<double, 64>();
+    check_packets<int, 32>();
+    check_packet_math<float>();
+    check_packet_math<double>();
+    std::cout << "Caso 9 OK\n";
+}
+
+void test_case_10() {
+    // Difusión: (3, 1) op (1, 4) => (3, 4), mezclada con escalares
+    Tensor<double, 2> column(3, 1), row(1, 4);
+    column = {1, 2, 3};
+    row = {10, 20, 30, 40};
+    Tensor<double, 2> grid = column * row + 1.0;
+    assert((grid.shape() == std::array<size_t, 2>{3, 4}));
+    assert(grid(2, 3) == 121 && grid(0, 0) == 11);
+    Tensor<double, 2> mixed = (row - column) / 2.0 + grid.view();
+    assert(mixed(1, 2) == 14 + 61);
+    Tensor<double, 2> flipped = 100.0 - grid;
+    assert(flipped(1, 1) == 59);
+
+    // Expresiones perezosas: se leen sin evaluarlas y se evalúan en una sola pasada
+    const auto lazy = 50.0 + (grid - 1.0) / 10.0;
+    assert((lazy.shape() == std::array<size_t, 2>{3, 4}) && lazy(2, 3) == 62);
+    Tensor<double, 2> ratio = grid / column;
+    assert(ratio(1, 0) == 10.5);
+    assert(transpose_2d(grid * 2.0)(3, 2) == 242);
+    assert(matrix_product(column * 1.0, row)(2, 3) == 120);
+
+    // El destino también es operando: cada elemento se lee antes de escribirse
+    Tensor<double, 2> sq(3, 3);
+    sq = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    sq = sq * 2.0 + sq;
+    assert(sq(0, 1) == 3 && sq(2, 2) == 24);
+
+    // Asignación con alias: el destino aparece traspuesto en la expresión
+    Tensor<double, 2> expected(3, 3);
+    for (size_t i = 0; i < 3; ++i)
+        for (size_t j = 0; j < 3; ++j) expected(i, j) = sq(i, j) * 2 + sq(j, i);
+    sq = sq * 2.0 + sq.transpose_view();
+    assert(same(sq, expected));
+
+    // Vistas que se solapan: se lee todo antes de escribir
+    Tensor<int, 1> line(8);
+    line = {0, 1, 2, 3, 4, 5, 6, 7};
+    line.slice(0, 1, 8).assign(line.slice(0, 0, 7));
+    Tensor<int, 1> shifted(8);
+    shifted = {0, 0, 1, 2, 3, 4, 5, 6};
+    assert(same(line, shifted));
+
+    // Una vista recibe una fila difundida a todas sus filas
+    grid.slice(0, 1, 3).assign(row);
+    assert(grid(0, 3) == 41 && grid(1, 3) == 40 && grid(2, 0) == 10);
+
+    bool exception_thrown = false;
+    try {
+        Tensor<double, 2> bad = grid + Tensor<double, 2>(3, 3);
+        (void)bad;
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 10 OK\n";
+}
+
+void test_case_11() {
+    // Vistas con saltos: select, slice, reshape y traspuesta sobre el mismo almacenamiento
+    Tensor<int, 3> cube(2, 3, 4);
+    for (size_t i = 0; i < cube.size(); ++i) cube.data()[i] = int(i);
+    const auto plane = cube.select(0, 1);
+    assert(plane.is_contiguous() && plane(2, 3) == 23);
+    const auto column = cube.select(2, 1);
+    assert((column.shape() == std::array<size_t, 2>{2, 3}));
+    assert(!column.is_contiguous() && column(1, 2) == 12 + 8 + 1);
+    const auto window = cube.slice(1, 1, 3);
+    assert(window(1, 0, 0) == 16 && window(0, 1, 3) == 11);
+    assert(cube.reshape_view(6, 4)(5, 3) == 23);
+    const auto swapped = cube.transpose_view();
+    assert((swapped.shape() == std::array<size_t, 3>{2, 4, 3}) && swapped(1, 3, 2) == cube(1, 2, 3));
+    assert(same(Tensor<int, 2>(column), Tensor<int, 2>(column * 1)));
+
+    bool reshape_thrown = false, slice_thrown = false, select_thrown = false;
+    try { (void)column.reshape(6); } catch (const std::runtime_error&) { reshape_thrown = true; }
+    try { (void)cube.slice(2, 2, 5); } catch (const std::out_of_range&) { slice_thrown = true; }
+    try { (void)cube.select(0, 2); } catch (const std::out_of_range&) { select_thrown = true; }
+    assert(reshape_thrown && slice_thrown && select_thrown);
+
+    column.fill(-1);
+    assert(cube(1, 2, 1) == -1 && cube(1, 2, 2) == 22);
+    const auto flipped = transpose_2d(window);
+    assert((flipped.shape() == std::array<size_t, 3>{2, 4, 2}) && flipped(1, 3, 0) == window(1, 0, 3));
+
+    // Traspuesta por bloques: tamaños que cortan los mosaicos, con lotes y varios tipos
+    const size_t dims[][3] = {{1, 1, 1}, {2, 37, 70}, {3, 65, 33}, {1, 128, 96}};
+    unsigned seed = 50;
+    for (const auto& d : dims) {
+        Tensor<float, 3> src(d[0], d[1], d[2]);
+        randomize(src, seed++);
+        const auto t = transpose_2d(src);
+        Tensor<double, 3> src_d(d[0], d[1], d[2]);
+        randomize(src_d, seed++);
+        const auto t_d = transpose_2d(src_d);
+        for (size_t b = 0; b < d[0]; ++b)
+            for (size_t i = 0; i < d[1]; ++i)
+                for (size_t j = 0; j < d[2]; ++j) assert(t(b, j, i) == src(b, i, j) && t_d(b, j, i) == src_d(b, i, j));
+
+        // Vista con filas más largas que su ancho: mismo kernel con otro salto de fila
+        if (d[2] > 2) {
+            const auto inner = src.slice(2, 1, d[2] - 1);
+            const auto ti = transpose_2d(inner);
+            for (size_t b = 0; b < d[0]; ++b)
+                for (size_t i = 0; i < d[1]; ++i)
+                    for (size_t j = 0; j + 2 < d[2]; ++j) assert(ti(b, j, i) == src(b, i, j + 1));
+        }
+    }
+
+    // Lotes sin salto uniforme: se recorren con el evaluador de expresiones
+    Tensor<short, 4> hyper(2, 3, 5, 7);
+    for (size_t i = 0; i < hyper.size(); ++i) hyper.data()[i] = short(i);
+    const auto part = hyper.slice(1, 0, 2);
+    const auto tp = transpose_2d(part);
+    assert((tp.shape() == std::array<size_t, 4>{2, 2, 7, 5}));
+    for (size_t a = 0; a < 2; ++a)
+        for (size_t b = 0; b < 2; ++b)
+            for (size_t i = 0; i < 5; ++i)
+                for (size_t j = 0; j < 7; ++j) assert(tp(a, b, j, i) == hyper(a, b, i, j));
+    std::cout << "Caso 11 OK\n";
+}
+
+void test_case_12() {
+    // Operadores compuestos: la difusión no puede cambiar la forma del destino
+    Tensor<float, 2> acc(3, 4), bias(1, 4);
+    acc.fill(1.0f);
+    bias = {1, 2, 3, 4};
+    acc += bias;
+    assert(acc(2, 3) == 5.0f && acc(0, 0) == 2.0f);
+    acc -= 1.0f;
+    acc *= 2.0f;
+    assert(acc(2, 3) == 8.0f);
+    acc /= bias;
+    assert(acc(0, 0) == 2.0f && acc(2, 3) == 2.0f);
+    acc *= acc.view();
+    assert(acc(1, 2) == 4.0f);
+    bool exception_thrown = false;
+    try {
+        bias += acc;
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+
+    // Forma de parámetro de salida: se adapta la forma una vez y después se reutiliza la memoria
+    Tensor<float, 2> out;
+    add(acc, bias, out);
+    assert(out.shape() == acc.shape() && out(2, 3) == 8.0f);
+    const float* storage = out.data();
+    subtract(acc, bias, out);
+    assert(out.data() == storage && out(2, 3) == 0.0f);
+    multiply(acc, 3.0f, out);
+    assert(out.data() == storage && out(0, 1) == 12.0f);
+    divide(bias, acc, out);
+    assert(out.data() == storage && out(1, 3) == 1.0f);
+    add(out, out, out);
+    assert(out(1, 3) == 2.0f);
+
+    // Salida en una vista: solo se escriben las filas que cubre
+    Tensor<float, 2> big(5, 4);
+    big.fill(-1.0f);
+    add(acc, bias, big.slice(0, 1, 4));
+    assert(big(0, 0) == -1.0f && big(1, 0) == 5.0f && big(3, 3) == 8.0f && big(4, 3) == -1.0f);
+    std::cout << "Caso 12 OK\n";
+}
+
+void test_case_13() {
+    // Tensores alineados al tamaño de línea de caché
+    Tensor<float, 2> aligned(3, 5);
+    assert(reinterpret_cast<std::uintptr_t>(aligned.data()) % tensor_alignment == 0);
+
+    // Arena: rewind devuelve la misma memoria; reset une los bloques desbordados en uno
+    arena a(1024);
+    assert(a.capacity() == 0 && a.used() == 0);
+    void* first = a.allocate(100);
+    assert(reinterpret_cast<std::uintptr_t>(first) % tensor_alignment == 0);
+    const auto mark = a.position();
+    void* second = a.allocate(200);
+    assert(second != first && reinterpret_cast<std::uintptr_t>(second) % tensor_alignment == 0);
+    a.rewind(mark);
+    assert(a.allocate(200) == second);
+    a.allocate(2000);
+    assert(a.capacity() == 1024 + 2000);
+    assert(a.used() > 2000);
+    a.reset();
+    assert(a.capacity() == 1024 + 2000 && a.used() == 0);
+    a.allocate(2500);
+    assert(a.capacity() == 1024 + 2000);
+    {
+        arena_scope scope(a);
+        a.allocate(64);
+        assert(a.used() > 2500);
+    }
+    assert(a.used() == 2500);
+
+    // Tensores sobre la arena del hilo: arena_scope libera todo al salir
+    arena& local = arena::local();
+    const size_t before = local.used();
+    {
+        arena_scope scope;
+        Tensor<float, 2, arena_allocator<float>> x(8, 8), y(8, 8);
+        x.fill(1.0f);
+        y.fill(2.0f);
+        const auto z = matrix_product(x, y);
+        assert(z(7, 7) == 16.0f);
+        assert(reinterpret_cast<std::uintptr_t>(z.data()) % tensor_alignment == 0);
+        assert(local.used() > before);
+    }
+    assert(local.used() == before);
+    std::cout << "Caso 13 OK\n";
+}
+
+void test_case_14() {
+    // El resultado no depende del número de hilos; se bajan los umbrales para forzar el reparto
+    const parallel::settings saved = parallel::config();
+    Tensor<float, 2> a(97, 101), b(101, 89);
+    randomize(a, 60);
+    randomize(b, 61);
+    Tensor<double, 3> m(2, 70, 45);
+    randomize(m, 62);
+    Tensor<float, 1> u(100000), v(100000);
+    randomize(u, 63);
+    randomize(v, 64);
+
+    parallel::set_num_threads(1);
+    const auto product = matrix_product(a, b);
+    const auto transposed = transpose_2d(m);
+    const Tensor<float, 1> sum = u * v + u;
+
+    for (size_t threads : {1, 2, 3, 5}) {
+        parallel::set_num_threads(threads);
+        parallel::set_grain_size(64);
+        parallel::set_gemm_grain(1);
+        assert(parallel::num_threads() == threads);
+
+        // Cada índice se visita exactamente una vez, también con parallel_for anidados
+        std::vector<int> hits(1000, 0);
+        parallel::parallel_for(0, 1000, 7, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) ++hits[i];
+        });
+        parallel::parallel_for(0, 0, 1, [&](size_t, size_t) { assert(false); });
+        std::vector<int> nested(10 * 100, 0);
+        parallel::parallel_for(0, 10, 1, [&](size_t r0, size_t r1) {
+            for (size_t r = r0; r < r1; ++r) {
+                parallel::parallel_for(0, 100, 3, [&](size_t c0, size_t c1) {
+                    for (size_t c = c0; c < c1; ++c) ++nested[r * 100 + c];
+                });
+            }
+        });
+        assert(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+        assert(std::all_of(nested.begin(), nested.end(), [](int h) { return h == 1; }));
+
+        assert(same(matrix_product(a, b), product));
+        assert(same(transpose_2d(m), transposed));
+        assert(same(Tensor<float, 1>(u * v + u), sum));
+    }
+
+    parallel::set_num_threads(saved.num_threads);
+    parallel::set_grain_size(saved.grain_size);
+    parallel::set_gemm_grain(saved.gemm_grain);
+    std::cout << "Caso 14 OK\n";
+}
+
+void test_case_15() {
+    // Variante ISA activa: nunca por encima de la detectada, y UTEC_ISA la puede bajar.
+    // CMake ejecuta este test además con UTEC_ISA=baseline y UTEC_ISA=avx2.
+    const dispatch::isa detected = dispatch::detect();
+    const dispatch::isa active = dispatch::active();
+    assert(active <= detected);
+    if (const char* env = std::getenv("UTEC_ISA")) {
+        const std::string_view requested(env);
+        if (requested == "baseline") assert(active == dispatch::isa::baseline);
+        if (requested == "avx2") assert(active == std::min(detected, dispatch::isa::avx2));
+        if (requested == "avx512") assert(active == detected);
+    } else {
+        assert(active == detected);
+    }
+    assert(std::string_view(dispatch::name(dispatch::isa::baseline)) == "baseline");
+    assert(std::string_view(dispatch::name(dispatch::isa::avx2)) == "avx2");
+    assert(std::string_view(dispatch::name(dispatch::isa::avx512)) == "avx512");
+
+    const size_t bytes = dispatch::vector_bytes();
+    assert(bytes >= simd::native_bytes);
+    if (active == dispatch::isa::avx512) assert(bytes == 64);
+    if (active == dispatch::isa::avx2) assert(bytes == std::max<size_t>(32, simd::native_bytes));
+    if (active == dispatch::isa::baseline) assert(bytes == simd::native_bytes);
+    if (dispatch::vnni()) assert(active == dispatch::isa::avx512);
+
+    // UTEC_ISA solo baja el nivel; un nombre desconocido es un error
+    assert(dispatch::limit("baseline", dispatch::isa::avx512) == dispatch::isa::baseline);
+    assert(dispatch::limit("avx2", dispatch::isa::avx512) == dispatch::isa::avx2);
+    assert(dispatch::limit("avx512", dispatch::isa::avx2) == dispatch::isa::avx2);
+    assert(dispatch::limit("", dispatch::isa::avx2) == dispatch::isa::avx2);
+    bool unknown_thrown = false;
+    try {
+        (void)dispatch::limit("sse2", dispatch::isa::avx512);
+    } catch (const std::runtime_error&) {
+        unknown_thrown = true;
+    }
+    assert(unknown_thrown);
+
+    // select elige la variante del ancho activo, o la nativa si el objetivo ya es igual de ancho
+    using kernel = int (*)();
+    const kernel narrow = [] { return 16; };
+    const kernel avx2 = [] { return 32; };
+    const kernel avx512 = [] { return 64; };
+    const int chosen = dispatch::select(narrow, avx2, avx512)();
+    assert(chosen == (bytes > simd::native_bytes ? int(bytes) : 16));
+    assert(dispatch::select(narrow)() == 16);
+    std::cout << "Caso 15 OK (" << dispatch::name(active) << ")\n";
+}
+
+// Producto evaluado en tiempo de compilación: todos los tamaños son constantes
+constexpr auto static_product = [] {
+    StaticTensor<int, 2, 3> a;
+    StaticTensor<int, 3, 2> b;
+    a = {1, 2, 3, 4, 5, 6};
+    b = {7, 8, 9, 10, 11, 12};
+    return matrix_product(a, b);
+}();
+static_assert(static_product(0, 0) == 58 && static_product(1, 1) == 154);
+
+void test_case_16() {
+    // StaticTensor: matrix_product contra el del Tensor dinámico, con una matriz y con lotes
+    StaticTensor<float, 5, 7> a;
+    StaticTensor<float, 7, 3> b;
+    for (size_t i = 0; i < a.size(); ++i) a.data()[i] = float(i % 5) - 2.0f;
+    for (size_t i = 0; i < b.size(); ++i) b.data()[i] = 0.25f * float(i % 9);
+    const auto c = matrix_product(a, b);
+    static_assert(std::is_same_v<std::remove_const_t<decltype(c)>, StaticTensor<float, 5, 3>>);
+    assert(same(c.to_tensor(), matrix_product(a.to_tensor(), b.to_tensor())));
+
+    StaticTensor<double, 2, 3, 5> x;
+    StaticTensor<double, 2, 5, 4> y;
+    for (size_t i = 0; i < x.size(); ++i) x.data()[i] = 0.5 * double(i) - 7.0;
+    for (size_t i = 0; i < y.size(); ++i) y.data()[i] = double(i % 6) - 2.5;
+    const auto z = matrix_product(x, y);
+    assert(close(z.to_tensor(), matrix_product(x.to_tensor(), y.to_tensor()), 1e-14));
+    assert(same(transpose_2d(c).to_tensor(), transpose_2d(c.to_tensor())));
+
+    // Operaciones elemento a elemento, con difusión resuelta en tiempo de compilación
+    StaticTensor<float, 3, 1> column;
+    StaticTensor<float, 1, 4> row;
+    column = {1, 2, 3};
+    row = {10, 20, 30, 40};
+    const auto grid = column * row + 1.0f;
+    static_assert(std::is_same_v<std::remove_const_t<decltype(grid)>, StaticTensor<float, 3, 4>>);
+    assert(grid(2, 3) == 121.0f && grid(0, 1) == 21.0f);
+    const auto mixed = (100.0f - grid) / 2.0f - row;
+    assert(mixed(2, 3) == (100.0f - 121.0f) / 2.0f - 40.0f);
+    StaticTensor<float, 3, 4> acc(1.0f);
+    acc += row;
+    acc *= 2.0f;
+    acc -= grid;
+    acc /= StaticTensor<float, 3, 4>(2.0f);
+    assert(acc(1, 2) == ((1.0f + 30.0f) * 2.0f - 61.0f) / 2.0f);
+    const Tensor<float, 2> dynamic = column.to_tensor() * row.to_tensor() + 1.0f;
+    assert(same(grid.to_tensor(), dynamic));
+
+    // De Tensor a StaticTensor: desde un tensor, una vista con saltos (difundida) o una expresión
+    Tensor<float, 2> source(3, 4);
+    for (size_t i = 0; i < source.size(); ++i) source.data()[i] = float(i);
+    const StaticTensor<float, 3, 4> copied(source);
+    assert(copied(2, 3) == 11.0f);
+    const StaticTensor<float, 3, 2> strided(source.slice(1, 1, 3));
+    assert(strided(2, 0) == 9.0f && strided(0, 1) == 2.0f);
+    const StaticTensor<float, 3, 4> broadcast(source.slice(0, 1, 2));
+    assert(broadcast(0, 2) == 6.0f && broadcast(2, 2) == 6.0f);
+    const StaticTensor<float, 3, 4> evaluated(source * 2.0f + dynamic);
+    assert(evaluated(1, 1) == 10.0f + 41.0f);
+
+    // De StaticTensor a Tensor: su vista entra en expresiones, matrix_product y asignaciones
+    const Tensor<float, 2> sum = copied.view() + source;
+    assert(sum(2, 3) == 22.0f);
+    const Tensor<float, 2> product = matrix_product(a.view(), b.to_tensor());
+    assert(same(product, c.to_tensor()));
+    StaticTensor<float, 3, 4> target;
+    target.view().assign(source.transpose_view().transposed());
+    assert(same(target.to_tensor(), source));
+    static_assert(alignof(StaticTensor<float, 4>) == 16 && alignof(StaticTensor<float, 64>) == tensor_alignment);
+    std::cout << "Caso 16 OK\n";
+}
+
+void test_case_17() {
+    // Precisión mixta: bfloat16/float16 almacenados, productos acumulados en float
+    assert(float(bfloat16(1.0f + 1.0f / 256)) == 1.0f);          // empate: redondea al par
+    assert(float(bfloat16(1.0f + 3.0f / 256)) == 1.0f + 4.0f / 256);
+    assert(float(float16(65504.0f)) == 65504.0f && std::isinf(float(float16(70000.0f))));
+    assert(float(float16(5.96e-8f)) == std::ldexp(1.0f, -24));  // subnormal mínimo
+
+    const size_t m = 5, k = 1000, n = 19;
+    Tensor<float, 2> a(m, k), b(k, n);
+    for (size_t i = 0; i < a.size(); ++i) a.data()[i] = float(bfloat16(std::sin(double(i))));
+    for (size_t i = 0; i < b.size(); ++i) b.data()[i] = float(bfloat16(std::cos(double(i))));
+    const auto a16 = convert<bfloat16>(a);
+    const auto b16 = convert<bfloat16>(b);
+    const auto c16 = matrix_product(a16, b16);
+    const auto reference = matrix_product<double>(a, b);
+    Tensor<float, 2> c;
+    convert(c16, c);
+    for (size_t i = 0; i < m; ++i)
+        for (size_t j = 0; j < n; ++j) {
+            double exact = 0;
+            for (size_t p = 0; p < k; ++p) exact += double(a(i, p)) * double(b(p, j));
+            assert(std::abs(reference(i, j) - exact) < 1e-3);
+            // un solo redondeo a bfloat16 al final: |error| <= 2^-8 relativo
+            assert(std::abs(c(i, j) - exact) <= std::abs(exact) / 256 + 1e-3);
+        }
+
+    Tensor<float16, 2> h(2, 2), out;
+    h = {float16(1.0f), float16(2.0f), float16(3.0f), float16(4.0f)};
+    matrix_product(h, h, out);
+    assert(float(out(0, 0)) == 7 && float(out(0, 1)) == 10 && float(out(1, 0)) == 15 && float(out(1, 1)) == 22);
+    std::cout << "Caso 17 OK\n";
+}
+
+void test_case_18() {
+    // Formato binario: save, load con copia, load_mmap sin copia y errores de formato
+    // Un archivo por variante ISA: ctest puede correr las tres a la vez
+    const char* isa = std::getenv("UTEC_ISA");
+    const std::string name = "utec_test_tensor_" + std::string(isa ? isa : "native") + ".bin";
+    const std::string path = (std::filesystem::temp_directory_path() / name).string();
+    Tensor<float, 3> t(2, 3, 5);
+    for (size_t i = 0; i < t.size(); ++i) t.data()[i] = std::sin(float(i));
+    t.save(path);
+
+    const auto loaded = Tensor<float, 3>::load(path);
+    assert(loaded.shape() == t.shape() && std::equal(loaded.begin(), loaded.end(), t.begin()));
+    const auto mapped = Tensor<float, 3>::load_mmap(path);
+    assert(mapped.shape() == t.shape() && mapped(1, 2, 4) == t(1, 2, 4));
+    assert(reinterpret_cast<uintptr_t>(mapped.data()) % tensor_alignment == 0);
+    const auto product = matrix_product(mapped.view().select(0, 1), t.select(0, 0).transposed());
+    const auto expected = matrix_product(t.select(0, 1), t.select(0, 0).transposed());
+    assert(std::equal(product.begin(), product.end(), expected.begin()));
+
+    auto throws = [&](auto&& load) {
+        try {
+            load();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(throws([&] { Tensor<double, 3>::load_mmap(path); }));
+    assert(throws([&] { Tensor<float, 2>::load(path); }));
+    std::filesystem::resize_file(path, 100);
+    assert(throws([&] { Tensor<float, 3>::load(path); }));
+    std::ofstream(path) << "no es un tensor";
+    assert(throws([&] { Tensor<float, 3>::load_mmap(path); }));
+
+    // Forma cuyo número de elementos desborda size_t: 2^62 * 4 daría 0 y pasaría por un archivo vacío
+    Tensor<float, 2>(2, 3).save(path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        const uint64_t extents[2] = {uint64_t(1) << 62, 4};
+        file.seekp(std::streamoff(serialization::fixed_header));
+        file.write(reinterpret_cast<const char*>(extents), sizeof(extents));
+    }
+    assert(throws([&] { Tensor<float, 2>::load(path); }));
+    assert(throws([&] { Tensor<float, 2>::load_mmap(path); }));
+    std::filesystem::remove(path);
+    std::cout << "Caso 18 OK\n";
+}
+
+void test_case_19() {
+    // Reducciones por eje y totales contra referencias escalares (tamaños impares, varios bloques)
+    const size_t grain = parallel::grain_size();
+    parallel::set_grain_size(512);
+    Tensor<float, 3> x(5, 37, 67);
+    for (size_t i = 0; i < x.size(); ++i) x.data()[i] = float(std::sin(double(i) * 0.7) * 3);
+    for (size_t axis = 0; axis < 3; ++axis) {
+        const auto s = sum(x, axis);
+        const auto m = mean(x, axis);
+        const auto mx = max(x, axis);
+        const auto am = argmax(x, axis);
+        const auto sm = softmax(x, axis);
+        auto expected = x.shape();
+        expected[axis] = 1;
+        assert(s.shape() == expected && am.shape() == expected && sm.shape() == x.shape());
+        for (size_t i = 0; i < expected[0]; ++i)
+            for (size_t j = 0; j < expected[1]; ++j)
+                for (size_t k = 0; k < expected[2]; ++k) {
+                    double total = 0;
+                    float best = -INFINITY;
+                    size_t best_index = 0;
+                    for (size_t r = 0; r < x.shape()[axis]; ++r) {
+                        const float v = axis == 0 ? x(r, j, k) : axis == 1 ? x(i, r, k) : x(i, j, r);
+                        total += v;
+                        if (v > best) best = v, best_index = r;
+                    }
+                    double normalizer = 0;
+                    for (size_t r = 0; r < x.shape()[axis]; ++r) {
+                        const float v = axis == 0 ? x(r, j, k) : axis == 1 ? x(i, r, k) : x(i, j, r);
+                        normalizer += std::exp(double(v) - best);
+                    }
+                    for (size_t r = 0; r < x.shape()[axis]; ++r) {
+                        const float v = axis == 0 ? x(r, j, k) : axis == 1 ? x(i, r, k) : x(i, j, r);
+                        const float y = axis == 0 ? sm(r, j, k) : axis == 1 ? sm(i, r, k) : sm(i, j, r);
+                        assert(std::abs(y - std::exp(double(v) - best) / normalizer) < 1e-6);
+                    }
+                    assert(std::abs(s(i, j, k) - total) < 1e-4);
+                    assert(std::abs(m(i, j, k) - total / double(x.shape()[axis])) < 1e-5);
+                    assert(mx(i, j, k) == best && am(i, j, k) == best_index);
+                }
+    }
+
+    // Suma total: la suma por pares de float sigue a la de double en un millón de términos
+    Tensor<float, 1> big(1000003);
+    double exact = 0;
+    for (size_t i = 0; i < big.size(); ++i) {
+        big(i) = 0.1f + float(i % 7) * 1e-3f;
+        exact += big(i);
+    }
+    assert(std::abs(sum(big) - exact) < exact * 1e-6);
+    assert(std::abs(mean(big) - exact / double(big.size())) < 1e-6);
+    big(123457) = 5;
+    big(900001) = 5;
+    assert(max(big) == 5 && argmax(big) == 123457);  // empate: el primer índice
+    parallel::set_grain_size(grain);
+
+    // Vistas no contiguas y expresiones se materializan antes de reducir
+    Tensor<float, 2> a(3, 4);
+    a = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const auto column_sums = sum(a.transpose_view(), 1);
+    assert(column_sums(0, 0) == 15 && column_sums(3, 0) == 24);
+    assert(sum(a * a) == 650);
+
+    // softmax estable con logits grandes
+    Tensor<double, 2> logits(2, 3);
+    logits = {1000, 1001, 1002, -1000, -1000, -1000};
+    const auto p = softmax(logits, 1);
+    assert(std::abs(p(0, 0) + p(0, 1) + p(0, 2) - 1) < 1e-12 && p(0, 2) > p(0, 1));
+    assert(std::abs(p(1, 0) - 1.0 / 3) < 1e-12);
+
+    bool exception_thrown = false;
+    try {
+        sum(a, 2);
+    } catch (const std::out_of_range&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    exception_thrown = false;
+    try {
+        max(Tensor<float, 2>(0, 3));
+    } catch (const std::runtime_error&) {
+        exception_thrown = true;
+    }
+    assert(exception_thrown);
+    std::cout << "Caso 19 OK\n";
+}
+
+void test_case_20() {
+    // SparseTensor CSR: conversión desde denso, acceso por índice y vuelta a denso
+    Tensor<double, 2> W(45, 37);
+    for (size_t i = 0; i < W.size(); ++i) W.data()[i] = i % 7 == 0 ? std::sin(0.3 * double(i)) : 0.0;
+    const SparseTensor<double> S(W);
+    assert(S.rows() == 45 && S.columns() == 37);
+    size_t nonzeros = 0;
+    for (double v : W) nonzeros += v != 0.0;
+    assert(S.nonzeros() == nonzeros && S.row_offsets().size() == 46);
+    assert(S.density() < 0.15 && S.bytes() * 3 < W.size() * sizeof(double));
+    assert(S(1, 0) == 0.0 && S(0, 7) == W(0, 7) && S(0, 7) != 0.0);
+    const auto restored = S.to_dense();
+    for (size_t i = 0; i < W.size(); ++i) assert(restored.data()[i] == W.data()[i]);
+    const SparseTensor<double> large(W, 0.5);
+    for (double v : large.values()) assert(std::abs(v) > 0.5);
+
+    // Producto disperso-denso: coincide con matrix_product denso, también con un operando traspuesto
+    Tensor<double, 2> B(37, 70), Bt(70, 37);
+    for (size_t i = 0; i < B.size(); ++i) B.data()[i] = std::cos(0.11 * double(i));
+    for (size_t i = 0; i < 37; ++i)
+        for (size_t j = 0; j < 70; ++j) Bt(j, i) = B(i, j);
+    const auto dense = matrix_product(W, B);
+    const auto sparse = matrix_product(S, B);
+    Tensor<double, 2> strided;
+    matrix_product(S, Bt.transpose_view(), strided);
+    assert(sparse.shape() == dense.shape() && strided.shape() == dense.shape());
+    for (size_t i = 0; i < dense.size(); ++i) {
+        assert(std::abs(sparse.data()[i] - dense.data()[i]) < 1e-12);
+        assert(std::abs(strided.data()[i] - dense.data()[i]) < 1e-12);
+    }
+
+    bool threw = false;
+    try { matrix_product(S, Tensor<double, 2>(36, 4)); } catch (const std::runtime_error&) { threw = true; }
+    assert(threw);
+    std::cout << "Caso 20 OK\n";
+}
+
 int main() {
     test_case_1();
     test_case_2();
@@ -92,6 +877,19 @@ int main() {
     test_case_5();
     test_case_6();
     test_case_7();
+    test_case_8();
+    test_case_9();
+    test_case_10();
+    test_case_11();
+    test_case_12();
+    test_case_13();
+    test_case_14();
+    test_case_15();
+    test_case_16();
+    test_case_17();
+    test_case_18();
+    test_case_19();
+    test_case_20();
     std::cout << "Todos los tests pasaron correctamente ✅\n";
     return 0;
-}
\ No newline at end of file
+}